@@ -88,3 +88,41 @@ function(bmmidi_gtest name)
   gtest_discover_tests(BMMidi_${name}
       WORKING_DIRECTORY ${BMMidi_BINARY_DIR}/stage/${CMAKE_INSTALL_BINDIR})
 endfunction()
+
+## Adds fuzz target executable named BMMidi_${name}, built from the remaining
+## arguments (which must define LLVMFuzzerTestOneInput()), with seed corpus in
+## ${BMMidi_SOURCE_DIR}/fuzz/corpus/${corpusDir}/.
+##
+## If BMMidi_ENABLE_FUZZING, links with libFuzzer (requires Clang). Otherwise,
+## links the standalone fuzz_main.cpp driver, which replays input files (or
+## stdin, e.g. under AFL) and reports throughput.
+##
+## Either way, if testing for this project is enabled, also adds a CTest test
+## that replays the seed corpus.
+function(bmmidi_fuzzer name corpusDir)
+  add_executable(BMMidi_${name} ${ARGN})
+
+  # Always include the src/ dir as a base include path.
+  target_include_directories(BMMidi_${name}
+      PRIVATE ${BMMidi_SOURCE_DIR}/src)
+
+  target_compile_features(BMMidi_${name} PRIVATE cxx_std_14)
+  bmmidi_enable_warnings(${name})
+
+  set(corpusPath ${BMMidi_SOURCE_DIR}/fuzz/corpus/${corpusDir})
+  if(BMMidi_ENABLE_FUZZING)
+    target_link_options(BMMidi_${name}
+        PRIVATE -fsanitize=fuzzer)
+    set(replayArgs -runs=0 ${corpusPath})
+  else()
+    target_sources(BMMidi_${name}
+        PRIVATE ${BMMidi_SOURCE_DIR}/fuzz/fuzz_main.cpp)
+    file(GLOB corpusFiles ${corpusPath}/*.bin)
+    set(replayArgs --repeat=20 --min-bytes-per-sec=100000 ${corpusFiles})
+  endif()
+
+  if(BMMidi_ENABLE_TESTING)
+    add_test(NAME ${name}.Corpus
+        COMMAND BMMidi_${name} ${replayArgs})
+  endif()
+endfunction()
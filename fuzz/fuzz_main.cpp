@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Standalone driver for fuzz targets built without libFuzzer: runs
+// LLVMFuzzerTestOneInput() on each input file (or on stdin if no files are
+// given, e.g. when run under AFL), and reports throughput so that corpus
+// replays double as performance regression checks.
+//
+// Usage: <fuzzer> [--repeat=N] [--min-bytes-per-sec=X] [FILE...]
+//
+// --repeat=N             Runs each input N times (for more stable timing).
+// --min-bytes-per-sec=X  Fails if any input of at least 4 KiB (or the corpus as
+//                        a whole) is processed slower than X bytes/s, which
+//                        catches pathological (e.g. quadratic) inputs.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+namespace {
+
+constexpr std::size_t kMinTimedInputBytes = 4096;
+
+using Clock = std::chrono::steady_clock;
+
+struct Input {
+  std::string name;
+  std::vector<std::uint8_t> bytes;
+};
+
+bool readInput(std::istream& in, const std::string& name, std::vector<Input>& inputs) {
+  if (!in) {
+    std::cerr << "Failed to open " << name << "\n";
+    return false;
+  }
+  Input input;
+  input.name = name;
+  input.bytes.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+  inputs.push_back(std::move(input));
+  return true;
+}
+
+bool startsWith(const char* arg, const char* prefix) {
+  return std::strncmp(arg, prefix, std::strlen(prefix)) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int numRepeats = 1;
+  double minBytesPerSec = 0.0;
+  std::vector<Input> inputs;
+
+  for (int i = 1; i < argc; ++i) {
+    if (startsWith(argv[i], "--repeat=")) {
+      numRepeats = std::atoi(argv[i] + std::strlen("--repeat="));
+    } else if (startsWith(argv[i], "--min-bytes-per-sec=")) {
+      minBytesPerSec = std::atof(argv[i] + std::strlen("--min-bytes-per-sec="));
+    } else {
+      std::ifstream file{argv[i], std::ios::binary};
+      if (!readInput(file, argv[i], inputs)) { return EXIT_FAILURE; }
+    }
+  }
+  if (inputs.empty()) { readInput(std::cin, "<stdin>", inputs); }
+  if (numRepeats < 1) { numRepeats = 1; }
+
+  bool isTooSlow = false;
+  double slowestBytesPerSec = 0.0;
+  std::string slowestName;
+  std::size_t totalBytes = 0;
+  double totalSeconds = 0.0;
+
+  for (const Input& input : inputs) {
+    const auto start = Clock::now();
+    for (int r = 0; r < numRepeats; ++r) {
+      LLVMFuzzerTestOneInput(input.bytes.data(), input.bytes.size());
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const std::size_t numBytes = input.bytes.size() * numRepeats;
+    totalBytes += numBytes;
+    totalSeconds += seconds;
+
+    if ((input.bytes.size() >= kMinTimedInputBytes) && (seconds > 0.0)) {
+      const double bytesPerSec = numBytes / seconds;
+      if (slowestName.empty() || (bytesPerSec < slowestBytesPerSec)) {
+        slowestBytesPerSec = bytesPerSec;
+        slowestName = input.name;
+      }
+      if (bytesPerSec < minBytesPerSec) { isTooSlow = true; }
+    }
+  }
+
+  const double totalBytesPerSec = (totalSeconds > 0.0) ? (totalBytes / totalSeconds) : 0.0;
+  std::printf("Ran %zu inputs x %d: %zu bytes in %.6f s (%.0f bytes/s)\n",
+              inputs.size(), numRepeats, totalBytes, totalSeconds, totalBytesPerSec);
+  if (!slowestName.empty()) {
+    std::printf("Slowest input: %s (%.0f bytes/s)\n", slowestName.c_str(), slowestBytesPerSec);
+  }
+
+  if ((minBytesPerSec > 0.0) && (totalSeconds > 0.0) && (totalBytesPerSec < minBytesPerSec)) {
+    isTooSlow = true;
+  }
+  if (isTooSlow) {
+    std::printf("FAILED: throughput below --min-bytes-per-sec=%.0f\n", minBytesPerSec);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
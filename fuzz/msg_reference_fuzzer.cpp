@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Fuzz target for MsgReference (and its typed subclass) constructors and
+// accessors.
+//
+// The input is first checked with isValidMsg(), exactly as code handling
+// untrusted bytes should. Valid input is then referenced through every
+// applicable reference type, checking that accessors stay in bounds and that
+// setters round-trip.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+#include "bmmidi/sysex.hpp"
+
+namespace {
+
+constexpr std::size_t kMaxInputBytes = 1 << 20;
+
+void check(bool condition) {
+  if (!condition) { std::abort(); }
+}
+
+void exerciseChanMsg(bmmidi::MsgRef msg) {
+  const std::vector<std::uint8_t> original(msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+  auto chanMsg = msg.asRef<bmmidi::ChanMsgRef>();
+  const bmmidi::Channel channel = chanMsg.channel();
+  check(channel.isNormal());
+  chanMsg.setChannel(bmmidi::Channel::index((channel.index() + 1) % bmmidi::kNumChannels));
+  chanMsg.setChannel(channel);
+
+  switch (msg.type()) {
+    case bmmidi::MsgType::kNoteOff:
+    case bmmidi::MsgType::kNoteOn: {
+      auto note = msg.asRef<bmmidi::NoteMsgRef>();
+      check(note.isNoteOn() != note.isNoteOff());
+      note.setKey(note.key());
+      note.setVelocity(note.velocity());
+      break;
+    }
+
+    case bmmidi::MsgType::kPolyphonicKeyPressure: {
+      auto keyPressure = msg.asRef<bmmidi::KeyPressureMsgRef>();
+      keyPressure.setKey(keyPressure.key());
+      keyPressure.setPressure(keyPressure.pressure());
+      break;
+    }
+
+    case bmmidi::MsgType::kControlChange: {
+      auto cc = msg.asRef<bmmidi::ControlChangeMsgRef>();
+      cc.setControl(cc.control());
+      cc.setValue(cc.value());
+      break;
+    }
+
+    case bmmidi::MsgType::kProgramChange: {
+      auto program = msg.asRef<bmmidi::ProgramChangeMsgRef>();
+      program.setProgram(program.program());
+      break;
+    }
+
+    case bmmidi::MsgType::kChannelPressure: {
+      auto pressure = msg.asRef<bmmidi::ChanPressureMsgRef>();
+      pressure.setPressure(pressure.pressure());
+      break;
+    }
+
+    case bmmidi::MsgType::kPitchBend: {
+      auto bend = msg.asRef<bmmidi::PitchBendMsgRef>();
+      bend.setBend(bend.bend());
+      break;
+    }
+
+    default:
+      check(false);
+  }
+
+  // Every setter above wrote back the value it read.
+  check(std::vector<std::uint8_t>(msg.rawBytes(), msg.rawBytes() + msg.numBytes()) == original);
+}
+
+void exerciseSysEx(const bmmidi::MsgView& msg) {
+  // isValidMsg() guarantees a complete header for the matching reference type.
+  const auto sysEx = msg.asView<bmmidi::SysExMsgView>();
+
+  if (sysEx.isUniversal()) {
+    const auto universal = msg.asView<bmmidi::UniversalSysExMsgView>();
+    check(universal.universalType().category() == universal.category());
+    universal.device();
+    check(universal.rawPayloadBytes() + universal.numPayloadBytes()
+          == msg.rawBytes() + msg.numBytes() - 1);
+  } else {
+    const bool isExtended = (sysEx.sysExId() == bmmidi::Manufacturer::kExtendedSysExId);
+    const auto mfr = msg.asView<bmmidi::MfrSysExMsgView>();
+    check(mfr.manufacturer().isExtended() == isExtended);
+    check(mfr.rawPayloadBytes() + mfr.numPayloadBytes() == msg.rawBytes() + msg.numBytes() - 1);
+  }
+}
+
+void exerciseSystemMsg(const bmmidi::MsgView& msg) {
+  switch (msg.type()) {
+    case bmmidi::MsgType::kSystemExclusive:
+      exerciseSysEx(msg);
+      break;
+
+    case bmmidi::MsgType::kMtcQuarterFrame: {
+      const auto quarterFrame = msg.asView<bmmidi::MtcQuarterFrameMsgView>();
+      quarterFrame.piece();
+      check(quarterFrame.valueInLower4Bits() <= 0x0F);
+      break;
+    }
+
+    case bmmidi::MsgType::kSongPositionPointer:
+      msg.asView<bmmidi::SongPosMsgView>().sixteenthsAfterStart();
+      break;
+
+    case bmmidi::MsgType::kSongSelect:
+      check(msg.asView<bmmidi::SongSelectMsgView>().song().isNormal());
+      break;
+
+    default:
+      break;
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+  if ((size > kMaxInputBytes) || !bmmidi::isValidMsg(data, static_cast<int>(size))) { return 0; }
+
+  // Copy so read-write references can be exercised.
+  std::vector<std::uint8_t> bytes(data, data + size);
+  bmmidi::MsgRef msg{bytes.data(), static_cast<int>(bytes.size())};
+  const bmmidi::MsgView view = msg;
+  check(view.hasSameValueAs(msg));
+
+  const int numDataBytes = view.status().numDataBytes();
+  if (numDataBytes >= 1) { check(view.data1().value() >= 0); }
+  if (numDataBytes >= 2) { check(view.data2().value() >= 0); }
+
+  if (view.status().isChannelSpecific()) {
+    exerciseChanMsg(msg);
+  } else {
+    exerciseSystemMsg(view);
+  }
+  return 0;
+}
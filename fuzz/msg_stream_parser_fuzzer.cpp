@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Fuzz target for MsgStreamParser (byte stream parsing and SysEx reassembly).
+//
+// Input format: 2 header bytes (parse chunk size and max SysEx size), followed
+// by the raw MIDI byte stream. Checks that every emitted message is valid and
+// that parsing in chunks gives exactly the same result as parsing all at once.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg_stream_parser.hpp"
+
+namespace {
+
+constexpr std::size_t kMaxInputBytes = 1 << 24;
+
+void check(bool condition) {
+  if (!condition) { std::abort(); }
+}
+
+// Parses bytes in chunks of chunkSize, appending each emitted message (and its
+// size) to out.
+void parseInChunks(bmmidi::MsgStreamParser& parser, const std::uint8_t* bytes, int numBytes,
+                   int chunkSize, int maxSysExBytes, std::vector<int>& out) {
+  const auto emit = [&out, maxSysExBytes](const bmmidi::MsgView& msg) {
+    check(bmmidi::isValidMsg(msg.rawBytes(), msg.numBytes()));
+    check((msg.type() != bmmidi::MsgType::kSystemExclusive) || (msg.numBytes() <= maxSysExBytes));
+    out.push_back(msg.numBytes());
+    out.insert(out.end(), msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+  };
+
+  for (int i = 0; i < numBytes; i += chunkSize) {
+    parser.parse(bytes + i, std::min(chunkSize, numBytes - i), emit);
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+  if ((size < 2) || (size > kMaxInputBytes)) { return 0; }
+
+  const int chunkSize = 1 + (data[0] % 64);
+  bmmidi::MsgStreamParserOptions options;
+  options.maxSysExBytes = 2 + data[1] * 16;
+
+  const std::uint8_t* bytes = data + 2;
+  const int numBytes = static_cast<int>(size - 2);
+
+  bmmidi::MsgStreamParser wholeParser{options};
+  std::vector<int> wholeMsgs;
+  parseInChunks(wholeParser, bytes, numBytes, std::max(numBytes, 1), options.maxSysExBytes,
+                wholeMsgs);
+
+  bmmidi::MsgStreamParser chunkedParser{options};
+  std::vector<int> chunkedMsgs;
+  parseInChunks(chunkedParser, bytes, numBytes, chunkSize, options.maxSysExBytes, chunkedMsgs);
+
+  check(wholeMsgs == chunkedMsgs);
+  check(wholeParser.numDiscardedBytes() == chunkedParser.numDiscardedBytes());
+  check(wholeParser.numDroppedSysEx() == chunkedParser.numDroppedSysEx());
+  check(wholeParser.isInSysEx() == chunkedParser.isInSysEx());
+  return 0;
+}
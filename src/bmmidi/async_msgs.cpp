@@ -0,0 +1,179 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/async_msgs.hpp"
+
+#include <new>
+
+namespace bmmidi {
+
+namespace {
+
+// Each frame is preceded by the arena it came from (nullptr for the heap),
+// padded to keep the frame maximally aligned.
+constexpr std::size_t kFrameHeaderBytes = alignof(std::max_align_t);
+static_assert(kFrameHeaderBytes >= sizeof(CoroFrameArena*), "Frame header too small");
+
+}  // namespace
+
+CoroFrameArena::CoroFrameArena(int blockBytes, int numBlocks)
+    : blockBytes_{(kFrameHeaderBytes + static_cast<std::size_t>(blockBytes) + kFrameHeaderBytes - 1)
+                  & ~(kFrameHeaderBytes - 1)},
+      numBlocks_{numBlocks},
+      numFreeBlocks_{numBlocks} {
+  assert(blockBytes > 0);
+  assert(numBlocks > 0);
+  storage_.reset(new unsigned char[blockBytes_ * static_cast<std::size_t>(numBlocks)]);
+  for (int i = numBlocks - 1; i >= 0; --i) {
+    void* block = &storage_[blockBytes_ * static_cast<std::size_t>(i)];
+    *static_cast<void**>(block) = firstFree_;
+    firstFree_ = block;
+  }
+}
+
+thread_local CoroFrameArena* CoroFrameArena::current_ = nullptr;
+
+void* CoroFrameArena::allocateFrame(std::size_t numBytes) {
+  const std::size_t numBlockBytes = kFrameHeaderBytes + numBytes;
+  CoroFrameArena* arena = current_;
+  void* block = nullptr;
+  if (arena != nullptr) {
+    if ((numBlockBytes <= arena->blockBytes_) && (arena->firstFree_ != nullptr)) {
+      block = arena->firstFree_;
+      arena->firstFree_ = *static_cast<void**>(block);
+      --arena->numFreeBlocks_;
+    } else {
+      ++arena->numHeapFallbacks_;
+      arena = nullptr;
+    }
+  }
+  if (block == nullptr) { block = ::operator new(numBlockBytes); }
+
+  *static_cast<CoroFrameArena**>(block) = arena;
+  return static_cast<unsigned char*>(block) + kFrameHeaderBytes;
+}
+
+void CoroFrameArena::deallocateFrame(void* frame) {
+  void* block = static_cast<unsigned char*>(frame) - kFrameHeaderBytes;
+  CoroFrameArena* arena = *static_cast<CoroFrameArena**>(block);
+  if (arena == nullptr) {
+    ::operator delete(block);
+    return;
+  }
+
+  assert(block >= arena->storage_.get());
+  assert(block < arena->storage_.get()
+                     + arena->blockBytes_ * static_cast<std::size_t>(arena->numBlocks_));
+  *static_cast<void**>(block) = arena->firstFree_;
+  arena->firstFree_ = block;
+  ++arena->numFreeBlocks_;
+}
+
+void CoroScheduler::schedule(internal::CoroWaiter& waiter) {
+  assert(waiter.handle);
+  waiter.next = nullptr;
+  if (last_ != nullptr) {
+    last_->next = &waiter;
+  } else {
+    first_ = &waiter;
+  }
+  last_ = &waiter;
+}
+
+int CoroScheduler::runReady() {
+  int numResumed = 0;
+  while (first_ != nullptr) {
+    internal::CoroWaiter* waiter = first_;
+    first_ = waiter->next;
+    if (first_ == nullptr) { last_ = nullptr; }
+
+    // The waiter may be destroyed once its coroutine resumes.
+    const std::coroutine_handle<> handle = waiter->handle;
+    handle.resume();
+    ++numResumed;
+  }
+  return numResumed;
+}
+
+AsyncMsgQueue::AsyncMsgQueue(CoroScheduler& scheduler, int capacityMsgs)
+    : scheduler_{&scheduler}, capacityMsgs_{capacityMsgs} {
+  assert(capacityMsgs > 0);
+}
+
+bool AsyncMsgQueue::trySend(double timestamp, const MsgView& msg) {
+  if (isClosed_ || (firstSender_ != nullptr) || (pending_.size() >= capacityMsgs_)) {
+    return false;
+  }
+  pending_.push(timestamp, msg);
+  wakeReceiver();
+  return true;
+}
+
+bool AsyncMsgQueue::pushFrom(SendAwaiter& sender) {
+  if (isClosed_) { return true; }
+  if (firstSender_ == nullptr) { pushMsgs(sender); }
+  return sender.numSent_ == sender.numMsgs_;
+}
+
+void AsyncMsgQueue::pushMsgs(SendAwaiter& sender) {
+  const int numSentBefore = sender.numSent_;
+  while ((sender.numSent_ < sender.numMsgs_) && (pending_.size() < capacityMsgs_)) {
+    pending_.push(sender.msgAt(sender.numSent_));
+    ++sender.numSent_;
+  }
+  if (sender.numSent_ != numSentBefore) { wakeReceiver(); }
+}
+
+void AsyncMsgQueue::addSender(SendAwaiter& sender) {
+  sender.nextSender_ = nullptr;
+  if (lastSender_ != nullptr) {
+    lastSender_->nextSender_ = &sender;
+  } else {
+    firstSender_ = &sender;
+  }
+  lastSender_ = &sender;
+}
+
+void AsyncMsgQueue::wakeReceiver() {
+  if (receiver_ != nullptr) {
+    scheduler_->schedule(*receiver_);
+    receiver_ = nullptr;
+  }
+}
+
+const TimedMsgBuffer* AsyncMsgQueue::takeBatch() {
+  if (pending_.empty()) {
+    assert(isClosed_);
+    return nullptr;
+  }
+
+  // Swap buffers (rather than copy), so both keep their storage.
+  batch_.clear();
+  std::swap(batch_, pending_);
+
+  // Hand the freed room to waiting senders, in order.
+  while ((firstSender_ != nullptr) && (pending_.size() < capacityMsgs_)) {
+    SendAwaiter& sender = *firstSender_;
+    pushMsgs(sender);
+    if (sender.numSent_ < sender.numMsgs_) { break; }
+
+    firstSender_ = sender.nextSender_;
+    if (firstSender_ == nullptr) { lastSender_ = nullptr; }
+    scheduler_->schedule(sender.waiter_);
+  }
+  return &batch_;
+}
+
+void AsyncMsgQueue::close() {
+  isClosed_ = true;
+  wakeReceiver();
+  while (firstSender_ != nullptr) {
+    SendAwaiter& sender = *firstSender_;
+    firstSender_ = sender.nextSender_;
+    scheduler_->schedule(sender.waiter_);
+  }
+  lastSender_ = nullptr;
+}
+
+}  // namespace bmmidi
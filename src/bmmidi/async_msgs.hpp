@@ -0,0 +1,413 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_ASYNC_MSGS_HPP
+#define BMMIDI_ASYNC_MSGS_HPP
+
+#include "bmmidi/cpp_features.hpp"
+
+#if !BMMIDI_HAS_COROUTINES
+  #error "bmmidi/async_msgs.hpp requires C++20 coroutines (build with BMMidi_ENABLE_COROUTINES)"
+#endif
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/**
+ * Fixed pool of equal-size blocks for coroutine frames, so that starting a
+ * Task never touches the heap (and so can be done from a realtime thread).
+ *
+ * Task frames come from the arena of the innermost CoroFrameArena::Scope on
+ * the calling thread (typically held for the lifetime of a scheduler thread),
+ * or else from the heap. If the arena has no free block big enough, the frame
+ * falls back to the heap and is counted (see numHeapFallbacks()), so size
+ * arenas for the most frames ever alive at once.
+ *
+ * Not thread-safe: use one arena per scheduler thread.
+ */
+class CoroFrameArena {
+public:
+  /** Allocates Task frames created on this thread from arena while alive. */
+  class Scope {
+  public:
+    explicit Scope(CoroFrameArena& arena) : previous_{current_} { current_ = &arena; }
+    ~Scope() { current_ = previous_; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    CoroFrameArena* previous_;
+  };
+
+  /** Creates numBlocks blocks, each big enough for a frame of blockBytes. */
+  CoroFrameArena(int blockBytes, int numBlocks);
+
+  CoroFrameArena(const CoroFrameArena&) = delete;
+  CoroFrameArena& operator=(const CoroFrameArena&) = delete;
+
+  /** All frames allocated from this arena must be destroyed first. */
+  ~CoroFrameArena() { assert(numFreeBlocks_ == numBlocks_); }
+
+  /** Returns the # of blocks not holding a frame. */
+  int numFreeBlocks() const { return numFreeBlocks_; }
+
+  /** Returns # of frames that didn't fit in this arena (so used the heap). */
+  std::int64_t numHeapFallbacks() const { return numHeapFallbacks_; }
+
+  /**
+   * Allocates numBytes for a coroutine frame from the current Scope's arena
+   * (if any, and it has room) or else from the heap.
+   */
+  static void* allocateFrame(std::size_t numBytes);
+
+  /** Frees frame (from allocateFrame()). */
+  static void deallocateFrame(void* frame);
+
+private:
+  static thread_local CoroFrameArena* current_;
+
+  std::unique_ptr<unsigned char[]> storage_;
+  std::size_t blockBytes_;
+  int numBlocks_;
+  int numFreeBlocks_;
+  void* firstFree_ = nullptr;  // Free blocks are linked through their first bytes.
+  std::int64_t numHeapFallbacks_ = 0;
+};
+
+namespace internal {
+
+// Node in an intrusive (allocation-free) list of suspended coroutines.
+struct CoroWaiter {
+  std::coroutine_handle<> handle;
+  CoroWaiter* next = nullptr;
+};
+
+// Resumes the awaiting coroutine (if any) when a Task finishes.
+struct TaskFinalAwaiter {
+  bool await_ready() const noexcept { return false; }
+
+  template<typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    const std::coroutine_handle<> continuation = handle.promise().continuation;
+    return continuation ? continuation : std::noop_coroutine();
+  }
+
+  void await_resume() const noexcept {}
+};
+
+class TaskPromiseBase {
+public:
+  static void* operator new(std::size_t numBytes) {
+    return CoroFrameArena::allocateFrame(numBytes);
+  }
+  static void operator delete(void* frame) { CoroFrameArena::deallocateFrame(frame); }
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  TaskFinalAwaiter final_suspend() const noexcept { return {}; }
+
+  // This library doesn't use exceptions.
+  void unhandled_exception() const noexcept { std::terminate(); }
+
+  std::coroutine_handle<> continuation;
+  CoroWaiter startWaiter;  // For starting this Task from a CoroScheduler.
+};
+
+template<typename T>
+class TaskPromise;
+
+}  // namespace internal
+
+/**
+ * Lazily started coroutine returning T, which runs when co_await'ed from
+ * another coroutine (resuming it directly when done, without recursion) or
+ * when started by a CoroScheduler.
+ */
+template<typename T = void>
+class [[nodiscard]] Task {
+public:
+  using promise_type = internal::TaskPromise<T>;
+
+  Task() = default;
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_{handle} {}
+
+  Task(Task&& other) noexcept : handle_{std::exchange(other.handle_, nullptr)} {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task() { destroy(); }
+
+  /** Returns true if this Task holds a coroutine. */
+  bool isValid() const { return static_cast<bool>(handle_); }
+
+  /** Returns true if this Task's coroutine has finished. */
+  bool isDone() const {
+    assert(isValid());
+    return handle_.done();
+  }
+
+  /** Returns the result of a finished Task. */
+  decltype(auto) result() {
+    assert(isDone());
+    return handle_.promise().result();
+  }
+
+  // Awaiting a Task runs it (if not already done) until it finishes.
+  bool await_ready() const noexcept { return handle_.done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  decltype(auto) await_resume() { return handle_.promise().result(); }
+
+private:
+  friend class CoroScheduler;
+
+  void destroy() {
+    if (handle_) { handle_.destroy(); }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace internal {
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+  Task<T> get_return_object() noexcept {
+    return Task<T>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+  }
+
+  void return_value(T value) { value_.emplace(std::move(value)); }
+
+  T& result() { return *value_; }
+
+private:
+  std::optional<T> value_;
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+  Task<void> get_return_object() noexcept {
+    return Task<void>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+  }
+
+  void return_void() const noexcept {}
+
+  void result() const noexcept {}
+};
+
+}  // namespace internal
+
+/**
+ * Single-threaded run queue of coroutines, so that one thread can service
+ * many devices (each with its own straight-line Task) instead of needing a
+ * thread per device. Scheduling never allocates.
+ */
+class CoroScheduler {
+public:
+  class YieldAwaiter {
+  public:
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      waiter_.handle = handle;
+      scheduler_->schedule(waiter_);
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    friend class CoroScheduler;
+    explicit YieldAwaiter(CoroScheduler* scheduler) : scheduler_{scheduler} {}
+
+    CoroScheduler* scheduler_;
+    internal::CoroWaiter waiter_;
+  };
+
+  CoroScheduler() = default;
+
+  CoroScheduler(const CoroScheduler&) = delete;
+  CoroScheduler& operator=(const CoroScheduler&) = delete;
+
+  /**
+   * Schedules task (which must outlive its running, and must not already be
+   * started) to start running in the next runReady().
+   */
+  template<typename T>
+  void start(Task<T>& task) {
+    assert(task.isValid() && !task.isDone());
+    internal::CoroWaiter& waiter = task.handle_.promise().startWaiter;
+    waiter.handle = task.handle_;
+    schedule(waiter);
+  }
+
+  /** Schedules the suspended coroutine in waiter to resume, in FIFO order. */
+  void schedule(internal::CoroWaiter& waiter);
+
+  /** Returns an awaitable that lets other scheduled coroutines run first. */
+  YieldAwaiter yield() { return YieldAwaiter{this}; }
+
+  /** Returns true if any coroutines are scheduled. */
+  bool hasReady() const { return first_ != nullptr; }
+
+  /**
+   * Resumes scheduled coroutines (including any scheduled meanwhile) until
+   * none are left. Returns the # resumed.
+   */
+  int runReady();
+
+private:
+  internal::CoroWaiter* first_ = nullptr;
+  internal::CoroWaiter* last_ = nullptr;
+};
+
+/**
+ * Bounded queue of timed messages between coroutines on one CoroScheduler,
+ * from any # of senders to one receiver, which receives everything queued so
+ * far as one batch per co_await.
+ *
+ * Senders co_await send() or sendAll(), which suspend while the queue is full
+ * (back-pressure) and resume once the receiver makes room. Waiting senders
+ * are served in FIFO order, and nothing is allocated once the queue's buffers
+ * have grown to their steady-state size.
+ */
+class AsyncMsgQueue {
+public:
+  /** Awaitable returned by send() and sendAll(). */
+  class [[nodiscard]] SendAwaiter {
+  public:
+    bool await_ready() { return queue_->pushFrom(*this); }
+    void await_suspend(std::coroutine_handle<> handle) {
+      waiter_.handle = handle;
+      queue_->addSender(*this);
+    }
+
+    /** Returns true if all messages were sent (false if the queue was closed). */
+    bool await_resume() const noexcept { return numSent_ == numMsgs_; }
+
+  private:
+    friend class AsyncMsgQueue;
+
+    SendAwaiter(AsyncMsgQueue* queue, double timestamp, const MsgView& msg)
+        : queue_{queue}, timestamp_{timestamp}, bytes_{msg.rawBytes()}, numBytes_{msg.numBytes()},
+          numMsgs_{1} {}
+    SendAwaiter(AsyncMsgQueue* queue, const TimedMsgBuffer& msgs)
+        : queue_{queue}, msgs_{&msgs}, numMsgs_{msgs.size()} {}
+
+    TimedMsgView msgAt(int index) const {
+      return (msgs_ != nullptr) ? (*msgs_)[index] : TimedMsgView{timestamp_, bytes_, numBytes_};
+    }
+
+    AsyncMsgQueue* queue_;
+    const TimedMsgBuffer* msgs_ = nullptr;
+    double timestamp_ = 0.0;
+    const std::uint8_t* bytes_ = nullptr;
+    int numBytes_ = 0;
+    int numMsgs_;
+    int numSent_ = 0;
+    internal::CoroWaiter waiter_;
+    SendAwaiter* nextSender_ = nullptr;
+  };
+
+  /** Awaitable returned by receive(). */
+  class [[nodiscard]] ReceiveAwaiter {
+  public:
+    bool await_ready() const noexcept { return !queue_->pending_.empty() || queue_->isClosed_; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      assert(queue_->receiver_ == nullptr);
+      waiter_.handle = handle;
+      queue_->receiver_ = &waiter_;
+    }
+    const TimedMsgBuffer* await_resume() { return queue_->takeBatch(); }
+
+  private:
+    friend class AsyncMsgQueue;
+    explicit ReceiveAwaiter(AsyncMsgQueue* queue) : queue_{queue} {}
+
+    AsyncMsgQueue* queue_;
+    internal::CoroWaiter waiter_;
+  };
+
+  /** Creates a queue holding up to capacityMsgs messages between receives. */
+  AsyncMsgQueue(CoroScheduler& scheduler, int capacityMsgs);
+
+  AsyncMsgQueue(const AsyncMsgQueue&) = delete;
+  AsyncMsgQueue& operator=(const AsyncMsgQueue&) = delete;
+
+  /**
+   * Returns an awaitable that queues msg with timestamp (copying its bytes),
+   * suspending until there is room.
+   */
+  SendAwaiter send(double timestamp, const MsgView& msg) { return {this, timestamp, msg}; }
+
+  /**
+   * Returns an awaitable that queues all of msgs (which must outlive it) in
+   * order, suspending whenever the queue is full.
+   */
+  SendAwaiter sendAll(const TimedMsgBuffer& msgs) { return {this, msgs}; }
+
+  /**
+   * Queues msg with timestamp if there is room (and no waiting senders), e.g.
+   * from a callback that can't co_await. Returns false if not.
+   */
+  bool trySend(double timestamp, const MsgView& msg);
+
+  /**
+   * Returns an awaitable that waits until messages are queued (or the queue is
+   * closed), then takes all queued messages as one batch. The batch is valid
+   * until the next receive, and is nullptr once the queue is closed and empty.
+   */
+  ReceiveAwaiter receive() { return ReceiveAwaiter{this}; }
+
+  /**
+   * Closes the queue: waiting and future sends fail, and the receiver gets any
+   * already-queued messages and then nullptr.
+   */
+  void close();
+
+  /** Returns true if close() was called. */
+  bool isClosed() const { return isClosed_; }
+
+  /** Returns # of messages queued (not yet received). */
+  int size() const { return pending_.size(); }
+
+private:
+  // Queues as many of sender's messages as fit (if no other senders are
+  // waiting), returning true if there are none left to send.
+  bool pushFrom(SendAwaiter& sender);
+  void pushMsgs(SendAwaiter& sender);
+  void addSender(SendAwaiter& sender);
+  void wakeReceiver();
+  const TimedMsgBuffer* takeBatch();
+
+  CoroScheduler* scheduler_;
+  int capacityMsgs_;
+  TimedMsgBuffer pending_;
+  TimedMsgBuffer batch_;
+  SendAwaiter* firstSender_ = nullptr;
+  SendAwaiter* lastSender_ = nullptr;
+  internal::CoroWaiter* receiver_ = nullptr;
+  bool isClosed_ = false;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_ASYNC_MSGS_HPP
@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/async_msgs.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg_stream_parser.hpp"
+#include "bmmidi/test_msgs.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+using Bytes = std::vector<std::uint8_t>;
+
+using bmmidi::test::viewOf;
+
+bmmidi::Task<int> addLater(bmmidi::CoroScheduler& scheduler, int a, int b) {
+  co_await scheduler.yield();
+  co_return a + b;
+}
+
+bmmidi::Task<int> sumOfSums(bmmidi::CoroScheduler& scheduler) {
+  const int first = co_await addLater(scheduler, 1, 2);
+  const int second = co_await addLater(scheduler, 3, 4);
+  co_return first + second;
+}
+
+TEST(CoroFrameArena, AllocatesTaskFramesFromArena) {
+  bmmidi::CoroFrameArena arena{512, 4};
+  const bmmidi::CoroFrameArena::Scope arenaScope{arena};
+  bmmidi::CoroScheduler scheduler;
+  {
+    auto task = sumOfSums(scheduler);
+    EXPECT_THAT(arena.numFreeBlocks(), Eq(3));
+    scheduler.start(task);
+    EXPECT_THAT(scheduler.runReady(), Eq(3));
+    ASSERT_THAT(task.isDone(), IsTrue());
+    EXPECT_THAT(task.result(), Eq(10));
+  }
+  EXPECT_THAT(arena.numFreeBlocks(), Eq(4));
+  EXPECT_THAT(arena.numHeapFallbacks(), Eq(0));
+}
+
+TEST(CoroFrameArena, FallsBackToHeapWhenFull) {
+  bmmidi::CoroFrameArena arena{512, 1};
+  const bmmidi::CoroFrameArena::Scope arenaScope{arena};
+  bmmidi::CoroScheduler scheduler;
+  {
+    auto first = addLater(scheduler, 1, 1);
+    auto second = addLater(scheduler, 2, 2);
+    EXPECT_THAT(arena.numFreeBlocks(), Eq(0));
+    EXPECT_THAT(arena.numHeapFallbacks(), Eq(1));
+  }
+  EXPECT_THAT(arena.numFreeBlocks(), Eq(1));
+}
+
+// Sends msgs, one at a time.
+bmmidi::Task<> sendEach(bmmidi::AsyncMsgQueue& queue,
+                        const std::vector<Bytes>& msgs, std::vector<bool>& results) {
+  for (const Bytes& msg : msgs) {
+    results.push_back(co_await queue.send(static_cast<double>(results.size()), viewOf(msg)));
+  }
+}
+
+// Receives batches until the queue is closed, recording {batch size, bytes...}.
+bmmidi::Task<> receiveAll(bmmidi::AsyncMsgQueue& queue,
+                          std::vector<Bytes>& batches) {
+  while (const bmmidi::TimedMsgBuffer* batch = co_await queue.receive()) {
+    Bytes summary{static_cast<std::uint8_t>(batch->size())};
+    for (const bmmidi::TimedMsgView msg : *batch) {
+      const bmmidi::MsgView view = msg.value();
+      summary.insert(summary.end(), view.rawBytes(), view.rawBytes() + view.numBytes());
+    }
+    batches.push_back(summary);
+  }
+}
+
+TEST(AsyncMsgQueue, AppliesBackPressure) {
+  bmmidi::CoroFrameArena arena{512, 4};
+  const bmmidi::CoroFrameArena::Scope arenaScope{arena};
+  bmmidi::CoroScheduler scheduler;
+  bmmidi::AsyncMsgQueue queue{scheduler, 2};
+
+  const std::vector<Bytes> msgs = {{0xF8}, {0xFA}, {0xC0, 1}, {0xF0, 0x7D, 0xF7}, {0xFC}};
+  std::vector<bool> results;
+  auto sender = sendEach(queue, msgs, results);
+  scheduler.start(sender);
+  scheduler.runReady();
+  EXPECT_THAT(results, ElementsAre(true, true));
+  EXPECT_THAT(queue.size(), Eq(2));
+  EXPECT_THAT(queue.trySend(9.0, viewOf({0xFE})), IsFalse());
+
+  std::vector<Bytes> batches;
+  auto receiver = receiveAll(queue, batches);
+  scheduler.start(receiver);
+  scheduler.runReady();
+  EXPECT_THAT(sender.isDone(), IsTrue());
+  EXPECT_THAT(results, ElementsAre(true, true, true, true, true));
+  EXPECT_THAT(batches, ElementsAre(ElementsAre(2, 0xF8, 0xFA), ElementsAre(1, 0xC0, 1),
+                                   ElementsAre(2, 0xF0, 0x7D, 0xF7, 0xFC)));
+
+  EXPECT_THAT(queue.trySend(9.0, viewOf({0xFE})), IsTrue());
+  queue.close();
+  scheduler.runReady();
+  EXPECT_THAT(receiver.isDone(), IsTrue());
+  EXPECT_THAT(batches.back(), ElementsAre(1, 0xFE));
+  EXPECT_THAT(arena.numHeapFallbacks(), Eq(0));
+}
+
+TEST(AsyncMsgQueue, FailsWaitingSendsOnClose) {
+  bmmidi::CoroFrameArena arena{512, 2};
+  const bmmidi::CoroFrameArena::Scope arenaScope{arena};
+  bmmidi::CoroScheduler scheduler;
+  bmmidi::AsyncMsgQueue queue{scheduler, 1};
+
+  const std::vector<Bytes> msgs = {{0xF8}, {0xF8}, {0xF8}};
+  std::vector<bool> results;
+  auto sender = sendEach(queue, msgs, results);
+  scheduler.start(sender);
+  scheduler.runReady();
+  EXPECT_THAT(sender.isDone(), IsFalse());
+
+  queue.close();
+  scheduler.runReady();
+  EXPECT_THAT(sender.isDone(), IsTrue());
+  EXPECT_THAT(results, ElementsAre(true, false, false));
+}
+
+// Straight-line bridge from a byte stream device: parses each chunk of bytes
+// and forwards the parsed messages, waiting whenever the output is full.
+bmmidi::Task<> bridge(bmmidi::CoroScheduler& scheduler,
+                      const std::vector<Bytes>& chunks, bmmidi::AsyncMsgQueue& out) {
+  bmmidi::MsgStreamParser parser;
+  bmmidi::TimedMsgBuffer parsed;
+  double now = 0.0;
+  for (const Bytes& chunk : chunks) {
+    co_await scheduler.yield();  // Stands in for awaiting device input.
+    parsed.clear();
+    parser.parse(chunk.data(), static_cast<int>(chunk.size()),
+                 [&parsed, now](const bmmidi::MsgView& msg) { parsed.push(now, msg); });
+    if (!co_await out.sendAll(parsed)) { co_return; }
+    now += 1.0;
+  }
+  out.close();
+}
+
+TEST(AsyncMsgQueue, BridgesParsedMsgs) {
+  bmmidi::CoroFrameArena arena{1024, 4};
+  const bmmidi::CoroFrameArena::Scope arenaScope{arena};
+  bmmidi::CoroScheduler scheduler;
+  bmmidi::AsyncMsgQueue queue{scheduler, 2};
+
+  const std::vector<Bytes> chunks = {{0x90, 60, 100, 62}, {100, 64, 100, 0xF0, 1}, {2, 0xF7}};
+  auto device = bridge(scheduler, chunks, queue);
+
+  std::vector<double> timestamps;
+  Bytes bytes;
+  auto consumer = [](bmmidi::AsyncMsgQueue& queue,
+                     std::vector<double>& timestamps, Bytes& bytes) -> bmmidi::Task<> {
+    while (const bmmidi::TimedMsgBuffer* batch = co_await queue.receive()) {
+      for (const bmmidi::TimedMsgView msg : *batch) {
+        timestamps.push_back(msg.timestamp());
+        const bmmidi::MsgView view = msg.value();
+        bytes.insert(bytes.end(), view.rawBytes(), view.rawBytes() + view.numBytes());
+      }
+    }
+  }(queue, timestamps, bytes);
+
+  scheduler.start(device);
+  scheduler.start(consumer);
+  scheduler.runReady();
+  EXPECT_THAT(device.isDone(), IsTrue());
+  EXPECT_THAT(consumer.isDone(), IsTrue());
+  EXPECT_THAT(timestamps, ElementsAre(0.0, 1.0, 1.0, 2.0));
+  EXPECT_THAT(bytes, ElementsAre(0x90, 60, 100, 0x90, 62, 100, 0x90, 64, 100, 0xF0, 1, 2, 0xF7));
+  EXPECT_THAT(arena.numHeapFallbacks(), Eq(0));
+}
+
+}  // namespace
@@ -27,6 +27,28 @@ inline constexpr std::uint8_t setBits(
   return result;
 }
 
+/** Returns the # of 1 bits in value. */
+inline int countOneBits(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(value);
+#else
+  int count = 0;
+  for (; value != 0; value &= (value - 1)) { ++count; }
+  return count;
+#endif
+}
+
+/** Returns index of the lowest 1 bit in value, which must be nonzero. */
+inline int lowestOneBitIndex(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(value);
+#else
+  int index = 0;
+  for (; (value & 0x01) == 0; value >>= 1) { ++index; }
+  return index;
+#endif
+}
+
 }  // namespace internal
 }  // namespace bmmidi
 
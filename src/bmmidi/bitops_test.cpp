@@ -60,5 +60,18 @@ TEST(SetBits, ReplacesOnlyOneBitsInMask) {
                              Eq(0b0011'1101));
 }
 
+TEST(CountOneBits, CountsAll64Bits) {
+  EXPECT_THAT(internal::countOneBits(0), Eq(0));
+  EXPECT_THAT(internal::countOneBits(0b1011'0001), Eq(4));
+  EXPECT_THAT(internal::countOneBits(0x8000'0000'0000'0001), Eq(2));
+  EXPECT_THAT(internal::countOneBits(~std::uint64_t{0}), Eq(64));
+}
+
+TEST(LowestOneBitIndex, FindsLowestSetBit) {
+  EXPECT_THAT(internal::lowestOneBitIndex(0b0001), Eq(0));
+  EXPECT_THAT(internal::lowestOneBitIndex(0b1010'0000), Eq(5));
+  EXPECT_THAT(internal::lowestOneBitIndex(0x8000'0000'0000'0000), Eq(63));
+}
+
 }  // namespace
 }  // bmmidi
@@ -0,0 +1,304 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/ble_midi.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "bmmidi/running_status.hpp"
+#include "bmmidi/status.hpp"
+#include "bmmidi/sysex.hpp"
+
+namespace bmmidi {
+
+namespace {
+
+// Timestamps are 13 bits of milliseconds: 6 in the header byte, and 7 in each
+// timestamp byte.
+constexpr int kTimestampModulus = 8192;
+constexpr int kTimestampLowBits = 7;
+constexpr int kTimestampLowMask = 0x7F;
+constexpr int kTimestampHighMask = 0x3F;
+
+constexpr std::uint8_t kSysExStart = 0xF0;
+constexpr std::uint8_t kEox = 0xF7;
+constexpr std::uint8_t kFirstRealtimeStatus = 0xF8;
+
+std::uint8_t headerByte(std::int64_t ms) {
+  return static_cast<std::uint8_t>(0x80 | ((ms >> kTimestampLowBits) & kTimestampHighMask));
+}
+
+std::uint8_t timestampByte(int low) { return static_cast<std::uint8_t>(0x80 | low); }
+
+std::int64_t toMs(double timestamp) {
+  return std::max(std::int64_t{0}, static_cast<std::int64_t>(std::llround(timestamp)));
+}
+
+bool isUndefinedStatus(std::uint8_t status) {
+  return (status == 0xF4) || (status == 0xF5) || (status == 0xF9) || (status == 0xFD);
+}
+
+}  // namespace
+
+BleMidiEncoder::BleMidiEncoder(const BleMidiEncoderOptions& options) : options_{options} {
+  // Room for a header, a timestamp, and any non-SysEx message.
+  assert(options.maxPacketBytes >= 5);
+}
+
+int BleMidiEncoder::encodePacket(const TimedMsgBuffer& msgs, int firstIndex,
+                                 std::vector<std::uint8_t>& packet) {
+  assert((0 <= firstIndex) && (firstIndex <= msgs.size()));
+  packet.clear();
+  if (firstIndex == msgs.size()) {
+    assert(sysExOffset_ == 0);
+    return 0;
+  }
+
+  const auto maxBytes = static_cast<std::size_t>(options_.maxPacketBytes);
+  std::int64_t lastMs = toMs(msgs[firstIndex].timestamp());
+  std::int64_t block = lastMs >> kTimestampLowBits;
+  int lastLow = -1;  // Low bits of the last timestamp byte, if any.
+  packet.push_back(headerByte(lastMs));
+
+  int index = firstIndex;
+  if (sysExOffset_ > 0) {
+    const int low = static_cast<int>(lastMs & kTimestampLowMask);
+    if (!continueSysEx(msgs[index].value(), low, packet)) { return 0; }
+    lastLow = low;
+    ++index;
+  }
+
+  RunningStatusEncoder runningStatus;
+  bool canOmitTimestamp = false;
+  for (; index < msgs.size(); ++index) {
+    const TimedMsgView timedMsg = msgs[index];
+    const MsgView msg = timedMsg.value();
+    const std::int64_t ms = std::max(lastMs, toMs(timedMsg.timestamp()));
+    const std::int64_t msBlock = ms >> kTimestampLowBits;
+    const int low = static_cast<int>(ms & kTimestampLowMask);
+
+    // Within a packet, timestamp bytes can only advance the header's bits by
+    // wrapping their own.
+    if ((msBlock != block) && ((msBlock != block + 1) || (low >= lastLow))) { break; }
+
+    const std::size_t room = maxBytes - packet.size();
+    if (msg.type() == MsgType::kSystemExclusive) {
+      // Only start SysEx if at least one byte after F0 also fits.
+      if (room < 3) { break; }
+      runningStatus.advance(msg);
+      packet.push_back(timestampByte(low));
+      packet.push_back(std::uint8_t{kSysExStart});
+      block = msBlock;
+      lastLow = low;
+      lastMs = ms;
+      canOmitTimestamp = false;
+
+      sysExOffset_ = 1;
+      if (!continueSysEx(msg, low, packet)) { break; }
+      continue;
+    }
+
+    // A running status message directly following a Channel message (without
+    // a timestamp byte) has the same timestamp.
+    const int numWireBytes = runningStatus.numWireBytes(msg);
+    const bool omitTimestamp = canOmitTimestamp && (ms == lastMs)
+        && (numWireBytes < msg.numBytes());
+    const auto numPacketBytes = static_cast<std::size_t>(numWireBytes + (omitTimestamp ? 0 : 1));
+    if (numPacketBytes > room) { break; }
+
+    const int numOmitted = runningStatus.advance(msg);
+    if (!omitTimestamp) { packet.push_back(timestampByte(low)); }
+    packet.insert(packet.end(), msg.rawBytes() + numOmitted, msg.rawBytes() + msg.numBytes());
+    block = msBlock;
+    lastLow = low;
+    lastMs = ms;
+    canOmitTimestamp = msg.status().isChannelSpecific();
+  }
+  return index - firstIndex;
+}
+
+bool BleMidiEncoder::continueSysEx(const MsgView& sysEx, int timestampLow,
+                                   std::vector<std::uint8_t>& packet) {
+  const auto maxBytes = static_cast<std::size_t>(options_.maxPacketBytes);
+  const int eoxIndex = sysEx.numBytes() - 1;
+  const int numData = std::min(eoxIndex - sysExOffset_,
+                               static_cast<int>(maxBytes - packet.size()));
+  packet.insert(packet.end(), sysEx.rawBytes() + sysExOffset_,
+                sysEx.rawBytes() + sysExOffset_ + numData);
+  sysExOffset_ += numData;
+
+  if ((sysExOffset_ < eoxIndex) || (maxBytes - packet.size() < 2)) { return false; }
+  packet.push_back(timestampByte(timestampLow));
+  packet.push_back(std::uint8_t{kEox});
+  sysExOffset_ = 0;
+  return true;
+}
+
+BleMidiDecoder::BleMidiDecoder(const BleMidiDecoderOptions& options) : options_{options} {
+  assert(options.maxSysExBytes >= 2);
+}
+
+bool BleMidiDecoder::decode(const std::uint8_t* bytes, int numBytes, double receivedMs,
+                            TimedMsgBuffer& msgs) {
+  assert((bytes != nullptr) || (numBytes == 0));
+  if ((numBytes < 1) || ((bytes[0] & 0xC0) != 0x80)) { return false; }
+  receivedMs_ = receivedMs;
+
+  int high = bytes[0] & kTimestampHighMask;
+  int lastLow = -1;  // Low bits of the last timestamp byte, if any.
+  double time = 0.0;
+  int pos = 1;
+  while (pos < numBytes) {
+    const std::uint8_t byte = bytes[pos];
+    if (byte < 0x80) {
+      if (isInSysEx()) {
+        // Continues SysEx (at the start of a packet, or after interleaved
+        // realtime messages).
+        pos = appendSysExData(bytes, pos, numBytes);
+      } else if ((lastLow >= 0) && (runningStatus_ != 0)) {
+        // Running status message with the same timestamp as the previous.
+        pos = decodeMsg(bytes, pos, numBytes, time, msgs);
+      } else {
+        ++numDiscardedBytes_;
+        ++pos;
+      }
+      continue;
+    }
+
+    // Timestamp byte, where wrapping low bits implies that high bits advanced.
+    const int low = byte & kTimestampLowMask;
+    if ((lastLow >= 0) && (low < lastLow)) { high = (high + 1) & kTimestampHighMask; }
+    time = toReceiverTime((high << kTimestampLowBits) | low, lastLow < 0);
+    lastLow = low;
+    if (++pos == numBytes) {
+      ++numDiscardedBytes_;
+      break;
+    }
+
+    const std::uint8_t next = bytes[pos];
+    if (isInSysEx()) {
+      if (next == kEox) {
+        endSysEx(msgs);
+        ++pos;
+        continue;
+      }
+      if ((next >= kFirstRealtimeStatus) && !isUndefinedStatus(next)) {
+        msgs.push(time, &bytes[pos], 1);
+        ++pos;
+        continue;
+      }
+      dropSysEx();
+    }
+    pos = decodeMsg(bytes, pos, numBytes, time, msgs);
+  }
+  return true;
+}
+
+void BleMidiDecoder::reset() {
+  runningStatus_ = 0;
+  sysEx_.clear();
+  sysExOverflowed_ = false;
+  hasTime_ = false;
+}
+
+double BleMidiDecoder::toReceiverTime(int timestamp, bool isFirstInPacket) {
+  if (!hasTime_) {
+    hasTime_ = true;
+    lastTimestamp_ = timestamp;
+    senderMs_ = timestamp;
+    offsetMs_ = receivedMs_ - timestamp;
+    lastReceivedMs_ = receivedMs_;
+    return receivedMs_;
+  }
+
+  // Timestamps within a packet advance by less than one wrap, while between
+  // packets, the time elapsed on the receiver's clock tells how many whole
+  // wraps occurred (or whether the timestamp jittered slightly backwards).
+  const int delta = (timestamp - lastTimestamp_) & (kTimestampModulus - 1);
+  double elapsed = delta;
+  if (isFirstInPacket) {
+    const double expected = receivedMs_ - lastReceivedMs_;
+    elapsed += kTimestampModulus * std::round((expected - delta) / kTimestampModulus);
+  }
+  senderMs_ += elapsed;
+  lastTimestamp_ = timestamp;
+  lastReceivedMs_ = receivedMs_;
+  return senderMs_ + offsetMs_;
+}
+
+int BleMidiDecoder::decodeMsg(const std::uint8_t* bytes, int pos, int numBytes, double time,
+                              TimedMsgBuffer& msgs) {
+  std::uint8_t status = bytes[pos];
+  int dataPos = pos + 1;
+  if (status < 0x80) {
+    status = runningStatus_;
+    dataPos = pos;
+  }
+  if ((status == 0) || (status == kEox) || isUndefinedStatus(status)) {
+    ++numDiscardedBytes_;
+    return pos + 1;
+  }
+
+  if (status == kSysExStart) {
+    sysEx_.assign(1, std::uint8_t{kSysExStart});
+    sysExOverflowed_ = false;
+    sysExTime_ = time;
+    return appendSysExData(bytes, dataPos, numBytes);
+  }
+
+  // Messages other than SysEx never span packets.
+  const int numData = Status{status}.numDataBytes();
+  int end = dataPos;
+  while ((end < numBytes) && (end < dataPos + numData) && (bytes[end] < 0x80)) { ++end; }
+  if (end < dataPos + numData) {
+    numDiscardedBytes_ += end - pos;
+    return end;
+  }
+
+  std::uint8_t msgBytes[3] = {status};
+  std::copy(&bytes[dataPos], &bytes[end], &msgBytes[1]);
+  msgs.push(time, msgBytes, 1 + numData);
+  if (Status{status}.isChannelSpecific()) { runningStatus_ = status; }
+  return end;
+}
+
+int BleMidiDecoder::appendSysExData(const std::uint8_t* bytes, int pos, int numBytes) {
+  int end = pos;
+  while ((end < numBytes) && (bytes[end] < 0x80)) { ++end; }
+  if (sysExOverflowed_) { return end; }
+
+  // Leave room for the terminating EOX.
+  if (static_cast<int>(sysEx_.size()) + (end - pos) > options_.maxSysExBytes - 1) {
+    sysExOverflowed_ = true;
+    sysEx_.resize(1);
+    return end;
+  }
+  sysEx_.insert(sysEx_.end(), &bytes[pos], &bytes[end]);
+  return end;
+}
+
+void BleMidiDecoder::endSysEx(TimedMsgBuffer& msgs) {
+  if (sysExOverflowed_) {
+    dropSysEx();
+    return;
+  }
+
+  sysEx_.push_back(std::uint8_t{kEox});
+  if (!internal::hasCompleteSysExHeader(sysEx_.data(), static_cast<int>(sysEx_.size()))) {
+    dropSysEx();  // E.g. empty (F0 F7), so unusable as any SysEx reference.
+    return;
+  }
+  msgs.push(sysExTime_, sysEx_.data(), static_cast<int>(sysEx_.size()));
+  sysEx_.clear();
+}
+
+void BleMidiDecoder::dropSysEx() {
+  sysEx_.clear();
+  sysExOverflowed_ = false;
+  ++numDroppedSysEx_;
+}
+
+}  // namespace bmmidi
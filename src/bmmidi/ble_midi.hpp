@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_BLE_MIDI_HPP
+#define BMMIDI_BLE_MIDI_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Options for BleMidiEncoder. */
+struct BleMidiEncoderOptions {
+  /**
+   * Max # of bytes per packet: the negotiated ATT MTU minus 3 (20 for the
+   * default ATT MTU of 23). Must be at least 5.
+   */
+  int maxPacketBytes = 20;
+};
+
+/**
+ * Encodes timed MIDI messages as BLE-MIDI packets, packing as many messages as
+ * fit into each packet.
+ *
+ * Each packet starts with a header byte holding bits 7-12 of a 13-bit
+ * millisecond timestamp, and each message is preceded by a timestamp byte
+ * holding bits 0-6 (a wrap of bits 0-6 within a packet implies that bits 7-12
+ * incremented). Channel messages use running status within a packet, and a
+ * running status message with the same timestamp as the previous message also
+ * omits its timestamp byte. SysEx messages too long for one packet continue
+ * in the following packets.
+ */
+class BleMidiEncoder {
+public:
+  explicit BleMidiEncoder(const BleMidiEncoderOptions& options = BleMidiEncoderOptions{});
+
+  /**
+   * Encodes messages msgs[firstIndex, ...) (with timestamps in milliseconds,
+   * which should be nondecreasing) into one packet, replacing its contents,
+   * and returns the # of messages fully encoded. The packet is empty if there
+   * is nothing to encode.
+   *
+   * A SysEx message that does not fit is continued by the next call, which
+   * must then pass the same msgs and the index of that SysEx message as
+   * firstIndex (see isInSysEx()).
+   */
+  int encodePacket(const TimedMsgBuffer& msgs, int firstIndex, std::vector<std::uint8_t>& packet);
+
+  /** Returns true if the last packet ended in the middle of a SysEx message. */
+  bool isInSysEx() const { return sysExOffset_ > 0; }
+
+  /** Abandons any partially encoded SysEx message. */
+  void reset() { sysExOffset_ = 0; }
+
+private:
+  // Appends the rest of SysEx message sysEx that fits to packet, ending it
+  // (with a timestamp byte holding timestampLow before EOX) if possible.
+  // Returns true if the whole message has been encoded.
+  bool continueSysEx(const MsgView& sysEx, int timestampLow, std::vector<std::uint8_t>& packet);
+
+  BleMidiEncoderOptions options_;
+
+  // Index of the next byte to send of a partially encoded SysEx, or 0 if none.
+  int sysExOffset_ = 0;
+};
+
+/** Options for BleMidiDecoder. */
+struct BleMidiDecoderOptions {
+  /**
+   * Maximum # of bytes (F0 through F7, inclusive) of a reassembled SysEx
+   * message. Longer SysEx messages are dropped (see numDroppedSysEx()).
+   */
+  int maxSysExBytes = 64 * 1024;
+};
+
+/**
+ * Decodes BLE-MIDI packets into timed messages, reconstructing absolute times
+ * from the 13-bit (wrapping every 8.192 s) millisecond timestamps.
+ *
+ * Timestamps are unwrapped into a continuous sender timeline, using the time
+ * each packet was received to account for any whole wraps between packets
+ * (e.g. after a pause), and are then mapped to the receiver's clock so that
+ * the first message is timestamped when its packet was received. Messages
+ * thus keep the sender's relative timing (clock drift is not corrected).
+ *
+ * As BLE-MIDI allows, running status continues across timestamp bytes, System
+ * messages, and packets. SysEx messages are reassembled across packets, and may
+ * be interleaved with System Realtime messages. Malformed bytes are discarded
+ * and counted, as are SysEx messages that are interrupted, longer than
+ * maxSysExBytes, or too short for a complete SysEx header (e.g. F0 F7).
+ */
+class BleMidiDecoder {
+public:
+  explicit BleMidiDecoder(const BleMidiDecoderOptions& options = BleMidiDecoderOptions{});
+
+  /**
+   * Decodes packet bytes[0, numBytes), received at receivedMs (milliseconds on
+   * the receiver's clock), appending its messages to msgs. Returns false (and
+   * ignores the packet) if it does not start with a valid header byte.
+   */
+  bool decode(const std::uint8_t* bytes, int numBytes, double receivedMs, TimedMsgBuffer& msgs);
+
+  /** Decodes all bytes of packet (any contiguous container of std::uint8_t). */
+  template<typename Container>
+  bool decode(const Container& packet, double receivedMs, TimedMsgBuffer& msgs) {
+    return decode(packet.data(), static_cast<int>(packet.size()), receivedMs, msgs);
+  }
+
+  /**
+   * Forgets running status, any incomplete SysEx, and the timestamp mapping
+   * (e.g. after reconnecting). Does not reset counters.
+   */
+  void reset();
+
+  /** Returns true if currently in the middle of a SysEx message. */
+  bool isInSysEx() const { return !sysEx_.empty(); }
+
+  /** Returns # of input bytes discarded as malformed since construction. */
+  std::int64_t numDiscardedBytes() const { return numDiscardedBytes_; }
+
+  /**
+   * Returns # of SysEx messages dropped (as interrupted, too long, or without a
+   * complete header) since construction.
+   */
+  std::int64_t numDroppedSysEx() const { return numDroppedSysEx_; }
+
+private:
+  // Returns receiver time of 13-bit timestamp, which is the first in its
+  // packet if isFirstInPacket.
+  double toReceiverTime(int timestamp, bool isFirstInPacket);
+
+  // Decodes the message starting with status at bytes[pos] (or with running
+  // status if bytes[pos] is a data byte), returning index just past it.
+  int decodeMsg(const std::uint8_t* bytes, int pos, int numBytes, double time,
+                TimedMsgBuffer& msgs);
+
+  // Appends the run of data bytes starting at bytes[pos] to SysEx (unless it
+  // already overflowed), returning index just past it.
+  int appendSysExData(const std::uint8_t* bytes, int pos, int numBytes);
+
+  // Emits the SysEx being reassembled (ended by EOX) at sysExTime_, unless it
+  // overflowed or has no complete header.
+  void endSysEx(TimedMsgBuffer& msgs);
+
+  void dropSysEx();
+
+  BleMidiDecoderOptions options_;
+
+  std::uint8_t runningStatus_ = 0;
+  std::vector<std::uint8_t> sysEx_;
+  bool sysExOverflowed_ = false;  // If so, sysEx_ only holds F0 (to skip the rest).
+  double sysExTime_ = 0.0;
+
+  bool hasTime_ = false;
+  int lastTimestamp_ = 0;
+  double senderMs_ = 0.0;
+  double offsetMs_ = 0.0;
+  double receivedMs_ = 0.0;      // When the current packet was received.
+  double lastReceivedMs_ = 0.0;  // When lastTimestamp_'s packet was received.
+
+  std::int64_t numDiscardedBytes_ = 0;
+  std::int64_t numDroppedSysEx_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_BLE_MIDI_HPP
@@ -0,0 +1,268 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/ble_midi.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace {
+
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Le;
+
+using Bytes = std::vector<std::uint8_t>;
+
+void push(bmmidi::TimedMsgBuffer& msgs, double timestamp, const Bytes& bytes) {
+  msgs.push(timestamp, bytes.data(), static_cast<int>(bytes.size()));
+}
+
+// Each message as its bytes.
+std::vector<Bytes> msgBytes(const bmmidi::TimedMsgBuffer& msgs) {
+  std::vector<Bytes> result;
+  for (const bmmidi::TimedMsgView msg : msgs) {
+    const bmmidi::MsgView view = msg.value();
+    EXPECT_THAT(bmmidi::isValidMsg(view.rawBytes(), view.numBytes()), IsTrue());
+    result.emplace_back(view.rawBytes(), view.rawBytes() + view.numBytes());
+  }
+  return result;
+}
+
+std::vector<double> timestamps(const bmmidi::TimedMsgBuffer& msgs) {
+  return std::vector<double>(msgs.rawTimestamps(), msgs.rawTimestamps() + msgs.size());
+}
+
+TEST(BleMidiEncoder, EncodesRunningStatusAcrossTimestamps) {
+  bmmidi::TimedMsgBuffer msgs;
+  push(msgs, 4660.0, {0x90, 60, 100});
+  push(msgs, 4660.0, {0x90, 62, 100});
+  push(msgs, 4661.0, {0x90, 64, 100});
+  push(msgs, 4661.0, {0xB0, 7, 100});
+
+  bmmidi::BleMidiEncoder encoder;
+  Bytes packet;
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(4));
+  EXPECT_THAT(packet, ElementsAre(0xA4, 0xB4, 0x90, 60, 100, 62, 100, 0xB5, 64, 100,
+                                  0xB5, 0xB0, 7, 100));
+
+  EXPECT_THAT(encoder.encodePacket(msgs, 4, packet), Eq(0));
+  EXPECT_THAT(packet, IsEmpty());
+}
+
+TEST(BleMidiEncoder, WrapsTimestampsWithinPacket) {
+  bmmidi::TimedMsgBuffer msgs;
+  push(msgs, 127.0, {0xF8});
+  push(msgs, 130.0, {0xF8});
+  push(msgs, 300.0, {0xF8});
+
+  bmmidi::BleMidiEncoder encoder;
+  Bytes packet;
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(2));
+  EXPECT_THAT(packet, ElementsAre(0x80, 0xFF, 0xF8, 0x82, 0xF8));
+
+  // Advancing the header's bits by 2 needs a new packet.
+  EXPECT_THAT(encoder.encodePacket(msgs, 2, packet), Eq(1));
+  EXPECT_THAT(packet, ElementsAre(0x82, 0xAC, 0xF8));
+
+  // So does advancing them by 1 without wrapping the low bits.
+  msgs.clear();
+  push(msgs, 0.0, {0xF8});
+  push(msgs, 130.0, {0xF8});
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(1));
+}
+
+TEST(BleMidiEncoder, PacksMsgsPerMtu) {
+  bmmidi::TimedMsgBuffer msgs;
+  for (int channel = 0; channel < 6; ++channel) {
+    push(msgs, 0.0, {static_cast<std::uint8_t>(0x90 | channel), 60, 100});
+  }
+
+  bmmidi::BleMidiEncoder encoder;
+  Bytes packet;
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(4));
+  EXPECT_THAT(packet.size(), Eq(17));
+  EXPECT_THAT(encoder.encodePacket(msgs, 4, packet), Eq(2));
+
+  bmmidi::BleMidiEncoderOptions options;
+  options.maxPacketBytes = 100;
+  bmmidi::BleMidiEncoder largeEncoder{options};
+  EXPECT_THAT(largeEncoder.encodePacket(msgs, 0, packet), Eq(6));
+}
+
+TEST(BleMidiEncoder, ContinuesSysExAcrossPackets) {
+  Bytes sysEx = {0xF0};
+  for (std::uint8_t i = 1; i <= 28; ++i) { sysEx.push_back(i); }
+  sysEx.push_back(0xF7);
+
+  bmmidi::TimedMsgBuffer msgs;
+  push(msgs, 0.0, sysEx);
+  push(msgs, 0.0, {0xF8});
+
+  bmmidi::BleMidiEncoder encoder;
+  Bytes packet;
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(0));
+  EXPECT_THAT(encoder.isInSysEx(), IsTrue());
+  EXPECT_THAT(packet, ElementsAre(0x80, 0x80, 0xF0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                  13, 14, 15, 16, 17));
+
+  EXPECT_THAT(encoder.encodePacket(msgs, 0, packet), Eq(2));
+  EXPECT_THAT(encoder.isInSysEx(), IsFalse());
+  EXPECT_THAT(packet, ElementsAre(0x80, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28,
+                                  0x80, 0xF7, 0x80, 0xF8));
+}
+
+TEST(BleMidiDecoder, DecodesRunningStatusAcrossTimestamps) {
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(decoder.decode(Bytes{0xA4, 0xB4, 0x90, 60, 100, 62, 100, 0xB5, 64, 100,
+                                   0xB5, 0xB0, 7, 100},
+                             1000.0, msgs),
+              IsTrue());
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0x90, 60, 100), ElementsAre(0x90, 62, 100),
+                                          ElementsAre(0x90, 64, 100), ElementsAre(0xB0, 7, 100)));
+  EXPECT_THAT(timestamps(msgs), ElementsAre(1000.0, 1000.0, 1001.0, 1001.0));
+
+  // Running status continues across packets and System messages.
+  msgs.clear();
+  decoder.decode(Bytes{0xA4, 0xB6, 0xF6, 0xB6, 8, 50}, 1002.0, msgs);
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xF6), ElementsAre(0xB0, 8, 50)));
+  EXPECT_THAT(decoder.numDiscardedBytes(), Eq(0));
+}
+
+TEST(BleMidiDecoder, ReconstructsTimestamps) {
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer msgs;
+
+  // Low bits wrapping within a packet.
+  decoder.decode(Bytes{0x80, 0xFF, 0xF8, 0x82, 0xF8}, 500.0, msgs);
+  EXPECT_THAT(timestamps(msgs), ElementsAre(500.0, 503.0));
+
+  // All 13 bits wrapping between packets.
+  decoder.reset();
+  msgs.clear();
+  decoder.decode(Bytes{0xBF, 0xFE, 0xF8}, 1000.0, msgs);
+  decoder.decode(Bytes{0x80, 0x83, 0xF8}, 1005.0, msgs);
+  EXPECT_THAT(timestamps(msgs), ElementsAre(1000.0, 1005.0));
+
+  // A whole wrap during a pause, then a slightly earlier timestamp.
+  msgs.clear();
+  decoder.decode(Bytes{0x80, 0x8D, 0xF8}, 9207.0, msgs);
+  decoder.decode(Bytes{0x80, 0x8B, 0xF8}, 9208.0, msgs);
+  EXPECT_THAT(timestamps(msgs), ElementsAre(9207.0, 9205.0));
+}
+
+TEST(BleMidiDecoder, ReassemblesSysExAcrossPackets) {
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer msgs;
+  decoder.decode(Bytes{0x80, 0x80, 0xF0, 1, 2, 0x81, 0xF8, 3}, 0.0, msgs);
+  EXPECT_THAT(decoder.isInSysEx(), IsTrue());
+  decoder.decode(Bytes{0x80, 4, 5, 0x82, 0xF7}, 2.0, msgs);
+  EXPECT_THAT(decoder.isInSysEx(), IsFalse());
+
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xF8),
+                                          ElementsAre(0xF0, 1, 2, 3, 4, 5, 0xF7)));
+  EXPECT_THAT(timestamps(msgs), ElementsAre(1.0, 0.0));
+}
+
+TEST(BleMidiDecoder, DiscardsMalformedBytes) {
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(decoder.decode(Bytes{0x00, 0x80, 0xF8}, 0.0, msgs), IsFalse());
+  EXPECT_THAT(decoder.decode(Bytes{0xC0, 0x80, 0xF8}, 0.0, msgs), IsFalse());
+
+  EXPECT_THAT(decoder.decode(Bytes{0x80, 60, 100,        // No timestamp or running status.
+                                   0x80, 0x90, 60,       // Truncated.
+                                   0x80, 0xF9,           // Undefined.
+                                   0x80, 0xF7,           // EOX without SysEx.
+                                   0x80},                // Timestamp without message.
+                             0.0, msgs),
+              IsTrue());
+  EXPECT_THAT(msgs, IsEmpty());
+  EXPECT_THAT(decoder.numDiscardedBytes(), Eq(7));
+
+  // Interrupted SysEx.
+  decoder.decode(Bytes{0x80, 0x80, 0xF0, 1, 2, 0x80, 0xC0, 5}, 0.0, msgs);
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xC0, 5)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));
+}
+
+TEST(BleMidiDecoder, DropsSysExWithoutCompleteHeader) {
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer msgs;
+  decoder.decode(Bytes{0x80, 0x80, 0xF0, 0x80, 0xF7,        // Empty.
+                       0x80, 0xF0, 0x7E, 0x80, 0xF7,        // No device or sub-IDs.
+                       0x80, 0xF0, 0x00, 0x20, 0x80, 0xF7,  // Short extended ID.
+                       0x80, 0xF0, 0x7D, 0x80, 0xF7},       // Complete.
+                 0.0, msgs);
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xF0, 0x7D, 0xF7)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(3));
+  EXPECT_THAT(decoder.isInSysEx(), IsFalse());
+}
+
+TEST(BleMidiDecoder, DropsSysExLongerThanMax) {
+  bmmidi::BleMidiDecoderOptions options;
+  options.maxSysExBytes = 6;
+  bmmidi::BleMidiDecoder decoder{options};
+  bmmidi::TimedMsgBuffer msgs;
+
+  decoder.decode(Bytes{0x80, 0x80, 0xF0, 0x7D, 1, 2, 3}, 0.0, msgs);
+  decoder.decode(Bytes{0x80, 4, 0x80, 0xF7}, 1.0, msgs);  // 7 bytes.
+  EXPECT_THAT(msgs, IsEmpty());
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));
+  EXPECT_THAT(decoder.isInSysEx(), IsFalse());
+
+  // Decoding goes on normally, and SysEx up to the max are kept.
+  decoder.decode(Bytes{0x80, 0x80, 0xF0, 0x7D, 1, 2, 0x80, 0xF7, 0x80, 0xF8}, 2.0, msgs);
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xF0, 0x7D, 1, 2, 0xF7),
+                                          ElementsAre(0xF8)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));
+}
+
+TEST(BleMidi, RoundTripsMsgs) {
+  Bytes sysEx(50, 0x33);
+  sysEx.front() = 0xF0;
+  sysEx.back() = 0xF7;
+
+  bmmidi::TimedMsgBuffer msgs;
+  double timestamp = 10000.0;
+  for (int i = 0; i < 40; ++i) {
+    push(msgs, timestamp, {0x90, static_cast<std::uint8_t>(i), 100});
+    push(msgs, timestamp, {0x80, static_cast<std::uint8_t>(i), 0});
+    if (i % 10 == 0) { push(msgs, timestamp, sysEx); }
+    timestamp += (i % 7 == 0) ? 9000.0 : static_cast<double>(i * 13);
+  }
+
+  bmmidi::BleMidiEncoder encoder;
+  bmmidi::BleMidiDecoder decoder;
+  bmmidi::TimedMsgBuffer decoded;
+  Bytes packet;
+  int index = 0;
+  while (index < msgs.size()) {
+    // Receive each packet when its first message was sent.
+    const double receivedMs = msgs[index].timestamp();
+    index += encoder.encodePacket(msgs, index, packet);
+    ASSERT_THAT(packet.size(), Le(20));
+    ASSERT_THAT(decoder.decode(packet, receivedMs, decoded), IsTrue());
+  }
+
+  EXPECT_THAT(msgBytes(decoded), Eq(msgBytes(msgs)));
+  ASSERT_THAT(decoded.size(), Eq(msgs.size()));
+  for (int i = 0; i < msgs.size(); ++i) {
+    EXPECT_THAT(decoded[i].timestamp(), DoubleEq(msgs[i].timestamp()));
+  }
+  EXPECT_THAT(decoder.numDiscardedBytes(), Eq(0));
+}
+
+}  // namespace
@@ -7,17 +7,43 @@
 #ifndef BMMIDI_BMMIDI_HPP
 #define BMMIDI_BMMIDI_HPP
 
+#include "bmmidi/ble_midi.hpp"
+#include "bmmidi/broadcast_msg_ring.hpp"
 #include "bmmidi/channel.hpp"
+#include "bmmidi/clock_mapper.hpp"
 #include "bmmidi/control.hpp"
 #include "bmmidi/data_value.hpp"
+#include "bmmidi/din_scheduler.hpp"
+#include "bmmidi/jitter_buffer.hpp"
 #include "bmmidi/key_number.hpp"
+#include "bmmidi/key_transform.hpp"
+#include "bmmidi/msg_block_index.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_columns.hpp"
+#include "bmmidi/msg_file.hpp"
+#include "bmmidi/msg_file_player.hpp"
+#include "bmmidi/msg_pipeline.hpp"
+#include "bmmidi/msg_query.hpp"
 #include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg_stream_parser.hpp"
 #include "bmmidi/msg.hpp"
+#include "bmmidi/packed_msgs.hpp"
+#include "bmmidi/pedal_resolver.hpp"
 #include "bmmidi/pitch_bend.hpp"
 #include "bmmidi/preset_number.hpp"
+#include "bmmidi/redundant_msg_filter.hpp"
+#include "bmmidi/routing_matrix.hpp"
+#include "bmmidi/rtp_midi.hpp"
+#include "bmmidi/running_status.hpp"
+#include "bmmidi/sample_clock_dll.hpp"
+#include "bmmidi/sharded_executor.hpp"
+#include "bmmidi/smf.hpp"
+#include "bmmidi/smf_batch.hpp"
 #include "bmmidi/status.hpp"
 #include "bmmidi/sysex.hpp"
+#include "bmmidi/thread_pool.hpp"
 #include "bmmidi/timecode.hpp"
 #include "bmmidi/timed.hpp"
+#include "bmmidi/usb_midi.hpp"
 
 #endif  // BMMIDI_BMMIDI_HPP
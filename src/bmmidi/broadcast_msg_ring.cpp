@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/broadcast_msg_ring.hpp"
+
+#include <algorithm>
+
+namespace bmmidi {
+
+BroadcastMsgRing::BroadcastMsgRing(int capacityBytes)
+    : words_{new std::atomic<std::uint64_t>[static_cast<std::size_t>(capacityBytes) / 8]()},
+      mask_{static_cast<std::uint64_t>(capacityBytes) / 8 - 1} {
+  assert(capacityBytes >= 256);
+  assert((capacityBytes & (capacityBytes - 1)) == 0);
+}
+
+void BroadcastMsgRing::publish(double timestamp, const MsgView& msg) {
+  assert(msg.numBytes() <= maxMsgBytes());
+  const auto numBytes = static_cast<std::uint32_t>(msg.numBytes());
+  const std::uint64_t numDataWords = dataWords(numBytes);
+  const std::uint64_t numWords = kHeaderWords + numDataWords;
+  const std::uint64_t writePos = writePos_.load(std::memory_order_relaxed);
+
+  // Retire the oldest records this will overwrite before overwriting them, so
+  // readers copying them can tell.
+  std::uint64_t oldestPos = oldestPos_.load(std::memory_order_relaxed);
+  if (writePos + numWords - oldestPos > mask_ + 1) {
+    while (writePos + numWords - oldestPos > mask_ + 1) {
+      oldestPos += kHeaderWords + dataWords(static_cast<std::uint32_t>(wordAt(oldestPos)));
+    }
+    oldestPos_.store(oldestPos, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  std::uint64_t timestampBits;
+  std::memcpy(&timestampBits, &timestamp, sizeof(timestampBits));
+  words_[writePos & mask_].store(numBytes, std::memory_order_relaxed);
+  words_[(writePos + 1) & mask_].store(timestampBits, std::memory_order_relaxed);
+
+  const std::uint8_t* bytes = msg.rawBytes();
+  for (std::uint64_t i = 0; i < numDataWords; ++i) {
+    std::uint64_t word = 0;
+    const std::uint64_t offset = 8 * i;
+    std::memcpy(&word, &bytes[offset], std::min<std::uint64_t>(8, numBytes - offset));
+    words_[(writePos + kHeaderWords + i) & mask_].store(word, std::memory_order_relaxed);
+  }
+
+  writePos_.store(writePos + numWords, std::memory_order_release);
+}
+
+}  // namespace bmmidi
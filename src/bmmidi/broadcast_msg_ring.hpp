@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_BROADCAST_MSG_RING_HPP
+#define BMMIDI_BROADCAST_MSG_RING_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/**
+ * Single-producer, multi-consumer broadcast ring of timed messages (including
+ * SysEx, stored inline): the producer writes each message once, and any # of
+ * readers (each on its own thread) read every message at their own pace, so
+ * fanning one stream out to N consumers costs one write instead of N queue
+ * pushes.
+ *
+ * The producer never waits for readers: once the ring is full, publishing
+ * overwrites the oldest messages. A reader that falls more than a ring's worth
+ * behind detects the overrun (even in the middle of copying a message), skips
+ * ahead to the oldest intact message, and counts it (see
+ * Reader::numOverruns()).
+ *
+ * Messages are stored as 64-bit words accessed atomically (records are copied
+ * out and then validated, as with a seqlock), so readers never block the
+ * producer or each other.
+ */
+class BroadcastMsgRing {
+public:
+  /** A reader's cursor into the ring, used by only one thread at a time. */
+  class Reader {
+  public:
+    /** Returns # of times this reader was overrun (and so missed messages). */
+    std::int64_t numOverruns() const { return numOverruns_; }
+
+  private:
+    friend class BroadcastMsgRing;
+
+    explicit Reader(std::uint64_t pos) : pos_{pos} {}
+
+    std::uint64_t pos_;  // Word position of the next record to read.
+    std::vector<std::uint64_t> scratch_;
+    std::int64_t numOverruns_ = 0;
+  };
+
+  /** Creates a ring holding capacityBytes (a power of 2, at least 256) of records. */
+  explicit BroadcastMsgRing(int capacityBytes);
+
+  BroadcastMsgRing(const BroadcastMsgRing&) = delete;
+  BroadcastMsgRing& operator=(const BroadcastMsgRing&) = delete;
+
+  /** Returns the maximum # of bytes of each message. */
+  int maxMsgBytes() const { return static_cast<int>((mask_ + 1) / 2 - kHeaderWords) * 8; }
+
+  /**
+   * Publishes msg (of at most maxMsgBytes()) with the given timestamp to all
+   * readers, overwriting the oldest messages if needed. Must only be called by
+   * the (single) producer thread. Never blocks.
+   */
+  void publish(double timestamp, const MsgView& msg);
+
+  /** Returns a reader that will read messages published from now on. */
+  Reader reader() const { return Reader{writePos_.load(std::memory_order_acquire)}; }
+
+  /** Returns true if reader has no more messages to read. */
+  bool isCaughtUp(const Reader& reader) const {
+    return reader.pos_ == writePos_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Reads up to maxMsgs messages published since reader's last read, in
+   * order, calling emit(const TimedMsgView&) with a copy of each. Returns the
+   * # of messages read.
+   *
+   * Emitted TimedMsgView references are only valid during each emit() call.
+   */
+  template<typename EmitFn>
+  int read(Reader& reader, EmitFn&& emit, int maxMsgs = std::numeric_limits<int>::max()) const {
+    const std::uint64_t writePos = writePos_.load(std::memory_order_acquire);
+    int numRead = 0;
+    while ((reader.pos_ != writePos) && (numRead < maxMsgs)) {
+      const std::uint64_t oldestPos = oldestPos_.load(std::memory_order_acquire);
+      if (reader.pos_ < oldestPos) {
+        skipTo(reader, oldestPos);
+        continue;
+      }
+
+      // Copy the record, then check it wasn't overwritten meanwhile (in which
+      // case any garbage copied is discarded).
+      const std::uint64_t header = wordAt(reader.pos_);
+      const std::uint64_t timestampBits = wordAt(reader.pos_ + 1);
+      const auto numBytes = static_cast<std::uint32_t>(header);
+      const std::uint64_t numDataWords = dataWords(numBytes);
+      const bool isSane = (numBytes <= static_cast<std::uint32_t>(maxMsgBytes()));
+      if (isSane) {
+        reader.scratch_.resize(numDataWords);
+        for (std::uint64_t i = 0; i < numDataWords; ++i) {
+          reader.scratch_[i] = wordAt(reader.pos_ + kHeaderWords + i);
+        }
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const std::uint64_t newOldestPos = oldestPos_.load(std::memory_order_relaxed);
+      if (reader.pos_ < newOldestPos) {
+        skipTo(reader, newOldestPos);
+        continue;
+      }
+      assert(isSane);
+
+      double timestamp;
+      std::memcpy(&timestamp, &timestampBits, sizeof(timestamp));
+      const auto* bytes = reinterpret_cast<const std::uint8_t*>(reader.scratch_.data());
+      emit(TimedMsgView{timestamp, bytes, static_cast<int>(numBytes)});
+      reader.pos_ += kHeaderWords + numDataWords;
+      ++numRead;
+    }
+    return numRead;
+  }
+
+private:
+  // Each record is a header word (holding the # of message bytes), a
+  // timestamp word, and then the message bytes packed into words.
+  static constexpr std::uint64_t kHeaderWords = 2;
+
+  static std::uint64_t dataWords(std::uint32_t numBytes) {
+    return (std::uint64_t{numBytes} + 7) / 8;
+  }
+
+  std::uint64_t wordAt(std::uint64_t pos) const {
+    return words_[pos & mask_].load(std::memory_order_relaxed);
+  }
+
+  static void skipTo(Reader& reader, std::uint64_t pos) {
+    reader.pos_ = pos;
+    ++reader.numOverruns_;
+  }
+
+  std::unique_ptr<std::atomic<std::uint64_t>[]> words_;
+  std::uint64_t mask_;
+
+  // Word positions (increasing forever) of the end of the newest record, and
+  // of the start of the oldest record not (being) overwritten.
+  alignas(64) std::atomic<std::uint64_t> writePos_{0};
+  std::atomic<std::uint64_t> oldestPos_{0};
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_BROADCAST_MSG_RING_HPP
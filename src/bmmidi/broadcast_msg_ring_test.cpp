@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/broadcast_msg_ring.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/test_msgs.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+using Bytes = std::vector<std::uint8_t>;
+
+using bmmidi::test::viewOf;
+
+// Reads all available messages as {timestamp, bytes...}.
+std::vector<std::vector<double>> readAll(const bmmidi::BroadcastMsgRing& ring,
+                                         bmmidi::BroadcastMsgRing::Reader& reader) {
+  std::vector<std::vector<double>> result;
+  ring.read(reader, [&result](const bmmidi::TimedMsgView& msg) {
+    std::vector<double> entry{msg.timestamp()};
+    const bmmidi::MsgView view = msg.value();
+    entry.insert(entry.end(), view.rawBytes(), view.rawBytes() + view.numBytes());
+    result.push_back(entry);
+  });
+  return result;
+}
+
+// Test sequence with frequent short SysEx messages (so many fit in the ring).
+Bytes testMsg(int index) { return bmmidi::test::testMsg(index, 10, 39); }
+
+TEST(BroadcastMsgRing, DeliversEveryMsgToEachReader) {
+  bmmidi::BroadcastMsgRing ring{1024};
+  EXPECT_THAT(ring.maxMsgBytes(), Eq(496));
+
+  auto early = ring.reader();
+  ring.publish(1.0, viewOf({0x90, 60, 100}));
+  auto late = ring.reader();
+  ring.publish(2.0, viewOf({0xF0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xF7}));
+
+  EXPECT_THAT(readAll(ring, early),
+              ElementsAre(ElementsAre(1.0, 0x90, 60, 100),
+                          ElementsAre(2.0, 0xF0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xF7)));
+  EXPECT_THAT(readAll(ring, late),
+              ElementsAre(ElementsAre(2.0, 0xF0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xF7)));
+  EXPECT_THAT(ring.isCaughtUp(early), IsTrue());
+  EXPECT_THAT(readAll(ring, early), IsEmpty());
+
+  ring.publish(3.0, viewOf({0xF8}));
+  EXPECT_THAT(ring.isCaughtUp(early), IsFalse());
+  EXPECT_THAT(ring.read(early, [](const bmmidi::TimedMsgView&) {}, 1), Eq(1));
+  EXPECT_THAT(readAll(ring, late), ElementsAre(ElementsAre(3.0, 0xF8)));
+  EXPECT_THAT(early.numOverruns(), Eq(0));
+}
+
+TEST(BroadcastMsgRing, DetectsOverruns) {
+  // 32 words, and each 3-byte message takes 3 words.
+  bmmidi::BroadcastMsgRing ring{256};
+  auto slow = ring.reader();
+  auto fast = ring.reader();
+
+  for (int i = 0; i < 20; ++i) {
+    ring.publish(i, viewOf({0xB0, 7, static_cast<std::uint8_t>(i)}));
+    EXPECT_THAT(readAll(ring, fast), ElementsAre(ElementsAre(i, 0xB0, 7, i)));
+  }
+  EXPECT_THAT(fast.numOverruns(), Eq(0));
+
+  // Only the newest 10 messages are intact.
+  const auto msgs = readAll(ring, slow);
+  EXPECT_THAT(slow.numOverruns(), Eq(1));
+  ASSERT_THAT(msgs.size(), Eq(10));
+  EXPECT_THAT(msgs.front(), ElementsAre(10.0, 0xB0, 7, 10));
+  EXPECT_THAT(msgs.back(), ElementsAre(19.0, 0xB0, 7, 19));
+}
+
+TEST(BroadcastMsgRing, ReadersNeverSeeTornMsgs) {
+  constexpr int kNumMsgs = 50000;
+  constexpr int kNumReaders = 3;
+  bmmidi::BroadcastMsgRing ring{512};
+
+  std::vector<bmmidi::BroadcastMsgRing::Reader> readers;
+  for (int i = 0; i < kNumReaders; ++i) { readers.push_back(ring.reader()); }
+
+  std::atomic<bool> isDone{false};
+  std::vector<int> numRead(kNumReaders, 0);
+  std::vector<int> numBad(kNumReaders, 0);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < kNumReaders; ++r) {
+    threads.emplace_back([&, r] {
+      int lastIndex = -1;
+      auto check = [&](const bmmidi::TimedMsgView& msg) {
+        const auto index = static_cast<int>(msg.timestamp());
+        const bmmidi::MsgView view = msg.value();
+        if ((index <= lastIndex)
+            || (Bytes(view.rawBytes(), view.rawBytes() + view.numBytes()) != testMsg(index))) {
+          ++numBad[r];
+        }
+        lastIndex = index;
+        ++numRead[r];
+      };
+      while (!isDone.load() || !ring.isCaughtUp(readers[r])) {
+        if (ring.read(readers[r], check) == 0) { std::this_thread::yield(); }
+      }
+    });
+  }
+
+  for (int i = 0; i < kNumMsgs; ++i) {
+    const Bytes msg = testMsg(i);
+    ring.publish(i, viewOf(msg));
+    if (i % 64 == 0) { std::this_thread::yield(); }
+  }
+  isDone = true;
+  for (std::thread& thread : threads) { thread.join(); }
+
+  for (int r = 0; r < kNumReaders; ++r) {
+    EXPECT_THAT(numBad[r], Eq(0));
+    EXPECT_THAT(numRead[r], Gt(0));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/clock_mapper.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace bmmidi {
+namespace {
+
+// Initial variance of the offset and rate, which is large so the first few
+// pairs dominate (as in ordinary least squares).
+constexpr double kInitialVariance = 1e4;
+
+// Bounds of the rate used for mapping (+-1000 ppm), far beyond real clock
+// drift, so a few badly delayed pairs can't make the mapping decreasing.
+constexpr double kMinRate = 1.0 - 1e-3;
+constexpr double kMaxRate = 1.0 + 1e-3;
+
+}  // namespace
+
+void ClockMapper::addPair(double deviceTime, double hostTime) {
+  if (numPairs_ == 0) {
+    deviceOrigin_ = deviceTime;
+    offset_ = hostTime;
+    rate_ = 1.0;
+    p00_ = kInitialVariance;
+    p01_ = 0.0;
+    p11_ = kInitialVariance;
+  }
+  ++numPairs_;
+
+  // RLS update with regressor x = (1, t), where P is symmetric:
+  // k = P x / (lambda + x' P x), theta += k * error, P = (P - k x' P) / lambda.
+  const double t = deviceTime - deviceOrigin_;
+  const double px0 = p00_ + p01_ * t;
+  const double px1 = p01_ + p11_ * t;
+  const double gainDenominator = forgettingFactor_ + px0 + px1 * t;
+  const double k0 = px0 / gainDenominator;
+  const double k1 = px1 / gainDenominator;
+
+  const double error = hostTime - (offset_ + rate_ * t);
+  offset_ += k0 * error;
+  rate_ += k1 * error;
+
+  p00_ = (p00_ - k0 * px0) / forgettingFactor_;
+  p01_ = (p01_ - k0 * px1) / forgettingFactor_;
+  p11_ = (p11_ - k1 * px1) / forgettingFactor_;
+}
+
+double ClockMapper::rate() const {
+  return (numPairs_ > 0) ? std::min(std::max(rate_, kMinRate), kMaxRate) : 1.0;
+}
+
+void ClockMapper::mapToHost(TimedMsgBuffer& msgs) const {
+  if (numPairs_ == 0) { return; }
+  for (int i = 0; i < msgs.size(); ++i) { msgs.setTimestampAt(i, toHost(msgs.timestampAt(i))); }
+}
+
+void ClockDomainMerger::merge(const std::vector<const TimedMsgBuffer*>& inputs,
+                              TimedMsgBuffer& out, std::vector<int>* outSources) const {
+  assert(static_cast<int>(inputs.size()) == numSources());
+
+  struct Head {
+    double hostTime;
+    int source;
+    int index;
+
+    bool operator>(const Head& other) const {
+      return (hostTime != other.hostTime) ? (hostTime > other.hostTime)
+                                          : (source > other.source);
+    }
+  };
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  for (int source = 0; source < numSources(); ++source) {
+    const TimedMsgBuffer* input = inputs[source];
+    if ((input != nullptr) && !input->empty()) {
+      heads.push(Head{mappers_[source].toHost(input->timestampAt(0)), source, 0});
+    }
+  }
+
+  while (!heads.empty()) {
+    const Head head = heads.top();
+    heads.pop();
+    const TimedMsgBuffer& input = *inputs[head.source];
+    out.push(head.hostTime, input[head.index].value());
+    if (outSources != nullptr) { outSources->push_back(head.source); }
+
+    const int next = head.index + 1;
+    if (next < input.size()) {
+      assert(input.timestampAt(next) >= input.timestampAt(head.index));
+      heads.push(Head{mappers_[head.source].toHost(input.timestampAt(next)), head.source, next});
+    }
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_CLOCK_MAPPER_HPP
+#define BMMIDI_CLOCK_MAPPER_HPP
+
+#include <cassert>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace bmmidi {
+
+/**
+ * Maps timestamps from a device's clock to the host clock, by fitting
+ * hostTime = offset + rate * deviceTime to pairs of (device, host)
+ * timestamps of the same instants with recursive least squares (RLS).
+ *
+ * Each pair updates the fit in O(1). The forgetting factor weights older
+ * pairs less (by forgettingFactor per pair), so the fit follows slow changes
+ * in drift (e.g. as a device's crystal warms up). Device times are fitted
+ * relative to the first pair's, to keep the fit well conditioned over long
+ * recordings.
+ *
+ * Pairs are typically a device's timestamp of a message (or sync packet) and
+ * the host time it was received; delivery jitter averages out, but pairs
+ * with unusually long delays (e.g. after a stall) are best left out.
+ *
+ * Mapping uses the fitted rate clamped to within 1000 ppm of 1 (far beyond
+ * real clock drift), so it stays increasing even while the first few pairs
+ * are badly delayed and fit a wild (or negative) rate; the fit itself is not
+ * clamped, so later pairs still correct it.
+ */
+class ClockMapper {
+public:
+  /** Creates a mapper with no pairs, which maps device times unchanged. */
+  explicit ClockMapper(double forgettingFactor = 0.9999) : forgettingFactor_{forgettingFactor} {
+    assert((0.0 < forgettingFactor) && (forgettingFactor <= 1.0));
+  }
+
+  /** Forgets all pairs. */
+  void reset() { numPairs_ = 0; }
+
+  /** Updates the fit with a pair of timestamps of the same instant. */
+  void addPair(double deviceTime, double hostTime);
+
+  /** Returns # of pairs added since construction or reset(). */
+  int numPairs() const { return numPairs_; }
+
+  /** Returns true once enough pairs were added to fit drift (not just offset). */
+  bool hasDrift() const { return numPairs_ >= 2; }
+
+  /**
+   * Returns the host seconds per device second used for mapping: the fitted
+   * rate, within 1000 ppm of 1 (and 1 until hasDrift()).
+   */
+  double rate() const;
+
+  /**
+   * Returns how much faster the device clock runs than the host clock, in
+   * parts per million (negative if slower).
+   */
+  double driftPpm() const { return (1.0 / rate() - 1.0) * 1e6; }
+
+  /** Returns host time of deviceTime. */
+  double toHost(double deviceTime) const {
+    return (numPairs_ > 0) ? offset_ + rate() * (deviceTime - deviceOrigin_) : deviceTime;
+  }
+
+  /** Returns device time of hostTime. */
+  double toDevice(double hostTime) const {
+    return (numPairs_ > 0) ? deviceOrigin_ + (hostTime - offset_) / rate() : hostTime;
+  }
+
+  /**
+   * Maps all timestamps of msgs from device to host time. Since the mapping
+   * is increasing, msgs stay in order.
+   */
+  void mapToHost(TimedMsgBuffer& msgs) const;
+
+private:
+  double forgettingFactor_;
+  int numPairs_ = 0;
+  double deviceOrigin_ = 0.0;
+
+  // Fit (offset at deviceOrigin_, unclamped rate) and its inverse correlation
+  // matrix.
+  double offset_ = 0.0;
+  double rate_ = 1.0;
+  double p00_ = 0.0;
+  double p01_ = 0.0;
+  double p11_ = 0.0;
+};
+
+/**
+ * Merges timestamp-sorted message streams from several devices, each with its
+ * own ClockMapper, into one host-time stream, mapping timestamps as it merges
+ * (so merging is O(n log k) for k sources, with no re-sorting).
+ */
+class ClockDomainMerger {
+public:
+  /** Creates a merger for numSources sources. */
+  explicit ClockDomainMerger(int numSources, double forgettingFactor = 0.9999)
+      : mappers_(static_cast<std::size_t>(numSources), ClockMapper{forgettingFactor}) {
+    assert(numSources > 0);
+  }
+
+  /** Returns # of sources. */
+  int numSources() const { return static_cast<int>(mappers_.size()); }
+
+  /** Returns the clock mapper of source. */
+  ClockMapper& mapper(int source) {
+    assert((0 <= source) && (source < numSources()));
+    return mappers_[source];
+  }
+  const ClockMapper& mapper(int source) const {
+    assert((0 <= source) && (source < numSources()));
+    return mappers_[source];
+  }
+
+  /**
+   * Appends the messages of inputs[source] (one per source, each sorted by
+   * device time; nullptr for none) to out in host time order, with ties in
+   * source order. If outSources is not nullptr, appends the source of each
+   * message to it.
+   */
+  void merge(const std::vector<const TimedMsgBuffer*>& inputs, TimedMsgBuffer& out,
+             std::vector<int>* outSources = nullptr) const;
+
+private:
+  std::vector<ClockMapper> mappers_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_CLOCK_MAPPER_HPP
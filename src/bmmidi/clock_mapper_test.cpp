@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/clock_mapper.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+using Bytes = std::vector<std::uint8_t>;
+
+// Device clock that runs fast by driftPpm and started at hostStart.
+struct SimulatedDevice {
+  double hostStart;
+  double driftPpm;
+
+  double deviceTimeAt(double hostTime) const {
+    return (hostTime - hostStart) * (1.0 + driftPpm * 1e-6);
+  }
+};
+
+TEST(ClockMapper, MapsUnchangedWithoutPairs) {
+  bmmidi::ClockMapper mapper;
+  EXPECT_THAT(mapper.toHost(12.5), Eq(12.5));
+  EXPECT_THAT(mapper.toDevice(12.5), Eq(12.5));
+  mapper.addPair(10.0, 110.0);
+  EXPECT_THAT(mapper.hasDrift(), IsFalse());
+  EXPECT_THAT(mapper.toHost(12.5), DoubleNear(112.5, 1e-9));
+}
+
+TEST(ClockMapper, FitsOffsetAndDriftDespiteJitter) {
+  const SimulatedDevice device{1000.0, 50.0};
+  std::mt19937 random{42};
+  std::uniform_real_distribution<double> delay{0.0005, 0.0025};
+
+  // Pairs every 100 ms for an hour, received after 0.5-2.5 ms of delay.
+  bmmidi::ClockMapper mapper;
+  for (int i = 0; i < 36000; ++i) {
+    const double hostTime = 1000.0 + i * 0.1;
+    mapper.addPair(device.deviceTimeAt(hostTime), hostTime + delay(random));
+  }
+
+  ASSERT_THAT(mapper.hasDrift(), IsTrue());
+  EXPECT_THAT(mapper.driftPpm(), DoubleNear(50.0, 1.0));
+  // Mean delivery delay (1.5 ms) shows up as offset; the error is within jitter.
+  const double hostTime = 4500.0;
+  EXPECT_THAT(mapper.toHost(device.deviceTimeAt(hostTime)), DoubleNear(hostTime + 0.0015, 3e-4));
+  EXPECT_THAT(mapper.toDevice(mapper.toHost(123.0)), DoubleNear(123.0, 1e-9));
+}
+
+TEST(ClockMapper, KeepsRateNearOneDespiteDelayedFirstPair) {
+  // First pair arrives 150 ms late, so the first two alone fit a negative rate.
+  bmmidi::ClockMapper mapper;
+  mapper.addPair(0.0, 100.15);
+  mapper.addPair(0.1, 100.1);
+
+  ASSERT_THAT(mapper.hasDrift(), IsTrue());
+  EXPECT_THAT(mapper.rate(), DoubleNear(1.0, 1e-3 + 1e-12));
+  EXPECT_THAT(mapper.toHost(0.2), Gt(mapper.toHost(0.1)));
+  EXPECT_THAT(mapper.toDevice(100.2), Gt(mapper.toDevice(100.1)));
+
+  // Later (promptly delivered) pairs still recover the actual rate.
+  for (int i = 2; i < 10000; ++i) { mapper.addPair(i * 0.1, 100.0 + i * 0.1); }
+  EXPECT_THAT(mapper.driftPpm(), DoubleNear(0.0, 1.0));
+  EXPECT_THAT(mapper.toHost(1000.0), DoubleNear(1100.0, 1e-3));
+}
+
+TEST(ClockMapper, MapsBufferToHost) {
+  bmmidi::ClockMapper mapper;
+  mapper.addPair(0.0, 100.0);
+  mapper.addPair(10.0, 110.01);
+
+  const Bytes clock = {0xF8};
+  bmmidi::TimedMsgBuffer msgs;
+  msgs.push(0.0, clock.data(), 1);
+  msgs.push(5.0, clock.data(), 1);
+  mapper.mapToHost(msgs);
+  EXPECT_THAT(msgs.timestampAt(0), DoubleNear(100.0, 1e-6));
+  EXPECT_THAT(msgs.timestampAt(1), DoubleNear(105.005, 1e-6));
+}
+
+TEST(ClockDomainMerger, MergesDriftingDevicesInHostOrder) {
+  const std::vector<SimulatedDevice> devices = {{0.0, 80.0}, {0.3, -40.0}};
+  bmmidi::ClockDomainMerger merger{2};
+  for (int source = 0; source < 2; ++source) {
+    for (int i = 0; i <= 60; ++i) {
+      const double hostTime = i * 60.0;
+      merger.mapper(source).addPair(devices[source].deviceTimeAt(hostTime), hostTime);
+    }
+  }
+
+  // Interleaved notes an hour in: 10 ms apart on the host clock, where the
+  // unmapped device clocks disagree by far more.
+  std::vector<bmmidi::TimedMsgBuffer> inputs(2);
+  for (int i = 0; i < 10; ++i) {
+    const int source = i % 2;
+    const Bytes note = {0x90, static_cast<std::uint8_t>(i), 100};
+    inputs[source].push(devices[source].deviceTimeAt(3600.0 + i * 0.01), note.data(), 3);
+  }
+
+  bmmidi::TimedMsgBuffer out;
+  std::vector<int> outSources;
+  merger.merge({&inputs[0], &inputs[1]}, out, &outSources);
+  ASSERT_THAT(out.size(), Eq(10));
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_THAT(out[i].value().rawBytes()[1], Eq(i));
+    EXPECT_THAT(out.timestampAt(i), DoubleNear(3600.0 + i * 0.01, 1e-6));
+  }
+  EXPECT_THAT(outSources, ElementsAre(0, 1, 0, 1, 0, 1, 0, 1, 0, 1));
+}
+
+}  // namespace
@@ -14,4 +14,16 @@
   #endif
 #endif
 
+// C++20 coroutine support (required by bmmidi/async_msgs.hpp):
+#ifndef BMMIDI_HAS_COROUTINES
+  #if defined(__cpp_impl_coroutine) && defined(__has_include)
+    #if __has_include(<coroutine>)
+      #define BMMIDI_HAS_COROUTINES 1
+    #endif
+  #endif
+  #ifndef BMMIDI_HAS_COROUTINES
+    #define BMMIDI_HAS_COROUTINES 0
+  #endif
+#endif
+
 #endif  // BMMIDI_CPP_FEATURES_HPP
@@ -0,0 +1,220 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/din_scheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "bmmidi/control.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+namespace {
+
+// Coalescing slots per channel: one per control, one per key (for Key
+// Pressure), then Channel Pressure and Pitch Bend.
+constexpr int kKeyPressureSlot = kNumControls;
+constexpr int kChanPressureSlot = kKeyPressureSlot + kNumKeys;
+constexpr int kPitchBendSlot = kChanPressureSlot + 1;
+constexpr int kSlotsPerChannel = kPitchBendSlot + 1;
+
+constexpr int kNoSlot = -1;
+
+bool isCommandControl(int control) {
+  switch (static_cast<Control>(control)) {
+    case Control::kDataEntry:
+    case Control::kLsbDataEntry:
+    case Control::kDataIncrement:
+    case Control::kDataDecrement:
+    case Control::kLsbNRPN:
+    case Control::kNRPN:
+    case Control::kLsbRPN:
+    case Control::kRPN:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool isNormalPriorityControl(int control) {
+  // Bank Select must stay ordered with Program Change, and switch pedals and
+  // Channel Mode messages with notes.
+  return (control == static_cast<int>(Control::kBankSelect))
+      || (control == static_cast<int>(Control::kLsbBankSelect))
+      || ((static_cast<int>(Control::kSustainPedal) <= control)
+          && (control <= static_cast<int>(Control::k069)))
+      || (control >= static_cast<int>(Control::kAllSoundOff));
+}
+
+// Returns coalescing slot of a kBulk priority channel message (within its
+// channel), or kNoSlot if it must never be coalesced.
+int coalescingSlot(const std::uint8_t* bytes) {
+  switch (static_cast<MsgType>(bytes[0] & 0xF0)) {
+    case MsgType::kControlChange:
+      return isCommandControl(bytes[1]) ? kNoSlot : bytes[1];
+
+    case MsgType::kPolyphonicKeyPressure:
+      return kKeyPressureSlot + bytes[1];
+
+    case MsgType::kChannelPressure:
+      return kChanPressureSlot;
+
+    case MsgType::kPitchBend:
+      return kPitchBendSlot;
+
+    default:
+      return kNoSlot;
+  }
+}
+
+}  // namespace
+
+DinPriority dinPriorityOf(const MsgView& msg) {
+  const Status status = msg.status();
+  if (status.value() >= static_cast<std::uint8_t>(MsgType::kTimingClock)) {
+    return DinPriority::kRealtime;
+  }
+
+  switch (status.type()) {
+    case MsgType::kNoteOff:
+    case MsgType::kNoteOn:
+    case MsgType::kProgramChange:
+      return DinPriority::kNormal;
+
+    case MsgType::kControlChange:
+      return isNormalPriorityControl(msg.rawBytes()[1]) ? DinPriority::kNormal
+                                                         : DinPriority::kBulk;
+
+    case MsgType::kPolyphonicKeyPressure:
+    case MsgType::kChannelPressure:
+    case MsgType::kPitchBend:
+    case MsgType::kSystemExclusive:
+      return DinPriority::kBulk;
+
+    default:
+      // System Common.
+      return DinPriority::kNormal;
+  }
+}
+
+DinOutputScheduler::DinOutputScheduler(const DinSchedulerOptions& options)
+    : options_{options},
+      secondsPerByte_{1.0 / options.bytesPerSecond},
+      pendingSeqs_(kNumChannels * kSlotsPerChannel, 0) {
+  assert(options.bytesPerSecond > 0.0);
+}
+
+void DinOutputScheduler::enqueue(double time, const MsgView& msg) {
+  const DinPriority priority = dinPriorityOf(msg);
+  Queue& queue = queues_[static_cast<int>(priority)];
+  const std::uint8_t* bytes = msg.rawBytes();
+
+  if ((priority == DinPriority::kBulk) && options_.coalesce
+      && msg.status().isChannelSpecific()) {
+    const int slot = coalescingSlot(bytes);
+    if (slot != kNoSlot) {
+      std::int64_t& pendingSeq = pendingSeqs_[(bytes[0] & 0x0F) * kSlotsPerChannel + slot];
+      if ((pendingSeq != 0) && (pendingSeq - 1 >= queue.firstSeq)) {
+        // Still queued: replace its value in place (keeping its queue position
+        // and time, so a steady stream of updates cannot starve it).
+        Entry& pending = queue.entries[pendingSeq - 1 - queue.firstSeq];
+        assert(pending.numBytes == msg.numBytes());
+        std::memcpy(pending.bytes, bytes, msg.numBytes());
+        ++numCoalesced_;
+        return;
+      }
+      pendingSeq = queue.firstSeq + static_cast<std::int64_t>(queue.entries.size()) + 1;
+    }
+  }
+
+  queue.entries.emplace_back();
+  Entry& entry = queue.entries.back();
+  entry.time = time;
+  entry.numBytes = msg.numBytes();
+  if (msg.numBytes() <= static_cast<int>(sizeof(entry.bytes))) {
+    std::memcpy(entry.bytes, bytes, msg.numBytes());
+  } else {
+    entry.sysEx.assign(bytes, bytes + msg.numBytes());
+  }
+}
+
+const DinOutputScheduler::Entry* DinOutputScheduler::popNext(
+    double now, double& startTime, int& numOmitted) {
+  double earliestTime = std::numeric_limits<double>::infinity();
+  for (const Queue& queue : queues_) {
+    if (!queue.entries.empty()) {
+      earliestTime = std::min(earliestTime, queue.entries.front().time);
+    }
+  }
+
+  // The wire next becomes available for a message at this time.
+  const double time = std::max(wireFreeTime_, earliestTime);
+  if (!(time <= now)) { return nullptr; }
+
+  // Highest priority message due by then (there is always at least one).
+  for (Queue& queue : queues_) {
+    if (queue.entries.empty() || (queue.entries.front().time > time)) { continue; }
+
+    sending_ = std::move(queue.entries.front());
+    queue.entries.pop_front();
+    ++queue.firstSeq;
+
+    const MsgView msg{sending_.data(), sending_.numBytes};
+    numOmitted = options_.useRunningStatus ? runningStatus_.advance(msg) : 0;
+    startTime = time;
+    wireFreeTime_ = time + wireDuration(sending_.numBytes - numOmitted);
+    return &sending_;
+  }
+
+  assert(false);
+  return nullptr;
+}
+
+double DinOutputScheduler::predictedDrainTime(double now) const {
+  // Replay popNext() over the queue fronts, without mutating anything.
+  std::size_t next[kNumPriorities] = {};
+  double time = std::max(wireFreeTime_, now);
+  for (;;) {
+    double earliestTime = std::numeric_limits<double>::infinity();
+    for (int p = 0; p < kNumPriorities; ++p) {
+      const auto& entries = queues_[p].entries;
+      if (next[p] < entries.size()) {
+        earliestTime = std::min(earliestTime, entries[next[p]].time);
+      }
+    }
+    if (earliestTime == std::numeric_limits<double>::infinity()) { return time; }
+
+    time = std::max(time, earliestTime);
+    for (int p = 0; p < kNumPriorities; ++p) {
+      const auto& entries = queues_[p].entries;
+      if ((next[p] < entries.size()) && (entries[next[p]].time <= time)) {
+        time += wireDuration(entries[next[p]].numBytes);
+        ++next[p];
+        break;
+      }
+    }
+  }
+}
+
+int DinOutputScheduler::numQueued() const {
+  int result = 0;
+  for (const Queue& queue : queues_) { result += static_cast<int>(queue.entries.size()); }
+  return result;
+}
+
+void DinOutputScheduler::clear() {
+  for (Queue& queue : queues_) {
+    queue.firstSeq += static_cast<std::int64_t>(queue.entries.size());
+    queue.entries.clear();
+  }
+  runningStatus_.reset();
+}
+
+}  // namespace bmmidi
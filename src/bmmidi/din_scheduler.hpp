@@ -0,0 +1,210 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_DIN_SCHEDULER_HPP
+#define BMMIDI_DIN_SCHEDULER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/running_status.hpp"
+#include "bmmidi/timed.hpp"
+
+namespace bmmidi {
+
+/** Classes of output message priority used by DinOutputScheduler. */
+enum class DinPriority {
+  /** System Realtime messages (clock, start/stop, ...), always sent first. */
+  kRealtime,
+
+  /**
+   * Timing-critical messages: notes, Program Change and Bank Select, switch
+   * pedals (CC 64-69) and Channel Mode messages (whose order relative to notes
+   * matters), and System Common messages.
+   */
+  kNormal,
+
+  /**
+   * Continuous controller data, Pitch Bend, Channel/Key Pressure, and System
+   * Exclusive messages, which may be delayed behind kNormal messages.
+   */
+  kBulk,
+};
+
+/** Returns the priority class DinOutputScheduler uses for msg. */
+DinPriority dinPriorityOf(const MsgView& msg);
+
+/** Options for DinOutputScheduler. */
+struct DinSchedulerOptions {
+  /**
+   * Wire bandwidth, in bytes per second. Defaults to a standard DIN/serial
+   * MIDI link: 31250 baud with 10 bits per byte (start + 8 data + stop).
+   */
+  double bytesPerSecond = 3125.0;
+
+  /** Omit repeated Channel Voice status bytes (see RunningStatusEncoder). */
+  bool useRunningStatus = true;
+
+  /**
+   * Replace a still-queued kBulk Control Change, Pitch Bend, or Channel/Key
+   * Pressure value with a newer value for the same channel and control (or
+   * key). Data Entry, Data Increment/Decrement, and (N)RPN parameter number
+   * controls are never coalesced, since each one is a command.
+   */
+  bool coalesce = true;
+};
+
+/** One message committed to the wire by DinOutputScheduler::transmit(). */
+struct DinTransmission {
+  /** Predicted time the first wire byte starts transmitting. */
+  double startTime;
+
+  /** Predicted time the last wire byte finishes transmitting. */
+  double endTime;
+
+  /** Requested (enqueued) time of the message, which is <= startTime. */
+  double requestedTime;
+
+  /** The complete message (including its status byte). */
+  MsgView msg;
+
+  /**
+   * Bytes to write to the wire: msg's bytes with the status byte omitted if
+   * running status allows.
+   */
+  const std::uint8_t* wireBytes;
+  int numWireBytes;
+};
+
+/**
+ * Rate-aware output scheduler for bandwidth-limited (e.g. 31.25 kbaud DIN)
+ * MIDI links, where a burst of controller data can otherwise delay
+ * timing-critical notes by many milliseconds.
+ *
+ * Messages are queued with enqueue() in the order they are produced, each
+ * with the time it should ideally be sent. transmit() then simulates wire
+ * occupancy (from each message's encoded size, including running status
+ * savings) up to the current time, committing messages to the wire in
+ * DinPriority order: among messages already due when the wire frees up, a
+ * higher priority message is always sent first. Within a priority class,
+ * messages are sent in enqueue order.
+ *
+ * Because lower priority messages may be overtaken, ordering is only
+ * preserved within each priority class. The classes are chosen so that
+ * messages whose relative order changes their meaning (e.g. sustain pedal vs.
+ * Note Off, or Bank Select vs. Program Change) share a class.
+ *
+ * Not thread-safe: enqueue() and transmit() must be called from the same
+ * thread (or externally synchronized).
+ */
+class DinOutputScheduler {
+public:
+  explicit DinOutputScheduler(const DinSchedulerOptions& options = DinSchedulerOptions{});
+
+  /** Queues a copy of msg to be sent at (or as soon as possible after) time. */
+  void enqueue(double time, const MsgView& msg);
+
+  /** Queues a copy of timedMsg. */
+  void enqueue(const TimedMsgView& timedMsg) { enqueue(timedMsg.timestamp(), timedMsg.value()); }
+
+  /**
+   * Commits every queued message whose predicted wire start time is <= now,
+   * calling emit(const DinTransmission&) for each in transmission order, and
+   * returns the # of messages emitted.
+   *
+   * Messages are only committed once the (simulated) wire would actually be
+   * free, so that messages enqueued later can still overtake lower priority
+   * ones. Callers with output latency should pass a now that includes their
+   * lookahead.
+   *
+   * DinTransmission references are only valid during each emit() call.
+   */
+  template<typename EmitFn>
+  int transmit(double now, EmitFn&& emit) {
+    int numSent = 0;
+    double startTime = 0.0;
+    int numOmitted = 0;
+    const Entry* entry;
+    while ((entry = popNext(now, startTime, numOmitted)) != nullptr) {
+      const std::uint8_t* bytes = entry->data();
+      const DinTransmission transmission{
+          startTime, wireFreeTime_, entry->time, MsgView{bytes, entry->numBytes},
+          bytes + numOmitted, entry->numBytes - numOmitted};
+      std::forward<EmitFn>(emit)(transmission);
+      ++numSent;
+    }
+    return numSent;
+  }
+
+  /**
+   * Returns predicted time all currently queued messages would finish
+   * transmitting, if the next transmit() call were at time now (ignoring
+   * running status savings, so this is an upper bound).
+   */
+  double predictedDrainTime(double now) const;
+
+  /** Returns time the (simulated) wire finishes sending committed messages. */
+  double wireFreeTime() const { return wireFreeTime_; }
+
+  /** Returns # of queued (not yet transmitted) messages. */
+  int numQueued() const;
+
+  /** Returns # of queued messages replaced by newer values since construction. */
+  std::int64_t numCoalesced() const { return numCoalesced_; }
+
+  /** Returns wire time (in seconds) needed to transmit numBytes bytes. */
+  double wireDuration(int numBytes) const { return numBytes * secondsPerByte_; }
+
+  /**
+   * Clears queued messages and running status (but keeps predicted wire
+   * occupancy, since already committed bytes are still being sent).
+   */
+  void clear();
+
+private:
+  static constexpr int kNumPriorities = 3;
+
+  struct Entry {
+    double time;
+    int numBytes;
+    std::uint8_t bytes[3];
+
+    // Only used for SysEx messages (so short messages never allocate).
+    std::vector<std::uint8_t> sysEx;
+
+    const std::uint8_t* data() const { return sysEx.empty() ? bytes : sysEx.data(); }
+  };
+
+  struct Queue {
+    std::deque<Entry> entries;
+
+    // Sequence # of entries.front() (entries are numbered in enqueue order).
+    std::int64_t firstSeq = 0;
+  };
+
+  // Removes the next message to commit to the wire by now (if any), setting
+  // its predicted start time and # of status bytes omitted by running status.
+  const Entry* popNext(double now, double& startTime, int& numOmitted);
+
+  DinSchedulerOptions options_;
+  double secondsPerByte_;
+  double wireFreeTime_ = 0.0;
+  RunningStatusEncoder runningStatus_;
+  Queue queues_[kNumPriorities];
+
+  // For each coalescing slot (see .cpp), the sequence # + 1 of the bulk queue
+  // entry holding its latest value (or 0 if none).
+  std::vector<std::int64_t> pendingSeqs_;
+  std::int64_t numCoalesced_ = 0;
+
+  // The entry being emitted by transmit() (kept alive through emit() calls).
+  Entry sending_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_DIN_SCHEDULER_HPP
@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/din_scheduler.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+#include "bmmidi/pitch_bend.hpp"
+
+namespace {
+
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+constexpr double kByteTime = 1.0 / 3125.0;
+
+struct Sent {
+  double startTime;
+  std::vector<int> wireBytes;
+};
+
+std::vector<Sent> transmitAll(bmmidi::DinOutputScheduler& scheduler, double now) {
+  std::vector<Sent> result;
+  scheduler.transmit(now, [&result](const bmmidi::DinTransmission& t) {
+    result.push_back(Sent{t.startTime,
+                          std::vector<int>(t.wireBytes, t.wireBytes + t.numWireBytes)});
+  });
+  return result;
+}
+
+bmmidi::ControlChangeMsg cc(bmmidi::Control control, int value) {
+  return bmmidi::ControlChangeMsg{bmmidi::Channel::index(0), control,
+                                  bmmidi::DataValue{static_cast<std::int8_t>(value)}};
+}
+
+bmmidi::NoteMsg noteOn(int key) {
+  return bmmidi::NoteMsg::on(bmmidi::Channel::index(0),
+                             bmmidi::KeyNumber::key(key), bmmidi::DataValue{100});
+}
+
+TEST(DinOutputScheduler, ClassifiesPriorities) {
+  EXPECT_THAT(bmmidi::dinPriorityOf(bmmidi::timingClockMsg()),
+              Eq(bmmidi::DinPriority::kRealtime));
+  EXPECT_THAT(bmmidi::dinPriorityOf(noteOn(60)), Eq(bmmidi::DinPriority::kNormal));
+  EXPECT_THAT(bmmidi::dinPriorityOf(cc(bmmidi::Control::kSustainPedal, 127)),
+              Eq(bmmidi::DinPriority::kNormal));
+  EXPECT_THAT(bmmidi::dinPriorityOf(cc(bmmidi::Control::kBankSelect, 1)),
+              Eq(bmmidi::DinPriority::kNormal));
+  EXPECT_THAT(bmmidi::dinPriorityOf(cc(bmmidi::Control::kModWheel, 1)),
+              Eq(bmmidi::DinPriority::kBulk));
+}
+
+TEST(DinOutputScheduler, ModelsWireTimeWithRunningStatus) {
+  bmmidi::DinOutputScheduler scheduler;
+  scheduler.enqueue(0.0, noteOn(60));
+  scheduler.enqueue(0.0, noteOn(62));
+  scheduler.enqueue(0.0, noteOn(64));
+  EXPECT_THAT(scheduler.predictedDrainTime(0.0), DoubleEq(9 * kByteTime));
+
+  const auto sent = transmitAll(scheduler, 1.0);
+  ASSERT_THAT(sent.size(), Eq(3u));
+  EXPECT_THAT(sent[0].wireBytes, ElementsAre(0x90, 60, 100));
+  EXPECT_THAT(sent[1].wireBytes, ElementsAre(62, 100));
+  EXPECT_THAT(sent[2].wireBytes, ElementsAre(64, 100));
+  EXPECT_THAT(sent[1].startTime, DoubleEq(3 * kByteTime));
+  EXPECT_THAT(sent[2].startTime, DoubleEq(5 * kByteTime));
+  EXPECT_THAT(scheduler.wireFreeTime(), DoubleEq(7 * kByteTime));
+}
+
+TEST(DinOutputScheduler, WaitsUntilRequestedTime) {
+  bmmidi::DinOutputScheduler scheduler;
+  scheduler.enqueue(0.5, noteOn(60));
+  EXPECT_THAT(transmitAll(scheduler, 0.25).size(), Eq(0u));
+  EXPECT_THAT(scheduler.numQueued(), Eq(1));
+
+  const auto sent = transmitAll(scheduler, 0.5);
+  ASSERT_THAT(sent.size(), Eq(1u));
+  EXPECT_THAT(sent[0].startTime, DoubleEq(0.5));
+}
+
+TEST(DinOutputScheduler, NotesOvertakeControllerBursts) {
+  bmmidi::DinOutputScheduler scheduler;
+  for (int i = 1; i <= 20; ++i) {
+    scheduler.enqueue(0.0, cc(static_cast<bmmidi::Control>(i), 1));
+  }
+
+  // Wire is busy with the first CC, so only that one is committed.
+  EXPECT_THAT(transmitAll(scheduler, 0.0).size(), Eq(1u));
+
+  scheduler.enqueue(0.0001, noteOn(60));
+  scheduler.enqueue(0.0002, bmmidi::timingClockMsg());
+  const auto sent = transmitAll(scheduler, 1.0);
+  ASSERT_THAT(sent.size(), Eq(21u));
+  EXPECT_THAT(sent[0].wireBytes, ElementsAre(0xF8));
+  EXPECT_THAT(sent[0].startTime, DoubleEq(3 * kByteTime));
+  EXPECT_THAT(sent[1].wireBytes, ElementsAre(0x90, 60, 100));
+  EXPECT_THAT(sent[1].startTime, DoubleEq(4 * kByteTime));
+  EXPECT_THAT(sent[2].wireBytes, ElementsAre(0xB0, 2, 1));
+}
+
+TEST(DinOutputScheduler, CoalescesSupersededValues) {
+  bmmidi::DinOutputScheduler scheduler;
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kModWheel, 1));
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kModWheel, 2));
+  scheduler.enqueue(0.0, bmmidi::PitchBendMsg{bmmidi::Channel::index(0),
+                                              bmmidi::PitchBend::midpoint()});
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kModWheel, 3));
+  scheduler.enqueue(0.0, bmmidi::PitchBendMsg{bmmidi::Channel::index(0),
+                                              bmmidi::PitchBend::max()});
+
+  // Data Entry is a command, so never coalesced.
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kDataEntry, 5));
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kDataEntry, 5));
+  EXPECT_THAT(scheduler.numCoalesced(), Eq(3));
+
+  const auto sent = transmitAll(scheduler, 1.0);
+  ASSERT_THAT(sent.size(), Eq(4u));
+  EXPECT_THAT(sent[0].wireBytes, ElementsAre(0xB0, 1, 3));
+  EXPECT_THAT(sent[1].wireBytes, ElementsAre(0xE0, 0x7F, 0x7F));
+  EXPECT_THAT(sent[2].wireBytes, ElementsAre(0xB0, 6, 5));
+  EXPECT_THAT(sent[3].wireBytes, ElementsAre(6, 5));
+
+  // Once sent, a new value is queued again.
+  scheduler.enqueue(1.0, cc(bmmidi::Control::kModWheel, 3));
+  EXPECT_THAT(scheduler.numQueued(), Eq(1));
+}
+
+TEST(DinOutputScheduler, CanDisableRunningStatusAndCoalescing) {
+  bmmidi::DinSchedulerOptions options;
+  options.useRunningStatus = false;
+  options.coalesce = false;
+  bmmidi::DinOutputScheduler scheduler{options};
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kModWheel, 1));
+  scheduler.enqueue(0.0, cc(bmmidi::Control::kModWheel, 2));
+
+  const auto sent = transmitAll(scheduler, 1.0);
+  ASSERT_THAT(sent.size(), Eq(2u));
+  EXPECT_THAT(sent[1].wireBytes, ElementsAre(0xB0, 1, 2));
+}
+
+}  // namespace
@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/jitter_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace bmmidi {
+namespace {
+
+// Rate at which the smallest transit time is allowed to rise (seconds per
+// second of arrivals), so it follows route changes and clock drift.
+constexpr double kBaseTransitRelaxRate = 1e-3;
+
+// RFC 3550 jitter estimate gain.
+constexpr double kJitterGain = 1.0 / 16.0;
+
+// Quantile step, as a fraction of the jitter estimate (or of kMinDelayStep).
+constexpr double kDelayStepGain = 0.5;
+constexpr double kMinDelayStep = 1e-4;
+
+}  // namespace
+
+JitterBuffer::JitterBuffer(const JitterBufferOptions& options)
+    : options_{options},
+      slots_(static_cast<std::size_t>(options.capacityMsgs)),
+      slotBytes_(static_cast<std::size_t>(options.capacityMsgs)
+                 * static_cast<std::size_t>(options.maxMsgBytes)) {
+  assert(options.capacityMsgs > 0);
+  assert(options.maxMsgBytes > 0);
+  assert((0.0 < options.targetLateRate) && (options.targetLateRate < 1.0));
+  assert((0.0 <= options.minDelay) && (options.minDelay <= options.maxDelay));
+  freeSlots_.reserve(slots_.size());
+  heap_.reserve(slots_.size());
+  reset();
+}
+
+void JitterBuffer::reset() {
+  freeSlots_.clear();
+  for (int i = options_.capacityMsgs - 1; i >= 0; --i) { freeSlots_.push_back(i); }
+  heap_.clear();
+  hasTransit_ = false;
+  jitter_ = 0.0;
+  delay_ = std::min(std::max(options_.initialDelay, options_.minDelay), options_.maxDelay);
+  releasedUntil_ = -std::numeric_limits<double>::infinity();
+}
+
+bool JitterBuffer::push(double senderTime, double arrivalTime, const MsgView& msg) {
+  ++numPushed_;
+  const bool isLate = updateDelay(senderTime, arrivalTime);
+  if (freeSlots_.empty() || (msg.numBytes() > options_.maxMsgBytes)) {
+    ++numDropped_;
+    return false;
+  }
+  if (isLate) { ++numLate_; }
+
+  const int slot = freeSlots_.back();
+  freeSlots_.pop_back();
+  slots_[slot] = Slot{senderTime, nextSeq_++, msg.numBytes()};
+  std::memcpy(&slotBytes_[static_cast<std::size_t>(slot) * options_.maxMsgBytes], msg.rawBytes(),
+              static_cast<std::size_t>(msg.numBytes()));
+
+  heap_.push_back(slot);
+  std::push_heap(heap_.begin(), heap_.end(), [this](int a, int b) { return isAfter(a, b); });
+  return true;
+}
+
+void JitterBuffer::release(double blockStart, double blockEnd, TimedMsgBuffer& out) {
+  assert(blockStart <= blockEnd);
+  const auto isAfterFn = [this](int a, int b) { return isAfter(a, b); };
+  while (!heap_.empty()) {
+    const int slot = heap_.front();
+    const double time = playoutTime(slots_[slot].senderTime);
+    if (time >= blockEnd) { break; }
+
+    out.push(std::max(time, blockStart),
+             &slotBytes_[static_cast<std::size_t>(slot) * options_.maxMsgBytes],
+             slots_[slot].numBytes);
+    std::pop_heap(heap_.begin(), heap_.end(), isAfterFn);
+    heap_.pop_back();
+    freeSlots_.push_back(slot);
+  }
+  releasedUntil_ = std::max(releasedUntil_, blockEnd);
+}
+
+bool JitterBuffer::updateDelay(double senderTime, double arrivalTime) {
+  const double transit = arrivalTime - senderTime;
+  if (!hasTransit_) {
+    hasTransit_ = true;
+    baseTransit_ = transit;
+    lastTransit_ = transit;
+    lastArrival_ = arrivalTime;
+    return playoutTime(senderTime) < releasedUntil_;
+  }
+
+  if (arrivalTime > lastArrival_) {
+    baseTransit_ += kBaseTransitRelaxRate * (arrivalTime - lastArrival_);
+    lastArrival_ = arrivalTime;
+  }
+  baseTransit_ = std::min(baseTransit_, transit);
+  jitter_ += kJitterGain * (std::abs(transit - lastTransit_) - jitter_);
+  lastTransit_ = transit;
+
+  // Stochastic approximation of the (1 - targetLateRate) quantile of the
+  // excess transit time, measured to when the message can first be released
+  // (so including the granularity of blocks): at equilibrium, P(late) =
+  // targetLateRate.
+  const bool isLate = playoutTime(senderTime) < std::max(arrivalTime, releasedUntil_);
+  const double step = kDelayStepGain * std::max(jitter_, kMinDelayStep);
+  delay_ += step * ((isLate ? 1.0 : 0.0) - options_.targetLateRate);
+  delay_ = std::min(std::max(delay_, options_.minDelay), options_.maxDelay);
+  return isLate;
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,148 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_JITTER_BUFFER_HPP
+#define BMMIDI_JITTER_BUFFER_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Configuration for JitterBuffer. */
+struct JitterBufferOptions {
+  /** Maximum # of buffered messages. */
+  int capacityMsgs = 1024;
+
+  /** Maximum size of each buffered message (larger ones are dropped). */
+  int maxMsgBytes = 256;
+
+  /**
+   * Fraction of messages the playout delay is adapted to let arrive late, so
+   * higher values trade more late messages for lower latency.
+   */
+  double targetLateRate = 0.01;
+
+  /** Playout delay before any messages arrive, in seconds. */
+  double initialDelay = 0.01;
+
+  /** Bounds of the playout delay, in seconds. */
+  double minDelay = 0.0;
+  double maxDelay = 0.2;
+};
+
+/**
+ * Buffers messages delivered over a network with variable delay, and releases
+ * them in the order they were sent, each a fixed (adaptive) delay after it
+ * was sent, so they keep their relative timing.
+ *
+ * Each message's transit time (arrival time minus sender timestamp, which
+ * includes the unknown offset between the clocks) is compared with the
+ * smallest recent transit time, and the excess is the message's jitter. The
+ * playout delay tracks the (1 - targetLateRate) quantile of the jitter (up to
+ * when the message can first be released, so including block granularity),
+ * with a stochastic approximation step scaled by the RFC 3550 interarrival
+ * jitter estimate, so it settles quickly and follows changing conditions.
+ *
+ * All storage is allocated by the constructor, so push() and release() never
+ * allocate (as long as release()'s output buffer has room). Messages are
+ * kept in a binary heap ordered by sender timestamp, so push() is O(log n).
+ *
+ * Sender timestamps and local times (arrivals and blocks) are in seconds, on
+ * their own clocks; drifting sender clocks are best mapped with a
+ * ClockMapper first.
+ */
+class JitterBuffer {
+public:
+  explicit JitterBuffer(const JitterBufferOptions& options = JitterBufferOptions{});
+
+  /**
+   * Removes all messages and restarts delay estimation (e.g. after
+   * reconnecting). Does not reset counters.
+   */
+  void reset();
+
+  /**
+   * Buffers msg, sent at senderTime and received at arrivalTime (local time).
+   * Returns false (and drops msg) if the buffer is full or msg is too large.
+   *
+   * If the message's playout time is already in a released block, it is late,
+   * and is released at the start of the next block.
+   */
+  bool push(double senderTime, double arrivalTime, const MsgView& msg);
+
+  /**
+   * Appends messages with playout times before blockEnd (local time) to out,
+   * in sender order, timestamped with their playout times (or blockStart, if
+   * late).
+   */
+  void release(double blockStart, double blockEnd, TimedMsgBuffer& out);
+
+  /** Returns the local time at which a message sent at senderTime plays. */
+  double playoutTime(double senderTime) const { return senderTime + baseTransit_ + delay_; }
+
+  /** Returns the playout delay beyond the smallest transit time, in seconds. */
+  double playoutDelay() const { return delay_; }
+
+  /** Returns the RFC 3550 interarrival jitter estimate, in seconds. */
+  double jitter() const { return jitter_; }
+
+  /** Returns # of buffered messages. */
+  int size() const { return static_cast<int>(heap_.size()); }
+
+  /** Returns # of messages that arrived after their playout time. */
+  std::int64_t numLate() const { return numLate_; }
+
+  /** Returns # of messages dropped for not fitting in the buffer. */
+  std::int64_t numDropped() const { return numDropped_; }
+
+  /** Returns # of messages pushed (including dropped ones). */
+  std::int64_t numPushed() const { return numPushed_; }
+
+private:
+  struct Slot {
+    double senderTime;
+    std::uint64_t seq;  // Arrival order, to keep ties stable.
+    int numBytes;
+  };
+
+  // Updates the transit and jitter estimates, and the playout delay, and
+  // returns true if the message is late.
+  bool updateDelay(double senderTime, double arrivalTime);
+
+  // Returns true if slot a should be released after slot b (for a min-heap).
+  bool isAfter(int a, int b) const {
+    const Slot& slotA = slots_[a];
+    const Slot& slotB = slots_[b];
+    return (slotA.senderTime != slotB.senderTime) ? (slotA.senderTime > slotB.senderTime)
+                                                  : (slotA.seq > slotB.seq);
+  }
+
+  JitterBufferOptions options_;
+  std::vector<Slot> slots_;
+  std::vector<std::uint8_t> slotBytes_;  // maxMsgBytes per slot.
+  std::vector<int> freeSlots_;
+  std::vector<int> heap_;  // Indices of used slots.
+  std::uint64_t nextSeq_ = 0;
+
+  bool hasTransit_ = false;
+  double baseTransit_ = 0.0;  // Smallest recent transit time.
+  double lastTransit_ = 0.0;
+  double lastArrival_ = 0.0;
+  double jitter_ = 0.0;
+  double delay_;
+  double releasedUntil_;  // End of the last released block.
+
+  std::int64_t numLate_ = 0;
+  std::int64_t numDropped_ = 0;
+  std::int64_t numPushed_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_JITTER_BUFFER_HPP
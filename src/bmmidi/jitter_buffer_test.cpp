@@ -0,0 +1,150 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/jitter_buffer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/test_msgs.hpp"
+
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Lt;
+
+using Bytes = std::vector<std::uint8_t>;
+
+using bmmidi::test::viewOf;
+
+Bytes noteOn(int key) { return {0x90, static_cast<std::uint8_t>(key), 100}; }
+
+std::vector<int> keysOf(const bmmidi::TimedMsgBuffer& msgs) {
+  std::vector<int> keys;
+  for (const bmmidi::TimedMsgView msg : msgs) { keys.push_back(msg.value().rawBytes()[1]); }
+  return keys;
+}
+
+TEST(JitterBuffer, ReleasesInSenderOrderAfterDelay) {
+  bmmidi::JitterBufferOptions options;
+  options.initialDelay = 0.005;
+  bmmidi::JitterBuffer buffer{options};
+
+  // Sent every 1 ms, arriving 10 ms (or for key 1, 12 ms) later.
+  EXPECT_THAT(buffer.push(0.000, 0.010, viewOf(noteOn(0))), IsTrue());
+  EXPECT_THAT(buffer.push(0.002, 0.012, viewOf(noteOn(2))), IsTrue());
+  EXPECT_THAT(buffer.push(0.001, 0.013, viewOf(noteOn(1))), IsTrue());
+  EXPECT_THAT(buffer.size(), Eq(3));
+
+  bmmidi::TimedMsgBuffer out;
+  buffer.release(0.010, 0.015, out);
+  EXPECT_THAT(keysOf(out), ElementsAre(0));
+  buffer.release(0.015, 0.020, out);
+  EXPECT_THAT(keysOf(out), ElementsAre(0, 1, 2));
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_THAT(out.timestampAt(i), DoubleNear(buffer.playoutTime(i * 0.001), 1e-12));
+  }
+  EXPECT_THAT(buffer.numLate(), Eq(0));
+}
+
+TEST(JitterBuffer, ReleasesLateMsgsAtBlockStart) {
+  bmmidi::JitterBufferOptions options;
+  options.initialDelay = 0.001;
+  options.maxDelay = 0.001;
+  bmmidi::JitterBuffer buffer{options};
+  bmmidi::TimedMsgBuffer out;
+
+  buffer.push(0.000, 0.010, viewOf(noteOn(0)));
+  buffer.release(0.010, 0.020, out);
+  buffer.push(0.001, 0.025, viewOf(noteOn(1)));  // 14 ms later than the first.
+  EXPECT_THAT(buffer.numLate(), Eq(1));
+  buffer.release(0.020, 0.030, out);
+  EXPECT_THAT(keysOf(out), ElementsAre(0, 1));
+  EXPECT_THAT(out.timestampAt(1), Eq(0.020));
+}
+
+TEST(JitterBuffer, DropsMsgsThatDoNotFit) {
+  bmmidi::JitterBufferOptions options;
+  options.capacityMsgs = 2;
+  options.maxMsgBytes = 4;
+  bmmidi::JitterBuffer buffer{options};
+
+  EXPECT_THAT(buffer.push(0.0, 0.0, viewOf({0xF0, 1, 2, 3, 0xF7})), IsFalse());
+  EXPECT_THAT(buffer.push(0.0, 0.0, viewOf(noteOn(0))), IsTrue());
+  EXPECT_THAT(buffer.push(0.0, 0.0, viewOf(noteOn(1))), IsTrue());
+  EXPECT_THAT(buffer.push(0.0, 0.0, viewOf(noteOn(2))), IsFalse());
+  EXPECT_THAT(buffer.numDropped(), Eq(2));
+
+  bmmidi::TimedMsgBuffer out;
+  buffer.release(0.0, 1.0, out);
+  EXPECT_THAT(keysOf(out), ElementsAre(0, 1));
+  EXPECT_THAT(buffer.push(0.0, 0.0, viewOf(noteOn(3))), IsTrue());
+}
+
+TEST(JitterBuffer, AdaptsDelayToNetworkJitter) {
+  constexpr int kNumMsgs = 40000;
+  constexpr double kBlockSeconds = 128 / 48000.0;
+
+  // Sent every 5 ms, delayed by 30 ms plus up to 8 ms of jitter (so often
+  // reordered).
+  std::mt19937 random{7};
+  std::uniform_real_distribution<double> jitter{0.0, 0.008};
+  struct Packet {
+    double senderTime;
+    double arrivalTime;
+    int key;
+  };
+  std::vector<Packet> packets;
+  for (int i = 0; i < kNumMsgs; ++i) {
+    const double senderTime = 100.0 + i * 0.005;
+    packets.push_back(Packet{senderTime, senderTime + 0.030 + jitter(random), i % 128});
+  }
+  std::sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b) {
+    return a.arrivalTime < b.arrivalTime;
+  });
+
+  bmmidi::JitterBuffer buffer;
+  bmmidi::TimedMsgBuffer out;
+  out.reserve(kNumMsgs, 3 * kNumMsgs);
+  std::int64_t numLateAtHalf = 0;
+  std::size_t next = 0;
+  for (double blockStart = 100.0; next < packets.size() || buffer.size() > 0;
+       blockStart += kBlockSeconds) {
+    for (; (next < packets.size()) && (packets[next].arrivalTime <= blockStart); ++next) {
+      buffer.push(packets[next].senderTime, packets[next].arrivalTime,
+                  viewOf(noteOn(packets[next].key)));
+    }
+    if (next == packets.size() / 2) { numLateAtHalf = buffer.numLate(); }
+    buffer.release(blockStart, blockStart + kBlockSeconds, out);
+  }
+
+  ASSERT_THAT(out.size(), Eq(kNumMsgs));
+  EXPECT_THAT(buffer.jitter(), Gt(0.001));
+  // Around the jitter plus a block (far less than a fixed 20 ms), with about
+  // the target 1% of messages late once settled.
+  EXPECT_THAT(buffer.playoutDelay(), Gt(0.008));
+  EXPECT_THAT(buffer.playoutDelay(), Lt(0.0125));
+  const std::int64_t numLateAfterHalf = buffer.numLate() - numLateAtHalf;
+  EXPECT_THAT(numLateAfterHalf, Lt(kNumMsgs / 2 / 50));
+
+  // Apart from late messages, output is in sender order.
+  int numOutOfOrder = 0;
+  const std::vector<int> keys = keysOf(out);
+  for (int i = 0; i < kNumMsgs; ++i) { numOutOfOrder += (keys[i] != i % 128) ? 1 : 0; }
+  EXPECT_THAT(numOutOfOrder, Lt(2 * buffer.numLate() + 1));
+}
+
+}  // namespace
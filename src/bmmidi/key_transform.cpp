@@ -0,0 +1,216 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/key_transform.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+  #define BMMIDI_KEY_TRANSFORM_USE_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+namespace bmmidi {
+namespace internal {
+namespace {
+
+constexpr int kMsgNumBytes = 3;
+constexpr int kMaxKey = 127;
+constexpr int kOctave = 12;
+
+// Layer settings unpacked to raw values once per call.
+struct RawLayer {
+  int minKey;
+  int maxKey;
+  int semitones;
+  KeyOutOfRange outOfRange;
+  int channel;  // -1 to keep input channel.
+};
+
+RawLayer unpackLayer(const KeyLayer& layer) {
+  assert(layer.first.isNormal() && layer.last.isNormal());
+  assert((-kMaxKey <= layer.semitones) && (layer.semitones <= kMaxKey));
+  assert(layer.channel.isNormal() || layer.channel.isNone());
+  return RawLayer{layer.first.value(), layer.last.value(), layer.semitones, layer.outOfRange,
+                  layer.channel.isNone() ? -1 : layer.channel.index()};
+}
+
+// Transforms a single message from in to out, returning false if dropped.
+bool applyToMsg(const std::uint8_t* in, const RawLayer& layer, std::uint8_t* out) {
+  const std::uint8_t status = in[0];
+  int key = in[1];
+  const std::uint8_t data2 = in[2];
+
+  if ((key < layer.minKey) || (key > layer.maxKey)) { return false; }
+
+  key += layer.semitones;
+  if ((key < 0) || (key > kMaxKey)) {
+    switch (layer.outOfRange) {
+      case KeyOutOfRange::kClamp:
+        key = (key < 0) ? 0 : kMaxKey;
+        break;
+
+      case KeyOutOfRange::kDrop:
+        return false;
+
+      case KeyOutOfRange::kWrapOctave:
+        while (key < 0) { key += kOctave; }
+        while (key > kMaxKey) { key -= kOctave; }
+        break;
+    }
+  }
+
+  out[0] = (layer.channel < 0)
+      ? status
+      : static_cast<std::uint8_t>((status & 0xF0) | layer.channel);
+  out[1] = static_cast<std::uint8_t>(key);
+  out[2] = data2;
+  return true;
+}
+
+#ifdef BMMIDI_KEY_TRANSFORM_USE_SSE2
+
+constexpr int kBlockNumMsgs = 16;
+constexpr int kBlockNumBytes = kBlockNumMsgs * kMsgNumBytes;  // 3 SSE registers.
+
+// Bits 3i + 1 (data1 byte of msg i) of a 48-bit block bitmask.
+constexpr std::uint64_t kData1Bits = 0x924924924924ULL >> 1;
+
+// Returns vector with value in lanes [16 * reg, 16 * reg + 16) of a block
+// where (lane % 3 == byteIndex), and otherValue elsewhere.
+__m128i laneVector(int reg, int byteIndex, std::uint8_t value, std::uint8_t otherValue) {
+  alignas(16) std::uint8_t bytes[16];
+  for (int i = 0; i < 16; ++i) {
+    bytes[i] = ((reg * 16 + i) % kMsgNumBytes == byteIndex) ? value : otherValue;
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+}
+
+#endif  // BMMIDI_KEY_TRANSFORM_USE_SSE2
+
+}  // namespace
+
+int applyKeyLayerToBytes(const std::uint8_t* inBytes, int numMsgs, const KeyLayer& layer,
+                         std::uint8_t* outBytes) {
+  assert(numMsgs >= 0);
+  const RawLayer raw = unpackLayer(layer);
+  int numOut = 0;
+  int i = 0;
+
+#ifdef BMMIDI_KEY_TRANSFORM_USE_SSE2
+  const auto amount =
+      static_cast<std::uint8_t>((raw.semitones < 0) ? -raw.semitones : raw.semitones);
+  const bool isClamp = (raw.outOfRange == KeyOutOfRange::kClamp);
+  const bool hasChannel = (raw.channel >= 0);
+
+  __m128i minKeys[3];
+  __m128i maxKeys[3];
+  __m128i amounts[3];
+  __m128i maxValues[3];
+  __m128i statusAnds[3];
+  __m128i statusOrs[3];
+  for (int r = 0; r < 3; ++r) {
+    minKeys[r] = laneVector(r, 1, static_cast<std::uint8_t>(raw.minKey), 0x00);
+    maxKeys[r] = laneVector(r, 1, static_cast<std::uint8_t>(raw.maxKey), 0xFF);
+    amounts[r] = laneVector(r, 1, amount, 0x00);
+    maxValues[r] = laneVector(r, 1, kMaxKey, 0xFF);
+    statusAnds[r] = laneVector(r, 0, hasChannel ? 0xF0 : 0xFF, 0xFF);
+    statusOrs[r] = laneVector(r, 0, static_cast<std::uint8_t>(hasChannel ? raw.channel : 0), 0x00);
+  }
+
+  alignas(16) std::uint8_t block[kBlockNumBytes];
+  for (; i + kBlockNumMsgs <= numMsgs; i += kBlockNumMsgs) {
+    const std::uint8_t* in = inBytes + i * kMsgNumBytes;
+    __m128i x[3];
+    __m128i y[3];
+    std::uint64_t keepBits = 0;
+    std::uint64_t outOfRangeBits = 0;
+
+    for (int r = 0; r < 3; ++r) {
+      x[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * r));
+      const __m128i inLayer = _mm_and_si128(
+          _mm_cmpeq_epi8(_mm_max_epu8(x[r], minKeys[r]), x[r]),
+          _mm_cmpeq_epi8(_mm_min_epu8(x[r], maxKeys[r]), x[r]));
+
+      // Saturating add/subtract never wraps, so out-of-range keys are detected
+      // (or clamped) afterwards.
+      __m128i fits;
+      if (raw.semitones >= 0) {
+        y[r] = _mm_adds_epu8(x[r], amounts[r]);
+        fits = _mm_cmpeq_epi8(_mm_min_epu8(y[r], maxValues[r]), y[r]);
+        if (isClamp) { y[r] = _mm_min_epu8(y[r], maxValues[r]); }
+      } else {
+        y[r] = _mm_subs_epu8(x[r], amounts[r]);
+        fits = _mm_cmpeq_epi8(_mm_max_epu8(x[r], amounts[r]), x[r]);
+      }
+      y[r] = _mm_or_si128(_mm_and_si128(y[r], statusAnds[r]), statusOrs[r]);
+
+      const auto inLayerMask = static_cast<std::uint64_t>(_mm_movemask_epi8(inLayer));
+      const auto fitsMask = static_cast<std::uint64_t>(_mm_movemask_epi8(fits));
+      keepBits |= (isClamp ? inLayerMask : (inLayerMask & fitsMask)) << (16 * r);
+      outOfRangeBits |= (inLayerMask & ~fitsMask & 0xFFFF) << (16 * r);
+    }
+
+    std::uint8_t* out = outBytes + numOut * kMsgNumBytes;
+    if ((raw.outOfRange == KeyOutOfRange::kWrapOctave) && ((outOfRangeBits & kData1Bits) != 0)) {
+      // Rare: fall back to scalar for blocks needing octave wrapping.
+      for (int r = 0; r < 3; ++r) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(block + 16 * r), x[r]);
+      }
+      for (int m = 0; m < kBlockNumMsgs; ++m) {
+        if (applyToMsg(block + m * kMsgNumBytes, raw, outBytes + numOut * kMsgNumBytes)) {
+          ++numOut;
+        }
+      }
+    } else if ((keepBits & kData1Bits) == kData1Bits) {
+      for (int r = 0; r < 3; ++r) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * r), y[r]);
+      }
+      numOut += kBlockNumMsgs;
+    } else {
+      for (int r = 0; r < 3; ++r) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(block + 16 * r), y[r]);
+      }
+      for (int m = 0; m < kBlockNumMsgs; ++m) {
+        if ((keepBits >> (m * kMsgNumBytes + 1)) & 0x01) {
+          std::memcpy(outBytes + numOut * kMsgNumBytes, block + m * kMsgNumBytes, kMsgNumBytes);
+          ++numOut;
+        }
+      }
+    }
+  }
+#endif
+
+  for (; i < numMsgs; ++i) {
+    if (applyToMsg(inBytes + i * kMsgNumBytes, raw, outBytes + numOut * kMsgNumBytes)) {
+      ++numOut;
+    }
+  }
+  return numOut;
+}
+
+int remapKeyBytes(const std::uint8_t* inBytes, int numMsgs, const KeyMap& keyMap,
+                  std::uint8_t* outBytes) {
+  assert(numMsgs >= 0);
+  const std::uint8_t* table = keyMap.rawTable();
+  int numOut = 0;
+
+  for (int i = 0; i < numMsgs; ++i) {
+    const std::uint8_t* in = inBytes + i * kMsgNumBytes;
+    const std::uint8_t status = in[0];
+    const std::uint8_t key = table[in[1] & 0x7F];
+    const std::uint8_t data2 = in[2];
+    if (key == kDroppedKey) { continue; }
+
+    std::uint8_t* out = outBytes + numOut * kMsgNumBytes;
+    out[0] = status;
+    out[1] = key;
+    out[2] = data2;
+    ++numOut;
+  }
+  return numOut;
+}
+
+}  // namespace internal
+}  // namespace bmmidi
@@ -0,0 +1,155 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_KEY_TRANSFORM_HPP
+#define BMMIDI_KEY_TRANSFORM_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace bmmidi {
+
+/** What to do with keys transposed outside of the [0, 127] range. */
+enum class KeyOutOfRange {
+  /** Clamps key to 0 or 127. */
+  kClamp,
+
+  /** Drops the message from the output. */
+  kDrop,
+
+  /** Moves key by whole octaves until it is back in range. */
+  kWrapOctave,
+};
+
+/**
+ * Key range layer (e.g. one half of a keyboard split): selects messages with
+ * keys in [first, last], transposes them, and optionally moves them to another
+ * channel.
+ */
+struct KeyLayer {
+  KeyNumber first = KeyNumber::first();
+  KeyNumber last = KeyNumber::last();
+
+  /** Semitones to transpose selected keys by, in [-127, 127]. */
+  int semitones = 0;
+
+  /** Policy for keys transposed out of range. */
+  KeyOutOfRange outOfRange = KeyOutOfRange::kDrop;
+
+  /** Output channel, or Channel::none() to keep each message's own channel. */
+  Channel channel = Channel::none();
+};
+
+namespace internal {
+
+// KeyMap table entry for dropped keys.
+constexpr std::uint8_t kDroppedKey = 0xFF;
+
+}  // namespace internal
+
+/**
+ * Table mapping each input key to an output key (or to KeyNumber::none(), to
+ * drop messages with that key). Starts as the identity map.
+ */
+class KeyMap {
+public:
+  KeyMap() {
+    for (int i = 0; i < kNumKeys; ++i) { table_[i] = static_cast<std::uint8_t>(i); }
+  }
+
+  /** Maps input key from to output key to, or drops it if to is none(). */
+  void set(KeyNumber from, KeyNumber to) {
+    assert(to.isNormal() || to.isNone());
+    table_[from.value()] =
+        to.isNone() ? internal::kDroppedKey : static_cast<std::uint8_t>(to.value());
+  }
+
+  /** Returns output key for input key from (possibly none()). */
+  KeyNumber get(KeyNumber from) const {
+    const std::uint8_t to = table_[from.value()];
+    return (to == internal::kDroppedKey) ? KeyNumber::none() : KeyNumber::key(to);
+  }
+
+  /** Returns 128-entry table of output keys, with 0xFF for dropped keys. */
+  const std::uint8_t* rawTable() const { return table_; }
+
+private:
+  std::uint8_t table_[kNumKeys];
+};
+
+namespace internal {
+
+template<typename MsgT>
+struct IsKeyMsg : std::integral_constant<bool,
+    std::is_same<MsgT, NoteMsg>::value || std::is_same<MsgT, KeyPressureMsg>::value> {};
+
+// Raw kernel over numMsgs packed 3-byte key messages; see applyKeyLayer().
+int applyKeyLayerToBytes(const std::uint8_t* inBytes, int numMsgs, const KeyLayer& layer,
+                         std::uint8_t* outBytes);
+
+// Raw kernel over numMsgs packed 3-byte key messages; see remapKeys().
+int remapKeyBytes(const std::uint8_t* inBytes, int numMsgs, const KeyMap& keyMap,
+                  std::uint8_t* outBytes);
+
+}  // namespace internal
+
+// Bulk key transforms over arrays of packed NoteMsg or KeyPressureMsg.
+//
+// Each reads numMsgs messages from in and writes the transformed messages that
+// are kept to out (compacted, in order), returning the # written. out may be
+// the same array as in (to transform in-place), but must not otherwise
+// overlap it.
+//
+// These work directly on the raw message bytes (16 messages at a time with
+// SSE2 where available), so they skip the per-message KeyNumber and Channel
+// assertions of the individual message accessors.
+
+/**
+ * Keeps messages with keys in [layer.first, layer.last], transposing them by
+ * layer.semitones and moving them to layer.channel (if not none()).
+ */
+template<typename KeyMsgT, typename = std::enable_if_t<internal::IsKeyMsg<KeyMsgT>::value>>
+int applyKeyLayer(const KeyMsgT* in, int numMsgs, const KeyLayer& layer, KeyMsgT* out) {
+  return internal::applyKeyLayerToBytes(reinterpret_cast<const std::uint8_t*>(in), numMsgs,
+                                        layer, reinterpret_cast<std::uint8_t*>(out));
+}
+
+/** Transposes all messages by semitones, in [-127, 127]. */
+template<typename KeyMsgT, typename = std::enable_if_t<internal::IsKeyMsg<KeyMsgT>::value>>
+int transposeKeys(const KeyMsgT* in, int numMsgs, int semitones, KeyOutOfRange outOfRange,
+                  KeyMsgT* out) {
+  KeyLayer layer;
+  layer.semitones = semitones;
+  layer.outOfRange = outOfRange;
+  return applyKeyLayer(in, numMsgs, layer, out);
+}
+
+/** Replaces each message's key via keyMap (dropping messages it maps to none()). */
+template<typename KeyMsgT, typename = std::enable_if_t<internal::IsKeyMsg<KeyMsgT>::value>>
+int remapKeys(const KeyMsgT* in, int numMsgs, const KeyMap& keyMap, KeyMsgT* out) {
+  return internal::remapKeyBytes(reinterpret_cast<const std::uint8_t*>(in), numMsgs,
+                                 keyMap, reinterpret_cast<std::uint8_t*>(out));
+}
+
+/**
+ * Splits messages into numLayers layers, writing the output of layer i to
+ * outs[i] (which must each have room for numMsgs messages) and its count to
+ * outCounts[i]. Layers may overlap, so one input can produce several outputs.
+ */
+template<typename KeyMsgT, typename = std::enable_if_t<internal::IsKeyMsg<KeyMsgT>::value>>
+void splitKeyLayers(const KeyMsgT* in, int numMsgs, const KeyLayer* layers, int numLayers,
+                    KeyMsgT* const* outs, int* outCounts) {
+  for (int i = 0; i < numLayers; ++i) {
+    outCounts[i] = applyKeyLayer(in, numMsgs, layers[i], outs[i]);
+  }
+}
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_KEY_TRANSFORM_HPP
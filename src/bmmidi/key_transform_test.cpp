@@ -0,0 +1,165 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/key_transform.hpp"
+
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::Eq;
+
+std::vector<bmmidi::NoteMsg> makeRandomNotes(int numMsgs) {
+  std::mt19937 rng{1234};
+  std::uniform_int_distribution<int> channels{0, 15};
+  std::uniform_int_distribution<int> keys{0, 127};
+  std::uniform_int_distribution<int> velocities{0, 127};
+
+  std::vector<bmmidi::NoteMsg> notes;
+  for (int i = 0; i < numMsgs; ++i) {
+    const auto channel = bmmidi::Channel::index(channels(rng));
+    const auto key = bmmidi::KeyNumber::key(keys(rng));
+    const auto velocity = bmmidi::DataValue{static_cast<std::int8_t>(velocities(rng))};
+    notes.push_back((i % 2 == 0) ? bmmidi::NoteMsg::on(channel, key, velocity)
+                                 : bmmidi::NoteMsg::off(channel, key, velocity));
+  }
+  return notes;
+}
+
+// Straightforward per-message reference implementation of applyKeyLayer().
+std::vector<bmmidi::NoteMsg> referenceLayer(
+    const std::vector<bmmidi::NoteMsg>& notes, const bmmidi::KeyLayer& layer) {
+  std::vector<bmmidi::NoteMsg> result;
+  for (auto note : notes) {
+    if ((note.key() < layer.first) || (layer.last < note.key())) { continue; }
+
+    int key = note.key().value() + layer.semitones;
+    if ((key < 0) || (key > 127)) {
+      if (layer.outOfRange == bmmidi::KeyOutOfRange::kDrop) { continue; }
+      if (layer.outOfRange == bmmidi::KeyOutOfRange::kClamp) {
+        key = (key < 0) ? 0 : 127;
+      } else {
+        key = (key < 0) ? key + 12 * ((-key + 11) / 12) : key - 12 * ((key - 116) / 12);
+      }
+    }
+    note.setKey(bmmidi::KeyNumber::key(key));
+    if (!layer.channel.isNone()) { note.setChannel(layer.channel); }
+    result.push_back(note);
+  }
+  return result;
+}
+
+void expectSameNotes(const std::vector<bmmidi::NoteMsg>& actual,
+                     const std::vector<bmmidi::NoteMsg>& expected) {
+  ASSERT_THAT(actual.size(), Eq(expected.size()));
+  for (std::size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_THAT(actual[i], Eq(expected[i])) << "msg " << i;
+  }
+}
+
+std::vector<bmmidi::NoteMsg> runLayer(
+    const std::vector<bmmidi::NoteMsg>& notes, const bmmidi::KeyLayer& layer) {
+  std::vector<bmmidi::NoteMsg> out = notes;
+  const int numOut = bmmidi::applyKeyLayer(
+      notes.data(), static_cast<int>(notes.size()), layer, out.data());
+  out.resize(numOut, out[0]);
+  return out;
+}
+
+TEST(KeyTransform, TransposesWithEachPolicy) {
+  const auto notes = makeRandomNotes(1000);
+  for (int semitones : {0, 5, -7, 40, -100, 127}) {
+    for (auto policy : {bmmidi::KeyOutOfRange::kClamp, bmmidi::KeyOutOfRange::kDrop,
+                        bmmidi::KeyOutOfRange::kWrapOctave}) {
+      bmmidi::KeyLayer layer;
+      layer.semitones = semitones;
+      layer.outOfRange = policy;
+      SCOPED_TRACE(semitones);
+      expectSameNotes(runLayer(notes, layer), referenceLayer(notes, layer));
+    }
+  }
+}
+
+TEST(KeyTransform, TransposesInPlace) {
+  auto notes = makeRandomNotes(101);
+  const auto original = notes;
+
+  const int numOut = bmmidi::transposeKeys(notes.data(), static_cast<int>(notes.size()), 60,
+                                           bmmidi::KeyOutOfRange::kDrop, notes.data());
+  notes.resize(numOut, notes[0]);
+
+  bmmidi::KeyLayer layer;
+  layer.semitones = 60;
+  expectSameNotes(notes, referenceLayer(original, layer));
+}
+
+TEST(KeyTransform, SplitsIntoLayers) {
+  const auto notes = makeRandomNotes(333);
+
+  bmmidi::KeyLayer layers[2];
+  layers[0].last = bmmidi::KeyNumber::key(59);
+  layers[0].semitones = 12;
+  layers[0].channel = bmmidi::Channel::index(1);
+  layers[1].first = bmmidi::KeyNumber::key(60);
+  layers[1].channel = bmmidi::Channel::index(2);
+
+  std::vector<bmmidi::NoteMsg> lower = notes;
+  std::vector<bmmidi::NoteMsg> upper = notes;
+  bmmidi::NoteMsg* outs[] = {lower.data(), upper.data()};
+  int counts[2];
+  bmmidi::splitKeyLayers(notes.data(), static_cast<int>(notes.size()), layers, 2, outs, counts);
+  lower.resize(counts[0], notes[0]);
+  upper.resize(counts[1], notes[0]);
+
+  EXPECT_THAT(counts[0] + counts[1], Eq(static_cast<int>(notes.size())));
+  expectSameNotes(lower, referenceLayer(notes, layers[0]));
+  expectSameNotes(upper, referenceLayer(notes, layers[1]));
+}
+
+TEST(KeyTransform, WorksOnKeyPressureMsgs) {
+  const bmmidi::KeyPressureMsg msgs[] = {
+      bmmidi::KeyPressureMsg{bmmidi::Channel::index(3), bmmidi::KeyNumber::key(10),
+                             bmmidi::DataValue{50}},
+      bmmidi::KeyPressureMsg{bmmidi::Channel::index(3), bmmidi::KeyNumber::key(120),
+                             bmmidi::DataValue{60}},
+  };
+  bmmidi::KeyPressureMsg out[2] = {msgs[0], msgs[0]};
+
+  EXPECT_THAT(bmmidi::transposeKeys(msgs, 2, 10, bmmidi::KeyOutOfRange::kWrapOctave, out), Eq(2));
+  EXPECT_THAT(out[0].key(), Eq(bmmidi::KeyNumber::key(20)));
+  EXPECT_THAT(out[1].key(), Eq(bmmidi::KeyNumber::key(118)));
+  EXPECT_THAT(out[1].pressure(), Eq(bmmidi::DataValue{60}));
+}
+
+TEST(KeyTransform, RemapsViaKeyMap) {
+  bmmidi::KeyMap keyMap;
+  keyMap.set(bmmidi::KeyNumber::key(36), bmmidi::KeyNumber::key(35));
+  keyMap.set(bmmidi::KeyNumber::key(38), bmmidi::KeyNumber::none());
+  EXPECT_THAT(keyMap.get(bmmidi::KeyNumber::key(37)), Eq(bmmidi::KeyNumber::key(37)));
+  EXPECT_THAT(keyMap.get(bmmidi::KeyNumber::key(38)), Eq(bmmidi::KeyNumber::none()));
+
+  const auto ch = bmmidi::Channel::index(9);
+  const bmmidi::NoteMsg notes[] = {
+      bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(36), bmmidi::DataValue{100}),
+      bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(38), bmmidi::DataValue{100}),
+      bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(42), bmmidi::DataValue{100}),
+  };
+  bmmidi::NoteMsg out[3] = {notes[0], notes[0], notes[0]};
+
+  EXPECT_THAT(bmmidi::remapKeys(notes, 3, keyMap, out), Eq(2));
+  EXPECT_THAT(out[0],
+              Eq(bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(35), bmmidi::DataValue{100})));
+  EXPECT_THAT(out[1], Eq(notes[2]));
+}
+
+}  // namespace
@@ -120,7 +120,7 @@ public:
   template<
       typename MsgT,
       typename = std::enable_if_t<std::is_base_of<Msg<N>, MsgT>::value>>
-  MsgT to() const { return MsgT::fromMsg(*this); }
+  constexpr MsgT to() const { return MsgT::fromMsg(*this); }
 
   /**
    * Returns read-only reference of ViewType to this Msg; check type() to ensure
@@ -199,11 +199,11 @@ public:
   // All Channel messages have 1 or 2 data bytes.
   static_assert((N == 2) || (N == 3), "ChanMsg<N>: N must be 2 or 3 bytes");
 
-  static ChanMsg<2> fromMsg(const Msg<2>& msg) {
+  static constexpr ChanMsg<2> fromMsg(const Msg<2>& msg) {
     return ChanMsg<2>{msg.status(), msg.data1()};
   }
 
-  static ChanMsg<3> fromMsg(const Msg<3>& msg) {
+  static constexpr ChanMsg<3> fromMsg(const Msg<3>& msg) {
     return ChanMsg<3>{msg.status(), msg.data1(), msg.data2()};
   }
 
@@ -263,7 +263,7 @@ static_assert(std::is_trivially_destructible<ChanMsg<3>>::value,
  */
 class NoteMsg : public ChanMsg<3> {
 public:
-  static NoteMsg fromMsg(const Msg<3>& msg) {
+  static constexpr NoteMsg fromMsg(const Msg<3>& msg) {
     assert((msg.type() == MsgType::kNoteOff) || (msg.type() == MsgType::kNoteOn));
     return NoteMsg{msg.status(), KeyNumber::key(msg.data1().value()), msg.data2()};
   }
@@ -384,7 +384,7 @@ public:
  */
 class KeyPressureMsg : public ChanMsg<3> {
 public:
-  static KeyPressureMsg fromMsg(const Msg<3>& msg) {
+  static constexpr KeyPressureMsg fromMsg(const Msg<3>& msg) {
     assert(msg.type() == MsgType::kPolyphonicKeyPressure);
     return KeyPressureMsg{msg.status().channel(), KeyNumber::key(msg.data1().value()), msg.data2()};
   }
@@ -460,7 +460,7 @@ public:
  */
 class ControlChangeMsg : public ChanMsg<3> {
 public:
-  static ControlChangeMsg fromMsg(const Msg<3>& msg) {
+  static constexpr ControlChangeMsg fromMsg(const Msg<3>& msg) {
     assert(msg.type() == MsgType::kControlChange);
     return ControlChangeMsg{msg.status().channel(), controlFromDataValue(msg.data1()), msg.data2()};
   }
@@ -524,7 +524,7 @@ public:
  */
 class ProgramChangeMsg : public ChanMsg<2> {
 public:
-  static ProgramChangeMsg fromMsg(const Msg<2>& msg) {
+  static constexpr ProgramChangeMsg fromMsg(const Msg<2>& msg) {
     assert(msg.type() == MsgType::kProgramChange);
     return ProgramChangeMsg{msg.status().channel(), PresetNumber::index(msg.data1().value())};
   }
@@ -592,7 +592,7 @@ public:
  */
 class ChanPressureMsg : public ChanMsg<2> {
 public:
-  static ChanPressureMsg fromMsg(const Msg<2>& msg) {
+  static constexpr ChanPressureMsg fromMsg(const Msg<2>& msg) {
     assert(msg.type() == MsgType::kChannelPressure);
     return ChanPressureMsg{msg.status().channel(), msg.data1()};
   }
@@ -648,7 +648,7 @@ public:
  */
 class PitchBendMsg : public ChanMsg<3> {
 public:
-  static PitchBendMsg fromMsg(const Msg<3>& msg) {
+  static constexpr PitchBendMsg fromMsg(const Msg<3>& msg) {
     assert(msg.type() == MsgType::kPitchBend);
     return PitchBendMsg{
         msg.status().channel(),
@@ -721,7 +721,7 @@ public:
  */
 class MtcQuarterFrameMsg : public Msg<2> {
 public:
-  static MtcQuarterFrameMsg fromMsg(const Msg<2>& msg) {
+  static constexpr MtcQuarterFrameMsg fromMsg(const Msg<2>& msg) {
     assert(msg.type() == MsgType::kMtcQuarterFrame);
     return MtcQuarterFrameMsg::withDataByte(msg.data1().value());
   }
@@ -856,7 +856,7 @@ public:
  */
 class SongPosMsg : public Msg<3> {
 public:
-  static SongPosMsg fromMsg(const Msg<3>& msg) {
+  static constexpr SongPosMsg fromMsg(const Msg<3>& msg) {
     assert(msg.type() == MsgType::kSongPositionPointer);
     return SongPosMsg{
         DoubleDataValue::fromLsbMsb(
@@ -946,7 +946,7 @@ public:
  */
 class SongSelectMsg : public Msg<2> {
 public:
-  static SongSelectMsg fromMsg(const Msg<2>& msg) {
+  static constexpr SongSelectMsg fromMsg(const Msg<2>& msg) {
     assert(msg.type() == MsgType::kSongSelect);
     return SongSelectMsg{PresetNumber::index(msg.data1().value())};
   }
@@ -1007,7 +1007,9 @@ public:
 // provided below:
 
 /** Creates a status-byte-only Oscillator Tune Request message. */
-inline Msg<1> oscTuneMsg() { return Msg<1>{Status::system(MsgType::kOscillatorTuneRequest)}; }
+inline constexpr Msg<1> oscTuneMsg() {
+  return Msg<1>{Status::system(MsgType::kOscillatorTuneRequest)};
+}
 
 /** Creates a timestamped Oscillator Tune Request message. */
 inline TimedMsg<Msg<1>> timedOscTuneMsg(double timestamp) {
@@ -1015,7 +1017,7 @@ inline TimedMsg<Msg<1>> timedOscTuneMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only Timing Clock message. */
-inline Msg<1> timingClockMsg() { return Msg<1>{Status::system(MsgType::kTimingClock)}; }
+inline constexpr Msg<1> timingClockMsg() { return Msg<1>{Status::system(MsgType::kTimingClock)}; }
 
 /** Creates a timestamped Timing Clock message. */
 inline TimedMsg<Msg<1>> timedTimingClockMsg(double timestamp) {
@@ -1023,7 +1025,7 @@ inline TimedMsg<Msg<1>> timedTimingClockMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only Start Playback message. */
-inline Msg<1> startPlaybackMsg() { return Msg<1>{Status::system(MsgType::kStart)}; }
+inline constexpr Msg<1> startPlaybackMsg() { return Msg<1>{Status::system(MsgType::kStart)}; }
 
 /** Creates a timestamped Start Playback message. */
 inline TimedMsg<Msg<1>> timedStartPlaybackMsg(double timestamp) {
@@ -1031,7 +1033,7 @@ inline TimedMsg<Msg<1>> timedStartPlaybackMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only Continue Playback message. */
-inline Msg<1> continuePlaybackMsg() { return Msg<1>{Status::system(MsgType::kContinue)}; }
+inline constexpr Msg<1> continuePlaybackMsg() { return Msg<1>{Status::system(MsgType::kContinue)}; }
 
 /** Creates a timestamped Continue Playback message. */
 inline TimedMsg<Msg<1>> timedContinuePlaybackMsg(double timestamp) {
@@ -1039,7 +1041,7 @@ inline TimedMsg<Msg<1>> timedContinuePlaybackMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only Stop Playback message. */
-inline Msg<1> stopPlaybackMsg() { return Msg<1>{Status::system(MsgType::kStop)}; }
+inline constexpr Msg<1> stopPlaybackMsg() { return Msg<1>{Status::system(MsgType::kStop)}; }
 
 /** Creates a timestamped Stop Playback message. */
 inline TimedMsg<Msg<1>> timedStopPlaybackMsg(double timestamp) {
@@ -1047,7 +1049,9 @@ inline TimedMsg<Msg<1>> timedStopPlaybackMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only Active Sensing message. */
-inline Msg<1> activeSensingMsg() { return Msg<1>{Status::system(MsgType::kActiveSensing)}; }
+inline constexpr Msg<1> activeSensingMsg() {
+  return Msg<1>{Status::system(MsgType::kActiveSensing)};
+}
 
 /** Creates a timestamped Active Sensing message. */
 inline TimedMsg<Msg<1>> timedActiveSensingMsg(double timestamp) {
@@ -1055,7 +1059,7 @@ inline TimedMsg<Msg<1>> timedActiveSensingMsg(double timestamp) {
 }
 
 /** Creates a status-byte-only System Reset message. */
-inline Msg<1> systemResetMsg() { return Msg<1>{Status::system(MsgType::kSystemReset)}; }
+inline constexpr Msg<1> systemResetMsg() { return Msg<1>{Status::system(MsgType::kSystemReset)}; }
 
 /** Creates a timestamped System Reset message. */
 inline TimedMsg<Msg<1>> timedSystemResetMsg(double timestamp) {
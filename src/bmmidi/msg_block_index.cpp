@@ -0,0 +1,33 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_block_index.hpp"
+
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+void MsgBlockSummary::add(std::uint8_t status, std::uint8_t data1) {
+  statusBits[status / 64] |= (std::uint64_t{1} << (status % 64));
+  if (status < static_cast<std::uint8_t>(MsgType::kControlChange)) {
+    if (data1 < minKey) { minKey = data1; }
+    if (data1 > maxKey) { maxKey = data1; }
+  } else if (status <= (static_cast<std::uint8_t>(MsgType::kControlChange) | 0x0F)) {
+    const int control = data1 & 0x7F;
+    controlBits[control / 64] |= (std::uint64_t{1} << (control % 64));
+  }
+}
+
+void MsgBlockIndex::update(const TimedMsgColumns& columns) {
+  assert(columns.size() >= numRows_);
+  const std::uint8_t* statuses = columns.statuses();
+  const std::uint8_t* data1s = columns.data1s();
+  for (int i = numRows_; i < columns.size(); ++i) {
+    if (i % blockRows_ == 0) { blocks_.emplace_back(); }
+    blocks_.back().add(statuses[i], data1s[i]);
+  }
+  numRows_ = columns.size();
+}
+
+}  // namespace bmmidi
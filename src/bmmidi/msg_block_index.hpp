@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_BLOCK_INDEX_HPP
+#define BMMIDI_MSG_BLOCK_INDEX_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/control.hpp"
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_columns.hpp"
+#include "bmmidi/msg_query.hpp"
+
+namespace bmmidi {
+
+/**
+ * Summary of the messages in one block of rows of a TimedMsgColumns: which
+ * statuses (and so which types and channels) are present, the range of keys
+ * of Note On/Off and Poly Key Pressure messages, and which controls of Control
+ * Change messages are present.
+ */
+struct MsgBlockSummary {
+  std::uint64_t statusBits[4] = {};   // Bit (status % 64) of [status / 64].
+  std::uint8_t minKey = 0xFF;         // Greater than maxKey if no key messages.
+  std::uint8_t maxKey = 0x00;
+  std::uint64_t controlBits[2] = {};  // Bit (control % 64) of [control / 64].
+
+  /** Returns true if some message in the block has status. */
+  bool hasStatus(std::uint8_t status) const {
+    return (statusBits[status / 64] >> (status % 64)) & 0x01;
+  }
+
+  /** Returns true if some message in the block has a key. */
+  bool hasKeys() const { return minKey <= maxKey; }
+
+  /** Returns true if some Control Change message in the block has control. */
+  bool hasControl(Control control) const {
+    const auto value = static_cast<int>(control);
+    return (controlBits[value / 64] >> (value % 64)) & 0x01;
+  }
+
+  /** Adds message status, data1 to the summary. */
+  void add(std::uint8_t status, std::uint8_t data1);
+};
+
+/**
+ * Index of a TimedMsgColumns by fixed-size blocks of rows, each with a
+ * MsgBlockSummary, so a MsgQuery can skip whole blocks that cannot match
+ * without evaluating any of their rows (see MsgQuery::select() with an index).
+ *
+ * Summaries are ORed together as rows are added, so a growing recording is
+ * indexed incrementally by calling update() after pushing more rows.
+ *
+ * Example (all Expression CCs on channel 5 in the last hour of a recording):
+ *
+ *   bmmidi::MsgBlockIndex index;
+ *   index.update(columns);
+ *   const auto selection = bmmidi::MsgQuery{}
+ *       .onChannel(bmmidi::Channel::index(4))
+ *       .withControls(bmmidi::Control::kExpression, bmmidi::Control::kExpression)
+ *       .during(end - 3600.0, end)
+ *       .select(columns, index);
+ */
+class MsgBlockIndex {
+public:
+  BMMIDI_INLINE_VAR static constexpr int kDefaultBlockRows = 4096;
+
+  /**
+   * Creates an empty index with blockRows rows per block, which must be a
+   * positive multiple of 64 (so blocks line up with MsgSelection words).
+   */
+  explicit MsgBlockIndex(int blockRows = kDefaultBlockRows) : blockRows_{blockRows} {
+    assert((blockRows > 0) && (blockRows % 64 == 0));
+  }
+
+  /** Removes all blocks (e.g. after the indexed columns were cleared). */
+  void clear() {
+    blocks_.clear();
+    numRows_ = 0;
+  }
+
+  /**
+   * Indexes rows of columns added since the last update(). The columns must
+   * otherwise be unchanged since then.
+   */
+  void update(const TimedMsgColumns& columns);
+
+  /** Returns the # of rows per block. */
+  int blockRows() const { return blockRows_; }
+
+  /** Returns the # of indexed rows. */
+  int numRows() const { return numRows_; }
+
+  /** Returns the # of blocks (the last of which may be partial). */
+  int numBlocks() const { return static_cast<int>(blocks_.size()); }
+
+  /** Returns the summary of block index. */
+  const MsgBlockSummary& block(int index) const {
+    assert((0 <= index) && (index < numBlocks()));
+    return blocks_[index];
+  }
+
+  /** Returns the rows of block index. */
+  MsgRowRange blockRowRange(int index) const {
+    assert((0 <= index) && (index < numBlocks()));
+    const int first = index * blockRows_;
+    return MsgRowRange{first, (numRows_ - first < blockRows_) ? numRows_ : first + blockRows_};
+  }
+
+private:
+  int blockRows_;
+  int numRows_ = 0;
+  std::vector<MsgBlockSummary> blocks_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_BLOCK_INDEX_HPP
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_block_index.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+#include "bmmidi/msg_columns.hpp"
+#include "bmmidi/msg_query.hpp"
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+void pushMsg(bmmidi::TimedMsgColumns& columns, double timestamp, const bmmidi::MsgView& msg) {
+  columns.push(bmmidi::TimedMsgView{timestamp, msg});
+}
+
+// Returns a long recording of notes and Mod Wheel CCs on channels 1-4 (one per
+// tick), with Expression CCs on channel 5 only around rows [5000, 5100).
+bmmidi::TimedMsgColumns makeRecording(int numMsgs) {
+  bmmidi::TimedMsgColumns columns;
+  for (int i = 0; i < numMsgs; ++i) {
+    const auto value = bmmidi::DataValue{static_cast<std::int8_t>(i % 128)};
+    if ((5000 <= i) && (i < 5100) && (i % 3 == 0)) {
+      pushMsg(columns, i, bmmidi::ControlChangeMsg{bmmidi::Channel::index(4),
+                                                   bmmidi::Control::kExpression, value}
+                              .asView<bmmidi::MsgView>());
+    } else if (i % 2 == 0) {
+      const auto key = bmmidi::KeyNumber::key(36 + (i % 48));
+      pushMsg(columns, i, bmmidi::NoteMsg::on(bmmidi::Channel::index(i % 4), key, value)
+                              .asView<bmmidi::MsgView>());
+    } else {
+      pushMsg(columns, i, bmmidi::ControlChangeMsg{bmmidi::Channel::index(i % 4),
+                                                   bmmidi::Control::kModWheel, value}
+                              .asView<bmmidi::MsgView>());
+    }
+  }
+  return columns;
+}
+
+TEST(MsgBlockIndex, SummarizesBlocks) {
+  bmmidi::TimedMsgColumns columns;
+  pushMsg(columns, 0.0, bmmidi::NoteMsg::on(bmmidi::Channel::index(2), bmmidi::KeyNumber::key(60),
+                                            bmmidi::DataValue{100})
+                            .asView<bmmidi::MsgView>());
+  pushMsg(columns, 1.0, bmmidi::NoteMsg::off(bmmidi::Channel::index(2), bmmidi::KeyNumber::key(48))
+                            .asView<bmmidi::MsgView>());
+  pushMsg(columns, 2.0, bmmidi::ControlChangeMsg{bmmidi::Channel::index(9),
+                                                 bmmidi::Control::kSustainPedal,
+                                                 bmmidi::DataValue{127}}
+                            .asView<bmmidi::MsgView>());
+  pushMsg(columns, 3.0, bmmidi::timingClockMsg().asView<bmmidi::MsgView>());
+
+  bmmidi::MsgBlockIndex index{64};
+  index.update(columns);
+  ASSERT_THAT(index.numBlocks(), Eq(1));
+  const bmmidi::MsgBlockSummary& block = index.block(0);
+  EXPECT_THAT(block.hasStatus(0x92), IsTrue());
+  EXPECT_THAT(block.hasStatus(0x82), IsTrue());
+  EXPECT_THAT(block.hasStatus(0xB9), IsTrue());
+  EXPECT_THAT(block.hasStatus(0xF8), IsTrue());
+  EXPECT_THAT(block.hasStatus(0x90), IsFalse());
+  ASSERT_THAT(block.hasKeys(), IsTrue());
+  EXPECT_THAT(block.minKey, Eq(48));
+  EXPECT_THAT(block.maxKey, Eq(60));
+  EXPECT_THAT(block.hasControl(bmmidi::Control::kSustainPedal), IsTrue());
+  EXPECT_THAT(block.hasControl(bmmidi::Control::kModWheel), IsFalse());
+}
+
+TEST(MsgBlockIndex, IndexesAppendedRowsIncrementally) {
+  const bmmidi::MsgQuery everything;
+  bmmidi::MsgBlockIndex incremental{128};
+  for (const int numMsgs : {1, 100, 128, 129, 700, 1000}) {
+    // makeRecording() is deterministic, so each is a prefix of the next.
+    const bmmidi::TimedMsgColumns columns = makeRecording(numMsgs);
+    incremental.update(columns);
+    bmmidi::MsgBlockIndex fresh{128};
+    fresh.update(columns);
+
+    ASSERT_THAT(incremental.numRows(), Eq(numMsgs));
+    ASSERT_THAT(incremental.numBlocks(), Eq(fresh.numBlocks()));
+    for (int b = 0; b < fresh.numBlocks(); ++b) {
+      const bmmidi::MsgBlockSummary& expected = fresh.block(b);
+      const bmmidi::MsgBlockSummary& actual = incremental.block(b);
+      for (int w = 0; w < 4; ++w) {
+        EXPECT_THAT(actual.statusBits[w], Eq(expected.statusBits[w]));
+      }
+      EXPECT_THAT(actual.minKey, Eq(expected.minKey));
+      EXPECT_THAT(actual.maxKey, Eq(expected.maxKey));
+      EXPECT_THAT(actual.controlBits[0], Eq(expected.controlBits[0]));
+      EXPECT_THAT(actual.controlBits[1], Eq(expected.controlBits[1]));
+    }
+    EXPECT_THAT(everything.count(columns, incremental), Eq(numMsgs));
+  }
+}
+
+TEST(MsgBlockIndex, SkipsBlocksThatCannotMatch) {
+  const bmmidi::TimedMsgColumns columns = makeRecording(20000);
+  bmmidi::MsgBlockIndex index{256};
+  index.update(columns);
+
+  const auto query = bmmidi::MsgQuery{}
+                         .onChannel(bmmidi::Channel::index(4))
+                         .withControls(bmmidi::Control::kExpression,
+                                       bmmidi::Control::kExpression);
+  int numCandidates = 0;
+  for (int b = 0; b < index.numBlocks(); ++b) {
+    if (query.mayMatch(index.block(b))) { ++numCandidates; }
+  }
+  EXPECT_THAT(numCandidates, Eq(1));  // Rows [4864, 5120).
+  EXPECT_THAT(query.count(columns, index), Eq(33));
+
+  EXPECT_THAT(bmmidi::MsgQuery{}
+                  .withKeys(bmmidi::KeyNumber::key(100), bmmidi::KeyNumber::key(127))
+                  .mayMatch(index.block(0)),
+              IsFalse());
+  EXPECT_THAT(bmmidi::MsgQuery{}.ofType(bmmidi::MsgType::kTimingClock).mayMatch(index.block(0)),
+              IsFalse());
+  EXPECT_THAT(bmmidi::MsgQuery{}.ofType(bmmidi::MsgType::kNoteOn).mayMatch(index.block(0)),
+              IsTrue());
+}
+
+TEST(MsgBlockIndex, SelectsSameRowsAsFullScan) {
+  const bmmidi::TimedMsgColumns columns = makeRecording(20000);
+  bmmidi::MsgBlockIndex index{256};
+  index.update(columns);
+
+  const std::vector<bmmidi::MsgQuery> queries = {
+      bmmidi::MsgQuery{},
+      bmmidi::MsgQuery{}.ofType(bmmidi::MsgType::kControlChange).during(4900.5, 5050.0),
+      bmmidi::MsgQuery{}.onChannels(bmmidi::Channel::index(1), bmmidi::Channel::index(4)),
+      bmmidi::MsgQuery{}.withKeys(bmmidi::KeyNumber::key(40), bmmidi::KeyNumber::key(41)),
+      bmmidi::MsgQuery{}.withControls(bmmidi::Control::kModWheel, bmmidi::Control::kExpression),
+      bmmidi::MsgQuery{}
+          .onChannel(bmmidi::Channel::index(4))
+          .withControls(bmmidi::Control::kExpression, bmmidi::Control::kExpression)
+          .during(0.0, 5050.0),
+      bmmidi::MsgQuery{}.ofType(bmmidi::MsgType::kTimingClock),
+  };
+  for (const bmmidi::MsgQuery& query : queries) {
+    EXPECT_THAT(query.select(columns, index).words(), Eq(query.select(columns).words()));
+  }
+}
+
+}  // namespace
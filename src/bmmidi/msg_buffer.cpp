@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace bmmidi {
+
+void TimedMsgBuffer::reserve(int numMsgs, int numBytes) {
+  assert(numMsgs >= 0);
+  assert(numBytes >= 0);
+  timestamps_.reserve(numMsgs);
+  offsets_.reserve(numMsgs + 1);
+  bytes_.reserve(numBytes);
+}
+
+void TimedMsgBuffer::clear() {
+  timestamps_.clear();
+  offsets_.resize(1);
+  bytes_.clear();
+}
+
+void TimedMsgBuffer::push(double timestamp, const std::uint8_t* rawMsgBytes, int numBytes) {
+  assert(rawMsgBytes != nullptr);
+  assert(numBytes >= 1);
+
+  timestamps_.push_back(timestamp);
+  bytes_.insert(bytes_.end(), rawMsgBytes, rawMsgBytes + numBytes);
+  offsets_.push_back(static_cast<int>(bytes_.size()));
+}
+
+}  // namespace bmmidi
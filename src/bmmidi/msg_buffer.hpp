@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_BUFFER_HPP
+#define BMMIDI_MSG_BUFFER_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/**
+ * Growable sequence of timestamped MIDI messages, stored compactly as one
+ * contiguous span of message bytes (each message complete with its own status
+ * byte, as MsgReference requires) plus parallel arrays of timestamps and byte
+ * offsets.
+ *
+ * Elements are accessed as TimedMsgView (or TimedMsgRef) references into this
+ * buffer, which are invalidated by any operation that adds messages.
+ */
+class TimedMsgBuffer {
+public:
+  /** Read-only iterator over TimedMsgView elements. */
+  class ConstIterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = TimedMsgView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = TimedMsgView;
+
+    ConstIterator(const TimedMsgBuffer* buffer, int index)
+        : buffer_{buffer}, index_{index} {}
+
+    TimedMsgView operator*() const { return (*buffer_)[index_]; }
+
+    /** Returns the index within the buffer this iterator points to. */
+    int index() const { return index_; }
+
+    ConstIterator& operator++() {
+      ++index_;
+      return *this;
+    }
+
+    ConstIterator operator++(int) {
+      ConstIterator copy = *this;
+      ++index_;
+      return copy;
+    }
+
+    friend bool operator==(ConstIterator lhs, ConstIterator rhs) {
+      return (lhs.buffer_ == rhs.buffer_) && (lhs.index_ == rhs.index_);
+    }
+
+    friend bool operator!=(ConstIterator lhs, ConstIterator rhs) { return !(lhs == rhs); }
+
+  private:
+    const TimedMsgBuffer* buffer_;
+    int index_;
+  };
+
+  TimedMsgBuffer() = default;
+
+  /** Reserves storage for at least numMsgs messages spanning numBytes bytes. */
+  void reserve(int numMsgs, int numBytes);
+
+  /** Removes all messages (but keeps allocated storage). */
+  void clear();
+
+  /** Appends a copy of msg with the given timestamp. */
+  void push(double timestamp, const MsgView& msg) {
+    push(timestamp, msg.rawBytes(), msg.numBytes());
+  }
+
+  /** Appends a copy of timedMsg. */
+  void push(const TimedMsgView& timedMsg) { push(timedMsg.timestamp(), timedMsg.value()); }
+
+  /**
+   * Appends a copy of the complete message in rawMsgBytes[0, numBytes), which
+   * must meet MsgReference requirements.
+   */
+  void push(double timestamp, const std::uint8_t* rawMsgBytes, int numBytes);
+
+  /** Returns the # of messages in this buffer. */
+  int size() const { return static_cast<int>(timestamps_.size()); }
+
+  /** Returns true if this buffer contains no messages. */
+  bool empty() const { return timestamps_.empty(); }
+
+  /** Returns the total # of message bytes stored across all messages. */
+  int numBytes() const { return static_cast<int>(bytes_.size()); }
+
+  /** Returns timestamp of message at index. */
+  double timestampAt(int index) const {
+    assert((0 <= index) && (index < size()));
+    return timestamps_[index];
+  }
+
+  /** Updates timestamp of message at index. */
+  void setTimestampAt(int index, double timestamp) {
+    assert((0 <= index) && (index < size()));
+    timestamps_[index] = timestamp;
+  }
+
+  /** Returns read-only view of message at index. */
+  TimedMsgView operator[](int index) const {
+    assert((0 <= index) && (index < size()));
+    return TimedMsgView{timestamps_[index],
+                        MsgView{&bytes_[offsets_[index]], msgNumBytes(index)}};
+  }
+
+  /**
+   * Returns read-write reference to message at index. Note that the timestamp
+   * is copied into the returned value, so use setTimestampAt() to modify it.
+   */
+  TimedMsgRef refAt(int index) {
+    assert((0 <= index) && (index < size()));
+    return TimedMsgRef{timestamps_[index],
+                       MsgRef{&bytes_[offsets_[index]], msgNumBytes(index)}};
+  }
+
+  ConstIterator begin() const { return ConstIterator{this, 0}; }
+  ConstIterator end() const { return ConstIterator{this, size()}; }
+
+  /** Returns read-only pointer to the contiguous timestamps of all messages. */
+  const double* rawTimestamps() const { return timestamps_.data(); }
+
+  /** Returns read-only pointer to the contiguous bytes of all messages. */
+  const std::uint8_t* rawBytes() const { return bytes_.data(); }
+
+  /**
+   * Returns read-only pointer to size() + 1 byte offsets, where message i
+   * spans rawBytes()[offsets[i], offsets[i + 1]).
+   */
+  const int* rawOffsets() const { return offsets_.data(); }
+
+private:
+  int msgNumBytes(int index) const { return offsets_[index + 1] - offsets_[index]; }
+
+  std::vector<double> timestamps_;
+  std::vector<int> offsets_{0};
+  std::vector<std::uint8_t> bytes_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_BUFFER_HPP
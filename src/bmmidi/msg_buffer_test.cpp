@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_buffer.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+TEST(TimedMsgBuffer, StartsEmpty) {
+  bmmidi::TimedMsgBuffer buffer;
+  EXPECT_THAT(buffer.empty(), IsTrue());
+  EXPECT_THAT(buffer.size(), Eq(0));
+  EXPECT_THAT(buffer.numBytes(), Eq(0));
+  EXPECT_THAT(buffer.begin() == buffer.end(), IsTrue());
+}
+
+TEST(TimedMsgBuffer, StoresMsgsOfDifferentSizes) {
+  const auto noteOn = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(1), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{99});
+  const auto program = bmmidi::ProgramChangeMsg{
+      bmmidi::Channel::index(3), bmmidi::PresetNumber::index(7)};
+  const std::uint8_t sysEx[] = {0xF0, 0x7D, 0x01, 0x02, 0xF7};
+
+  bmmidi::TimedMsgBuffer buffer;
+  buffer.push(1.0, noteOn.asView<bmmidi::MsgView>());
+  buffer.push(bmmidi::TimedMsgView{2.0, program.asView<bmmidi::MsgView>()});
+  buffer.push(3.0, sysEx, 5);
+  buffer.push(4.0, bmmidi::timingClockMsg().asView<bmmidi::MsgView>());
+
+  EXPECT_THAT(buffer.empty(), IsFalse());
+  EXPECT_THAT(buffer.size(), Eq(4));
+  EXPECT_THAT(buffer.numBytes(), Eq(3 + 2 + 5 + 1));
+
+  EXPECT_THAT(buffer[0].timestamp(), Eq(1.0));
+  EXPECT_THAT(buffer[0].value().hasSameValueAs(noteOn.asView<bmmidi::MsgView>()), IsTrue());
+  EXPECT_THAT(buffer[1].timestamp(), Eq(2.0));
+  EXPECT_THAT(buffer[1].value().type(), Eq(bmmidi::MsgType::kProgramChange));
+  EXPECT_THAT(buffer[2].value().type(), Eq(bmmidi::MsgType::kSystemExclusive));
+  EXPECT_THAT(buffer[2].value().numBytes(), Eq(5));
+  EXPECT_THAT(buffer[2].value().rawBytes()[4], Eq(0xF7));
+  EXPECT_THAT(buffer[3].value().type(), Eq(bmmidi::MsgType::kTimingClock));
+
+  std::vector<double> timestamps;
+  for (const auto& timedMsg : buffer) { timestamps.push_back(timedMsg.timestamp()); }
+  EXPECT_THAT(timestamps, ElementsAre(1.0, 2.0, 3.0, 4.0));
+}
+
+TEST(TimedMsgBuffer, SupportsMutation) {
+  bmmidi::TimedMsgBuffer buffer;
+  buffer.push(1.0, bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(1), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{99})
+          .asView<bmmidi::MsgView>());
+
+  auto note = buffer.refAt(0).value().asRef<bmmidi::NoteMsgRef>();
+  note.setKey(bmmidi::KeyNumber::key(72));
+  note.setChannel(bmmidi::Channel::index(9));
+  buffer.setTimestampAt(0, 1.5);
+
+  const auto view = buffer[0].asView<bmmidi::NoteMsgView>();
+  EXPECT_THAT(view.timestamp(), Eq(1.5));
+  EXPECT_THAT(view.value().key(), Eq(bmmidi::KeyNumber::key(72)));
+  EXPECT_THAT(view.value().channel(), Eq(bmmidi::Channel::index(9)));
+}
+
+TEST(TimedMsgBuffer, ClearKeepsWorking) {
+  bmmidi::TimedMsgBuffer buffer;
+  buffer.reserve(8, 24);
+  buffer.push(1.0, bmmidi::startPlaybackMsg().asView<bmmidi::MsgView>());
+  buffer.clear();
+  EXPECT_THAT(buffer.empty(), IsTrue());
+  EXPECT_THAT(buffer.numBytes(), Eq(0));
+
+  buffer.push(2.0, bmmidi::stopPlaybackMsg().asView<bmmidi::MsgView>());
+  EXPECT_THAT(buffer.size(), Eq(1));
+  EXPECT_THAT(buffer[0].value().type(), Eq(bmmidi::MsgType::kStop));
+  EXPECT_THAT(buffer.rawOffsets()[1], Eq(1));
+}
+
+}  // namespace
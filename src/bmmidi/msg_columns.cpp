@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_columns.hpp"
+
+#include <memory>
+#include <utility>
+
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+void TimedMsgColumns::reserve(int numMsgs, int numSysExBytes) {
+  assert(numMsgs >= 0);
+  assert(numSysExBytes >= 0);
+  const int numBitmapBytes = (numMsgs + 7) / 8;
+
+  timestamps_.reserve(numMsgs);
+  statuses_.reserve(numMsgs);
+  channels_.reserve(numMsgs);
+  channelValidity_.reserve(numBitmapBytes);
+  data1s_.reserve(numMsgs);
+  data2s_.reserve(numMsgs);
+  sysExOffsets_.reserve(numMsgs + 1);
+  sysExBytes_.reserve(numSysExBytes);
+  sysExValidity_.reserve(numBitmapBytes);
+}
+
+void TimedMsgColumns::clear() {
+  timestamps_.clear();
+  statuses_.clear();
+  channels_.clear();
+  channelValidity_.clear();
+  data1s_.clear();
+  data2s_.clear();
+  sysExOffsets_.resize(1);
+  sysExBytes_.clear();
+  sysExValidity_.clear();
+  numNullChannels_ = 0;
+  numSysEx_ = 0;
+}
+
+void TimedMsgColumns::push(const TimedMsgView& timedMsg) {
+  const int index = size();
+  const MsgView& msg = timedMsg.value();
+  const std::uint8_t* bytes = msg.rawBytes();
+  const int numBytes = msg.numBytes();
+  const Status status = msg.status();
+
+  timestamps_.push_back(timedMsg.timestamp());
+  statuses_.push_back(bytes[0]);
+
+  const bool hasChannel = status.isChannelSpecific();
+  channels_.push_back(hasChannel ? static_cast<std::uint8_t>(status.channel().index()) : 0);
+  pushValidity(channelValidity_, index, hasChannel);
+  if (!hasChannel) { ++numNullChannels_; }
+
+  const bool isSysEx = (status.type() == MsgType::kSystemExclusive);
+  data1s_.push_back((!isSysEx && (numBytes >= 2)) ? bytes[1] : 0);
+  data2s_.push_back((!isSysEx && (numBytes >= 3)) ? bytes[2] : 0);
+
+  if (isSysEx) {
+    sysExBytes_.insert(sysExBytes_.end(), bytes, bytes + numBytes);
+    ++numSysEx_;
+  }
+  sysExOffsets_.push_back(static_cast<std::int32_t>(sysExBytes_.size()));
+  pushValidity(sysExValidity_, index, isSysEx);
+}
+
+void TimedMsgColumns::pushAll(const TimedMsgBuffer& buffer) {
+  reserve(size() + buffer.size(), numSysExBytes());
+  for (const auto& timedMsg : buffer) { push(timedMsg); }
+}
+
+void TimedMsgColumns::pushValidity(std::vector<std::uint8_t>& bitmap, int index, bool valid) {
+  if (index % 8 == 0) { bitmap.push_back(0x00); }
+  if (valid) { bitmap.back() |= static_cast<std::uint8_t>(0x01 << (index % 8)); }
+}
+
+namespace {
+
+constexpr int kMaxArrowBuffers = 3;
+
+// Each exported array (parent or child) shares ownership of the columns, so
+// that consumers may move children out and release them independently.
+struct ArrowArrayPrivate {
+  std::shared_ptr<const TimedMsgColumns> columns;
+  const void* buffers[kMaxArrowBuffers] = {};
+  std::vector<std::unique_ptr<ArrowArray>> ownedChildren;
+  std::vector<ArrowArray*> children;
+};
+
+struct ArrowSchemaPrivate {
+  std::vector<std::unique_ptr<ArrowSchema>> ownedChildren;
+  std::vector<ArrowSchema*> children;
+};
+
+void releaseArrowArray(ArrowArray* array) {
+  auto* priv = static_cast<ArrowArrayPrivate*>(array->private_data);
+  for (ArrowArray* child : priv->children) {
+    if (child->release != nullptr) { child->release(child); }
+  }
+  delete priv;
+  array->release = nullptr;
+}
+
+void releaseArrowSchema(ArrowSchema* schema) {
+  auto* priv = static_cast<ArrowSchemaPrivate*>(schema->private_data);
+  for (ArrowSchema* child : priv->children) {
+    if (child->release != nullptr) { child->release(child); }
+  }
+  delete priv;
+  schema->release = nullptr;
+}
+
+void initArrowArray(ArrowArray* array, ArrowArrayPrivate* priv,
+                    int64_t nullCount, int numBuffers) {
+  array->length = priv->columns->size();
+  array->null_count = nullCount;
+  array->offset = 0;
+  array->n_buffers = numBuffers;
+  array->n_children = static_cast<int64_t>(priv->children.size());
+  array->buffers = priv->buffers;
+  array->children = priv->children.empty() ? nullptr : priv->children.data();
+  array->dictionary = nullptr;
+  array->release = &releaseArrowArray;
+  array->private_data = priv;
+}
+
+void initArrowSchema(ArrowSchema* schema, ArrowSchemaPrivate* priv,
+                     const char* format, const char* name, int64_t flags) {
+  schema->format = format;
+  schema->name = name;
+  schema->metadata = nullptr;
+  schema->flags = flags;
+  schema->n_children = static_cast<int64_t>(priv->children.size());
+  schema->children = priv->children.empty() ? nullptr : priv->children.data();
+  schema->dictionary = nullptr;
+  schema->release = &releaseArrowSchema;
+  schema->private_data = priv;
+}
+
+struct ArrowField {
+  const char* format;
+  const char* name;
+  bool isNullable;
+  int64_t nullCount;
+  int numBuffers;
+  const void* buffers[kMaxArrowBuffers];
+};
+
+}  // namespace
+
+void exportToArrow(TimedMsgColumns&& columns, ArrowArray* outArray, ArrowSchema* outSchema) {
+  assert(outArray != nullptr);
+  assert(outSchema != nullptr);
+  auto shared = std::make_shared<const TimedMsgColumns>(std::move(columns));
+  const TimedMsgColumns& c = *shared;
+
+  const ArrowField fields[] = {
+      {"g", "timestamp", false, 0, 2, {nullptr, c.timestamps()}},
+      {"C", "status", false, 0, 2, {nullptr, c.statuses()}},
+      {"C", "channel", true, c.numNullChannels(), 2, {c.channelValidity(), c.channels()}},
+      {"C", "data1", false, 0, 2, {nullptr, c.data1s()}},
+      {"C", "data2", false, 0, 2, {nullptr, c.data2s()}},
+      {"z", "sysex", true, c.numNullSysEx(), 3,
+       {c.sysExValidity(), c.sysExOffsets(), c.sysExBytes()}},
+  };
+
+  auto* arrayPriv = new ArrowArrayPrivate{};
+  arrayPriv->columns = shared;
+  auto* schemaPriv = new ArrowSchemaPrivate{};
+
+  for (const ArrowField& field : fields) {
+    auto* childArrayPriv = new ArrowArrayPrivate{};
+    childArrayPriv->columns = shared;
+    for (int i = 0; i < field.numBuffers; ++i) { childArrayPriv->buffers[i] = field.buffers[i]; }
+
+    arrayPriv->ownedChildren.emplace_back(new ArrowArray{});
+    ArrowArray* childArray = arrayPriv->ownedChildren.back().get();
+    initArrowArray(childArray, childArrayPriv, field.nullCount, field.numBuffers);
+    arrayPriv->children.push_back(childArray);
+
+    schemaPriv->ownedChildren.emplace_back(new ArrowSchema{});
+    ArrowSchema* childSchema = schemaPriv->ownedChildren.back().get();
+    initArrowSchema(childSchema, new ArrowSchemaPrivate{}, field.format, field.name,
+                    field.isNullable ? ARROW_FLAG_NULLABLE : 0);
+    schemaPriv->children.push_back(childSchema);
+  }
+
+  // Struct arrays have only a (here omitted) validity buffer.
+  initArrowArray(outArray, arrayPriv, 0, 1);
+  initArrowSchema(outSchema, schemaPriv, "+s", "", 0);
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_COLUMNS_HPP
+#define BMMIDI_MSG_COLUMNS_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+// Apache Arrow C data interface structs, copied verbatim from the (ABI-stable)
+// specification at https://arrow.apache.org/docs/format/CDataInterface.html so
+// that no Arrow dependency is needed. The guard lets these coexist with any
+// Arrow headers that define the same structs.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  // Array type description
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowSchema*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+struct ArrowArray {
+  // Array data description
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+
+  // Release callback
+  void (*release)(struct ArrowArray*);
+  // Opaque producer-specific data
+  void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace bmmidi {
+
+/**
+ * Column-oriented (struct-of-arrays) copy of a timestamped MIDI message
+ * stream, for analytics queries that scan one field across many messages
+ * (e.g. "all CC1 on channel 3 between t0 and t1") without gathering from
+ * row-oriented TimedMsg values.
+ *
+ * Each message i is described by:
+ * - timestamps()[i]: its timestamp.
+ * - statuses()[i]: its complete status byte.
+ * - channels()[i]: its 0-based channel index, or 0 (and null in
+ *   channelValidity()) for System messages.
+ * - data1s()[i] and data2s()[i]: its data bytes, or 0 if not present.
+ * - sysExBytes()[sysExOffsets()[i], sysExOffsets()[i + 1]): the complete bytes
+ *   (including 0xF0 and 0xF7) of a System Exclusive message, or an empty
+ *   (and null in sysExValidity()) range otherwise.
+ *
+ * Buffers follow the Apache Arrow columnar format (validity bitmaps with bit i
+ * at byte i / 8, bit i % 8 set for valid values; int32 offsets), so they can be
+ * handed to Arrow-based tooling without conversion via exportToArrow().
+ */
+class TimedMsgColumns {
+public:
+  TimedMsgColumns() = default;
+
+  /** Reserves storage for numMsgs messages and numSysExBytes SysEx bytes. */
+  void reserve(int numMsgs, int numSysExBytes);
+
+  /** Removes all messages (but keeps allocated storage). */
+  void clear();
+
+  /** Appends a copy of timedMsg. */
+  void push(const TimedMsgView& timedMsg);
+
+  /** Appends copies of all messages in buffer. */
+  void pushAll(const TimedMsgBuffer& buffer);
+
+  /** Returns the # of messages (rows). */
+  int size() const { return static_cast<int>(timestamps_.size()); }
+
+  /** Returns true if there are no messages. */
+  bool empty() const { return timestamps_.empty(); }
+
+  /** Returns # of System (non-channel) messages, which have a null channel. */
+  int numNullChannels() const { return numNullChannels_; }
+
+  /** Returns # of non-SysEx messages, which have a null SysEx value. */
+  int numNullSysEx() const { return size() - numSysEx_; }
+
+  /** Returns true if message at index has a channel. */
+  bool hasChannel(int index) const {
+    assert((0 <= index) && (index < size()));
+    return isValid(channelValidity_, index);
+  }
+
+  /** Returns true if message at index is System Exclusive. */
+  bool hasSysEx(int index) const {
+    assert((0 <= index) && (index < size()));
+    return isValid(sysExValidity_, index);
+  }
+
+  const double* timestamps() const { return timestamps_.data(); }
+  const std::uint8_t* statuses() const { return statuses_.data(); }
+  const std::uint8_t* channels() const { return channels_.data(); }
+  const std::uint8_t* channelValidity() const { return channelValidity_.data(); }
+  const std::uint8_t* data1s() const { return data1s_.data(); }
+  const std::uint8_t* data2s() const { return data2s_.data(); }
+  const std::int32_t* sysExOffsets() const { return sysExOffsets_.data(); }
+  const std::uint8_t* sysExBytes() const { return sysExBytes_.data(); }
+  const std::uint8_t* sysExValidity() const { return sysExValidity_.data(); }
+
+  /** Returns the total # of SysEx bytes stored across all messages. */
+  int numSysExBytes() const { return static_cast<int>(sysExBytes_.size()); }
+
+private:
+  static bool isValid(const std::vector<std::uint8_t>& bitmap, int index) {
+    return (bitmap[index / 8] >> (index % 8)) & 0x01;
+  }
+
+  static void pushValidity(std::vector<std::uint8_t>& bitmap, int index, bool valid);
+
+  std::vector<double> timestamps_;
+  std::vector<std::uint8_t> statuses_;
+  std::vector<std::uint8_t> channels_;
+  std::vector<std::uint8_t> channelValidity_;
+  std::vector<std::uint8_t> data1s_;
+  std::vector<std::uint8_t> data2s_;
+  std::vector<std::int32_t> sysExOffsets_{0};
+  std::vector<std::uint8_t> sysExBytes_;
+  std::vector<std::uint8_t> sysExValidity_;
+  int numNullChannels_ = 0;
+  int numSysEx_ = 0;
+};
+
+/**
+ * Moves columns into an Arrow C data interface struct array (with fields
+ * "timestamp" float64, "status" uint8, "channel" nullable uint8, "data1"
+ * uint8, "data2" uint8, and "sysex" nullable binary) and its schema, both of
+ * which the caller must eventually release via their release callbacks.
+ *
+ * The exported buffers point directly into the (moved) columns, so no column
+ * data is copied. Children may be released independently of their parent.
+ */
+void exportToArrow(TimedMsgColumns&& columns, ArrowArray* outArray, ArrowSchema* outSchema);
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_COLUMNS_HPP
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_columns.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsNull;
+using ::testing::IsTrue;
+
+bmmidi::TimedMsgBuffer makeBuffer() {
+  const std::uint8_t sysEx[] = {0xF0, 0x7D, 0x01, 0xF7};
+
+  bmmidi::TimedMsgBuffer buffer;
+  buffer.push(0.5, bmmidi::NoteMsg::on(bmmidi::Channel::index(2), bmmidi::KeyNumber::key(60),
+                                       bmmidi::DataValue{100})
+                       .asView<bmmidi::MsgView>());
+  buffer.push(1.0, bmmidi::timingClockMsg().asView<bmmidi::MsgView>());
+  buffer.push(1.5, sysEx, 4);
+  buffer.push(2.0, bmmidi::ControlChangeMsg{bmmidi::Channel::index(3),
+                                            bmmidi::Control::kModWheel, bmmidi::DataValue{42}}
+                       .asView<bmmidi::MsgView>());
+  return buffer;
+}
+
+TEST(TimedMsgColumns, SplitsMsgsIntoColumns) {
+  bmmidi::TimedMsgColumns columns;
+  columns.pushAll(makeBuffer());
+  ASSERT_THAT(columns.size(), Eq(4));
+
+  const auto* ts = columns.timestamps();
+  EXPECT_THAT(std::vector<double>(ts, ts + 4), ElementsAre(0.5, 1.0, 1.5, 2.0));
+  const auto* st = columns.statuses();
+  EXPECT_THAT(std::vector<int>(st, st + 4), ElementsAre(0x92, 0xF8, 0xF0, 0xB3));
+  const auto* ch = columns.channels();
+  EXPECT_THAT(std::vector<int>(ch, ch + 4), ElementsAre(2, 0, 0, 3));
+  const auto* d1 = columns.data1s();
+  EXPECT_THAT(std::vector<int>(d1, d1 + 4), ElementsAre(60, 0, 0, 1));
+  const auto* d2 = columns.data2s();
+  EXPECT_THAT(std::vector<int>(d2, d2 + 4), ElementsAre(100, 0, 0, 42));
+
+  EXPECT_THAT(columns.hasChannel(0), IsTrue());
+  EXPECT_THAT(columns.hasChannel(1), IsFalse());
+  EXPECT_THAT(columns.hasChannel(2), IsFalse());
+  EXPECT_THAT(columns.hasChannel(3), IsTrue());
+  EXPECT_THAT(columns.channelValidity()[0], Eq(0x09));
+  EXPECT_THAT(columns.numNullChannels(), Eq(2));
+
+  EXPECT_THAT(columns.hasSysEx(2), IsTrue());
+  EXPECT_THAT(columns.hasSysEx(3), IsFalse());
+  EXPECT_THAT(columns.numNullSysEx(), Eq(3));
+  const auto* offsets = columns.sysExOffsets();
+  EXPECT_THAT(std::vector<int>(offsets, offsets + 5), ElementsAre(0, 0, 0, 4, 4));
+  const auto* sysEx = columns.sysExBytes();
+  EXPECT_THAT(std::vector<int>(sysEx, sysEx + 4), ElementsAre(0xF0, 0x7D, 0x01, 0xF7));
+}
+
+TEST(TimedMsgColumns, ValidityBitmapSpansBytes) {
+  bmmidi::TimedMsgColumns columns;
+  const auto clock = bmmidi::timingClockMsg();
+  for (int i = 0; i < 10; ++i) {
+    const auto noteOff = bmmidi::NoteMsg::off(bmmidi::Channel::index(0), bmmidi::KeyNumber::key(i));
+    const auto msg = (i % 3 == 0) ? clock.asView<bmmidi::MsgView>()
+                                  : noteOff.asView<bmmidi::MsgView>();
+    columns.push(bmmidi::TimedMsgView{static_cast<double>(i), msg});
+  }
+
+  // Indices 0, 3, 6, 9 are System msgs with null channel.
+  EXPECT_THAT(columns.channelValidity()[0], Eq(0xB6));
+  EXPECT_THAT(columns.channelValidity()[1], Eq(0x01));
+  EXPECT_THAT(columns.numNullChannels(), Eq(4));
+
+  columns.clear();
+  EXPECT_THAT(columns.empty(), IsTrue());
+  EXPECT_THAT(columns.numNullChannels(), Eq(0));
+  EXPECT_THAT(columns.sysExOffsets()[0], Eq(0));
+}
+
+TEST(TimedMsgColumns, ExportsToArrow) {
+  bmmidi::TimedMsgColumns columns;
+  columns.pushAll(makeBuffer());
+  const double* timestamps = columns.timestamps();
+
+  ArrowArray array;
+  ArrowSchema schema;
+  bmmidi::exportToArrow(std::move(columns), &array, &schema);
+
+  EXPECT_THAT(std::string{schema.format}, Eq("+s"));
+  ASSERT_THAT(schema.n_children, Eq(6));
+  std::vector<std::string> names;
+  std::vector<std::string> formats;
+  for (int i = 0; i < 6; ++i) {
+    names.push_back(schema.children[i]->name);
+    formats.push_back(schema.children[i]->format);
+  }
+  EXPECT_THAT(names, ElementsAre("timestamp", "status", "channel", "data1", "data2", "sysex"));
+  EXPECT_THAT(formats, ElementsAre("g", "C", "C", "C", "C", "z"));
+  EXPECT_THAT(schema.children[2]->flags, Eq(ARROW_FLAG_NULLABLE));
+
+  EXPECT_THAT(array.length, Eq(4));
+  ASSERT_THAT(array.n_children, Eq(6));
+
+  // Buffers are moved, not copied.
+  const ArrowArray* timestampArray = array.children[0];
+  EXPECT_THAT(timestampArray->buffers[0], IsNull());
+  EXPECT_THAT(timestampArray->buffers[1], Eq(static_cast<const void*>(timestamps)));
+
+  const ArrowArray* channelArray = array.children[2];
+  EXPECT_THAT(channelArray->null_count, Eq(2));
+  EXPECT_THAT(static_cast<const std::uint8_t*>(channelArray->buffers[0])[0], Eq(0x09));
+
+  const ArrowArray* sysExArray = array.children[5];
+  EXPECT_THAT(sysExArray->n_buffers, Eq(3));
+  EXPECT_THAT(sysExArray->null_count, Eq(3));
+  EXPECT_THAT(static_cast<const std::int32_t*>(sysExArray->buffers[1])[3], Eq(4));
+
+  // A child moved out by the consumer outlives its released parent.
+  ArrowArray movedChild = *array.children[1];
+  array.children[1]->release = nullptr;
+  array.release(&array);
+  EXPECT_THAT(array.release, IsNull());
+  EXPECT_THAT(static_cast<const std::uint8_t*>(movedChild.buffers[1])[3], Eq(0xB3));
+  movedChild.release(&movedChild);
+
+  schema.release(&schema);
+  EXPECT_THAT(schema.release, IsNull());
+}
+
+}  // namespace
@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_file.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace bmmidi {
+namespace {
+
+constexpr std::uint8_t kHeader[kMsgFileHeaderBytes] = {'B', 'M', 'M', 's', 'g', 's', 0x00, 0x01};
+
+void putLittleEndian(std::uint64_t value, int numBytes, std::uint8_t* bytes) {
+  for (int i = 0; i < numBytes; ++i) { bytes[i] = static_cast<std::uint8_t>(value >> (8 * i)); }
+}
+
+std::uint64_t getLittleEndian(const std::uint8_t* bytes, int numBytes) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < numBytes; ++i) { value |= std::uint64_t{bytes[i]} << (8 * i); }
+  return value;
+}
+
+}  // namespace
+
+MsgFileStatus MsgFileReader::open(const std::string& path) {
+  file_.close();
+  file_.clear();
+  file_.open(path, std::ios::binary);
+  if (!file_) { return MsgFileStatus::kOpenFailed; }
+
+  std::uint8_t header[kMsgFileHeaderBytes];
+  if (!file_.read(reinterpret_cast<char*>(header), kMsgFileHeaderBytes)
+      || (std::memcmp(header, kHeader, kMsgFileHeaderBytes) != 0)) {
+    return MsgFileStatus::kNotMsgFile;
+  }
+  return MsgFileStatus::kOk;
+}
+
+MsgFileStatus MsgFileReader::read(TimedMsgBuffer& out, int maxMsgs) {
+  assert(file_.is_open());
+  for (int i = 0; i < maxMsgs; ++i) {
+    std::uint8_t recordHeader[kMsgFileRecordHeaderBytes];
+    file_.read(reinterpret_cast<char*>(recordHeader), kMsgFileRecordHeaderBytes);
+    if (file_.gcount() == 0) { return MsgFileStatus::kEnd; }
+    if (file_.gcount() != kMsgFileRecordHeaderBytes) { return MsgFileStatus::kTruncated; }
+
+    const std::uint64_t timestampBits = getLittleEndian(recordHeader, 8);
+    double timestamp;
+    std::memcpy(&timestamp, &timestampBits, sizeof(timestamp));
+    const auto numBytes = static_cast<std::uint32_t>(getLittleEndian(recordHeader + 8, 4));
+    if ((numBytes == 0) || (numBytes > kMsgFileMaxMsgBytes)) {
+      return MsgFileStatus::kInvalidRecord;
+    }
+
+    msgBytes_.resize(numBytes);
+    if (!file_.read(reinterpret_cast<char*>(msgBytes_.data()), numBytes)) {
+      return MsgFileStatus::kTruncated;
+    }
+    if (!isValidMsg(msgBytes_.data(), static_cast<int>(numBytes))) {
+      return MsgFileStatus::kInvalidRecord;
+    }
+    out.push(timestamp, msgBytes_.data(), static_cast<int>(numBytes));
+  }
+
+  // Distinguish a full chunk that ends exactly at the end of the file.
+  return (file_.peek() == std::ifstream::traits_type::eof()) ? MsgFileStatus::kEnd
+                                                             : MsgFileStatus::kOk;
+}
+
+MsgFileStatus MsgFileWriter::open(const std::string& path) {
+  file_.close();
+  file_.clear();
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_) { return MsgFileStatus::kOpenFailed; }
+
+  lastTimestamp_ = -std::numeric_limits<double>::infinity();
+  file_.write(reinterpret_cast<const char*>(kHeader), kMsgFileHeaderBytes);
+  return file_ ? MsgFileStatus::kOk : MsgFileStatus::kWriteFailed;
+}
+
+MsgFileStatus MsgFileWriter::write(const TimedMsgView& timedMsg) {
+  assert(file_.is_open());
+  assert(timedMsg.timestamp() >= lastTimestamp_);
+  lastTimestamp_ = timedMsg.timestamp();
+
+  const MsgView msg = timedMsg.value();
+  std::uint8_t recordHeader[kMsgFileRecordHeaderBytes];
+  std::uint64_t timestampBits;
+  std::memcpy(&timestampBits, &lastTimestamp_, sizeof(timestampBits));
+  putLittleEndian(timestampBits, 8, recordHeader);
+  putLittleEndian(static_cast<std::uint64_t>(msg.numBytes()), 4, recordHeader + 8);
+
+  file_.write(reinterpret_cast<const char*>(recordHeader), kMsgFileRecordHeaderBytes);
+  file_.write(reinterpret_cast<const char*>(msg.rawBytes()), msg.numBytes());
+  return file_ ? MsgFileStatus::kOk : MsgFileStatus::kWriteFailed;
+}
+
+MsgFileStatus MsgFileWriter::writeAll(const TimedMsgBuffer& buffer) {
+  for (const TimedMsgView timedMsg : buffer) {
+    const MsgFileStatus status = write(timedMsg);
+    if (status != MsgFileStatus::kOk) { return status; }
+  }
+  return MsgFileStatus::kOk;
+}
+
+MsgFileStatus MsgFileWriter::close() {
+  file_.flush();
+  const bool isOk = static_cast<bool>(file_);
+  file_.close();
+  return (isOk && file_) ? MsgFileStatus::kOk : MsgFileStatus::kWriteFailed;
+}
+
+}  // namespace bmmidi
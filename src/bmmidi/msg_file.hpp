@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_FILE_HPP
+#define BMMIDI_MSG_FILE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Result of reading or writing a message file. */
+enum class MsgFileStatus {
+  /** Succeeded (and, when reading, there may be more messages). */
+  kOk,
+
+  /** Reached the end of the file after its last complete message. */
+  kEnd,
+
+  /** File could not be opened. */
+  kOpenFailed,
+
+  /** File does not start with a valid message file header. */
+  kNotMsgFile,
+
+  /** File ended in the middle of a message record. */
+  kTruncated,
+
+  /** A message record is not a valid MIDI message. */
+  kInvalidRecord,
+
+  /** File could not be written. */
+  kWriteFailed,
+};
+
+/**
+ * Message files store a timed message stream for playback straight from disk:
+ * an 8-byte header ("BMMsgs" then version 0x00 0x01), then one record per
+ * message, in non-decreasing timestamp order:
+ *
+ * - timestamp: IEEE 754 double, little-endian (8 bytes).
+ * - numBytes: unsigned 32-bit, little-endian (4 bytes).
+ * - bytes: the complete message (including SysEx F0 and F7 bytes).
+ *
+ * Unlike an SMF, records need no per-track state (running status, tempo map,
+ * or track merging) to decode, so a reader can stream a file of any length
+ * in fixed-size chunks.
+ */
+BMMIDI_INLINE_VAR constexpr int kMsgFileHeaderBytes = 8;
+BMMIDI_INLINE_VAR constexpr int kMsgFileRecordHeaderBytes = 12;
+
+/** Largest message a message file record may hold. */
+BMMIDI_INLINE_VAR constexpr std::uint32_t kMsgFileMaxMsgBytes = 1 << 24;
+
+/** Reads a message file sequentially, in chunks of messages. */
+class MsgFileReader {
+public:
+  MsgFileReader() = default;
+
+  /** Opens the file at path and checks its header. */
+  MsgFileStatus open(const std::string& path);
+
+  /**
+   * Appends up to maxMsgs messages from the file to out. Returns kEnd once the
+   * end of the file is reached (possibly after appending some messages), or
+   * an error (after appending any complete messages before it).
+   */
+  MsgFileStatus read(TimedMsgBuffer& out, int maxMsgs);
+
+private:
+  std::ifstream file_;
+  std::vector<std::uint8_t> msgBytes_;
+};
+
+/** Writes a message file sequentially. */
+class MsgFileWriter {
+public:
+  MsgFileWriter() = default;
+
+  /** Creates (or replaces) the file at path and writes its header. */
+  MsgFileStatus open(const std::string& path);
+
+  /** Appends timedMsg, whose timestamp must not be before the previous one. */
+  MsgFileStatus write(const TimedMsgView& timedMsg);
+
+  /** Appends all messages in buffer. */
+  MsgFileStatus writeAll(const TimedMsgBuffer& buffer);
+
+  /** Flushes and closes the file. */
+  MsgFileStatus close();
+
+private:
+  std::ofstream file_;
+  double lastTimestamp_ = -std::numeric_limits<double>::infinity();
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_FILE_HPP
@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_file_player.hpp"
+
+#include <chrono>
+#include <limits>
+
+namespace bmmidi {
+namespace {
+
+// The audio thread only hands chunks back with an atomic flag (as notifying a
+// condition variable may make a syscall), so the loader polls for them.
+constexpr std::chrono::milliseconds kLoaderPollInterval{5};
+
+// Initial storage per chunk, so the loader rarely reallocates.
+constexpr int kReservedBytesPerMsg = 4;
+
+}  // namespace
+
+MsgFilePlayer::MsgFilePlayer(const MsgFilePlayerOptions& options)
+    : chunkMsgs_{options.chunkMsgs}, chunks_(options.numChunks) {
+  assert(options.chunkMsgs > 0);
+  assert(options.numChunks >= 2);
+  for (Chunk& chunk : chunks_) {
+    chunk.msgs.reserve(chunkMsgs_, chunkMsgs_ * kReservedBytesPerMsg);
+  }
+}
+
+MsgFileStatus MsgFilePlayer::open(const std::string& path) {
+  stop();
+  for (Chunk& chunk : chunks_) { chunk.isLoaded.store(false, std::memory_order_relaxed); }
+  playChunk_ = 0;
+  playIndex_ = 0;
+  numUnderruns_.store(0, std::memory_order_relaxed);
+  lookahead_.clear();
+
+  const MsgFileStatus status = reader_.open(path);
+  readStatus_ = status;
+  loadStatus_.store(status, std::memory_order_release);
+  isFinished_ = (status != MsgFileStatus::kOk);
+  if (isFinished_) { return status; }
+
+  if (load(chunks_[0])) {
+    stopping_ = false;
+    loader_ = std::thread{[this] { runLoader(); }};
+  }
+  return status;
+}
+
+bool MsgFilePlayer::load(Chunk& chunk) {
+  chunk.msgs.clear();
+  if (!lookahead_.empty()) {
+    const TimedMsgView msg = lookahead_[0];
+    chunk.msgs.push(msg.timestamp(), msg.value().rawBytes(), msg.value().numBytes());
+    lookahead_.clear();
+  }
+
+  if (readStatus_ == MsgFileStatus::kOk) {
+    readStatus_ = reader_.read(chunk.msgs, chunkMsgs_ - chunk.msgs.size());
+    if (readStatus_ == MsgFileStatus::kOk) { readStatus_ = reader_.read(lookahead_, 1); }
+    loadStatus_.store(readStatus_, std::memory_order_release);
+  }
+
+  chunk.isLast = lookahead_.empty() && (readStatus_ != MsgFileStatus::kOk);
+  chunk.nextTimestamp =
+      lookahead_.empty() ? std::numeric_limits<double>::infinity() : lookahead_.timestampAt(0);
+  chunk.isLoaded.store(true, std::memory_order_release);
+  return !chunk.isLast;
+}
+
+void MsgFilePlayer::runLoader() {
+  for (int i = 1;; i = (i + 1) % static_cast<int>(chunks_.size())) {
+    Chunk& chunk = chunks_[i];
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      while (!stopping_ && chunk.isLoaded.load(std::memory_order_acquire)) {
+        stopRequested_.wait_for(lock, kLoaderPollInterval);
+      }
+      if (stopping_) { return; }
+    }
+    if (!load(chunk)) { return; }
+  }
+}
+
+void MsgFilePlayer::stop() {
+  if (!loader_.joinable()) { return; }
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  stopRequested_.notify_one();
+  loader_.join();
+}
+
+void MsgFilePlayer::releaseChunk() {
+  nextChunkTimestamp_ = chunks_[playChunk_].nextTimestamp;
+  chunks_[playChunk_].isLoaded.store(false, std::memory_order_release);
+  playChunk_ = (playChunk_ + 1) % static_cast<int>(chunks_.size());
+  playIndex_ = 0;
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_FILE_PLAYER_HPP
+#define BMMIDI_MSG_FILE_PLAYER_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_file.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Configuration for MsgFilePlayer. */
+struct MsgFilePlayerOptions {
+  /** # of messages read from the file at a time. */
+  int chunkMsgs = 4096;
+
+  /**
+   * # of chunks buffered ahead of playback (>= 2), i.e. read-ahead is roughly
+   * (numChunks - 1) * chunkMsgs messages.
+   */
+  int numChunks = 2;
+};
+
+/**
+ * Plays a message file (see MsgFileReader) straight from disk, so recordings
+ * of any length play in constant memory.
+ *
+ * A loader thread reads the file ahead of playback into a ring of chunks
+ * (double-buffered by default), and the audio thread takes per-block slices
+ * of messages with renderBlock(), which never blocks, allocates, or touches
+ * the file: it only reads chunks the loader has already filled (and so
+ * faulted in), and hands emptied chunks back with an atomic flag.
+ *
+ * If the loader falls behind, renderBlock() stops at the end of the loaded
+ * messages, and counts an underrun if any message not yet loaded is due (the
+ * loader reads one message ahead of each chunk, so the player knows when the
+ * next chunk's first message is due); the remaining messages are delivered
+ * late, at the start of later blocks.
+ */
+class MsgFilePlayer {
+public:
+  explicit MsgFilePlayer(const MsgFilePlayerOptions& options = MsgFilePlayerOptions{});
+
+  MsgFilePlayer(const MsgFilePlayer&) = delete;
+  MsgFilePlayer& operator=(const MsgFilePlayer&) = delete;
+
+  /** Stops the loader thread. */
+  ~MsgFilePlayer() { stop(); }
+
+  /**
+   * Opens the message file at path for playback from its start, loads its
+   * first chunk (so playback can start right away), and starts the loader
+   * thread. Not realtime-safe.
+   */
+  MsgFileStatus open(const std::string& path);
+
+  /**
+   * Calls fn(int frameOffset, const TimedMsgView& msg) for each message not
+   * yet played with timestamp (in seconds) before the end of the block of
+   * numFrames frames at sampleRate starting at startTime. frameOffset is the
+   * frame of the block the message falls on (0 for late messages). Returns
+   * the # of messages delivered.
+   *
+   * Must only be called from one (audio) thread, after open() succeeded.
+   */
+  template<typename Fn>
+  int renderBlock(double startTime, int numFrames, double sampleRate, Fn&& fn);
+
+  /** Returns true once every message of the file has been played. */
+  bool isFinished() const { return isFinished_; }
+
+  /**
+   * Returns the # of renderBlock() calls that could not deliver a due message
+   * because it was not loaded yet.
+   */
+  int numUnderruns() const { return numUnderruns_.load(std::memory_order_relaxed); }
+
+  /** Returns the loader's last read result (kOk while reading, then kEnd or an error). */
+  MsgFileStatus loadStatus() const { return loadStatus_.load(std::memory_order_acquire); }
+
+private:
+  struct Chunk {
+    TimedMsgBuffer msgs;
+    bool isLast = false;                // Written by loader before isLoaded.
+    double nextTimestamp = 0.0;         // Of the next chunk's first message (if any).
+    std::atomic<bool> isLoaded{false};  // Owned by loader if false, else by player.
+  };
+
+  // Fills chunk from reader_, returning false after the last chunk.
+  bool load(Chunk& chunk);
+
+  // Runs the loader thread until the last chunk is loaded or stopping_.
+  void runLoader();
+
+  // Stops and joins the loader thread.
+  void stop();
+
+  // Hands the current chunk back to the loader and moves on to the next.
+  void releaseChunk();
+
+  int chunkMsgs_;
+  std::vector<Chunk> chunks_;
+
+  // Only used by the loader.
+  MsgFileReader reader_;
+  MsgFileStatus readStatus_ = MsgFileStatus::kOk;
+  TimedMsgBuffer lookahead_;  // Message read ahead of the last loaded chunk.
+
+  std::atomic<MsgFileStatus> loadStatus_{MsgFileStatus::kOk};
+  std::atomic<int> numUnderruns_{0};
+
+  // Player (audio thread) state.
+  int playChunk_ = 0;
+  int playIndex_ = 0;
+  double nextChunkTimestamp_ = 0.0;  // Of the current chunk's first message.
+  bool isFinished_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable stopRequested_;
+  bool stopping_ = false;  // Guarded by mutex_.
+  std::thread loader_;
+};
+
+template<typename Fn>
+int MsgFilePlayer::renderBlock(double startTime, int numFrames, double sampleRate, Fn&& fn) {
+  assert(numFrames > 0);
+  assert(sampleRate > 0.0);
+  const double endTime = startTime + numFrames / sampleRate;
+  int numDelivered = 0;
+
+  while (!isFinished_) {
+    Chunk& chunk = chunks_[playChunk_];
+    if (!chunk.isLoaded.load(std::memory_order_acquire)) {
+      if (nextChunkTimestamp_ < endTime) { numUnderruns_.fetch_add(1, std::memory_order_relaxed); }
+      break;
+    }
+
+    const TimedMsgBuffer& msgs = chunk.msgs;
+    for (; playIndex_ < msgs.size(); ++playIndex_) {
+      const double timestamp = msgs.timestampAt(playIndex_);
+      if (timestamp >= endTime) { return numDelivered; }
+
+      const double frame = std::floor((timestamp - startTime) * sampleRate);
+      const int frameOffset =
+          (frame <= 0.0) ? 0 : ((frame >= numFrames) ? numFrames - 1 : static_cast<int>(frame));
+      fn(frameOffset, msgs[playIndex_]);
+      ++numDelivered;
+    }
+
+    if (chunk.isLast) {
+      isFinished_ = true;
+    } else {
+      releaseChunk();
+    }
+  }
+  return numDelivered;
+}
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_FILE_PLAYER_HPP
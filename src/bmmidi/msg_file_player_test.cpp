@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_file_player.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_file.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::IsTrue;
+using ::testing::Lt;
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockFrames = 64;
+
+// Writes numMsgs Note Ons, one every 0.37 ms (so several per block), to a
+// message file and returns its path.
+std::string writeRecording(const std::string& name, int numMsgs) {
+  const std::string path = ::testing::TempDir() + "bmmidi_msg_file_player_" + name;
+  bmmidi::MsgFileWriter writer;
+  EXPECT_THAT(writer.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  for (int i = 0; i < numMsgs; ++i) {
+    const std::uint8_t bytes[] = {0x90, static_cast<std::uint8_t>(i % 128), 100};
+    bmmidi::TimedMsgBuffer msg;
+    msg.push(i * 0.00037, bytes, 3);
+    EXPECT_THAT(writer.write(msg[0]), Eq(bmmidi::MsgFileStatus::kOk));
+  }
+  EXPECT_THAT(writer.close(), Eq(bmmidi::MsgFileStatus::kOk));
+  return path;
+}
+
+TEST(MsgFilePlayer, PlaysWholeFileInBlocks) {
+  constexpr int kNumMsgs = 5000;
+  const std::string path = writeRecording("whole.bmmsgs", kNumMsgs);
+
+  bmmidi::MsgFilePlayer player{bmmidi::MsgFilePlayerOptions{64, 2}};
+  ASSERT_THAT(player.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+
+  int numPlayed = 0;
+  bool isInOrder = true;
+  bool isOnTime = true;
+  for (int block = 0; !player.isFinished(); ++block) {
+    const double startTime = block * kBlockFrames / kSampleRate;
+    const double endTime = startTime + kBlockFrames / kSampleRate;
+    player.renderBlock(startTime, kBlockFrames, kSampleRate,
+                       [&](int frameOffset, const bmmidi::TimedMsgView& msg) {
+      const double timestamp = msg.timestamp();
+      isInOrder = isInOrder && (msg.value().rawBytes()[1] == numPlayed % 128);
+      // Never early; exact frame unless late (after an underrun).
+      const int expectedFrame = (timestamp < startTime)
+          ? 0 : static_cast<int>(std::floor((timestamp - startTime) * kSampleRate));
+      isOnTime = isOnTime && (timestamp < endTime) && (frameOffset == expectedFrame);
+      ++numPlayed;
+    });
+  }
+
+  EXPECT_THAT(numPlayed, Eq(kNumMsgs));
+  EXPECT_THAT(isInOrder, IsTrue());
+  EXPECT_THAT(isOnTime, IsTrue());
+  EXPECT_THAT(player.loadStatus(), Eq(bmmidi::MsgFileStatus::kEnd));
+}
+
+TEST(MsgFilePlayer, OnlyCountsUnderrunsWithDueMsgs) {
+  const std::string path = ::testing::TempDir() + "bmmidi_msg_file_player_sparse.bmmsgs";
+  {
+    bmmidi::MsgFileWriter writer;
+    ASSERT_THAT(writer.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+    const std::uint8_t bytes[] = {0x90, 0x3C, 100};
+    bmmidi::TimedMsgBuffer msgs;
+    msgs.push(0.0, bytes, 3);
+    msgs.push(10.0, bytes, 3);
+    ASSERT_THAT(writer.writeAll(msgs), Eq(bmmidi::MsgFileStatus::kOk));
+  }
+
+  // Whether or not the second chunk is loaded yet, its message isn't due.
+  bmmidi::MsgFilePlayer player{bmmidi::MsgFilePlayerOptions{1, 2}};
+  ASSERT_THAT(player.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  int numPlayed = 0;
+  for (int block = 0; block < 100; ++block) {
+    numPlayed += player.renderBlock(block * kBlockFrames / kSampleRate, kBlockFrames, kSampleRate,
+                                    [](int, const bmmidi::TimedMsgView&) {});
+  }
+  EXPECT_THAT(numPlayed, Eq(1));
+  EXPECT_THAT(player.numUnderruns(), Eq(0));
+}
+
+TEST(MsgFilePlayer, DeliversLateAfterUnderruns) {
+  constexpr int kNumMsgs = 200;
+  const std::string path = writeRecording("underrun.bmmsgs", kNumMsgs);
+
+  // One message per chunk, with every message due in the first block, so the
+  // loader can't keep up.
+  bmmidi::MsgFilePlayer player{bmmidi::MsgFilePlayerOptions{1, 2}};
+  ASSERT_THAT(player.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  const double firstStart = kNumMsgs * 0.00037;
+  const int numFirstPlayed = player.renderBlock(firstStart, kBlockFrames, kSampleRate,
+                                                [](int, const bmmidi::TimedMsgView&) {});
+  EXPECT_THAT(numFirstPlayed, Lt(kNumMsgs));
+  EXPECT_THAT(player.numUnderruns(), Ge(1));
+
+  int numPlayed = numFirstPlayed;
+  bool isInOrder = true;
+  bool isAtBlockStart = true;
+  for (int block = 1; !player.isFinished(); ++block) {
+    player.renderBlock(firstStart + block * kBlockFrames / kSampleRate, kBlockFrames, kSampleRate,
+                       [&](int frameOffset, const bmmidi::TimedMsgView& msg) {
+      isInOrder = isInOrder && (msg.value().rawBytes()[1] == numPlayed % 128);
+      isAtBlockStart = isAtBlockStart && (frameOffset == 0);  // Late.
+      ++numPlayed;
+    });
+    std::this_thread::yield();
+  }
+  EXPECT_THAT(numPlayed, Eq(kNumMsgs));
+  EXPECT_THAT(isInOrder, IsTrue());
+  EXPECT_THAT(isAtBlockStart, IsTrue());
+}
+
+TEST(MsgFilePlayer, ReopensForAnotherPass) {
+  const std::string path = writeRecording("reopen.bmmsgs", 100);
+  bmmidi::MsgFilePlayer player{bmmidi::MsgFilePlayerOptions{16, 3}};
+  for (int pass = 0; pass < 2; ++pass) {
+    ASSERT_THAT(player.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+    int numPlayed = 0;
+    while (!player.isFinished()) {
+      numPlayed += player.renderBlock(0.0, kBlockFrames, 1.0,
+                                      [](int, const bmmidi::TimedMsgView&) {});
+    }
+    EXPECT_THAT(numPlayed, Eq(100));
+  }
+}
+
+TEST(MsgFilePlayer, ReportsOpenFailures) {
+  bmmidi::MsgFilePlayer player;
+  EXPECT_THAT(player.open(::testing::TempDir() + "bmmidi_msg_file_player_missing"),
+              Eq(bmmidi::MsgFileStatus::kOpenFailed));
+  EXPECT_THAT(player.isFinished(), IsTrue());
+}
+
+}  // namespace
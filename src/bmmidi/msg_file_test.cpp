@@ -0,0 +1,150 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_file.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+
+using Bytes = std::vector<std::uint8_t>;
+
+std::string tempPath(const std::string& name) {
+  return ::testing::TempDir() + "bmmidi_msg_file_" + name;
+}
+
+bmmidi::TimedMsgBuffer makeMsgs() {
+  bmmidi::TimedMsgBuffer msgs;
+  const Bytes noteOn = {0x90, 60, 100};
+  const Bytes sysEx = {0xF0, 0x7D, 1, 2, 3, 0xF7};
+  const Bytes clock = {0xF8};
+  msgs.push(0.0, noteOn.data(), 3);
+  msgs.push(0.5, sysEx.data(), 6);
+  msgs.push(0.5, clock.data(), 1);
+  msgs.push(1234.25, noteOn.data(), 3);
+  return msgs;
+}
+
+Bytes readFile(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  return Bytes{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+void writeFile(const std::string& path, const Bytes& bytes) {
+  std::ofstream file{path, std::ios::binary};
+  file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+Bytes msgBytes(const bmmidi::TimedMsgBuffer& msgs) {
+  return Bytes(msgs.rawBytes(), msgs.rawBytes() + msgs.numBytes());
+}
+
+std::vector<double> timestamps(const bmmidi::TimedMsgBuffer& msgs) {
+  return std::vector<double>(msgs.rawTimestamps(), msgs.rawTimestamps() + msgs.size());
+}
+
+TEST(MsgFile, RoundTripsMsgsInChunks) {
+  const std::string path = tempPath("round_trip.bmmsgs");
+  const bmmidi::TimedMsgBuffer msgs = makeMsgs();
+  bmmidi::MsgFileWriter writer;
+  ASSERT_THAT(writer.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.writeAll(msgs), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.close(), Eq(bmmidi::MsgFileStatus::kOk));
+
+  bmmidi::MsgFileReader reader;
+  ASSERT_THAT(reader.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  bmmidi::TimedMsgBuffer read;
+  EXPECT_THAT(reader.read(read, 3), Eq(bmmidi::MsgFileStatus::kOk));
+  EXPECT_THAT(read.size(), Eq(3));
+  EXPECT_THAT(reader.read(read, 3), Eq(bmmidi::MsgFileStatus::kEnd));
+  EXPECT_THAT(timestamps(read), ElementsAreArray(timestamps(msgs)));
+  EXPECT_THAT(msgBytes(read), ElementsAreArray(msgBytes(msgs)));
+}
+
+TEST(MsgFile, ReportsEndAfterExactlyFullChunk) {
+  const std::string path = tempPath("exact.bmmsgs");
+  bmmidi::MsgFileWriter writer;
+  ASSERT_THAT(writer.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.writeAll(makeMsgs()), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.close(), Eq(bmmidi::MsgFileStatus::kOk));
+
+  bmmidi::MsgFileReader reader;
+  ASSERT_THAT(reader.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  bmmidi::TimedMsgBuffer read;
+  EXPECT_THAT(reader.read(read, 4), Eq(bmmidi::MsgFileStatus::kEnd));
+  EXPECT_THAT(read.size(), Eq(4));
+}
+
+TEST(MsgFile, DetectsInvalidFiles) {
+  bmmidi::MsgFileReader reader;
+  EXPECT_THAT(reader.open(tempPath("missing.bmmsgs")), Eq(bmmidi::MsgFileStatus::kOpenFailed));
+
+  const std::string notMsgFile = tempPath("not_msg_file.mid");
+  writeFile(notMsgFile, {'M', 'T', 'h', 'd', 0, 0, 0, 6});
+  EXPECT_THAT(reader.open(notMsgFile), Eq(bmmidi::MsgFileStatus::kNotMsgFile));
+
+  const std::string path = tempPath("truncated.bmmsgs");
+  bmmidi::MsgFileWriter writer;
+  ASSERT_THAT(writer.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.writeAll(makeMsgs()), Eq(bmmidi::MsgFileStatus::kOk));
+  ASSERT_THAT(writer.close(), Eq(bmmidi::MsgFileStatus::kOk));
+  Bytes bytes = readFile(path);
+  bytes.pop_back();
+  writeFile(path, bytes);
+
+  ASSERT_THAT(reader.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  bmmidi::TimedMsgBuffer read;
+  EXPECT_THAT(reader.read(read, 10), Eq(bmmidi::MsgFileStatus::kTruncated));
+  EXPECT_THAT(timestamps(read), ElementsAre(0.0, 0.5, 0.5));
+
+  // Data byte where the message should start.
+  bytes = readFile(path);
+  bytes[bmmidi::kMsgFileHeaderBytes + bmmidi::kMsgFileRecordHeaderBytes] = 0x3C;
+  writeFile(path, bytes);
+  ASSERT_THAT(reader.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+  read.clear();
+  EXPECT_THAT(reader.read(read, 10), Eq(bmmidi::MsgFileStatus::kInvalidRecord));
+  EXPECT_THAT(read.size(), Eq(0));
+}
+
+TEST(MsgFile, RejectsMalformedRecords) {
+  const std::string path = tempPath("malformed.bmmsgs");
+  const Bytes malformedMsgs[] = {
+      {0x90, 0x3C},              // Missing data byte.
+      {0x90, 0x3C, 0x40, 0x00},  // Extra data byte.
+      {0x90, 0xBC, 0x40},        // Status byte where a data byte should be.
+      {0xF0, 0x7D, 0x01, 0x02},  // SysEx without EOX.
+      {0xF0, 0xF7},              // SysEx without ID.
+  };
+
+  for (const Bytes& msg : malformedMsgs) {
+    // Timestamp 0.0, then little-endian # of bytes.
+    Bytes bytes = {'B', 'M', 'M', 's', 'g', 's', 0x00, 0x01, 0, 0, 0, 0, 0, 0, 0, 0};
+    bytes.push_back(static_cast<std::uint8_t>(msg.size()));
+    bytes.insert(bytes.end(), 3, 0);
+    bytes.insert(bytes.end(), msg.begin(), msg.end());
+    writeFile(path, bytes);
+
+    bmmidi::MsgFileReader reader;
+    ASSERT_THAT(reader.open(path), Eq(bmmidi::MsgFileStatus::kOk));
+    bmmidi::TimedMsgBuffer read;
+    EXPECT_THAT(reader.read(read, 10), Eq(bmmidi::MsgFileStatus::kInvalidRecord));
+    EXPECT_THAT(read.size(), Eq(0));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,426 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_PIPELINE_HPP
+#define BMMIDI_MSG_PIPELINE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/key_transform.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+// Compile-time composed message pipelines.
+//
+// Example (transposes notes up an octave and swaps channels 1 and 2, dropping
+// all other messages):
+//
+//   bmmidi::ChannelMap channelMap;
+//   channelMap.set(bmmidi::Channel::index(0), bmmidi::Channel::index(1));
+//   channelMap.set(bmmidi::Channel::index(1), bmmidi::Channel::index(0));
+//   const int numOut = bmmidi::msgsFrom(in)
+//       | bmmidi::filterType<bmmidi::MsgType::kNoteOn, bmmidi::MsgType::kNoteOff>()
+//       | bmmidi::transpose(12)
+//       | bmmidi::remapChannels(channelMap)
+//       | bmmidi::appendTo(out);
+//
+// Connecting a sink runs the pipeline: all stages are inlined into one loop
+// over the source buffer, with no virtual calls and no intermediate buffers.
+// Each stage also knows, at compile time, the set of message types that can
+// reach it (see PipeMsg), so e.g. transpose() after filterType() doesn't
+// recheck message types. Stages can be composed ahead of time (stage | stage)
+// and reused with different sources and sinks.
+
+/** Bitmask of all message types that can flow through a pipeline. */
+BMMIDI_INLINE_VAR static constexpr std::uint32_t kAllMsgTypeBits = 0x00FFFF7F;
+
+/** Bitmask of the Channel message types (see msgTypeBit()). */
+BMMIDI_INLINE_VAR static constexpr std::uint32_t kChanMsgTypeBits = 0x0000007F;
+
+/** Bitmask of Note Off, Note On, and Polyphonic Key Pressure types. */
+BMMIDI_INLINE_VAR static constexpr std::uint32_t kKeyMsgTypeBits = 0x00000007;
+
+/**
+ * Returns pipeline type bit for message type (bits [0, 6] for Channel message
+ * types, and bits [8, 23] for System message types).
+ */
+inline constexpr std::uint32_t msgTypeBit(MsgType type) {
+  return (static_cast<std::uint8_t>(type) < 0xF0)
+      ? (std::uint32_t{0x01} << ((static_cast<std::uint8_t>(type) >> 4) - 0x08))
+      : (std::uint32_t{0x01} << (8 + (static_cast<std::uint8_t>(type) & 0x0F)));
+}
+
+/** Returns pipeline type bit of a message with the given status byte. */
+inline constexpr std::uint32_t statusTypeBit(std::uint8_t status) {
+  return (status < 0xF0) ? (std::uint32_t{0x01} << ((status >> 4) - 0x08))
+                         : (std::uint32_t{0x01} << (8 + (status & 0x0F)));
+}
+
+/** Returns bitwise-OR of msgTypeBit() of each of the given types. */
+template<MsgType kFirst, MsgType... kRest>
+constexpr std::uint32_t msgTypeBits() {
+  const MsgType types[] = {kFirst, kRest...};
+  std::uint32_t bits = 0;
+  for (const MsgType type : types) { bits |= msgTypeBit(type); }
+  return bits;
+}
+
+/**
+ * Message passed between pipeline stages, whose type is statically known to
+ * be one of kTypeBits (a bitmask of msgTypeBit() values). Its bytes are only
+ * valid during the stage call that receives it.
+ */
+template<std::uint32_t kTypeBits>
+struct PipeMsg {
+  double timestamp;
+  const std::uint8_t* bytes;
+  int numBytes;
+
+  /** Returns this message's status byte. */
+  std::uint8_t status() const { return bytes[0]; }
+
+  /** Returns this message as a (validated) TimedMsgView. */
+  TimedMsgView view() const { return TimedMsgView{timestamp, bytes, numBytes}; }
+
+  /** Returns this message, known to be one of kNarrowerBits types. */
+  template<std::uint32_t kNarrowerBits>
+  PipeMsg<kNarrowerBits> as() const {
+    static_assert((kNarrowerBits & ~kTypeBits) == 0, "Can only narrow message types");
+    return PipeMsg<kNarrowerBits>{timestamp, bytes, numBytes};
+  }
+};
+
+/**
+ * Base class of pipeline stages. Each stage must define:
+ *
+ *   template<std::uint32_t kTypes, typename Next>
+ *   void operator()(const PipeMsg<kTypes>& msg, const Next& next) const;
+ *
+ * which calls next(pipeMsg) for each message (if any) it outputs for msg.
+ */
+struct MsgPipeStage {};
+
+/**
+ * Base class of pipeline sinks. Each sink must define:
+ *
+ *   template<std::uint32_t kTypes>
+ *   void operator()(const PipeMsg<kTypes>& msg) const;
+ */
+struct MsgPipeSink {};
+
+template<typename T>
+struct IsMsgPipeStage : std::is_base_of<MsgPipeStage, T> {};
+
+template<typename T>
+struct IsMsgPipeSink : std::is_base_of<MsgPipeSink, T> {};
+
+//==============================================================================
+// Stages
+//==============================================================================
+
+/** Stage that outputs each message unchanged. */
+class PassStage : public MsgPipeStage {
+public:
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    next(msg);
+  }
+};
+
+/** Stage running stage First, then stage Second on each of its outputs. */
+template<typename First, typename Second>
+class StageChain : public MsgPipeStage {
+public:
+  StageChain(First first, Second second) : first_{std::move(first)}, second_{std::move(second)} {}
+
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    first_(msg, [this, &next](const auto& firstOut) { second_(firstOut, next); });
+  }
+
+private:
+  First first_;
+  Second second_;
+};
+
+/** Stage that keeps only messages of types in kKeepBits; see filterType(). */
+template<std::uint32_t kKeepBits>
+class TypeFilterStage : public MsgPipeStage {
+public:
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    constexpr std::uint32_t kOutTypes = kTypes & kKeepBits;
+    constexpr bool kMayDrop = (kTypes & ~kKeepBits) != 0;
+    if ((kOutTypes == 0) || (kMayDrop && ((statusTypeBit(msg.status()) & kKeepBits) == 0))) {
+      return;
+    }
+    next(msg.template as<kOutTypes>());
+  }
+};
+
+/** Keeps only messages of the given types (dropping all others). */
+template<MsgType kFirst, MsgType... kRest>
+TypeFilterStage<msgTypeBits<kFirst, kRest...>()> filterType() {
+  return {};
+}
+
+/** Stage that keeps messages matching a predicate; see filterMsgs(). */
+template<typename Pred>
+class PredicateFilterStage : public MsgPipeStage {
+public:
+  explicit PredicateFilterStage(Pred pred) : pred_{std::move(pred)} {}
+
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    if (pred_(msg.view())) { next(msg); }
+  }
+
+private:
+  Pred pred_;
+};
+
+/** Keeps only messages for which pred(const TimedMsgView&) returns true. */
+template<typename Pred>
+PredicateFilterStage<std::decay_t<Pred>> filterMsgs(Pred&& pred) {
+  return PredicateFilterStage<std::decay_t<Pred>>{std::forward<Pred>(pred)};
+}
+
+/** Stage that transposes key messages; see transpose(). */
+class TransposeStage : public MsgPipeStage {
+public:
+  TransposeStage(int semitones, KeyOutOfRange outOfRange)
+      : semitones_{semitones}, outOfRange_{outOfRange} {
+    assert((-kMaxKey <= semitones) && (semitones <= kMaxKey));
+  }
+
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    constexpr std::uint32_t kKeyTypes = kTypes & kKeyMsgTypeBits;
+    constexpr std::uint32_t kOtherTypes = kTypes & ~kKeyMsgTypeBits;
+    if ((kKeyTypes == 0)
+        || ((kOtherTypes != 0) && ((statusTypeBit(msg.status()) & kKeyMsgTypeBits) == 0))) {
+      next(msg.template as<kOtherTypes>());
+      return;
+    }
+
+    int key = msg.bytes[1] + semitones_;
+    if ((key < 0) || (key > kMaxKey)) {
+      switch (outOfRange_) {
+        case KeyOutOfRange::kClamp:
+          key = (key < 0) ? 0 : kMaxKey;
+          break;
+
+        case KeyOutOfRange::kDrop:
+          return;
+
+        case KeyOutOfRange::kWrapOctave:
+          while (key < 0) { key += 12; }
+          while (key > kMaxKey) { key -= 12; }
+          break;
+      }
+    }
+    const std::uint8_t bytes[3] = {msg.bytes[0], static_cast<std::uint8_t>(key), msg.bytes[2]};
+    next(PipeMsg<kKeyTypes>{msg.timestamp, bytes, 3});
+  }
+
+private:
+  static constexpr int kMaxKey = 127;
+
+  int semitones_;
+  KeyOutOfRange outOfRange_;
+};
+
+/**
+ * Transposes the keys of Note On/Off and Polyphonic Key Pressure messages by
+ * semitones, in [-127, 127] (passing other messages through unchanged).
+ */
+inline TransposeStage transpose(int semitones,
+                                KeyOutOfRange outOfRange = KeyOutOfRange::kDrop) {
+  return TransposeStage{semitones, outOfRange};
+}
+
+/**
+ * Table mapping each input channel to an output channel (or to
+ * Channel::none(), to drop messages on that channel). Starts as the identity
+ * map.
+ */
+class ChannelMap {
+public:
+  ChannelMap() {
+    for (int i = 0; i < kNumChannels; ++i) { table_[i] = static_cast<std::uint8_t>(i); }
+  }
+
+  /** Maps input channel from to output channel to, or drops it if to is none(). */
+  void set(Channel from, Channel to) {
+    assert(to.isNormal() || to.isNone());
+    table_[from.index()] = to.isNone() ? kDropped : static_cast<std::uint8_t>(to.index());
+  }
+
+  /** Returns output channel for input channel from (possibly none()). */
+  Channel get(Channel from) const {
+    const std::uint8_t to = table_[from.index()];
+    return (to == kDropped) ? Channel::none() : Channel::index(to);
+  }
+
+  /** Returns 16-entry table of output channel indices, with 0xFF for dropped channels. */
+  const std::uint8_t* rawTable() const { return table_; }
+
+private:
+  static constexpr std::uint8_t kDropped = 0xFF;
+
+  std::uint8_t table_[kNumChannels];
+};
+
+/** Stage that moves Channel messages to other channels; see remapChannels(). */
+class ChannelRemapStage : public MsgPipeStage {
+public:
+  explicit ChannelRemapStage(const ChannelMap& channelMap) : channelMap_{channelMap} {}
+
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const PipeMsg<kTypes>& msg, const Next& next) const {
+    constexpr std::uint32_t kChanTypes = kTypes & kChanMsgTypeBits;
+    constexpr std::uint32_t kOtherTypes = kTypes & ~kChanMsgTypeBits;
+    if ((kChanTypes == 0) || ((kOtherTypes != 0) && (msg.status() >= 0xF0))) {
+      next(msg.template as<kOtherTypes>());
+      return;
+    }
+
+    const std::uint8_t to = channelMap_.rawTable()[msg.status() & 0x0F];
+    if (to == 0xFF) { return; }
+    const std::uint8_t bytes[3] = {
+        static_cast<std::uint8_t>((msg.status() & 0xF0) | to), msg.bytes[1],
+        (msg.numBytes > 2) ? msg.bytes[2] : std::uint8_t{0}};
+    next(PipeMsg<kChanTypes>{msg.timestamp, bytes, msg.numBytes});
+  }
+
+private:
+  ChannelMap channelMap_;
+};
+
+/** Moves Channel messages via channelMap (passing System messages through). */
+inline ChannelRemapStage remapChannels(const ChannelMap& channelMap) {
+  return ChannelRemapStage{channelMap};
+}
+
+//==============================================================================
+// Sinks
+//==============================================================================
+
+/** Sink that appends messages to a TimedMsgBuffer; see appendTo(). */
+class AppendSink : public MsgPipeSink {
+public:
+  explicit AppendSink(TimedMsgBuffer& out) : out_{&out} {}
+
+  template<std::uint32_t kTypes>
+  void operator()(const PipeMsg<kTypes>& msg) const {
+    out_->push(msg.timestamp, msg.bytes, msg.numBytes);
+  }
+
+private:
+  TimedMsgBuffer* out_;
+};
+
+/** Appends output messages to out. */
+inline AppendSink appendTo(TimedMsgBuffer& out) { return AppendSink{out}; }
+
+/** Sink that calls a function for each message; see forEachMsg(). */
+template<typename Fn>
+class ForEachSink : public MsgPipeSink {
+public:
+  explicit ForEachSink(Fn fn) : fn_{std::move(fn)} {}
+
+  template<std::uint32_t kTypes>
+  void operator()(const PipeMsg<kTypes>& msg) const {
+    fn_(msg.view());
+  }
+
+private:
+  Fn fn_;
+};
+
+/**
+ * Calls fn(const TimedMsgView&) for each output message (valid only during
+ * the call).
+ */
+template<typename Fn>
+ForEachSink<std::decay_t<Fn>> forEachMsg(Fn&& fn) {
+  return ForEachSink<std::decay_t<Fn>>{std::forward<Fn>(fn)};
+}
+
+//==============================================================================
+// Sources and composition
+//==============================================================================
+
+/** Messages of a TimedMsgBuffer flowing through Stage; see msgsFrom(). */
+template<typename Stage>
+class MsgPipeSource {
+public:
+  MsgPipeSource(const TimedMsgBuffer& msgs, Stage stage) : msgs_{&msgs}, stage_{std::move(stage)} {}
+
+  /** Runs all source messages through the pipeline into sink, returning # output. */
+  template<typename Sink>
+  int runInto(const Sink& sink) const {
+    int numOut = 0;
+    const auto countedSink = [&sink, &numOut](const auto& msg) {
+      ++numOut;
+      sink(msg);
+    };
+
+    const double* timestamps = msgs_->rawTimestamps();
+    const int* offsets = msgs_->rawOffsets();
+    const std::uint8_t* bytes = msgs_->rawBytes();
+    const int numMsgs = msgs_->size();
+    for (int i = 0; i < numMsgs; ++i) {
+      const PipeMsg<kAllMsgTypeBits> msg = {timestamps[i], &bytes[offsets[i]],
+                                            offsets[i + 1] - offsets[i]};
+      stage_(msg, countedSink);
+    }
+    return numOut;
+  }
+
+  const TimedMsgBuffer& msgs() const { return *msgs_; }
+  const Stage& stage() const { return stage_; }
+
+private:
+  const TimedMsgBuffer* msgs_;
+  Stage stage_;
+};
+
+/** Starts a pipeline reading msgs (which must outlive it). */
+inline MsgPipeSource<PassStage> msgsFrom(const TimedMsgBuffer& msgs) {
+  return MsgPipeSource<PassStage>{msgs, PassStage{}};
+}
+
+/** Composes two stages into one. */
+template<typename First, typename Second,
+         typename = std::enable_if_t<IsMsgPipeStage<First>::value
+                                     && IsMsgPipeStage<Second>::value>>
+StageChain<First, Second> operator|(First first, Second second) {
+  return StageChain<First, Second>{std::move(first), std::move(second)};
+}
+
+/** Appends stage to the end of a pipeline. */
+template<typename Stage, typename Next, typename = std::enable_if_t<IsMsgPipeStage<Next>::value>>
+MsgPipeSource<StageChain<Stage, Next>> operator|(const MsgPipeSource<Stage>& source, Next next) {
+  return MsgPipeSource<StageChain<Stage, Next>>{
+      source.msgs(), StageChain<Stage, Next>{source.stage(), std::move(next)}};
+}
+
+/** Runs a pipeline into sink, returning the # of messages output. */
+template<typename Stage, typename Sink, typename = std::enable_if_t<IsMsgPipeSink<Sink>::value>>
+int operator|(const MsgPipeSource<Stage>& source, const Sink& sink) {
+  return source.runInto(sink);
+}
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_PIPELINE_HPP
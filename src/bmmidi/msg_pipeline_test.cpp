@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_pipeline.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/key_transform.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+using Bytes = std::vector<std::uint8_t>;
+
+bmmidi::TimedMsgBuffer bufferOf(const std::vector<Bytes>& msgs) {
+  bmmidi::TimedMsgBuffer buffer;
+  for (const Bytes& msg : msgs) {
+    buffer.push(buffer.size(), msg.data(), static_cast<int>(msg.size()));
+  }
+  return buffer;
+}
+
+std::vector<Bytes> msgBytes(const bmmidi::TimedMsgBuffer& msgs) {
+  std::vector<Bytes> result;
+  for (const bmmidi::TimedMsgView msg : msgs) {
+    const bmmidi::MsgView view = msg.value();
+    result.emplace_back(view.rawBytes(), view.rawBytes() + view.numBytes());
+  }
+  return result;
+}
+
+// Custom stage that records the statically known types of each message.
+class RecordTypes : public bmmidi::MsgPipeStage {
+public:
+  explicit RecordTypes(std::vector<std::uint32_t>* types) : types_{types} {}
+
+  template<std::uint32_t kTypes, typename Next>
+  void operator()(const bmmidi::PipeMsg<kTypes>& msg, const Next& next) const {
+    types_->push_back(kTypes);
+    next(msg);
+  }
+
+private:
+  std::vector<std::uint32_t>* types_;
+};
+
+TEST(MsgPipeline, ComputesTypeBits) {
+  EXPECT_THAT(bmmidi::msgTypeBit(bmmidi::MsgType::kNoteOff), Eq(0x01u));
+  EXPECT_THAT(bmmidi::msgTypeBit(bmmidi::MsgType::kPitchBend), Eq(0x40u));
+  EXPECT_THAT(bmmidi::msgTypeBit(bmmidi::MsgType::kSystemExclusive), Eq(0x0100u));
+  EXPECT_THAT(bmmidi::msgTypeBit(bmmidi::MsgType::kSystemReset), Eq(0x800000u));
+  EXPECT_THAT(bmmidi::statusTypeBit(0x9F), Eq(0x02u));
+  EXPECT_THAT(bmmidi::statusTypeBit(0xF8), Eq(0x010000u));
+
+  constexpr std::uint32_t kNoteBits =
+      bmmidi::msgTypeBits<bmmidi::MsgType::kNoteOn, bmmidi::MsgType::kNoteOff>();
+  static_assert(kNoteBits == 0x03, "Note On and Off are bits 0 and 1");
+}
+
+TEST(MsgPipeline, FusesStages) {
+  const auto in = bufferOf({
+      {0x90, 60, 100},        // Note On ch 1.
+      {0xB0, 7, 100},         // CC (dropped).
+      {0x81, 60, 0},          // Note Off ch 2.
+      {0xF8},                 // Clock (dropped).
+      {0x92, 120, 100},       // Note On ch 3, out of range after transposing.
+      {0xF0, 0x7D, 1, 0xF7},  // SysEx (dropped).
+      {0x93, 64, 100},        // Note On ch 4 (dropped by channel map).
+  });
+
+  bmmidi::ChannelMap channelMap;
+  channelMap.set(bmmidi::Channel::index(0), bmmidi::Channel::index(1));
+  channelMap.set(bmmidi::Channel::index(1), bmmidi::Channel::index(0));
+  channelMap.set(bmmidi::Channel::index(3), bmmidi::Channel::none());
+
+  bmmidi::TimedMsgBuffer out;
+  const int numOut = bmmidi::msgsFrom(in)
+      | bmmidi::filterType<bmmidi::MsgType::kNoteOn, bmmidi::MsgType::kNoteOff>()
+      | bmmidi::transpose(12)
+      | bmmidi::remapChannels(channelMap)
+      | bmmidi::appendTo(out);
+
+  EXPECT_THAT(numOut, Eq(2));
+  EXPECT_THAT(msgBytes(out), ElementsAre(ElementsAre(0x91, 72, 100), ElementsAre(0x80, 72, 0)));
+  EXPECT_THAT(out.timestampAt(0), Eq(0.0));
+  EXPECT_THAT(out.timestampAt(1), Eq(2.0));
+}
+
+TEST(MsgPipeline, PassesThroughOtherTypes) {
+  const auto in = bufferOf({
+      {0xA5, 127, 30},
+      {0xC5, 3},
+      {0xF0, 0x7D, 1, 2, 3, 0xF7},
+      {0xFA},
+      {0x95, 0, 100},
+  });
+
+  bmmidi::ChannelMap channelMap;
+  channelMap.set(bmmidi::Channel::index(5), bmmidi::Channel::index(9));
+
+  bmmidi::TimedMsgBuffer out;
+  const int numOut = bmmidi::msgsFrom(in)
+      | bmmidi::transpose(-3, bmmidi::KeyOutOfRange::kWrapOctave)
+      | bmmidi::remapChannels(channelMap)
+      | bmmidi::appendTo(out);
+
+  EXPECT_THAT(numOut, Eq(5));
+  EXPECT_THAT(msgBytes(out),
+              ElementsAre(ElementsAre(0xA9, 124, 30), ElementsAre(0xC9, 3),
+                          ElementsAre(0xF0, 0x7D, 1, 2, 3, 0xF7), ElementsAre(0xFA),
+                          ElementsAre(0x99, 9, 100)));
+}
+
+TEST(MsgPipeline, ClampsTransposedKeys) {
+  const auto in = bufferOf({{0x90, 2, 100}, {0x80, 126, 0}});
+
+  bmmidi::TimedMsgBuffer down;
+  bmmidi::msgsFrom(in) | bmmidi::transpose(-5, bmmidi::KeyOutOfRange::kClamp)
+      | bmmidi::appendTo(down);
+  EXPECT_THAT(msgBytes(down), ElementsAre(ElementsAre(0x90, 0, 100), ElementsAre(0x80, 121, 0)));
+
+  bmmidi::TimedMsgBuffer up;
+  bmmidi::msgsFrom(in) | bmmidi::transpose(5) | bmmidi::appendTo(up);
+  EXPECT_THAT(msgBytes(up), ElementsAre(ElementsAre(0x90, 7, 100)));
+}
+
+TEST(MsgPipeline, NarrowsTypesStatically) {
+  const auto in = bufferOf({{0x90, 60, 100}, {0xF8}, {0xA0, 60, 10}, {0xB0, 1, 2}});
+
+  std::vector<std::uint32_t> afterFilter;
+  std::vector<std::uint32_t> afterTranspose;
+  const auto stages = bmmidi::filterType<bmmidi::MsgType::kNoteOn, bmmidi::MsgType::kTimingClock,
+                                         bmmidi::MsgType::kPolyphonicKeyPressure>()
+      | RecordTypes{&afterFilter} | bmmidi::transpose(1) | RecordTypes{&afterTranspose};
+
+  std::vector<double> timestamps;
+  const int numOut = bmmidi::msgsFrom(in) | stages
+      | bmmidi::forEachMsg([&timestamps](const bmmidi::TimedMsgView& msg) {
+          timestamps.push_back(msg.timestamp());
+        });
+
+  EXPECT_THAT(numOut, Eq(3));
+  EXPECT_THAT(timestamps, ElementsAre(0.0, 1.0, 2.0));
+
+  const std::uint32_t kFiltered = 0x010006;
+  EXPECT_THAT(afterFilter, ElementsAre(kFiltered, kFiltered, kFiltered));
+  EXPECT_THAT(afterTranspose, ElementsAre(0x000006u, 0x010000u, 0x000006u));
+}
+
+TEST(MsgPipeline, FiltersWithPredicates) {
+  const auto in = bufferOf({{0x90, 60, 100}, {0x90, 61, 20}, {0x80, 60, 0}});
+
+  bmmidi::TimedMsgBuffer out;
+  bmmidi::msgsFrom(in) | bmmidi::filterMsgs([](const bmmidi::TimedMsgView& msg) {
+    return msg.value().rawBytes()[2] >= 64;
+  }) | bmmidi::appendTo(out);
+  EXPECT_THAT(msgBytes(out), ElementsAre(ElementsAre(0x90, 60, 100)));
+}
+
+}  // namespace
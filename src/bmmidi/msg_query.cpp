@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_query.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "bmmidi/msg_block_index.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+  #define BMMIDI_QUERY_USE_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+namespace bmmidi {
+namespace {
+
+constexpr std::uint8_t kChannelStatusMask = 0xF0;
+constexpr std::uint8_t kFullByteMask = 0xFF;
+
+// ORs the low 16 bits of bits into selection words at row index.
+void orBits16(std::vector<std::uint64_t>& words, int index, std::uint64_t bits) {
+  const int shift = index % 64;
+  words[index / 64] |= (bits << shift);
+  if ((shift > 48) && ((bits >> (64 - shift)) != 0)) {
+    words[index / 64 + 1] |= (bits >> (64 - shift));
+  }
+}
+
+}  // namespace
+
+MsgQuery& MsgQuery::ofType(MsgType type) {
+  const auto value = static_cast<std::uint8_t>(type);
+  const bool isChannelType = (value < static_cast<std::uint8_t>(MsgType::kSystemExclusive));
+  addPredicate(MsgColumn::kStatus, isChannelType ? kChannelStatusMask : kFullByteMask,
+               value, value);
+  return *this;
+}
+
+MsgQuery& MsgQuery::onChannels(Channel first, Channel last) {
+  assert(first.isNormal() && last.isNormal());
+  addPredicate(MsgColumn::kStatus, kFullByteMask,
+               static_cast<std::uint8_t>(MsgType::kNoteOff), 0xEF);
+  addPredicate(MsgColumn::kChannel, kFullByteMask,
+               static_cast<std::uint8_t>(first.index()), static_cast<std::uint8_t>(last.index()));
+  return *this;
+}
+
+MsgQuery& MsgQuery::withKeys(KeyNumber first, KeyNumber last) {
+  assert(first.isNormal() && last.isNormal());
+  addPredicate(MsgColumn::kStatus, kChannelStatusMask,
+               static_cast<std::uint8_t>(MsgType::kNoteOff),
+               static_cast<std::uint8_t>(MsgType::kPolyphonicKeyPressure));
+  addPredicate(MsgColumn::kData1, kFullByteMask,
+               static_cast<std::uint8_t>(first.value()), static_cast<std::uint8_t>(last.value()));
+  return *this;
+}
+
+MsgQuery& MsgQuery::withControls(Control first, Control last) {
+  const auto type = static_cast<std::uint8_t>(MsgType::kControlChange);
+  addPredicate(MsgColumn::kStatus, kChannelStatusMask, type, type);
+  addPredicate(MsgColumn::kData1, kFullByteMask,
+               static_cast<std::uint8_t>(first), static_cast<std::uint8_t>(last));
+  return *this;
+}
+
+MsgQuery& MsgQuery::during(double startTime, double endTime) {
+  assert(startTime <= endTime);
+  startTime_ = startTime;
+  endTime_ = endTime;
+  return *this;
+}
+
+MsgRowRange MsgQuery::rowRange(const TimedMsgColumns& columns) const {
+  const double* begin = columns.timestamps();
+  const double* end = begin + columns.size();
+  const double* first = std::lower_bound(begin, end, startTime_);
+  const double* last = std::lower_bound(first, end, endTime_);
+  return MsgRowRange{static_cast<int>(first - begin), static_cast<int>(last - begin)};
+}
+
+MsgSelection MsgQuery::select(const TimedMsgColumns& columns) const {
+  MsgSelection selection{columns.size()};
+  selectRows(columns, rowRange(columns), selection.words());
+  return selection;
+}
+
+MsgSelection MsgQuery::select(const TimedMsgColumns& columns, const MsgBlockIndex& index) const {
+  assert(index.numRows() == columns.size());
+  MsgSelection selection{columns.size()};
+  const MsgRowRange range = rowRange(columns);
+  if (range.first == range.last) { return selection; }
+
+  const BlockFilter filter = blockFilter();
+  const int lastBlock = (range.last - 1) / index.blockRows();
+  for (int b = range.first / index.blockRows(); b <= lastBlock; ++b) {
+    if (!filter.matches(index.block(b))) { continue; }
+    const MsgRowRange blockRange = index.blockRowRange(b);
+    selectRows(columns,
+               MsgRowRange{std::max(range.first, blockRange.first),
+                           std::min(range.last, blockRange.last)},
+               selection.words());
+  }
+  return selection;
+}
+
+bool MsgQuery::mayMatch(const MsgBlockSummary& block) const {
+  return blockFilter().matches(block);
+}
+
+void MsgQuery::selectRows(const TimedMsgColumns& columns, MsgRowRange range,
+                          std::vector<std::uint64_t>& words) const {
+  const std::uint8_t* columnBytes[] = {
+      columns.statuses(), columns.channels(), columns.data1s(), columns.data2s()};
+
+  int i = range.first;
+
+#ifdef BMMIDI_QUERY_USE_SSE2
+  // Unsigned byte range test: (min <= x) == (max(x, min) == x), and
+  // (x <= max) == (min(x, max) == x).
+  __m128i masks[kMaxPredicates];
+  __m128i mins[kMaxPredicates];
+  __m128i maxes[kMaxPredicates];
+  for (int p = 0; p < numPredicates_; ++p) {
+    masks[p] = _mm_set1_epi8(static_cast<char>(predicates_[p].mask));
+    mins[p] = _mm_set1_epi8(static_cast<char>(predicates_[p].min));
+    maxes[p] = _mm_set1_epi8(static_cast<char>(predicates_[p].max));
+  }
+
+  for (; i + 16 <= range.last; i += 16) {
+    __m128i match = _mm_set1_epi8(-1);
+    for (int p = 0; p < numPredicates_; ++p) {
+      const std::uint8_t* bytes = columnBytes[static_cast<int>(predicates_[p].column)] + i;
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+      x = _mm_and_si128(x, masks[p]);
+      const __m128i aboveMin = _mm_cmpeq_epi8(_mm_max_epu8(x, mins[p]), x);
+      const __m128i belowMax = _mm_cmpeq_epi8(_mm_min_epu8(x, maxes[p]), x);
+      match = _mm_and_si128(match, _mm_and_si128(aboveMin, belowMax));
+    }
+    const auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(match));
+    if (bits != 0) { orBits16(words, i, bits); }
+  }
+#endif
+
+  for (; i < range.last; ++i) {
+    bool isMatch = true;
+    for (int p = 0; isMatch && (p < numPredicates_); ++p) {
+      const BytePredicate& pred = predicates_[p];
+      const std::uint8_t x = columnBytes[static_cast<int>(pred.column)][i] & pred.mask;
+      isMatch = (pred.min <= x) && (x <= pred.max);
+    }
+    if (isMatch) { words[i / 64] |= (std::uint64_t{1} << (i % 64)); }
+  }
+}
+
+std::vector<std::int64_t> MsgQuery::histogram(
+    const TimedMsgColumns& columns, MsgColumn column) const {
+  const MsgSelection selection = select(columns);
+
+  switch (column) {
+    case MsgColumn::kStatus: {
+      std::vector<std::int64_t> bins(256, 0);
+      const std::uint8_t* statuses = columns.statuses();
+      selection.forEach([&](int i) { ++bins[statuses[i]]; });
+      return bins;
+    }
+
+    case MsgColumn::kChannel: {
+      std::vector<std::int64_t> bins(kNumChannels, 0);
+      const std::uint8_t* channels = columns.channels();
+      selection.forEach([&](int i) {
+        if (columns.hasChannel(i)) { ++bins[channels[i]]; }
+      });
+      return bins;
+    }
+
+    case MsgColumn::kData1:
+    case MsgColumn::kData2: {
+      std::vector<std::int64_t> bins(128, 0);
+      const std::uint8_t* data =
+          (column == MsgColumn::kData1) ? columns.data1s() : columns.data2s();
+      selection.forEach([&](int i) { ++bins[data[i] & 0x7F]; });
+      return bins;
+    }
+  }
+
+  assert(false);
+  return {};
+}
+
+std::vector<std::int64_t> MsgQuery::countPerBin(
+    const TimedMsgColumns& columns, double origin, double binWidth) const {
+  assert(binWidth > 0.0);
+  std::vector<std::int64_t> bins;
+  const double* timestamps = columns.timestamps();
+
+  select(columns).forEach([&](int i) {
+    if (timestamps[i] < origin) { return; }
+    const auto bin = static_cast<std::size_t>(std::floor((timestamps[i] - origin) / binWidth));
+    if (bin >= bins.size()) { bins.resize(bin + 1, 0); }
+    ++bins[bin];
+  });
+  return bins;
+}
+
+void MsgQuery::addPredicate(
+    MsgColumn column, std::uint8_t mask, std::uint8_t min, std::uint8_t max) {
+  assert(min <= max);
+
+  // Conjunction of ranges over the same masked byte is their intersection
+  // (matching nothing if empty, i.e. min > max).
+  for (int p = 0; p < numPredicates_; ++p) {
+    BytePredicate& pred = predicates_[p];
+    if ((pred.column == column) && (pred.mask == mask)) {
+      pred.min = std::max(pred.min, min);
+      pred.max = std::min(pred.max, max);
+      return;
+    }
+  }
+
+  // Builders only use a few (column, mask) pairs, so merging keeps this bounded.
+  assert(numPredicates_ < kMaxPredicates);
+  predicates_[numPredicates_++] = BytePredicate{column, mask, min, max};
+}
+
+MsgQuery::BlockFilter MsgQuery::blockFilter() const {
+  BlockFilter filter = {{}, false, false, 0x00, 0xFF};
+
+  // Statuses (and so channels) are few enough to just test every one.
+  for (int status = 0x80; status <= 0xFF; ++status) {
+    const bool hasChannel = (status < static_cast<int>(MsgType::kSystemExclusive));
+    bool isMatch = true;
+    for (int p = 0; isMatch && (p < numPredicates_); ++p) {
+      const BytePredicate& pred = predicates_[p];
+      std::uint8_t x = 0;
+      if (pred.column == MsgColumn::kStatus) {
+        x = static_cast<std::uint8_t>(status) & pred.mask;
+      } else if (pred.column == MsgColumn::kChannel) {
+        x = (hasChannel ? static_cast<std::uint8_t>(status & 0x0F) : 0) & pred.mask;
+      } else {
+        continue;
+      }
+      isMatch = (pred.min <= x) && (x <= pred.max);
+    }
+    if (isMatch) { filter.statusBits[status / 64] |= (std::uint64_t{1} << (status % 64)); }
+  }
+
+  // Data byte 1 is a key or control only if every matching status says so.
+  bool hasData1Predicate = false;
+  for (int p = 0; p < numPredicates_; ++p) {
+    const BytePredicate& pred = predicates_[p];
+    if ((pred.column != MsgColumn::kData1) || (pred.mask != 0xFF)) { continue; }
+    hasData1Predicate = true;
+    filter.minData1 = std::max(filter.minData1, pred.min);
+    filter.maxData1 = std::min(filter.maxData1, pred.max);
+  }
+  if (hasData1Predicate) {
+    constexpr std::uint64_t kKeyStatusBits = 0x0000FFFFFFFFFFFF;    // 0x80-0xAF.
+    constexpr std::uint64_t kControlStatusBits = 0xFFFF000000000000;  // 0xB0-0xBF.
+    const std::uint64_t channelBits = filter.statusBits[2];
+    const bool hasOtherBits = (filter.statusBits[3] != 0);
+    filter.hasKeyRange = !hasOtherBits && ((channelBits & ~kKeyStatusBits) == 0);
+    filter.hasControlRange = !hasOtherBits && ((channelBits & ~kControlStatusBits) == 0);
+  }
+  return filter;
+}
+
+bool MsgQuery::BlockFilter::matches(const MsgBlockSummary& block) const {
+  if (((statusBits[0] & block.statusBits[0]) | (statusBits[1] & block.statusBits[1])
+       | (statusBits[2] & block.statusBits[2]) | (statusBits[3] & block.statusBits[3])) == 0) {
+    return false;
+  }
+  if (minData1 > maxData1) { return false; }
+  if (hasKeyRange
+      && (!block.hasKeys() || (block.maxKey < minData1) || (maxData1 < block.minKey))) {
+    return false;
+  }
+  if (hasControlRange) {
+    for (int w = 0; w < 2; ++w) {
+      // Bits [w * 64, w * 64 + 64) of the range [minData1, maxData1].
+      const int first = std::max(static_cast<int>(minData1), w * 64) - w * 64;
+      const int last = std::min(static_cast<int>(maxData1), w * 64 + 63) - w * 64;
+      if (first > last) { continue; }
+      const std::uint64_t rangeBits =
+          (~std::uint64_t{0} >> (63 - last)) & (~std::uint64_t{0} << first);
+      if ((block.controlBits[w] & rangeBits) != 0) { return true; }
+    }
+    return false;
+  }
+  return true;
+}
+
+}  // namespace bmmidi
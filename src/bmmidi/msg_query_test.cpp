@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_query.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_columns.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+void pushMsg(bmmidi::TimedMsgColumns& columns, double timestamp, const bmmidi::MsgView& msg) {
+  columns.push(bmmidi::TimedMsgView{timestamp, msg});
+}
+
+// Returns a deterministic mix of notes, CCs, and clocks (one per tick), long
+// enough to exercise both bulk and tail evaluation.
+bmmidi::TimedMsgColumns makeColumns(int numMsgs) {
+  bmmidi::TimedMsgColumns columns;
+  const auto clock = bmmidi::timingClockMsg();
+  for (int i = 0; i < numMsgs; ++i) {
+    const auto channel = bmmidi::Channel::index(i % 5);
+    const auto velocity = bmmidi::DataValue{static_cast<std::int8_t>((i * 7) % 128)};
+    const auto control = bmmidi::controlFromDataValue(
+        bmmidi::DataValue{static_cast<std::int8_t>(i % 8)});
+    const auto value = bmmidi::DataValue{static_cast<std::int8_t>(i % 128)};
+    switch (i % 4) {
+      case 0:
+      case 1:
+        pushMsg(columns, i, bmmidi::NoteMsg::on(channel, bmmidi::KeyNumber::key(i % 128), velocity)
+                                .asView<bmmidi::MsgView>());
+        break;
+      case 2:
+        pushMsg(columns, i, bmmidi::ControlChangeMsg{channel, control, value}
+                                .asView<bmmidi::MsgView>());
+        break;
+      default:
+        pushMsg(columns, i, clock.asView<bmmidi::MsgView>());
+        break;
+    }
+  }
+  return columns;
+}
+
+TEST(MsgQuery, EmptyQuerySelectsEverything) {
+  const auto columns = makeColumns(100);
+  EXPECT_THAT(bmmidi::MsgQuery{}.count(columns), Eq(100));
+}
+
+TEST(MsgQuery, MatchesNaiveEvaluation) {
+  const auto columns = makeColumns(1003);
+  const auto selection = bmmidi::MsgQuery{}
+      .ofType(bmmidi::MsgType::kControlChange)
+      .onChannels(bmmidi::Channel::index(1), bmmidi::Channel::index(3))
+      .withControls(bmmidi::Control::kModWheel, bmmidi::Control::k004)
+      .during(17.0, 990.5)
+      .select(columns);
+
+  std::int64_t expectedCount = 0;
+  for (int i = 0; i < columns.size(); ++i) {
+    const bool expected = (i % 4 == 2) && (1 <= i % 5) && (i % 5 <= 3) &&
+                          (1 <= i % 8) && (i % 8 <= 4) && (17 <= i) && (i <= 990);
+    EXPECT_THAT(selection.contains(i), Eq(expected)) << "row " << i;
+    if (expected) { ++expectedCount; }
+  }
+  EXPECT_THAT(selection.count(), Eq(expectedCount));
+}
+
+TEST(MsgQuery, ChannelPredicateSkipsSystemMsgs) {
+  const auto columns = makeColumns(64);
+  const auto selection = bmmidi::MsgQuery{}.onChannel(bmmidi::Channel::index(0)).select(columns);
+
+  std::vector<int> rows;
+  selection.forEach([&rows](int i) { rows.push_back(i); });
+  // Rows 15, 35, 55 are on channel 0 but are timing clocks.
+  EXPECT_THAT(rows, ElementsAre(0, 5, 10, 20, 25, 30, 40, 45, 50, 60));
+}
+
+TEST(MsgQuery, KeyPredicateMatchesNoteMsgsOnly) {
+  bmmidi::TimedMsgColumns columns;
+  const auto ch = bmmidi::Channel::index(0);
+  pushMsg(columns, 0, bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(60), bmmidi::DataValue{1})
+                          .asView<bmmidi::MsgView>());
+  pushMsg(columns, 1, bmmidi::NoteMsg::off(ch, bmmidi::KeyNumber::key(61))
+                          .asView<bmmidi::MsgView>());
+  pushMsg(columns, 2, bmmidi::ControlChangeMsg{ch, bmmidi::controlFromDataValue(
+                                                       bmmidi::DataValue{60}),
+                                               bmmidi::DataValue{0}}
+                          .asView<bmmidi::MsgView>());
+  pushMsg(columns, 3, bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::key(72), bmmidi::DataValue{1})
+                          .asView<bmmidi::MsgView>());
+
+  const auto selection = bmmidi::MsgQuery{}
+      .withKeys(bmmidi::KeyNumber::key(60), bmmidi::KeyNumber::key(71))
+      .select(columns);
+  EXPECT_THAT(selection.contains(0), IsTrue());
+  EXPECT_THAT(selection.contains(1), IsTrue());
+  EXPECT_THAT(selection.contains(2), IsFalse());
+  EXPECT_THAT(selection.contains(3), IsFalse());
+}
+
+TEST(MsgQuery, IntersectsRepeatedPredicates) {
+  const auto columns = makeColumns(1003);
+  const auto selection = bmmidi::MsgQuery{}
+      .ofType(bmmidi::MsgType::kControlChange)
+      .onChannels(bmmidi::Channel::index(0), bmmidi::Channel::index(3))
+      .withControls(bmmidi::Control::kBankSelect, bmmidi::Control::k004)
+      .withControls(bmmidi::Control::kModWheel, bmmidi::Control::k005)
+      .onChannels(bmmidi::Channel::index(1), bmmidi::Channel::index(4))
+      .ofType(bmmidi::MsgType::kControlChange)
+      .select(columns);
+  EXPECT_THAT(selection.count(),
+              Eq(bmmidi::MsgQuery{}
+                     .ofType(bmmidi::MsgType::kControlChange)
+                     .onChannels(bmmidi::Channel::index(1), bmmidi::Channel::index(3))
+                     .withControls(bmmidi::Control::kModWheel, bmmidi::Control::k004)
+                     .count(columns)));
+  EXPECT_THAT(selection.count(), Gt(0));
+
+  // Disjoint ranges match nothing.
+  EXPECT_THAT(bmmidi::MsgQuery{}
+                  .withKeys(bmmidi::KeyNumber::key(0), bmmidi::KeyNumber::key(127))
+                  .withControls(bmmidi::Control::kBankSelect, bmmidi::Control::kPolyMode)
+                  .count(columns),
+              Eq(0));
+  EXPECT_THAT(bmmidi::MsgQuery{}
+                  .onChannel(bmmidi::Channel::index(0))
+                  .onChannel(bmmidi::Channel::index(1))
+                  .count(columns),
+              Eq(0));
+}
+
+TEST(MsgQuery, FindsTimeWindowRows) {
+  const auto columns = makeColumns(50);
+  const auto range = bmmidi::MsgQuery{}.during(10.0, 20.0).rowRange(columns);
+  EXPECT_THAT(range.first, Eq(10));
+  EXPECT_THAT(range.last, Eq(20));
+
+  const auto empty = bmmidi::MsgQuery{}.during(100.0, 200.0).rowRange(columns);
+  EXPECT_THAT(empty.first, Eq(50));
+  EXPECT_THAT(empty.last, Eq(50));
+}
+
+TEST(MsgQuery, ComputesHistograms) {
+  const auto columns = makeColumns(40);
+
+  const auto byChannel = bmmidi::MsgQuery{}.histogram(columns, bmmidi::MsgColumn::kChannel);
+  ASSERT_THAT(byChannel.size(), Eq(16u));
+  // 30 channel msgs spread over channels 0-4 (clocks have no channel).
+  EXPECT_THAT(byChannel[0] + byChannel[1] + byChannel[2] + byChannel[3] + byChannel[4], Eq(30));
+  EXPECT_THAT(byChannel[5], Eq(0));
+
+  const auto byStatus = bmmidi::MsgQuery{}.histogram(columns, bmmidi::MsgColumn::kStatus);
+  EXPECT_THAT(byStatus[0xF8], Eq(10));
+
+  const auto ccValues = bmmidi::MsgQuery{}
+      .ofType(bmmidi::MsgType::kControlChange)
+      .histogram(columns, bmmidi::MsgColumn::kData1);
+  ASSERT_THAT(ccValues.size(), Eq(128u));
+  EXPECT_THAT(ccValues[2], Eq(5));
+  EXPECT_THAT(ccValues[6], Eq(5));
+}
+
+TEST(MsgQuery, CountsPerBin) {
+  const auto columns = makeColumns(100);
+  const auto perBar = bmmidi::MsgQuery{}
+      .ofType(bmmidi::MsgType::kNoteOn)
+      .countPerBin(columns, 4.0, 32.0);
+  // Note Ons at every i with i % 4 in {0, 1}, for i in [4, 100).
+  EXPECT_THAT(perBar, ElementsAre(16, 16, 16));
+}
+
+}  // namespace
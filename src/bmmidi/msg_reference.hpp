@@ -44,9 +44,9 @@ enum class MsgAccess {kReadOnly, kReadWrite};
  * status (where repeated messages of the same type don't repeat the status
  * byte).
  *
- * TODO: Add utility functions for converting from a raw MIDI bytes stream into
- * data that meets the requirements above (and utilities for outputting a raw
- * MIDI byte stream that takes advantage of running status).
+ * See MsgStreamParser for converting a raw MIDI byte stream into messages that
+ * meet the requirements above, and RunningStatusEncoder for outputting a raw
+ * MIDI byte stream that takes advantage of running status.
  */
 template<MsgAccess AccessType>
 class MsgReference {
@@ -207,6 +207,37 @@ using MsgView = MsgReference<MsgAccess::kReadOnly>;
 /** Alias for a read-write MsgReference. */
 using MsgRef = MsgReference<MsgAccess::kReadWrite>;
 
+/**
+ * Returns true if bytes[0, numBytes) is a complete message that meets the
+ * MsgReference requirements (a status byte followed by the right # of [0, 127]
+ * data bytes, or a SysEx message terminated by EOX), so it is safe to
+ * reference. SysEx messages must also have a complete header (SysEx ID, and
+ * for Universal SysEx the device and sub-IDs), so they are safe to reference
+ * as the matching SysEx reference type. Use this to check untrusted input
+ * before constructing references.
+ */
+inline bool isValidMsg(const std::uint8_t* bytes, int numBytes) {
+  if ((bytes == nullptr) || (numBytes < 1) || (bytes[0] < 0x80)) { return false; }
+
+  const Status status{bytes[0]};
+  const bool isSysEx = (status.type() == MsgType::kSystemExclusive);
+  int numDataBytes = numBytes - 1;
+  if (isSysEx) {
+    if ((numBytes < 2)
+        || (bytes[numBytes - 1] != static_cast<std::uint8_t>(MsgType::kEndOfSystemExclusive))) {
+      return false;
+    }
+    --numDataBytes;  // Don't check the EOX byte below.
+  } else if (numDataBytes != status.numDataBytes()) {
+    return false;
+  }
+
+  for (int i = 1; i <= numDataBytes; ++i) {
+    if (bytes[i] >= 0x80) { return false; }
+  }
+  return !isSysEx || internal::hasCompleteSysExHeader(bytes, numBytes);
+}
+
 /**
  * Special subclass of Timed<> for wrapped Msg<> or MsgReference<> classes,
  * supporting conversions to more specific timed message and reference types.
@@ -690,6 +721,7 @@ public:
   explicit SysExMsgReference(BytePointerType bytes, int numBytes)
       : MsgReference<AccessType>{bytes, numBytes} {
     assert(this->type() == MsgType::kSystemExclusive);
+    assert(numBytes >= 3);  // Status, SysEx ID, and EOX.
     assert(bytes[numBytes - 1] == static_cast<std::uint8_t>(MsgType::kEndOfSystemExclusive));
   }
 
@@ -759,6 +791,7 @@ public:
   explicit MfrSysExMsgReference(BytePointerType bytes, int numBytes)
       : SysExMsgReference<AccessType>{bytes, numBytes} {
     assert(!this->isUniversal());
+    assert(numPayloadBytes() >= 0);
   }
 
   /** Returns the Manufacturer this SysEx message is for. */
@@ -849,6 +882,8 @@ public:
   explicit UniversalSysExMsgReference(BytePointerType bytes, int numBytes)
       : SysExMsgReference<AccessType>{bytes, numBytes} {
     assert(this->isUniversal());
+    assert(numBytes >= 5);  // Through 1st sub-ID (needed for numHeaderBytes()).
+    assert(numPayloadBytes() >= 0);
   }
 
   /** Returns the category of universal message this is (non-realtime or realtime). */
@@ -1187,4 +1187,37 @@ TEST(SongSelectMsgRef, CanReferToRawBytes) {
   EXPECT_THAT(srcBytes[1], Eq(0x16));
 }
 
+TEST(IsValidMsg, ChecksUntrustedBytes) {
+  const std::uint8_t cc[] = {0xBC, 0x01, 0x25};
+  EXPECT_THAT(bmmidi::isValidMsg(cc, 3), IsTrue());
+  EXPECT_THAT(bmmidi::isValidMsg(cc, 2), IsFalse());
+  EXPECT_THAT(bmmidi::isValidMsg(cc, 0), IsFalse());
+  EXPECT_THAT(bmmidi::isValidMsg(&cc[1], 2), IsFalse());  // No status byte.
+
+  const std::uint8_t badData[] = {0x90, 0x3C, 0x80};
+  EXPECT_THAT(bmmidi::isValidMsg(badData, 3), IsFalse());
+
+  const std::uint8_t sysEx[] = {0xF0, 0x7D, 0x01, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(sysEx, 4), IsTrue());
+  EXPECT_THAT(bmmidi::isValidMsg(sysEx, 3), IsFalse());  // No EOX.
+
+  const std::uint8_t badSysEx[] = {0xF0, 0x7D, 0xF8, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(badSysEx, 4), IsFalse());
+
+  // SysEx needs a complete header to be referenced as SysEx.
+  const std::uint8_t emptySysEx[] = {0xF0, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(emptySysEx, 2), IsFalse());
+  const std::uint8_t universal[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(universal, 6), IsTrue());
+  const std::uint8_t noSubId2[] = {0xF0, 0x7E, 0x7F, 0x06, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(noSubId2, 5), IsFalse());
+  const std::uint8_t noSubId1[] = {0xF0, 0x7F, 0x7F, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(noSubId1, 4), IsFalse());
+  const std::uint8_t shortExtMfr[] = {0xF0, 0x00, 0x21, 0xF7};
+  EXPECT_THAT(bmmidi::isValidMsg(shortExtMfr, 4), IsFalse());
+
+  const std::uint8_t clock[] = {0xF8};
+  EXPECT_THAT(bmmidi::isValidMsg(clock, 1), IsTrue());
+}
+
 }  // namespace
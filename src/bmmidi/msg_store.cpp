@@ -0,0 +1,371 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_store.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+namespace bmmidi {
+
+namespace {
+
+using internal::kMsgStoreHeaderBytes;
+using internal::kMsgStoreRecordHeaderBytes;
+using internal::MsgStoreBlockHeader;
+using internal::MsgStoreHeader;
+
+constexpr std::uint32_t kMagic = 0x424D5354;       // "BMST"
+constexpr std::uint32_t kBlockMagic = 0x424D424B;  // "BMBK"
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kMinBlockAlignBytes = 64;
+
+static_assert(sizeof(MsgStoreHeader) <= kMsgStoreHeaderBytes, "Header must fit in first page");
+static_assert(sizeof(MsgStoreBlockHeader) == 24, "Block header must not be padded");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared atomics must be lock-free");
+
+// Offset of the checksummed fields of MsgStoreBlockHeader.
+constexpr std::size_t kBlockCrcOffset = offsetof(MsgStoreBlockHeader, index);
+
+bool isValidBlockAlign(std::uint64_t blockAlign) {
+  return (blockAlign >= kMinBlockAlignBytes) && ((blockAlign & (blockAlign - 1)) == 0)
+      && (blockAlign <= kMsgStoreHeaderBytes);
+}
+
+std::uint64_t alignUp(std::uint64_t numBytes, std::uint64_t blockAlign) {
+  return (numBytes + blockAlign - 1) & ~(blockAlign - 1);
+}
+
+// Returns table for CRC-32 (reflected polynomial 0xEDB88320, as in zlib).
+const std::array<std::uint32_t, 256>& crcTable() {
+  static const std::array<std::uint32_t, 256> table = [] {
+    std::array<std::uint32_t, 256> result;
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) { crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0); }
+      result[i] = crc;
+    }
+    return result;
+  }();
+  return table;
+}
+
+// Continues CRC-32 crc (0 to start) over bytes[0, numBytes).
+std::uint32_t updateCrc(std::uint32_t crc, const std::uint8_t* bytes, std::size_t numBytes) {
+  const auto& table = crcTable();
+  crc = ~crc;
+  for (std::size_t i = 0; i < numBytes; ++i) { crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8); }
+  return ~crc;
+}
+
+std::uint32_t blockCrc(const MsgStoreBlockHeader& header, const std::uint8_t* records) {
+  const std::uint32_t crc = updateCrc(0, reinterpret_cast<const std::uint8_t*>(&header)
+                                             + kBlockCrcOffset,
+                                      sizeof(header) - kBlockCrcOffset);
+  return updateCrc(crc, records, header.numRecordBytes);
+}
+
+// Calls fn(timestamp, bytes, numBytes) for each of numRecords records in
+// records[0, numRecordBytes), returning false if they are malformed.
+template<typename Fn>
+bool forEachRecord(const std::uint8_t* records, std::uint32_t numRecordBytes,
+                   std::uint32_t numRecords, Fn&& fn) {
+  std::uint32_t offset = 0;
+  for (std::uint32_t i = 0; i < numRecords; ++i) {
+    if (numRecordBytes - offset < kMsgStoreRecordHeaderBytes) { return false; }
+    double timestamp;
+    std::uint32_t numBytes;
+    std::memcpy(&timestamp, &records[offset], sizeof(timestamp));
+    std::memcpy(&numBytes, &records[offset + sizeof(timestamp)], sizeof(numBytes));
+    offset += kMsgStoreRecordHeaderBytes;
+    if ((numBytes == 0) || (numBytes > numRecordBytes - offset)) { return false; }
+    fn(timestamp, &records[offset], numBytes);
+    offset += numBytes;
+  }
+  return offset == numRecordBytes;
+}
+
+// Reads exactly numBytes at offset, returning 0, an errno value, or EBADMSG
+// if the file ends first.
+int readAt(int fd, void* bytes, std::size_t numBytes, std::uint64_t offset) {
+  auto* next = static_cast<std::uint8_t*>(bytes);
+  while (numBytes > 0) {
+    const ssize_t result = ::pread(fd, next, numBytes, static_cast<off_t>(offset));
+    if (result < 0) {
+      if (errno == EINTR) { continue; }
+      return errno;
+    }
+    if (result == 0) { return EBADMSG; }
+    next += result;
+    numBytes -= static_cast<std::size_t>(result);
+    offset += static_cast<std::uint64_t>(result);
+  }
+  return 0;
+}
+
+int writeAt(int fd, const void* bytes, std::size_t numBytes, std::uint64_t offset) {
+  const auto* next = static_cast<const std::uint8_t*>(bytes);
+  while (numBytes > 0) {
+    const ssize_t result = ::pwrite(fd, next, numBytes, static_cast<off_t>(offset));
+    if (result < 0) {
+      if (errno == EINTR) { continue; }
+      return errno;
+    }
+    next += result;
+    numBytes -= static_cast<std::size_t>(result);
+    offset += static_cast<std::uint64_t>(result);
+  }
+  return 0;
+}
+
+// Reads and validates the block at data offset pos, which must fit (with its
+// padding) in numAvailBytes. Returns 0, an errno value, or EBADMSG if the
+// block is invalid.
+int readBlock(int fd, std::uint64_t pos, std::uint64_t numAvailBytes, std::uint64_t blockAlign,
+              std::uint64_t expectedIndex, MsgStoreBlockHeader& header,
+              std::vector<std::uint8_t>& records) {
+  if (numAvailBytes < sizeof(header)) { return EBADMSG; }
+  const std::uint64_t offset = kMsgStoreHeaderBytes + pos;
+  int error = readAt(fd, &header, sizeof(header), offset);
+  if (error != 0) { return error; }
+  if ((header.magic != kBlockMagic) || (header.index != expectedIndex)
+      || (alignUp(sizeof(header) + std::uint64_t{header.numRecordBytes}, blockAlign)
+          > numAvailBytes)) {
+    return EBADMSG;
+  }
+
+  records.resize(header.numRecordBytes);
+  error = readAt(fd, records.data(), records.size(), offset + sizeof(header));
+  if (error != 0) { return error; }
+  if ((blockCrc(header, records.data()) != header.crc)
+      || !forEachRecord(records.data(), header.numRecordBytes, header.numRecords,
+                        [](double, const std::uint8_t*, std::uint32_t) {})) {
+    return EBADMSG;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int MsgStoreWriter::open(const char* path, const MsgStoreOptions& options) {
+  close();
+  assert(isValidBlockAlign(static_cast<std::uint64_t>(options.blockAlignBytes)));
+  assert(options.maxBlockBytes > 0);
+  options_ = options;
+
+  fd_ = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) { return errno; }
+  int error = 0;
+  struct stat stats;
+  if ((::flock(fd_, LOCK_EX | LOCK_NB) != 0) || (::fstat(fd_, &stats) != 0)) { error = errno; }
+
+  const bool isCreating = (error == 0) && (stats.st_size == 0);
+  if (isCreating && (::ftruncate(fd_, static_cast<off_t>(kMsgStoreHeaderBytes)) != 0)) {
+    error = errno;
+  }
+  if ((error == 0) && !isCreating
+      && (static_cast<std::uint64_t>(stats.st_size) < kMsgStoreHeaderBytes)) {
+    error = EINVAL;
+  }
+
+  void* memory = MAP_FAILED;
+  if (error == 0) {
+    memory = ::mmap(nullptr, kMsgStoreHeaderBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory == MAP_FAILED) { error = errno; }
+  }
+  if (error != 0) {
+    close();
+    return error;
+  }
+
+  header_ = static_cast<MsgStoreHeader*>(memory);
+  if (isCreating) {
+    new (memory) MsgStoreHeader{};
+    header_->version = kVersion;
+    header_->blockAlignBytes = static_cast<std::uint32_t>(options.blockAlignBytes);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+  } else if ((header_->magic != kMagic) || (header_->version != kVersion)
+             || !isValidBlockAlign(header_->blockAlignBytes)) {
+    close();
+    return EINVAL;
+  }
+  blockAlign_ = header_->blockAlignBytes;
+
+  pending_.reserve(sizeof(MsgStoreBlockHeader) + static_cast<std::size_t>(options.maxBlockBytes));
+  pending_.assign(sizeof(MsgStoreBlockHeader), 0);
+  numPendingRecords_ = 0;
+
+  error = isCreating ? 0 : recover(static_cast<std::uint64_t>(stats.st_size));
+  if (error != 0) { close(); }
+  return error;
+}
+
+int MsgStoreWriter::recover(std::uint64_t fileBytes) {
+  const std::uint64_t numDataBytes = fileBytes - kMsgStoreHeaderBytes;
+  std::uint64_t pos = 0;
+  std::uint64_t index = 0;
+  MsgStoreBlockHeader blockHeader;
+  std::vector<std::uint8_t> records;
+  for (;; ++index) {
+    const int error =
+        readBlock(fd_, pos, numDataBytes - pos, blockAlign_, index, blockHeader, records);
+    if (error == EBADMSG) { break; }
+    if (error != 0) { return error; }
+    pos += alignUp(sizeof(blockHeader) + std::uint64_t{blockHeader.numRecordBytes}, blockAlign_);
+  }
+
+  numRecoveredBytesDropped_ = numDataBytes - pos;
+  if (numRecoveredBytesDropped_ > 0) {
+    if (::ftruncate(fd_, static_cast<off_t>(kMsgStoreHeaderBytes + pos)) != 0) { return errno; }
+    if (options_.syncOnCommit && (::fdatasync(fd_) != 0)) { return errno; }
+  }
+  nextBlockIndex_ = index;
+  header_->committedBytes.store(pos, std::memory_order_release);
+  return 0;
+}
+
+int MsgStoreWriter::close() {
+  int error = 0;
+  if (header_ != nullptr) {
+    error = commit();
+    ::munmap(header_, kMsgStoreHeaderBytes);
+  }
+  if (fd_ >= 0) { ::close(fd_); }
+  header_ = nullptr;
+  fd_ = -1;
+  blockAlign_ = 0;
+  pending_.clear();
+  numPendingRecords_ = 0;
+  nextBlockIndex_ = 0;
+  return error;
+}
+
+int MsgStoreWriter::append(double timestamp, const MsgView& msg) {
+  assert(isOpen());
+  assert(isValidMsg(msg.rawBytes(), msg.numBytes()));
+
+  const auto numBytes = static_cast<std::uint32_t>(msg.numBytes());
+  const std::size_t offset = pending_.size();
+  pending_.resize(offset + kMsgStoreRecordHeaderBytes + numBytes);
+  std::memcpy(&pending_[offset], &timestamp, sizeof(timestamp));
+  std::memcpy(&pending_[offset + sizeof(timestamp)], &numBytes, sizeof(numBytes));
+  std::memcpy(&pending_[offset + kMsgStoreRecordHeaderBytes], msg.rawBytes(), numBytes);
+  ++numPendingRecords_;
+
+  const std::size_t numRecordBytes = pending_.size() - sizeof(MsgStoreBlockHeader);
+  return (numRecordBytes >= static_cast<std::size_t>(options_.maxBlockBytes)) ? commit() : 0;
+}
+
+int MsgStoreWriter::commit() {
+  assert(isOpen());
+  if (numPendingRecords_ == 0) { return 0; }
+
+  const std::size_t numUnpaddedBytes = pending_.size();
+  MsgStoreBlockHeader blockHeader;
+  blockHeader.magic = kBlockMagic;
+  blockHeader.index = nextBlockIndex_;
+  blockHeader.numRecords = static_cast<std::uint32_t>(numPendingRecords_);
+  blockHeader.numRecordBytes =
+      static_cast<std::uint32_t>(numUnpaddedBytes - sizeof(blockHeader));
+  blockHeader.crc = blockCrc(blockHeader, &pending_[sizeof(blockHeader)]);
+  std::memcpy(pending_.data(), &blockHeader, sizeof(blockHeader));
+  pending_.resize(alignUp(numUnpaddedBytes, blockAlign_), 0);
+
+  // Publish only after the block is written (and synced), so readers (and
+  // recovery) never depend on a partially written block.
+  const std::uint64_t pos = header_->committedBytes.load(std::memory_order_relaxed);
+  int error = writeAt(fd_, pending_.data(), pending_.size(), kMsgStoreHeaderBytes + pos);
+  if ((error == 0) && options_.syncOnCommit && (::fdatasync(fd_) != 0)) { error = errno; }
+  if (error != 0) {
+    pending_.resize(numUnpaddedBytes);  // Keep pending messages, to retry.
+    return error;
+  }
+  header_->committedBytes.store(pos + pending_.size(), std::memory_order_release);
+
+  ++nextBlockIndex_;
+  pending_.resize(sizeof(blockHeader));
+  numPendingRecords_ = 0;
+  return 0;
+}
+
+int MsgStoreReader::open(const char* path) {
+  close();
+  fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) { return errno; }
+
+  struct stat stats;
+  if (::fstat(fd_, &stats) != 0) {
+    const int error = errno;
+    close();
+    return error;
+  }
+  if (static_cast<std::uint64_t>(stats.st_size) < kMsgStoreHeaderBytes) {
+    close();
+    return EINVAL;
+  }
+
+  void* memory = ::mmap(nullptr, kMsgStoreHeaderBytes, PROT_READ, MAP_SHARED, fd_, 0);
+  if (memory == MAP_FAILED) {
+    const int error = errno;
+    close();
+    return error;
+  }
+  header_ = static_cast<const MsgStoreHeader*>(memory);
+  if ((header_->magic != kMagic) || (header_->version != kVersion)
+      || !isValidBlockAlign(header_->blockAlignBytes)) {
+    close();
+    return EINVAL;
+  }
+  blockAlign_ = header_->blockAlignBytes;
+  return 0;
+}
+
+void MsgStoreReader::close() {
+  if (header_ != nullptr) {
+    ::munmap(const_cast<MsgStoreHeader*>(header_), kMsgStoreHeaderBytes);
+  }
+  if (fd_ >= 0) { ::close(fd_); }
+  header_ = nullptr;
+  fd_ = -1;
+  blockAlign_ = 0;
+  readBytes_ = 0;
+  nextBlockIndex_ = 0;
+  numInvalidMsgs_ = 0;
+}
+
+int MsgStoreReader::readCommitted(TimedMsgBuffer& out) {
+  assert(isOpen());
+  const std::uint64_t committedBytes = header_->committedBytes.load(std::memory_order_acquire);
+  MsgStoreBlockHeader blockHeader;
+  while (readBytes_ < committedBytes) {
+    const int error = readBlock(fd_, readBytes_, committedBytes - readBytes_, blockAlign_,
+                                nextBlockIndex_, blockHeader, blockBytes_);
+    if (error != 0) { return error; }
+
+    forEachRecord(blockBytes_.data(), blockHeader.numRecordBytes, blockHeader.numRecords,
+                  [this, &out](double timestamp, const std::uint8_t* bytes,
+                               std::uint32_t numBytes) {
+      if (isValidMsg(bytes, static_cast<int>(numBytes))) {
+        out.push(timestamp, bytes, static_cast<int>(numBytes));
+      } else {
+        ++numInvalidMsgs_;
+      }
+    });
+    readBytes_ +=
+        alignUp(sizeof(blockHeader) + std::uint64_t{blockHeader.numRecordBytes}, blockAlign_);
+    ++nextBlockIndex_;
+  }
+  return 0;
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_STORE_HPP
+#define BMMIDI_MSG_STORE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+namespace internal {
+
+// First page of a message store file.
+struct MsgStoreHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t blockAlignBytes;
+  std::uint32_t reserved;
+
+  // Bytes of blocks (after the header page) committed by the writer.
+  alignas(64) std::atomic<std::uint64_t> committedBytes;
+};
+
+// Precedes the records of each block.
+struct MsgStoreBlockHeader {
+  std::uint32_t magic;
+  std::uint32_t crc;  // CRC-32 of the fields below and the records.
+  std::uint64_t index;
+  std::uint32_t numRecords;
+  std::uint32_t numRecordBytes;
+};
+
+BMMIDI_INLINE_VAR static constexpr std::uint64_t kMsgStoreHeaderBytes = 4096;
+
+// Each record is a timestamp (8 bytes), numBytes (4 bytes), then the message.
+BMMIDI_INLINE_VAR static constexpr std::size_t kMsgStoreRecordHeaderBytes = 12;
+
+}  // namespace internal
+
+/** Configuration for MsgStoreWriter. */
+struct MsgStoreOptions {
+  /**
+   * Blocks start at multiples of this (a power of 2 of at least 64), e.g. the
+   * device sector size, so a torn write can only damage the last block. Only
+   * used when creating a store.
+   */
+  int blockAlignBytes = 512;
+
+  /** append() commits once pending records reach this many bytes. */
+  int maxBlockBytes = 64 * 1024;
+
+  /** If true, commit() syncs blocks to disk before publishing them. */
+  bool syncOnCommit = true;
+};
+
+/**
+ * Appends timed messages to a message store file, which readers (in this or
+ * other processes, see MsgStoreReader) can tail while it is being written.
+ *
+ * Messages are buffered and written in checksummed blocks, each starting at
+ * a multiple of MsgStoreOptions::blockAlignBytes. After a block is written,
+ * commit() publishes the new committed length with an atomic store to the
+ * file's first page (which writer and readers map), so readers never lock
+ * or see partially written blocks.
+ *
+ * Opening an existing store recovers it: blocks are validated from the
+ * start, and the file is truncated after the last valid one (e.g. dropping
+ * a block torn by a crash), so appending continues from there.
+ *
+ * Only one writer may have a store open at a time (enforced with flock()).
+ * All functions that make system calls return 0 on success, or else an errno
+ * value.
+ */
+class MsgStoreWriter {
+public:
+  MsgStoreWriter() = default;
+  ~MsgStoreWriter() { close(); }
+
+  MsgStoreWriter(const MsgStoreWriter&) = delete;
+  MsgStoreWriter& operator=(const MsgStoreWriter&) = delete;
+
+  /**
+   * Opens (recovering) or creates the store at path for appending. Returns
+   * EWOULDBLOCK if another writer has it open, or EINVAL if path is not a
+   * store.
+   */
+  int open(const char* path, const MsgStoreOptions& options = MsgStoreOptions{});
+
+  /** Commits pending messages and closes the store. */
+  int close();
+
+  /** Returns true if a store is open. */
+  bool isOpen() const { return header_ != nullptr; }
+
+  /**
+   * Appends msg with timestamp to the pending block, committing it if it
+   * reaches MsgStoreOptions::maxBlockBytes (whose result is returned).
+   */
+  int append(double timestamp, const MsgView& msg);
+
+  /** Appends timedMsg. */
+  int append(const TimedMsgView& timedMsg) {
+    return append(timedMsg.timestamp(), timedMsg.value());
+  }
+
+  /** Writes any pending messages as a block and publishes it to readers. */
+  int commit();
+
+  /** Returns the # of appended messages not yet committed. */
+  int numPendingMsgs() const { return numPendingRecords_; }
+
+  /** Returns the # of committed bytes of blocks. */
+  std::uint64_t committedBytes() const {
+    assert(isOpen());
+    return header_->committedBytes.load(std::memory_order_relaxed);
+  }
+
+  /** Returns # of bytes dropped after the last valid block when opening. */
+  std::uint64_t numRecoveredBytesDropped() const { return numRecoveredBytesDropped_; }
+
+private:
+  // Validates blocks, truncates the file after the last valid one, and
+  // publishes the result.
+  int recover(std::uint64_t fileBytes);
+
+  internal::MsgStoreHeader* header_ = nullptr;
+  int fd_ = -1;
+  MsgStoreOptions options_;
+  std::uint64_t blockAlign_ = 0;  // Trusted copy of header_->blockAlignBytes.
+
+  std::vector<std::uint8_t> pending_;  // Block header space, then records.
+  int numPendingRecords_ = 0;
+  std::uint64_t nextBlockIndex_ = 0;
+  std::uint64_t numRecoveredBytesDropped_ = 0;
+};
+
+/**
+ * Tails a message store file (see MsgStoreWriter) while it is being written,
+ * by reading only committed blocks, without locking or blocking the writer.
+ */
+class MsgStoreReader {
+public:
+  MsgStoreReader() = default;
+  ~MsgStoreReader() { close(); }
+
+  MsgStoreReader(const MsgStoreReader&) = delete;
+  MsgStoreReader& operator=(const MsgStoreReader&) = delete;
+
+  /** Opens the store at path for reading from its start. */
+  int open(const char* path);
+
+  /** Closes the store. */
+  void close();
+
+  /** Returns true if a store is open. */
+  bool isOpen() const { return header_ != nullptr; }
+
+  /** Returns true if blocks have been committed that this has not read. */
+  bool hasUnread() const {
+    assert(isOpen());
+    return header_->committedBytes.load(std::memory_order_acquire) > readBytes_;
+  }
+
+  /**
+   * Appends the messages of all blocks committed since the last call to out.
+   * Returns EBADMSG (and stops reading) if a committed block is invalid.
+   */
+  int readCommitted(TimedMsgBuffer& out);
+
+  /** Returns the # of bytes of blocks read so far. */
+  std::uint64_t readBytes() const { return readBytes_; }
+
+  /** Returns # of invalid messages skipped since opening. */
+  std::int64_t numInvalidMsgs() const { return numInvalidMsgs_; }
+
+private:
+  const internal::MsgStoreHeader* header_ = nullptr;
+  int fd_ = -1;
+  std::uint64_t blockAlign_ = 0;
+  std::uint64_t readBytes_ = 0;
+  std::uint64_t nextBlockIndex_ = 0;
+  std::vector<std::uint8_t> blockBytes_;
+  std::int64_t numInvalidMsgs_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_STORE_HPP
@@ -0,0 +1,202 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_store.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/test_msgs.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+using Bytes = std::vector<std::uint8_t>;
+
+using bmmidi::test::testMsg;
+using bmmidi::test::viewOf;
+
+// Returns path of a new (empty) temporary store file.
+std::string tempStorePath(const std::string& name) {
+  const std::string path = ::testing::TempDir() + "bmmidi_msg_store_" + name;
+  ::unlink(path.c_str());
+  return path;
+}
+
+// Returns # of messages of msgs that do not match testMsg() at the timestamp
+// (index) of each message.
+int numMismatched(const bmmidi::TimedMsgBuffer& msgs) {
+  int result = 0;
+  for (int i = 0; i < msgs.size(); ++i) {
+    const Bytes expected = testMsg(i);
+    const bmmidi::MsgView msg = msgs[i].value();
+    if ((msgs.timestampAt(i) != i)
+        || (Bytes(msg.rawBytes(), msg.rawBytes() + msg.numBytes()) != expected)) {
+      ++result;
+    }
+  }
+  return result;
+}
+
+TEST(MsgStore, ReadersSeeOnlyCommittedMsgs) {
+  const std::string path = tempStorePath("committed");
+  bmmidi::MsgStoreWriter writer;
+  ASSERT_THAT(writer.open(path.c_str()), Eq(0));
+  bmmidi::MsgStoreReader reader;
+  ASSERT_THAT(reader.open(path.c_str()), Eq(0));
+
+  for (int i = 0; i < 3; ++i) { ASSERT_THAT(writer.append(i, viewOf(testMsg(i))), Eq(0)); }
+  EXPECT_THAT(writer.numPendingMsgs(), Eq(3));
+  EXPECT_THAT(reader.hasUnread(), IsFalse());
+
+  ASSERT_THAT(writer.commit(), Eq(0));
+  EXPECT_THAT(writer.committedBytes() % 512, Eq(0));
+  EXPECT_THAT(reader.hasUnread(), IsTrue());
+  bmmidi::TimedMsgBuffer msgs;
+  ASSERT_THAT(reader.readCommitted(msgs), Eq(0));
+  EXPECT_THAT(msgs.size(), Eq(3));
+  EXPECT_THAT(reader.hasUnread(), IsFalse());
+
+  ASSERT_THAT(writer.append(3, viewOf(testMsg(3))), Eq(0));
+  ASSERT_THAT(writer.close(), Eq(0));
+  ASSERT_THAT(reader.readCommitted(msgs), Eq(0));
+  EXPECT_THAT(msgs.size(), Eq(4));
+  EXPECT_THAT(numMismatched(msgs), Eq(0));
+}
+
+TEST(MsgStore, CommitsFullBlocks) {
+  const std::string path = tempStorePath("full_blocks");
+  bmmidi::MsgStoreOptions options;
+  options.maxBlockBytes = 1000;
+  options.syncOnCommit = false;
+  bmmidi::MsgStoreWriter writer;
+  ASSERT_THAT(writer.open(path.c_str(), options), Eq(0));
+  const Bytes noteOn = {0x90, 60, 100};
+  for (int i = 0; i < 1000; ++i) { ASSERT_THAT(writer.append(i, viewOf(noteOn)), Eq(0)); }
+
+  // Each record is 15 bytes, so blocks hold 67 (1005 bytes, padded to 1536).
+  EXPECT_THAT(writer.numPendingMsgs(), Eq(1000 % 67));
+  EXPECT_THAT(writer.committedBytes(), Eq((1000 / 67) * 1536));
+}
+
+TEST(MsgStore, AllowsOnlyOneWriter) {
+  const std::string path = tempStorePath("one_writer");
+  bmmidi::MsgStoreWriter writer;
+  ASSERT_THAT(writer.open(path.c_str()), Eq(0));
+  bmmidi::MsgStoreWriter other;
+  EXPECT_THAT(other.open(path.c_str()), Eq(EWOULDBLOCK));
+  writer.close();
+  EXPECT_THAT(other.open(path.c_str()), Eq(0));
+}
+
+TEST(MsgStore, RecoversToLastValidBlock) {
+  const std::string path = tempStorePath("recover");
+  std::uint64_t firstBlockBytes = 0;
+  {
+    bmmidi::MsgStoreWriter writer;
+    ASSERT_THAT(writer.open(path.c_str()), Eq(0));
+    for (int i = 0; i < 5; ++i) { ASSERT_THAT(writer.append(i, viewOf(testMsg(i))), Eq(0)); }
+    ASSERT_THAT(writer.commit(), Eq(0));
+    firstBlockBytes = writer.committedBytes();
+    for (int i = 5; i < 10; ++i) { ASSERT_THAT(writer.append(i, viewOf(testMsg(i))), Eq(0)); }
+  }
+
+  // Corrupt a message of the second block, as if torn by a crash.
+  const int fd = ::open(path.c_str(), O_RDWR);
+  ASSERT_THAT(fd, Gt(0));
+  const std::uint8_t garbage = 0x55;
+  ASSERT_THAT(::pwrite(fd, &garbage, 1, static_cast<off_t>(4096 + firstBlockBytes + 40)), Eq(1));
+  ::close(fd);
+
+  bmmidi::MsgStoreWriter writer;
+  ASSERT_THAT(writer.open(path.c_str()), Eq(0));
+  EXPECT_THAT(writer.numRecoveredBytesDropped(), Gt(0));
+  EXPECT_THAT(writer.committedBytes(), Eq(firstBlockBytes));
+  struct stat stats;
+  ASSERT_THAT(::stat(path.c_str(), &stats), Eq(0));
+  EXPECT_THAT(static_cast<std::uint64_t>(stats.st_size), Eq(4096 + firstBlockBytes));
+
+  // Appending continues after the last valid block.
+  for (int i = 5; i < 7; ++i) { ASSERT_THAT(writer.append(i, viewOf(testMsg(i))), Eq(0)); }
+  ASSERT_THAT(writer.commit(), Eq(0));
+  bmmidi::MsgStoreReader reader;
+  ASSERT_THAT(reader.open(path.c_str()), Eq(0));
+  bmmidi::TimedMsgBuffer msgs;
+  ASSERT_THAT(reader.readCommitted(msgs), Eq(0));
+  EXPECT_THAT(msgs.size(), Eq(7));
+  EXPECT_THAT(numMismatched(msgs), Eq(0));
+}
+
+TEST(MsgStore, RejectsNonStoreFiles) {
+  const std::string path = tempStorePath("not_store");
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_THAT(fd, Gt(0));
+  const Bytes bytes(5000, 0xAB);
+  ASSERT_THAT(::write(fd, bytes.data(), bytes.size()), Eq(static_cast<ssize_t>(bytes.size())));
+  ::close(fd);
+
+  bmmidi::MsgStoreWriter writer;
+  EXPECT_THAT(writer.open(path.c_str()), Eq(EINVAL));
+  bmmidi::MsgStoreReader reader;
+  EXPECT_THAT(reader.open(path.c_str()), Eq(EINVAL));
+}
+
+TEST(MsgStore, ReadersTailConcurrentWriter) {
+  constexpr int kNumMsgs = 20000;
+  const std::string path = tempStorePath("tail");
+  bmmidi::MsgStoreOptions options;
+  options.maxBlockBytes = 2048;
+  options.syncOnCommit = false;
+  bmmidi::MsgStoreWriter writer;
+  ASSERT_THAT(writer.open(path.c_str(), options), Eq(0));
+
+  std::vector<bmmidi::TimedMsgBuffer> received(3);
+  std::vector<int> errors(received.size(), 0);
+  std::vector<std::thread> readers;
+  for (std::size_t r = 0; r < received.size(); ++r) {
+    readers.emplace_back([&path, &received, &errors, r] {
+      bmmidi::MsgStoreReader reader;
+      errors[r] = reader.open(path.c_str());
+      while ((errors[r] == 0) && (received[r].size() < kNumMsgs)) {
+        if (!reader.hasUnread()) {
+          std::this_thread::yield();
+          continue;
+        }
+        errors[r] = reader.readCommitted(received[r]);
+      }
+    });
+  }
+
+  for (int i = 0; i < kNumMsgs; ++i) {
+    ASSERT_THAT(writer.append(i, viewOf(testMsg(i))), Eq(0));
+    if (i % 97 == 0) { ASSERT_THAT(writer.commit(), Eq(0)); }
+  }
+  ASSERT_THAT(writer.commit(), Eq(0));
+  for (std::thread& reader : readers) { reader.join(); }
+
+  EXPECT_THAT(errors, ElementsAre(0, 0, 0));
+  for (const bmmidi::TimedMsgBuffer& msgs : received) {
+    EXPECT_THAT(msgs.size(), Eq(kNumMsgs));
+    EXPECT_THAT(numMismatched(msgs), Eq(0));
+  }
+}
+
+}  // namespace
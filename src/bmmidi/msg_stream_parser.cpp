@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_stream_parser.hpp"
+
+namespace bmmidi {
+
+MsgStreamParser::MsgStreamParser(const MsgStreamParserOptions& options) : options_{options} {
+  assert(options.maxSysExBytes >= 2);
+}
+
+void MsgStreamParser::reset() {
+  status_ = 0;
+  numExpectedData_ = 0;
+  numData_ = 0;
+  inSysEx_ = false;
+  sysExOverflowed_ = false;
+  sysEx_.clear();
+}
+
+void MsgStreamParser::startSysEx() {
+  inSysEx_ = true;
+  sysExOverflowed_ = false;
+  sysEx_.clear();
+  sysEx_.push_back(std::uint8_t{kSysExStart});
+}
+
+void MsgStreamParser::dropSysEx() {
+  inSysEx_ = false;
+  sysEx_.clear();
+  ++numDroppedSysEx_;
+}
+
+int MsgStreamParser::appendSysExRun(const std::uint8_t* bytes, int i, int numBytes) {
+  int end = i;
+  while ((end < numBytes) && (bytes[end] < 0x80)) { ++end; }
+
+  if (!sysExOverflowed_) {
+    // Leave room for the terminating EOX.
+    const int numRoom = options_.maxSysExBytes - 1 - static_cast<int>(sysEx_.size());
+    if (end - i <= numRoom) {
+      sysEx_.insert(sysEx_.end(), bytes + i, bytes + end);
+    } else {
+      // Skip the rest of this message (without storing any more of it).
+      sysExOverflowed_ = true;
+      sysEx_.clear();
+    }
+  }
+  return end;
+}
+
+}  // namespace bmmidi
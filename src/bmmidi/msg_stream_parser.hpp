@@ -0,0 +1,241 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_MSG_STREAM_PARSER_HPP
+#define BMMIDI_MSG_STREAM_PARSER_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+#include "bmmidi/sysex.hpp"
+
+namespace bmmidi {
+
+/** Options for MsgStreamParser. */
+struct MsgStreamParserOptions {
+  /**
+   * Maximum # of bytes (F0 through F7, inclusive) of a reassembled SysEx
+   * message. Longer SysEx messages are dropped (see numDroppedSysEx()), which
+   * bounds memory use for untrusted input streams.
+   */
+  int maxSysExBytes = 64 * 1024;
+};
+
+/**
+ * Parses a raw MIDI byte stream (e.g. from a serial port or network MIDI
+ * packets) into complete messages that meet MsgReference requirements:
+ * running status is expanded, interleaved System Realtime messages are emitted
+ * on their own, and SysEx messages are reassembled across any number of
+ * parse() calls.
+ *
+ * Designed for untrusted input: any byte sequence is accepted in time linear
+ * in its length (each byte is examined once, and SysEx data is appended in
+ * bulk), and malformed input is dropped and counted rather than emitted:
+ * - Data bytes with no status to apply to (see numDiscardedBytes()).
+ * - Undefined status bytes (0xF4, 0xF5, 0xF9, 0xFD) and stray EOX (0xF7).
+ * - Messages cut short by a new status byte.
+ * - SysEx messages that are interrupted, longer than maxSysExBytes, or too
+ *   short for a complete SysEx header, e.g. F0 F7 (see numDroppedSysEx()).
+ */
+class MsgStreamParser {
+public:
+  explicit MsgStreamParser(const MsgStreamParserOptions& options = MsgStreamParserOptions{});
+
+  /**
+   * Parses bytes[0, numBytes), calling emit(const MsgView&) for each complete
+   * message in stream order. Any incomplete message at the end is kept to be
+   * continued by the next parse() call.
+   *
+   * Emitted MsgView references are only valid during each emit() call.
+   */
+  template<typename EmitFn>
+  void parse(const std::uint8_t* bytes, int numBytes, EmitFn&& emit) {
+    parseWithPositions(bytes, numBytes, [&emit](const MsgView& msg, int) { emit(msg); });
+  }
+
+  /** Parses all bytes of data (any contiguous container of std::uint8_t). */
+  template<typename Container, typename EmitFn>
+  void parse(const Container& data, EmitFn&& emit) {
+    parse(data.data(), static_cast<int>(data.size()), std::forward<EmitFn>(emit));
+  }
+
+  /**
+   * Like parse(), but calls emit(const MsgView&, int lastByteIndex) with the
+   * index in bytes of the byte that completed each message (e.g. to timestamp
+   * each message by when its last byte arrived).
+   */
+  template<typename EmitFn>
+  void parseWithPositions(const std::uint8_t* bytes, int numBytes, EmitFn&& emit) {
+    assert((bytes != nullptr) || (numBytes == 0));
+    int i = 0;
+    auto emitAt = [&emit, &i](const MsgView& msg) { emit(msg, i); };
+    while (i < numBytes) {
+      const std::uint8_t byte = bytes[i];
+
+      if (byte >= kFirstRealtimeStatus) {
+        // Realtime may interrupt anything (including SysEx) without affecting it.
+        if (isUndefinedRealtime(byte)) {
+          ++numDiscardedBytes_;
+        } else {
+          emitAt(MsgView{&bytes[i], 1});
+        }
+        ++i;
+        continue;
+      }
+
+      if (inSysEx_) {
+        if (byte < 0x80) {
+          i = appendSysExRun(bytes, i, numBytes);
+          continue;
+        }
+
+        if (byte == kEox) {
+          finishSysEx(emitAt);
+          ++i;
+          continue;
+        }
+
+        // Any other status byte interrupts (and so invalidates) the SysEx.
+        dropSysEx();
+      }
+
+      if (byte >= 0x80) {
+        handleStatus(byte, emitAt);
+      } else {
+        handleData(byte, emitAt);
+      }
+      ++i;
+    }
+  }
+
+  /**
+   * Forgets running status and any incomplete message (e.g. after the input
+   * was disconnected). Does not reset counters.
+   */
+  void reset();
+
+  /** Returns true if currently in the middle of a SysEx message. */
+  bool isInSysEx() const { return inSysEx_; }
+
+  /** Returns # of input bytes discarded as malformed since construction. */
+  std::int64_t numDiscardedBytes() const { return numDiscardedBytes_; }
+
+  /** Returns # of interrupted, too long, or too short SysEx messages dropped since construction. */
+  std::int64_t numDroppedSysEx() const { return numDroppedSysEx_; }
+
+private:
+  static constexpr std::uint8_t kSysExStart = 0xF0;
+  static constexpr std::uint8_t kEox = 0xF7;
+  static constexpr std::uint8_t kFirstRealtimeStatus = 0xF8;
+
+  static bool isUndefinedRealtime(std::uint8_t byte) {
+    return (byte == 0xF9) || (byte == 0xFD);
+  }
+
+  template<typename EmitFn>
+  void handleStatus(std::uint8_t byte, EmitFn& emit) {
+    // Any partial message is cut short by a new status byte.
+    numDiscardedBytes_ += (numData_ > 0) ? (1 + numData_) : 0;
+    numData_ = 0;
+
+    if (byte < kSysExStart) {
+      // Channel Voice status, which also becomes running status.
+      status_ = byte;
+      numExpectedData_ = Status{byte}.numDataBytes();
+      return;
+    }
+
+    // System Common messages (and SysEx) cancel running status.
+    status_ = 0;
+    switch (byte) {
+      case kSysExStart:
+        startSysEx();
+        return;
+
+      case 0xF1:  // MTC Quarter Frame.
+      case 0xF3:  // Song Select.
+        status_ = byte;
+        numExpectedData_ = 1;
+        return;
+
+      case 0xF2:  // Song Position Pointer.
+        status_ = byte;
+        numExpectedData_ = 2;
+        return;
+
+      case 0xF6:  // Tune Request.
+        msg_[0] = byte;
+        emit(MsgView{msg_, 1});
+        return;
+
+      default:
+        // Undefined (0xF4, 0xF5) or stray EOX.
+        ++numDiscardedBytes_;
+        return;
+    }
+  }
+
+  template<typename EmitFn>
+  void handleData(std::uint8_t byte, EmitFn& emit) {
+    if (status_ == 0) {
+      ++numDiscardedBytes_;
+      return;
+    }
+
+    msg_[1 + numData_] = byte;
+    if (++numData_ < numExpectedData_) { return; }
+
+    msg_[0] = status_;
+    numData_ = 0;
+    if (status_ >= kSysExStart) { status_ = 0; }  // No running status for System Common.
+    emit(MsgView{msg_, 1 + numExpectedData_});
+  }
+
+  template<typename EmitFn>
+  void finishSysEx(EmitFn& emit) {
+    inSysEx_ = false;
+    if (sysExOverflowed_ || (static_cast<int>(sysEx_.size()) >= options_.maxSysExBytes)) {
+      ++numDroppedSysEx_;
+      return;
+    }
+
+    sysEx_.push_back(std::uint8_t{kEox});
+    if (!internal::hasCompleteSysExHeader(sysEx_.data(), static_cast<int>(sysEx_.size()))) {
+      ++numDroppedSysEx_;  // E.g. empty (F0 F7), so unusable as any SysEx reference.
+      return;
+    }
+    emit(MsgView{sysEx_.data(), static_cast<int>(sysEx_.size())});
+  }
+
+  void startSysEx();
+  void dropSysEx();
+
+  // Appends the run of SysEx data bytes starting at bytes[i], returning the
+  // index just past it.
+  int appendSysExRun(const std::uint8_t* bytes, int i, int numBytes);
+
+  MsgStreamParserOptions options_;
+
+  // Status of the message being parsed (or 0 if none), which is also running
+  // status for Channel Voice messages.
+  std::uint8_t status_ = 0;
+  int numExpectedData_ = 0;
+  int numData_ = 0;
+  std::uint8_t msg_[3] = {};
+
+  bool inSysEx_ = false;
+  bool sysExOverflowed_ = false;
+  std::vector<std::uint8_t> sysEx_;
+
+  std::int64_t numDiscardedBytes_ = 0;
+  std::int64_t numDroppedSysEx_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_MSG_STREAM_PARSER_HPP
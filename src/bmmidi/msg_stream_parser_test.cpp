@@ -0,0 +1,156 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/msg_stream_parser.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::SizeIs;
+
+using Msgs = std::vector<std::vector<int>>;
+
+Msgs parseAll(bmmidi::MsgStreamParser& parser, const std::vector<std::uint8_t>& bytes) {
+  Msgs result;
+  parser.parse(bytes, [&result](const bmmidi::MsgView& msg) {
+    EXPECT_THAT(bmmidi::isValidMsg(msg.rawBytes(), msg.numBytes()), IsTrue());
+    result.emplace_back(msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+  });
+  return result;
+}
+
+TEST(MsgStreamParser, ExpandsRunningStatus) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0x90, 60, 100, 62, 100, 0xC3, 5, 6}),
+              ElementsAre(ElementsAre(0x90, 60, 100), ElementsAre(0x90, 62, 100),
+                          ElementsAre(0xC3, 5), ElementsAre(0xC3, 6)));
+}
+
+TEST(MsgStreamParser, ContinuesAcrossCalls) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0xB0, 7}), IsEmpty());
+  EXPECT_THAT(parseAll(parser, {100, 8}), ElementsAre(ElementsAre(0xB0, 7, 100)));
+  EXPECT_THAT(parseAll(parser, {1}), ElementsAre(ElementsAre(0xB0, 8, 1)));
+}
+
+TEST(MsgStreamParser, EmitsInterleavedRealtime) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0x90, 60, 0xF8, 100, 0xF0, 0x7D, 0xFA, 0x01, 0xF7}),
+              ElementsAre(ElementsAre(0xF8), ElementsAre(0x90, 60, 100),
+                          ElementsAre(0xFA), ElementsAre(0xF0, 0x7D, 0x01, 0xF7)));
+}
+
+TEST(MsgStreamParser, ReportsLastBytePositions) {
+  bmmidi::MsgStreamParser parser;
+  const std::vector<std::uint8_t> bytes = {0x90, 60, 0xF8, 100, 62, 100, 0xF0, 1, 0xF7};
+  std::vector<int> positions;
+  parser.parseWithPositions(bytes.data(), static_cast<int>(bytes.size()),
+                            [&positions](const bmmidi::MsgView&, int lastByteIndex) {
+                              positions.push_back(lastByteIndex);
+                            });
+  EXPECT_THAT(positions, ElementsAre(2, 3, 5, 8));
+}
+
+TEST(MsgStreamParser, ReassemblesSysEx) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0x90, 60, 100, 0xF0, 0x7E, 0x7F}),
+              ElementsAre(ElementsAre(0x90, 60, 100)));
+  EXPECT_THAT(parser.isInSysEx(), IsTrue());
+  EXPECT_THAT(parseAll(parser, {0x06, 0x01}), IsEmpty());
+  EXPECT_THAT(parseAll(parser, {0xF7}),
+              ElementsAre(ElementsAre(0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7)));
+  EXPECT_THAT(parser.isInSysEx(), IsFalse());
+
+  // SysEx cancels running status.
+  EXPECT_THAT(parseAll(parser, {62, 100}), IsEmpty());
+  EXPECT_THAT(parser.numDiscardedBytes(), Eq(2));
+}
+
+TEST(MsgStreamParser, HandlesSystemCommon) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0xF2, 0x10, 0x20, 0xF6, 0xF3, 0x04, 0x05}),
+              ElementsAre(ElementsAre(0xF2, 0x10, 0x20), ElementsAre(0xF6),
+                          ElementsAre(0xF3, 0x04)));
+  EXPECT_THAT(parser.numDiscardedBytes(), Eq(1));
+}
+
+TEST(MsgStreamParser, DropsMalformedInput) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0x01, 0x02, 0xF4, 0xF9, 0xF7, 0x90, 0x3C, 0xB0, 7, 1}),
+              ElementsAre(ElementsAre(0xB0, 7, 1)));
+  EXPECT_THAT(parser.numDiscardedBytes(), Eq(7));
+
+  // Interrupted SysEx.
+  EXPECT_THAT(parseAll(parser, {0xF0, 0x7D, 0x01, 0x90, 60, 100}),
+              ElementsAre(ElementsAre(0x90, 60, 100)));
+  EXPECT_THAT(parser.numDroppedSysEx(), Eq(1));
+}
+
+TEST(MsgStreamParser, DropsSysExWithoutCompleteHeader) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0xF0, 0xF7, 0xF8}), ElementsAre(ElementsAre(0xF8)));
+  EXPECT_THAT(parser.numDroppedSysEx(), Eq(1));
+
+  // Universal SysEx missing sub-IDs, and extended manufacturer ID cut short.
+  EXPECT_THAT(parseAll(parser, {0xF0, 0x7E, 0x7F, 0xF7, 0xF0, 0x00, 0x21, 0xF7}), IsEmpty());
+  EXPECT_THAT(parser.numDroppedSysEx(), Eq(3));
+
+  EXPECT_THAT(parseAll(parser, {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7}), SizeIs(1));
+  EXPECT_THAT(parser.numDroppedSysEx(), Eq(3));
+}
+
+TEST(MsgStreamParser, DropsTooLongSysEx) {
+  bmmidi::MsgStreamParserOptions options;
+  options.maxSysExBytes = 4;
+  bmmidi::MsgStreamParser parser{options};
+
+  EXPECT_THAT(parseAll(parser, {0xF0, 1, 2, 0xF7}), ElementsAre(ElementsAre(0xF0, 1, 2, 0xF7)));
+  EXPECT_THAT(parseAll(parser, {0xF0, 1, 2}), IsEmpty());
+  EXPECT_THAT(parseAll(parser, {3, 0xF7, 0xF8}), ElementsAre(ElementsAre(0xF8)));
+  EXPECT_THAT(parser.numDroppedSysEx(), Eq(1));
+}
+
+TEST(MsgStreamParser, ParsesLargeSysExInSmallChunks) {
+  // Byte-at-a-time delivery of a large SysEx must still reassemble it (in
+  // linear time).
+  const int kNumDataBytes = 200000;
+  bmmidi::MsgStreamParserOptions options;
+  options.maxSysExBytes = kNumDataBytes + 2;
+  bmmidi::MsgStreamParser parser{options};
+
+  const std::uint8_t start = 0xF0;
+  const std::uint8_t data = 0x55;
+  const std::uint8_t end = 0xF7;
+  int numSysExBytes = 0;
+  const auto emit = [&numSysExBytes](const bmmidi::MsgView& msg) {
+    numSysExBytes = msg.numBytes();
+  };
+
+  parser.parse(&start, 1, emit);
+  for (int i = 0; i < kNumDataBytes; ++i) { parser.parse(&data, 1, emit); }
+  parser.parse(&end, 1, emit);
+  EXPECT_THAT(numSysExBytes, Eq(kNumDataBytes + 2));
+}
+
+TEST(MsgStreamParser, ResetsState) {
+  bmmidi::MsgStreamParser parser;
+  EXPECT_THAT(parseAll(parser, {0x90, 60}), IsEmpty());
+  parser.reset();
+  EXPECT_THAT(parseAll(parser, {100}), IsEmpty());
+  EXPECT_THAT(parseAll(parser, {0xF0, 1}), IsEmpty());
+  parser.reset();
+  EXPECT_THAT(parseAll(parser, {0xF7, 0x80, 1, 2}), SizeIs(1));
+}
+
+}  // namespace
@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_PACKED_MSGS_HPP
+#define BMMIDI_PACKED_MSGS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "bmmidi/msg.hpp"
+
+namespace bmmidi {
+
+/**
+ * Fixed-size array of N raw bytes holding a sequence of complete MIDI messages
+ * (each with its own status byte, no running status), ready to send as-is.
+ *
+ * Built by packMsgs() or packMsgArray(), which are constexpr so that fixed
+ * output sequences (e.g. controller resets or init dumps) can be static
+ * read-only data:
+ *
+ *   static constexpr auto kInit = bmmidi::packMsgs(
+ *       bmmidi::PackedMsgBytes<6>{{0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7}},
+ *       bmmidi::ProgramChangeMsg{bmmidi::Channel::index(0), bmmidi::PresetNumber::index(4)},
+ *       bmmidi::ControlChangeMsg{bmmidi::Channel::index(0), bmmidi::Control::kChannelVolume,
+ *                                bmmidi::DataValue{100}});
+ *   send(kInit.data(), kInit.size());
+ *
+ * As the example shows, PackedMsgBytes can also be constructed directly from
+ * raw bytes (e.g. for System Exclusive messages).
+ */
+template<std::size_t N>
+struct PackedMsgBytes {
+  static_assert(N > 0, "PackedMsgBytes<N>: N must be positive");
+
+  /** The # of bytes (N). */
+  static constexpr std::size_t kNumBytes = N;
+
+  std::uint8_t bytes[N];
+
+  constexpr std::size_t size() const { return N; }
+  constexpr const std::uint8_t* data() const { return bytes; }
+  constexpr std::uint8_t operator[](std::size_t index) const { return bytes[index]; }
+
+  constexpr const std::uint8_t* begin() const { return bytes; }
+  constexpr const std::uint8_t* end() const { return bytes + N; }
+};
+
+template<std::size_t N>
+constexpr std::size_t PackedMsgBytes<N>::kNumBytes;  // Definition.
+
+namespace internal {
+
+// Overloads (only used in unevaluated decltype) mapping each packable type,
+// including subclasses of Msg<N>, to its # of bytes.
+template<std::size_t N>
+std::integral_constant<std::size_t, N> packedNumBytes(const Msg<N>&);
+
+template<std::size_t N>
+std::integral_constant<std::size_t, N> packedNumBytes(const PackedMsgBytes<N>&);
+
+template<typename T>
+using PackedNumBytes = decltype(packedNumBytes(std::declval<const T&>()));
+
+template<std::size_t... Ns>
+constexpr std::size_t sumOf() {
+  const std::size_t values[] = {0, Ns...};
+  std::size_t total = 0;
+  for (std::size_t value : values) { total += value; }
+  return total;
+}
+
+template<std::size_t N>
+constexpr std::size_t appendPacked(std::uint8_t* out, std::size_t pos, const Msg<N>& msg) {
+  for (std::size_t i = 0; i < N; ++i) { out[pos + i] = msg.rawBytes()[i]; }
+  return pos + N;
+}
+
+template<std::size_t N>
+constexpr std::size_t appendPacked(
+    std::uint8_t* out, std::size_t pos, const PackedMsgBytes<N>& packed) {
+  for (std::size_t i = 0; i < N; ++i) { out[pos + i] = packed.bytes[i]; }
+  return pos + N;
+}
+
+}  // namespace internal
+
+/**
+ * Returns the bytes of all given messages (any Msg<N> subclass or
+ * PackedMsgBytes<N>, which may itself hold several messages) concatenated in
+ * order.
+ */
+template<typename... MsgTs>
+constexpr PackedMsgBytes<internal::sumOf<internal::PackedNumBytes<MsgTs>::value...>()>
+packMsgs(const MsgTs&... msgs) {
+  PackedMsgBytes<internal::sumOf<internal::PackedNumBytes<MsgTs>::value...>()> result{};
+  std::size_t pos = 0;
+  // Braced initializers are evaluated in order.
+  const std::size_t positions[] = {0, (pos = internal::appendPacked(result.bytes, pos, msgs))...};
+  (void)positions;
+  return result;
+}
+
+/** Returns the bytes of all M messages in msgs concatenated in order. */
+template<typename MsgT, std::size_t M>
+constexpr PackedMsgBytes<internal::PackedNumBytes<MsgT>::value * M>
+packMsgArray(const MsgT (&msgs)[M]) {
+  PackedMsgBytes<internal::PackedNumBytes<MsgT>::value * M> result{};
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i < M; ++i) { pos = internal::appendPacked(result.bytes, pos, msgs[i]); }
+  return result;
+}
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_PACKED_MSGS_HPP
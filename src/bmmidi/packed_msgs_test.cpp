@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/packed_msgs.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+#include "bmmidi/preset_number.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+// Everything below is built at compile time (static_assert would fail to
+// compile otherwise).
+constexpr bmmidi::NoteMsg kChord[] = {
+    bmmidi::NoteMsg::on(
+        bmmidi::Channel::index(0), bmmidi::KeyNumber::key(60), bmmidi::DataValue{90}),
+    bmmidi::NoteMsg::on(
+        bmmidi::Channel::index(0), bmmidi::KeyNumber::key(64), bmmidi::DataValue{90}),
+    bmmidi::NoteMsg::on(
+        bmmidi::Channel::index(0), bmmidi::KeyNumber::key(67), bmmidi::DataValue{90}),
+};
+
+constexpr bmmidi::ControlChangeMsg kResetChannel2[] = {
+    bmmidi::ControlChangeMsg{bmmidi::Channel::index(1), bmmidi::Control::kResetAllControllers,
+                             bmmidi::DataValue{0}},
+    bmmidi::ControlChangeMsg{bmmidi::Channel::index(1), bmmidi::Control::kAllNotesOff,
+                             bmmidi::DataValue{0}},
+};
+
+constexpr auto kChordBytes = bmmidi::packMsgArray(kChord);
+static_assert(kChordBytes.size() == 9, "3 Note Ons are 9 bytes");
+static_assert(kChordBytes[3] == 0x90, "2nd Note On status");
+static_assert(kChordBytes[4] == 64, "2nd Note On key");
+
+constexpr auto kInit = bmmidi::packMsgs(
+    bmmidi::PackedMsgBytes<6>{{0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7}},  // GM System On.
+    bmmidi::packMsgArray(kResetChannel2),
+    bmmidi::ProgramChangeMsg{bmmidi::Channel::index(1), bmmidi::PresetNumber::index(4)},
+    bmmidi::NoteMsg::off(bmmidi::Channel::index(1), bmmidi::KeyNumber::key(60)),
+    bmmidi::timingClockMsg());
+static_assert(kInit.size() == 6 + 6 + 2 + 3 + 1, "Total bytes");
+static_assert(kInit[6] == 0xB1, "Reset All Controllers status");
+static_assert(kInit[7] == 121, "Reset All Controllers control");
+
+static_assert(kChord[1].key() == bmmidi::KeyNumber::key(64), "constexpr accessor");
+static_assert(bmmidi::Msg<3>{kChord[2]}.to<bmmidi::NoteMsg>().isNoteOn(), "constexpr to<>()");
+
+std::vector<int> toInts(const std::uint8_t* bytes, std::size_t numBytes) {
+  return std::vector<int>(bytes, bytes + numBytes);
+}
+
+TEST(PackedMsgs, PacksMsgArray) {
+  EXPECT_THAT(toInts(kChordBytes.data(), kChordBytes.size()),
+              ElementsAre(0x90, 60, 90, 0x90, 64, 90, 0x90, 67, 90));
+}
+
+TEST(PackedMsgs, PacksMixedMsgsInOrder) {
+  EXPECT_THAT(toInts(kInit.data(), kInit.size()),
+              ElementsAre(0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7,
+                          0xB1, 121, 0, 0xB1, 123, 0,
+                          0xC1, 4,
+                          0x81, 60, 0,
+                          0xF8));
+}
+
+TEST(PackedMsgs, SupportsRangeFor) {
+  int sum = 0;
+  for (std::uint8_t byte : kChordBytes) { sum += byte; }
+  EXPECT_THAT(sum, Eq(3 * 0x90 + 60 + 64 + 67 + 3 * 90));
+}
+
+}  // namespace
@@ -0,0 +1,279 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_PEDAL_RESOLVER_HPP
+#define BMMIDI_PEDAL_RESOLVER_HPP
+
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <utility>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+/**
+ * Streaming transform that resolves Sustain (CC64) and Sostenuto (CC66) pedal
+ * state into "effective" Note Off messages, e.g. for offline analysis or
+ * rendering MIDI to audio with instruments that don't implement pedals.
+ *
+ * Each input message passed to process() is forwarded to the emit callback,
+ * except for Note Off messages (or Note On with velocity 0) for keys that
+ * are still held by a pedal. Those Note Offs are instead emitted later (with 0
+ * velocity), at the timestamp of the pedal release that ends the note:
+ *
+ * - Sustain pedal (value >= 64 is down) keeps all released keys sounding.
+ * - Sostenuto pedal latches only the keys that are held down at the moment it
+ *   is pressed, and keeps those sounding after release.
+ * - Re-striking a key that is only sounding because of a pedal first emits a
+ *   Note Off for the previous note (at the same timestamp as the new Note On).
+ *
+ * State is a fixed-size set of per-channel key bitsets, so memory use does not
+ * depend on the number of notes processed. Output is deterministic: generated
+ * Note Offs always follow the message that caused them, in ascending key
+ * order.
+ *
+ * Input messages must be in non-decreasing timestamp order.
+ */
+class PedalResolver {
+public:
+  /** Controls whether processed pedal Control Change messages are emitted. */
+  enum class PedalMsgs {
+    /** Forward Sustain and Sostenuto Control Change messages to output. */
+    kPassThrough,
+
+    /**
+     * Drop Sustain and Sostenuto Control Change messages from output (since
+     * their effect is already applied to the emitted note durations).
+     */
+    kConsume,
+  };
+
+  /** The minimum Control Change value that indicates a pedal is down. */
+  static constexpr int kMinPedalDownValue = 64;
+
+  explicit PedalResolver(PedalMsgs pedalMsgs = PedalMsgs::kPassThrough)
+      : pedalMsgs_{pedalMsgs} {}
+
+  /**
+   * Processes the next input timedMsg, invoking emit(const TimedMsgView&) zero
+   * or more times with resulting output messages. Emitted views are only valid
+   * during the emit call.
+   */
+  template<typename EmitFn>
+  void process(const TimedMsgView& timedMsg, EmitFn&& emit) {
+    const MsgView& msg = timedMsg.value();
+    const double timestamp = timedMsg.timestamp();
+
+    switch (msg.type()) {
+      case MsgType::kNoteOn:
+      case MsgType::kNoteOff:
+        processNote(timedMsg, msg.asView<NoteMsgView>(), emit);
+        return;
+
+      case MsgType::kControlChange:
+        processControlChange(timedMsg, msg.asView<ControlChangeMsgView>(), emit);
+        return;
+
+      case MsgType::kSystemReset:
+        emit(timedMsg);
+        for (Channel ch = Channel::first(); ch <= Channel::last(); ++ch) {
+          endAllSounding(timestamp, ch, emit);
+          channels_[ch.index()] = ChannelState{};
+        }
+        return;
+
+      default:
+        emit(timedMsg);
+        return;
+    }
+  }
+
+  /**
+   * Emits Note Off messages at the given timestamp for every key that is
+   * still sounding only because of a pedal, e.g. at the end of a stream. Keys
+   * that are still held down are not affected.
+   */
+  template<typename EmitFn>
+  void releasePedals(double timestamp, EmitFn&& emit) {
+    for (Channel ch = Channel::first(); ch <= Channel::last(); ++ch) {
+      auto& state = channels_[ch.index()];
+      state.sustainOn = false;
+      state.sostenutoOn = false;
+      state.latched.reset();
+      endKeys(timestamp, ch, state.sustained, emit);
+      state.sustained.reset();
+    }
+  }
+
+  /** Resets all channels to pedals up with no held or sounding keys. */
+  void reset() { channels_.fill(ChannelState{}); }
+
+  /** Returns true if the Sustain pedal is currently down on channel. */
+  bool isSustainDown(Channel channel) const {
+    return channels_[channel.index()].sustainOn;
+  }
+
+  /** Returns true if the Sostenuto pedal is currently down on channel. */
+  bool isSostenutoDown(Channel channel) const {
+    return channels_[channel.index()].sostenutoOn;
+  }
+
+  /** Returns true if key is physically held down (Note On without Note Off). */
+  bool isHeld(Channel channel, KeyNumber key) const {
+    return channels_[channel.index()].held.test(key.value());
+  }
+
+  /** Returns true if key is held down or is still sounding due to a pedal. */
+  bool isSounding(Channel channel, KeyNumber key) const {
+    const auto& state = channels_[channel.index()];
+    return state.held.test(key.value()) || state.sustained.test(key.value());
+  }
+
+private:
+  using KeySet = std::bitset<kNumKeys>;
+
+  struct ChannelState {
+    KeySet held;       // Keys physically down (Note On received, no Note Off yet).
+    KeySet sustained;  // Keys released, but still sounding because of a pedal.
+    KeySet latched;    // Keys captured by the Sostenuto pedal when pressed.
+    bool sustainOn = false;
+    bool sostenutoOn = false;
+  };
+
+  template<typename EmitFn>
+  void processNote(const TimedMsgView& timedMsg, NoteMsgView note, EmitFn& emit) {
+    auto& state = channels_[note.channel().index()];
+    const int key = note.key().value();
+
+    if (note.isNoteOn()) {
+      if (state.sustained.test(key)) {
+        // Re-strike of a key that was still ringing: end the previous note.
+        state.sustained.reset(key);
+        emitNoteOff(timedMsg.timestamp(), note.channel(), key, emit);
+      }
+      state.held.set(key);
+      emit(timedMsg);
+      return;
+    }
+
+    state.held.reset(key);
+    if (state.sustainOn || (state.sostenutoOn && state.latched.test(key))) {
+      state.sustained.set(key);  // Deferred until pedal release.
+    } else {
+      emit(timedMsg);
+    }
+  }
+
+  template<typename EmitFn>
+  void processControlChange(
+      const TimedMsgView& timedMsg, ControlChangeMsgView cc, EmitFn& emit) {
+    const double timestamp = timedMsg.timestamp();
+    const Channel ch = cc.channel();
+    auto& state = channels_[ch.index()];
+    const bool isDown = (cc.value().value() >= kMinPedalDownValue);
+
+    switch (cc.control()) {
+      case Control::kSustainPedal:
+        if (pedalMsgs_ == PedalMsgs::kPassThrough) { emit(timedMsg); }
+        if (state.sustainOn && !isDown) {
+          state.sustainOn = false;
+          endReleasedKeys(timestamp, ch, emit);
+        }
+        state.sustainOn = isDown;
+        return;
+
+      case Control::kSostenutoPedal:
+        if (pedalMsgs_ == PedalMsgs::kPassThrough) { emit(timedMsg); }
+        if (!state.sostenutoOn && isDown) {
+          state.latched = state.held;
+        } else if (state.sostenutoOn && !isDown) {
+          state.sostenutoOn = false;
+          state.latched.reset();
+          endReleasedKeys(timestamp, ch, emit);
+        }
+        state.sostenutoOn = isDown;
+        return;
+
+      case Control::kResetAllControllers:
+        emit(timedMsg);
+        state.sustainOn = false;
+        state.sostenutoOn = false;
+        state.latched.reset();
+        endReleasedKeys(timestamp, ch, emit);
+        return;
+
+      case Control::kAllNotesOff:
+        // Treated as releasing all held keys (which pedals may still sustain).
+        emit(timedMsg);
+        for (int key = 0; key < kNumKeys; ++key) {
+          if (!state.held.test(key)) { continue; }
+          if (state.sustainOn || (state.sostenutoOn && state.latched.test(key))) {
+            state.sustained.set(key);
+          } else {
+            emitNoteOff(timestamp, ch, key, emit);
+          }
+        }
+        state.held.reset();
+        return;
+
+      case Control::kAllSoundOff:
+        emit(timedMsg);
+        endAllSounding(timestamp, ch, emit);
+        state.held.reset();
+        state.sustained.reset();
+        return;
+
+      default:
+        emit(timedMsg);
+        return;
+    }
+  }
+
+  // Ends sustained keys that are no longer held by either pedal.
+  template<typename EmitFn>
+  void endReleasedKeys(double timestamp, Channel ch, EmitFn& emit) {
+    auto& state = channels_[ch.index()];
+    KeySet toEnd = state.sustained;
+    if (state.sustainOn) { return; }
+    if (state.sostenutoOn) { toEnd &= ~state.latched; }
+
+    endKeys(timestamp, ch, toEnd, emit);
+    state.sustained &= ~toEnd;
+  }
+
+  template<typename EmitFn>
+  void endAllSounding(double timestamp, Channel ch, EmitFn& emit) {
+    const auto& state = channels_[ch.index()];
+    endKeys(timestamp, ch, state.held | state.sustained, emit);
+  }
+
+  template<typename EmitFn>
+  static void endKeys(double timestamp, Channel ch, const KeySet& keys, EmitFn& emit) {
+    if (keys.none()) { return; }
+    for (int key = 0; key < kNumKeys; ++key) {
+      if (keys.test(key)) { emitNoteOff(timestamp, ch, key, emit); }
+    }
+  }
+
+  template<typename EmitFn>
+  static void emitNoteOff(double timestamp, Channel ch, int key, EmitFn& emit) {
+    const auto noteOff = NoteMsg::off(ch, KeyNumber::key(key));
+    emit(TimedMsgView{timestamp, noteOff.asView<MsgView>()});
+  }
+
+  PedalMsgs pedalMsgs_;
+  std::array<ChannelState, kNumChannels> channels_{};
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_PEDAL_RESOLVER_HPP
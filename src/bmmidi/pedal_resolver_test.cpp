@@ -0,0 +1,266 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/pedal_resolver.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+constexpr auto kCh = bmmidi::Channel::index(2);
+constexpr auto kC4 = bmmidi::KeyNumber::middleC();
+constexpr auto kE4 = bmmidi::KeyNumber::key(64);
+constexpr auto kG4 = bmmidi::KeyNumber::key(67);
+
+// Simplified record of an emitted message, for easy comparisons.
+struct Out {
+  double timestamp;
+  std::uint8_t status;
+  int data1;
+
+  friend bool operator==(const Out& lhs, const Out& rhs) {
+    return (lhs.timestamp == rhs.timestamp)
+        && (lhs.status == rhs.status)
+        && (lhs.data1 == rhs.data1);
+  }
+};
+
+class Collector {
+public:
+  template<typename MsgT>
+  void process(bmmidi::PedalResolver& resolver, double timestamp, const MsgT& msg) {
+    resolver.process(bmmidi::TimedMsgView{timestamp, msg.template asView<bmmidi::MsgView>()},
+                     [this](const bmmidi::TimedMsgView& out) { record(out); });
+  }
+
+  void record(const bmmidi::TimedMsgView& out) {
+    const auto& msg = out.value();
+    outputs.push_back(Out{out.timestamp(), msg.status().value(),
+                          (msg.numBytes() > 1) ? msg.data1().value() : -1});
+  }
+
+  std::vector<Out> outputs;
+};
+
+bmmidi::ControlChangeMsg pedal(bmmidi::Control control, bool down) {
+  return bmmidi::ControlChangeMsg{kCh, control, bmmidi::DataValue{down ? std::int8_t{127} : std::int8_t{0}}};
+}
+
+Out noteOn(double timestamp, bmmidi::KeyNumber key) { return Out{timestamp, 0x92, key.value()}; }
+Out noteOff(double timestamp, bmmidi::KeyNumber key) { return Out{timestamp, 0x82, key.value()}; }
+Out cc(double timestamp, bmmidi::Control control) {
+  return Out{timestamp, 0xB2, bmmidi::controlToNumber(control)};
+}
+
+TEST(PedalResolver, PassesThroughNotesWithoutPedals) {
+  bmmidi::PedalResolver resolver;
+  Collector c;
+
+  c.process(resolver, 1.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  EXPECT_THAT(resolver.isHeld(kCh, kC4), IsTrue());
+  c.process(resolver, 2.0, bmmidi::NoteMsg::off(kCh, kC4));
+  EXPECT_THAT(resolver.isSounding(kCh, kC4), IsFalse());
+
+  EXPECT_THAT(c.outputs, ElementsAre(noteOn(1.0, kC4), noteOff(2.0, kC4)));
+}
+
+TEST(PedalResolver, SustainDelaysNoteOffsUntilPedalRelease) {
+  bmmidi::PedalResolver resolver;
+  Collector c;
+
+  c.process(resolver, 1.0, bmmidi::NoteMsg::on(kCh, kE4, bmmidi::DataValue{100}));
+  c.process(resolver, 1.5, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(kCh, kE4));
+  // Note On with velocity 0 should be treated the same as Note Off:
+  c.process(resolver, 3.5, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{0}));
+
+  EXPECT_THAT(resolver.isSustainDown(kCh), IsTrue());
+  EXPECT_THAT(resolver.isHeld(kCh, kC4), IsFalse());
+  EXPECT_THAT(resolver.isSounding(kCh, kC4), IsTrue());
+
+  c.process(resolver, 4.0, pedal(bmmidi::Control::kSustainPedal, false));
+
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(1.0, kE4),
+      cc(1.5, bmmidi::Control::kSustainPedal),
+      noteOn(2.0, kC4),
+      cc(4.0, bmmidi::Control::kSustainPedal),
+      noteOff(4.0, kC4),
+      noteOff(4.0, kE4)));
+  EXPECT_THAT(resolver.isSounding(kCh, kC4), IsFalse());
+  EXPECT_THAT(resolver.isSounding(kCh, kE4), IsFalse());
+}
+
+TEST(PedalResolver, SustainDoesNotEndKeysStillHeld) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, pedal(bmmidi::Control::kSustainPedal, false));
+  c.process(resolver, 4.0, bmmidi::NoteMsg::off(kCh, kC4));
+
+  EXPECT_THAT(c.outputs, ElementsAre(noteOn(2.0, kC4), noteOff(4.0, kC4)));
+}
+
+TEST(PedalResolver, ReStrikeEndsPreviouslySustainedNote) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(kCh, kC4));
+  c.process(resolver, 4.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{90}));
+  c.process(resolver, 5.0, bmmidi::NoteMsg::off(kCh, kC4));
+  c.process(resolver, 6.0, pedal(bmmidi::Control::kSustainPedal, false));
+
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(2.0, kC4),
+      noteOff(4.0, kC4),
+      noteOn(4.0, kC4),
+      noteOff(6.0, kC4)));
+}
+
+TEST(PedalResolver, SostenutoOnlyLatchesKeysHeldWhenPressed) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 2.0, pedal(bmmidi::Control::kSostenutoPedal, true));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::on(kCh, kE4, bmmidi::DataValue{100}));
+  c.process(resolver, 4.0, bmmidi::NoteMsg::off(kCh, kC4));  // Latched: deferred.
+  c.process(resolver, 5.0, bmmidi::NoteMsg::off(kCh, kE4));  // Not latched: immediate.
+
+  EXPECT_THAT(resolver.isSostenutoDown(kCh), IsTrue());
+  EXPECT_THAT(resolver.isSounding(kCh, kC4), IsTrue());
+  EXPECT_THAT(resolver.isSounding(kCh, kE4), IsFalse());
+
+  c.process(resolver, 6.0, pedal(bmmidi::Control::kSostenutoPedal, false));
+
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(1.0, kC4),
+      noteOn(3.0, kE4),
+      noteOff(5.0, kE4),
+      noteOff(6.0, kC4)));
+}
+
+TEST(PedalResolver, SostenutoReleaseKeepsKeysSustainedBySustainPedal) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 2.0, pedal(bmmidi::Control::kSostenutoPedal, true));
+  c.process(resolver, 3.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 4.0, bmmidi::NoteMsg::on(kCh, kG4, bmmidi::DataValue{100}));
+  c.process(resolver, 5.0, bmmidi::NoteMsg::off(kCh, kC4));
+  c.process(resolver, 5.0, bmmidi::NoteMsg::off(kCh, kG4));
+  c.process(resolver, 6.0, pedal(bmmidi::Control::kSostenutoPedal, false));
+  c.process(resolver, 7.0, pedal(bmmidi::Control::kSustainPedal, false));
+
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(1.0, kC4),
+      noteOn(4.0, kG4),
+      noteOff(7.0, kC4),
+      noteOff(7.0, kG4)));
+}
+
+TEST(PedalResolver, ChannelsAreIndependent) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+  const auto otherCh = bmmidi::Channel::index(3);
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(otherCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(otherCh, kC4));
+
+  EXPECT_THAT(resolver.isSustainDown(otherCh), IsFalse());
+  EXPECT_THAT(c.outputs, ElementsAre(
+      Out{2.0, 0x93, kC4.value()},
+      Out{3.0, 0x83, kC4.value()}));
+}
+
+TEST(PedalResolver, ResetAllControllersReleasesPedals) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(kCh, kC4));
+  c.process(resolver, 4.0, bmmidi::ControlChangeMsg{
+      kCh, bmmidi::Control::kResetAllControllers, bmmidi::DataValue::min()});
+
+  EXPECT_THAT(resolver.isSustainDown(kCh), IsFalse());
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(2.0, kC4),
+      cc(4.0, bmmidi::Control::kResetAllControllers),
+      noteOff(4.0, kC4)));
+}
+
+TEST(PedalResolver, AllSoundOffEndsEverything) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 2.5, bmmidi::NoteMsg::on(kCh, kE4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(kCh, kC4));
+  c.process(resolver, 4.0, bmmidi::ControlChangeMsg{
+      kCh, bmmidi::Control::kAllSoundOff, bmmidi::DataValue::min()});
+
+  EXPECT_THAT(resolver.isSounding(kCh, kC4), IsFalse());
+  EXPECT_THAT(resolver.isSounding(kCh, kE4), IsFalse());
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(2.0, kC4),
+      noteOn(2.5, kE4),
+      cc(4.0, bmmidi::Control::kAllSoundOff),
+      noteOff(4.0, kC4),
+      noteOff(4.0, kE4)));
+}
+
+TEST(PedalResolver, ReleasePedalsFlushesSustainedKeys) {
+  bmmidi::PedalResolver resolver{bmmidi::PedalResolver::PedalMsgs::kConsume};
+  Collector c;
+
+  c.process(resolver, 1.0, pedal(bmmidi::Control::kSustainPedal, true));
+  c.process(resolver, 2.0, bmmidi::NoteMsg::on(kCh, kC4, bmmidi::DataValue{100}));
+  c.process(resolver, 2.5, bmmidi::NoteMsg::on(kCh, kE4, bmmidi::DataValue{100}));
+  c.process(resolver, 3.0, bmmidi::NoteMsg::off(kCh, kC4));
+
+  resolver.releasePedals(10.0, [&c](const bmmidi::TimedMsgView& out) { c.record(out); });
+
+  EXPECT_THAT(resolver.isSustainDown(kCh), IsFalse());
+  EXPECT_THAT(resolver.isHeld(kCh, kE4), IsTrue());
+  EXPECT_THAT(c.outputs, ElementsAre(
+      noteOn(2.0, kC4),
+      noteOn(2.5, kE4),
+      noteOff(10.0, kC4)));
+}
+
+TEST(PedalResolver, PassesThroughOtherMsgs) {
+  bmmidi::PedalResolver resolver;
+  Collector c;
+
+  c.process(resolver, 1.0, bmmidi::ProgramChangeMsg{kCh, bmmidi::PresetNumber::index(5)});
+  c.process(resolver, 2.0, bmmidi::timingClockMsg());
+
+  EXPECT_THAT(c.outputs, ElementsAre(Out{1.0, 0xC2, 5}, Out{2.0, 0xF8, -1}));
+}
+
+}  // namespace
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/redundant_msg_filter.hpp"
+
+#include <cstring>
+
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+RedundantMsgFilter::RedundantMsgFilter(const RedundantMsgRules& rules) : rules_{rules} {
+  reset();
+}
+
+bool RedundantMsgFilter::process(const MsgView& msg) {
+  const Status status = msg.status();
+  if (status.isChannelSpecific()) {
+    const bool pass = processChannelMsg(msg.rawBytes());
+    if (!pass) { ++numDropped_; }
+    return pass;
+  }
+
+  if (status.type() == MsgType::kSystemReset) { reset(); }
+  return true;
+}
+
+void RedundantMsgFilter::reset() {
+  for (ChannelState& state : channels_) { resetChannel(state); }
+}
+
+void RedundantMsgFilter::resetControllers(ChannelState& state) {
+  // Reset All Controllers puts these back to (device-specific) defaults, so
+  // treat them as unknown rather than guessing.
+  std::memset(state.controls, kUnknown, sizeof(state.controls));
+  std::memset(state.keyPressures, kUnknown, sizeof(state.keyPressures));
+  state.chanPressure = kUnknown;
+  state.pitchBend = kUnknownBend;
+}
+
+void RedundantMsgFilter::resetChannel(ChannelState& state) {
+  resetControllers(state);
+  state.notesKnown.reset();
+  state.notesOn.reset();
+  state.program = kUnknown;
+}
+
+bool RedundantMsgFilter::processChannelMsg(const std::uint8_t* bytes) {
+  ChannelState& state = channels_[bytes[0] & 0x0F];
+  const auto type = static_cast<MsgType>(bytes[0] & 0xF0);
+
+  switch (type) {
+    case MsgType::kNoteOff:
+    case MsgType::kNoteOn: {
+      const int key = bytes[1];
+      const bool isOn = (type == MsgType::kNoteOn) && (bytes[2] != 0);
+      const bool isSame = state.notesKnown.test(key) && (state.notesOn.test(key) == isOn);
+      state.notesKnown.set(key);
+      state.notesOn.set(key, isOn);
+      return !rules_.notes || !isSame;
+    }
+
+    case MsgType::kPolyphonicKeyPressure: {
+      std::uint8_t& last = state.keyPressures[bytes[1]];
+      const bool isSame = (last == bytes[2]);
+      last = bytes[2];
+      return !rules_.keyPressure || !isSame;
+    }
+
+    case MsgType::kControlChange: {
+      const int control = bytes[1];
+      if (control == static_cast<int>(Control::kResetAllControllers)) {
+        resetControllers(state);
+        return true;
+      }
+      if ((control == static_cast<int>(Control::kAllNotesOff))
+          || (control == static_cast<int>(Control::kAllSoundOff))) {
+        // Receivers may ignore these (e.g. All Notes Off in Omni mode), so
+        // treat notes as unknown rather than off.
+        state.notesKnown.reset();
+        return true;
+      }
+
+      if ((control == static_cast<int>(Control::kBankSelect))
+          || (control == static_cast<int>(Control::kLsbBankSelect))) {
+        // Receivers apply a new bank only on the next Program Change, so that
+        // must pass even if it repeats the last program.
+        state.program = kUnknown;
+      }
+
+      std::uint8_t& last = state.controls[control];
+      const bool isSame = (last == bytes[2]);
+      last = bytes[2];
+      return !rules_.controls.test(control) || !isSame;
+    }
+
+    case MsgType::kProgramChange: {
+      const bool isSame = (state.program == bytes[1]);
+      state.program = bytes[1];
+      return !rules_.programChanges || !isSame;
+    }
+
+    case MsgType::kChannelPressure: {
+      const bool isSame = (state.chanPressure == bytes[1]);
+      state.chanPressure = bytes[1];
+      return !rules_.chanPressure || !isSame;
+    }
+
+    case MsgType::kPitchBend: {
+      const int bend = bytes[1] | (bytes[2] << 7);
+      const bool isSame = (state.pitchBend == bend);
+      state.pitchBend = bend;
+      return !rules_.pitchBend || !isSame;
+    }
+
+    default:
+      return true;
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_REDUNDANT_MSG_FILTER_HPP
+#define BMMIDI_REDUNDANT_MSG_FILTER_HPP
+
+#include <bitset>
+#include <cstdint>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Per-message-type rules for which redundant messages RedundantMsgFilter drops. */
+struct RedundantMsgRules {
+  /**
+   * Drop Note On for a key known to be on, and Note Off for a key known to be
+   * off.
+   */
+  bool notes = true;
+
+  /** Drop Poly Key Pressure repeating the key's last value. */
+  bool keyPressure = true;
+
+  /**
+   * Drop Program Change repeating the channel's last program (unless Bank
+   * Select was received since).
+   */
+  bool programChanges = true;
+
+  /** Drop Channel Pressure repeating the channel's last value. */
+  bool chanPressure = true;
+
+  /** Drop Pitch Bend repeating the channel's last value. */
+  bool pitchBend = true;
+
+  /**
+   * Controls for which Control Change messages repeating the last value are
+   * dropped. By default, this is all controls except those that act as
+   * commands rather than state: Data Entry (MSB and LSB) and Data
+   * Increment/Decrement (whose meaning depends on the selected parameter), and
+   * all Channel Mode messages (120-127).
+   */
+  std::bitset<kNumControls> controls = defaultControls();
+
+  static std::bitset<kNumControls> defaultControls() {
+    std::bitset<kNumControls> result;
+    result.set();
+    result.reset(static_cast<int>(Control::kDataEntry));
+    result.reset(static_cast<int>(Control::kLsbDataEntry));
+    result.reset(static_cast<int>(Control::kDataIncrement));
+    result.reset(static_cast<int>(Control::kDataDecrement));
+    for (int i = static_cast<int>(Control::kAllSoundOff); i < kNumControls; ++i) {
+      result.reset(i);
+    }
+    return result;
+  }
+};
+
+/**
+ * Stateful filter that drops messages which would not change a receiver's
+ * state, e.g. repeated identical Control Change values or duplicate Note Ons
+ * from merged/layered inputs (see RedundantMsgRules).
+ *
+ * Tracks the last value sent per channel (and per key or control), starting
+ * from "unknown" so that the first message of each kind always passes.
+ * Reset All Controllers, All Notes Off, All Sound Off, and System Reset
+ * messages (which always pass) update the tracked state accordingly. System
+ * and System Exclusive messages otherwise always pass.
+ *
+ * Call reset() whenever the receiver's state may have changed by other means
+ * (e.g. after reconnecting).
+ */
+class RedundantMsgFilter {
+public:
+  explicit RedundantMsgFilter(const RedundantMsgRules& rules = RedundantMsgRules{});
+
+  /**
+   * Processes msg (updating tracked state), returning true if it should be
+   * sent or false if it is redundant.
+   */
+  bool process(const MsgView& msg);
+
+  /** Forgets all tracked state, so every next message passes. */
+  void reset();
+
+  /** Returns # of messages dropped since construction. */
+  std::int64_t numDropped() const { return numDropped_; }
+
+private:
+  static constexpr std::uint8_t kUnknown = 0xFF;
+  static constexpr int kUnknownBend = -1;
+
+  struct ChannelState {
+    std::bitset<kNumKeys> notesKnown;  // Keys whose on/off state is known.
+    std::bitset<kNumKeys> notesOn;     // Only meaningful for known keys.
+    std::uint8_t controls[kNumControls];
+    std::uint8_t keyPressures[kNumKeys];
+    std::uint8_t program;
+    std::uint8_t chanPressure;
+    int pitchBend;
+  };
+
+  static void resetControllers(ChannelState& state);
+  static void resetChannel(ChannelState& state);
+
+  bool processChannelMsg(const std::uint8_t* bytes);
+
+  RedundantMsgRules rules_;
+  ChannelState channels_[kNumChannels];
+  std::int64_t numDropped_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_REDUNDANT_MSG_FILTER_HPP
@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/redundant_msg_filter.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+#include "bmmidi/pitch_bend.hpp"
+#include "bmmidi/preset_number.hpp"
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+bmmidi::ControlChangeMsg cc(int channel, bmmidi::Control control, int value) {
+  return bmmidi::ControlChangeMsg{bmmidi::Channel::index(channel), control,
+                                  bmmidi::DataValue{static_cast<std::int8_t>(value)}};
+}
+
+TEST(RedundantMsgFilter, DropsRepeatedControlValues) {
+  bmmidi::RedundantMsgFilter filter;
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kModWheel, 10)), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kModWheel, 10)), IsFalse());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kModWheel, 11)), IsTrue());
+
+  // Tracked per channel and per control.
+  EXPECT_THAT(filter.process(cc(1, bmmidi::Control::kModWheel, 11)), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kChannelVolume, 11)), IsTrue());
+  EXPECT_THAT(filter.numDropped(), Eq(1));
+}
+
+TEST(RedundantMsgFilter, AlwaysPassesCommandControls) {
+  bmmidi::RedundantMsgFilter filter;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kDataEntry, 2)), IsTrue());
+    EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kDataIncrement, 0)), IsTrue());
+    EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kAllNotesOff, 0)), IsTrue());
+  }
+}
+
+TEST(RedundantMsgFilter, DropsDuplicateNoteOnsAndOffs) {
+  bmmidi::RedundantMsgFilter filter;
+  const auto ch = bmmidi::Channel::index(3);
+  const auto key = bmmidi::KeyNumber::middleC();
+  const auto on = bmmidi::NoteMsg::on(ch, key, bmmidi::DataValue{100});
+  const auto off = bmmidi::NoteMsg::off(ch, key);
+  const auto onVelocity0 = bmmidi::NoteMsg::on(ch, key, bmmidi::DataValue{0});
+
+  EXPECT_THAT(filter.process(on), IsTrue());
+  EXPECT_THAT(filter.process(on), IsFalse());  // Layered duplicate.
+  EXPECT_THAT(filter.process(onVelocity0), IsTrue());
+  EXPECT_THAT(filter.process(off), IsFalse());
+  EXPECT_THAT(filter.process(on), IsTrue());
+
+  // All Notes Off makes notes unknown again.
+  EXPECT_THAT(filter.process(cc(3, bmmidi::Control::kAllNotesOff, 0)), IsTrue());
+  EXPECT_THAT(filter.process(off), IsTrue());
+  EXPECT_THAT(filter.process(off), IsFalse());
+}
+
+TEST(RedundantMsgFilter, PassesFirstNoteOffOfUnknownKeys) {
+  // E.g. inserted into a running stream, where the key may be sounding.
+  bmmidi::RedundantMsgFilter filter;
+  const auto ch = bmmidi::Channel::index(3);
+  const auto key = bmmidi::KeyNumber::middleC();
+  const auto off = bmmidi::NoteMsg::off(ch, key);
+
+  EXPECT_THAT(filter.process(off), IsTrue());
+  EXPECT_THAT(filter.process(off), IsFalse());
+  EXPECT_THAT(filter.process(bmmidi::NoteMsg::off(ch, bmmidi::KeyNumber::key(61))), IsTrue());
+
+  // As after reset().
+  filter.reset();
+  EXPECT_THAT(filter.process(off), IsTrue());
+  EXPECT_THAT(filter.process(off), IsFalse());
+}
+
+TEST(RedundantMsgFilter, DropsRepeatedChannelValues) {
+  bmmidi::RedundantMsgFilter filter;
+  const auto ch = bmmidi::Channel::index(0);
+  const bmmidi::ProgramChangeMsg program{ch, bmmidi::PresetNumber::index(5)};
+  const bmmidi::ChanPressureMsg pressure{ch, bmmidi::DataValue{64}};
+  const bmmidi::PitchBendMsg bend{ch, bmmidi::PitchBend::midpoint()};
+  const bmmidi::KeyPressureMsg keyPressure{ch, bmmidi::KeyNumber::key(40), bmmidi::DataValue{9}};
+
+  EXPECT_THAT(filter.process(program), IsTrue());
+  EXPECT_THAT(filter.process(program), IsFalse());
+  EXPECT_THAT(filter.process(pressure), IsTrue());
+  EXPECT_THAT(filter.process(pressure), IsFalse());
+  EXPECT_THAT(filter.process(bend), IsTrue());
+  EXPECT_THAT(filter.process(bend), IsFalse());
+  EXPECT_THAT(filter.process(keyPressure), IsTrue());
+  EXPECT_THAT(filter.process(keyPressure), IsFalse());
+
+  // Reset All Controllers forgets controller state (but not program).
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kResetAllControllers, 0)), IsTrue());
+  EXPECT_THAT(filter.process(bend), IsTrue());
+  EXPECT_THAT(filter.process(pressure), IsTrue());
+  EXPECT_THAT(filter.process(program), IsFalse());
+
+  // System Reset forgets everything.
+  EXPECT_THAT(filter.process(bmmidi::systemResetMsg()), IsTrue());
+  EXPECT_THAT(filter.process(program), IsTrue());
+}
+
+TEST(RedundantMsgFilter, PassesRepeatedProgramAfterBankSelect) {
+  bmmidi::RedundantMsgFilter filter;
+  const bmmidi::ProgramChangeMsg program{bmmidi::Channel::index(0),
+                                         bmmidi::PresetNumber::index(5)};
+
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kBankSelect, 1)), IsTrue());
+  EXPECT_THAT(filter.process(program), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kBankSelect, 2)), IsTrue());
+  EXPECT_THAT(filter.process(program), IsTrue());  // Selects program 5 of bank 2.
+  EXPECT_THAT(filter.process(program), IsFalse());
+
+  // Even when the bank value repeats, or only the LSB is sent.
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kBankSelect, 2)), IsFalse());
+  EXPECT_THAT(filter.process(program), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kLsbBankSelect, 3)), IsTrue());
+  EXPECT_THAT(filter.process(program), IsTrue());
+
+  // Tracked per channel.
+  EXPECT_THAT(filter.process(cc(1, bmmidi::Control::kBankSelect, 4)), IsTrue());
+  EXPECT_THAT(filter.process(program), IsFalse());
+}
+
+TEST(RedundantMsgFilter, FollowsRules) {
+  bmmidi::RedundantMsgRules rules;
+  rules.programChanges = false;
+  rules.controls.reset(static_cast<int>(bmmidi::Control::kModWheel));
+  bmmidi::RedundantMsgFilter filter{rules};
+
+  const bmmidi::ProgramChangeMsg program{bmmidi::Channel::index(0),
+                                         bmmidi::PresetNumber::index(5)};
+  EXPECT_THAT(filter.process(program), IsTrue());
+  EXPECT_THAT(filter.process(program), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kModWheel, 1)), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kModWheel, 1)), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kBreath, 1)), IsTrue());
+  EXPECT_THAT(filter.process(cc(0, bmmidi::Control::kBreath, 1)), IsFalse());
+}
+
+TEST(RedundantMsgFilter, PassesSystemMsgs) {
+  bmmidi::RedundantMsgFilter filter;
+  EXPECT_THAT(filter.process(bmmidi::timingClockMsg()), IsTrue());
+  EXPECT_THAT(filter.process(bmmidi::timingClockMsg()), IsTrue());
+}
+
+}  // namespace
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/routing_matrix.hpp"
+
+#include <utility>
+
+namespace bmmidi {
+
+RoutingMatrix::RoutingMatrix(
+    const std::vector<ChannelRoute>& routes, std::vector<int> systemPorts)
+    : systemPorts_{std::move(systemPorts)} {
+  // Bucket targets by slot (keeping route order within each slot), then flatten.
+  std::vector<std::vector<Target>> slotTargets(kNumSlots);
+  for (const ChannelRoute& route : routes) {
+    assert(route.input.isNormal() || route.input.isOmni());
+    assert(route.output.isNormal() || route.output.isNone());
+    assert(route.outputPort >= 0);
+    assert(route.firstKey.isNormal() && route.lastKey.isNormal());
+
+    const int firstInput = route.input.isOmni() ? 0 : route.input.index();
+    const int lastInput = route.input.isOmni() ? kNumChannels - 1 : route.input.index();
+    for (int input = firstInput; input <= lastInput; ++input) {
+      for (int t = 0; t < kNumChanMsgTypes; ++t) {
+        if ((route.msgTypes & (0x01 << t)) == 0) { continue; }
+
+        // Key range only applies to the keyed message types.
+        const auto type = static_cast<MsgType>((t + 0x08) << 4);
+        const bool hasKey = (type <= MsgType::kPolyphonicKeyPressure);
+        slotTargets[input * kNumChanMsgTypes + t].push_back(Target{
+            route.outputPort, route.output,
+            hasKey ? route.firstKey.value() : 0, hasKey ? route.lastKey.value() : 0});
+      }
+    }
+  }
+
+  int numTargets = 0;
+  for (int slot = 0; slot < kNumSlots; ++slot) {
+    slotStarts_[slot] = numTargets;
+    numTargets += static_cast<int>(slotTargets[slot].size());
+  }
+  slotStarts_[kNumSlots] = numTargets;
+
+  targets_.reserve(numTargets);
+  for (const auto& targets : slotTargets) {
+    targets_.insert(targets_.end(), targets.begin(), targets.end());
+  }
+}
+
+}  // namespace bmmidi
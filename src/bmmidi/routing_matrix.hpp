@@ -0,0 +1,170 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_ROUTING_MATRIX_HPP
+#define BMMIDI_ROUTING_MATRIX_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+/** ChannelRoute::msgTypes value that matches all Channel message types. */
+BMMIDI_INLINE_VAR static constexpr std::uint8_t kAllChanMsgTypes = 0x7F;
+
+/**
+ * Returns ChannelRoute::msgTypes bit for the given Channel message type (e.g.
+ * combine chanMsgTypeBit(MsgType::kNoteOn) | chanMsgTypeBit(MsgType::kNoteOff)
+ * to route only notes).
+ */
+inline constexpr std::uint8_t chanMsgTypeBit(MsgType type) {
+  return static_cast<std::uint8_t>(0x01 << ((static_cast<std::uint8_t>(type) >> 4) - 0x08));
+}
+
+/** One input-to-output connection of a RoutingMatrix. */
+struct ChannelRoute {
+  /** Input channel to route from, or Channel::omni() for all channels. */
+  Channel input = Channel::omni();
+
+  /** Application-defined output port index (>= 0). */
+  int outputPort = 0;
+
+  /** Output channel, or Channel::none() to keep the input channel. */
+  Channel output = Channel::none();
+
+  /** Bitwise-OR of chanMsgTypeBit() values of message types to route. */
+  std::uint8_t msgTypes = kAllChanMsgTypes;
+
+  /**
+   * Range of keys to route for Note On/Off and Poly Key Pressure messages
+   * (other message types are unaffected).
+   */
+  KeyNumber firstKey = KeyNumber::first();
+  KeyNumber lastKey = KeyNumber::last();
+};
+
+/**
+ * Routes Channel messages from each input channel to zero or more (output
+ * port, output channel) destinations, merging and splitting as configured by
+ * a list of ChannelRoute values.
+ *
+ * Routes are precompiled into a flat table indexed by (input channel, message
+ * type), so routing a message is one table lookup plus a copy per destination.
+ * System messages are passed through unchanged to a separate list of ports.
+ *
+ * Example 16x16 patch: channel 1 to port 0 channel 1 and to port 1 channel 5
+ * (notes only), all other channels to port 2 unchanged:
+ *
+ *   std::vector<bmmidi::ChannelRoute> routes(3);
+ *   routes[0].input = bmmidi::Channel::index(0);
+ *   routes[1].input = bmmidi::Channel::index(0);
+ *   routes[1].outputPort = 1;
+ *   routes[1].output = bmmidi::Channel::index(4);
+ *   routes[1].msgTypes = bmmidi::chanMsgTypeBit(bmmidi::MsgType::kNoteOn)
+ *                      | bmmidi::chanMsgTypeBit(bmmidi::MsgType::kNoteOff);
+ *   for (int i = 1; i < bmmidi::kNumChannels; ++i) { ... outputPort = 2 ... }
+ *
+ * Note that overlapping routes to the same destination produce duplicates.
+ */
+class RoutingMatrix {
+public:
+  /** Creates a matrix that routes nothing. */
+  RoutingMatrix() : RoutingMatrix{std::vector<ChannelRoute>{}} {}
+
+  /**
+   * Compiles routes (emitted in the given order for each message), sending
+   * System messages to systemPorts.
+   */
+  explicit RoutingMatrix(const std::vector<ChannelRoute>& routes,
+                         std::vector<int> systemPorts = {});
+
+  /**
+   * Calls emit(int port, const MsgView& msg) for each destination of msg
+   * (which is only valid during the call), returning the # of destinations.
+   */
+  template<typename EmitFn>
+  int route(const MsgView& msg, EmitFn&& emit) const {
+    const Status status = msg.status();
+    if (!status.isChannelSpecific()) {
+      for (int port : systemPorts_) { emit(port, msg); }
+      return static_cast<int>(systemPorts_.size());
+    }
+
+    const int numBytes = msg.numBytes();
+    assert(numBytes <= kMaxChanMsgBytes);
+    const std::uint8_t* inBytes = msg.rawBytes();
+    const bool hasKey = ((status.value() & 0xF0) <= static_cast<std::uint8_t>(
+                                                       MsgType::kPolyphonicKeyPressure));
+    const int key = hasKey ? inBytes[1] : 0;
+
+    const int slot = slotIndex(status.value());
+    int numRouted = 0;
+    for (int i = slotStarts_[slot]; i < slotStarts_[slot + 1]; ++i) {
+      const Target& target = targets_[i];
+      if ((key < target.firstKey) || (key > target.lastKey)) { continue; }
+
+      if (target.channel.isNone()) {
+        emit(target.port, msg);
+      } else {
+        std::uint8_t bytes[kMaxChanMsgBytes];
+        std::memcpy(bytes, inBytes, numBytes);
+        ChanMsgRef{bytes, numBytes}.setChannel(target.channel);
+        emit(target.port, MsgView{bytes, numBytes});
+      }
+      ++numRouted;
+    }
+    return numRouted;
+  }
+
+  /**
+   * Calls emit(int port, const TimedMsgView& timedMsg) for each destination
+   * of timedMsg (which is only valid during the call), returning the # of
+   * destinations.
+   */
+  template<typename EmitFn>
+  int route(const TimedMsgView& timedMsg, EmitFn&& emit) const {
+    return route(timedMsg.value(), [&](int port, const MsgView& msg) {
+      emit(port, TimedMsgView{timedMsg.timestamp(), msg});
+    });
+  }
+
+  /** Returns # of destinations for messages of type on the input channel. */
+  int numDestinations(Channel input, MsgType type) const {
+    const int slot = slotIndex(Status::channelVoice(type, input).value());
+    return slotStarts_[slot + 1] - slotStarts_[slot];
+  }
+
+private:
+  static constexpr int kNumChanMsgTypes = 7;
+  static constexpr int kNumSlots = kNumChannels * kNumChanMsgTypes;
+  static constexpr int kMaxChanMsgBytes = 3;
+
+  struct Target {
+    int port;
+    Channel channel;
+    int firstKey;
+    int lastKey;
+  };
+
+  static int slotIndex(std::uint8_t status) {
+    return (status & 0x0F) * kNumChanMsgTypes + ((status >> 4) - 0x08);
+  }
+
+  // Destinations for slot i are targets_[slotStarts_[i], slotStarts_[i + 1]).
+  int slotStarts_[kNumSlots + 1];
+  std::vector<Target> targets_;
+  std::vector<int> systemPorts_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_ROUTING_MATRIX_HPP
@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/routing_matrix.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+
+// (port, raw bytes) of each routed message.
+using Routed = std::vector<std::pair<int, std::vector<int>>>;
+
+Routed routeMsg(const bmmidi::RoutingMatrix& matrix, const bmmidi::MsgView& msg) {
+  Routed result;
+  const int numRouted = matrix.route(msg, [&result](int port, const bmmidi::MsgView& out) {
+    result.emplace_back(port, std::vector<int>(out.rawBytes(), out.rawBytes() + out.numBytes()));
+  });
+  EXPECT_THAT(numRouted, Eq(static_cast<int>(result.size())));
+  return result;
+}
+
+TEST(RoutingMatrix, RoutesNothingByDefault) {
+  const bmmidi::RoutingMatrix matrix;
+  const auto note = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(0), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{100});
+  EXPECT_THAT(routeMsg(matrix, note), IsEmpty());
+  EXPECT_THAT(routeMsg(matrix, bmmidi::timingClockMsg()), IsEmpty());
+}
+
+TEST(RoutingMatrix, SplitsAndRechannels) {
+  std::vector<bmmidi::ChannelRoute> routes(2);
+  routes[0].input = bmmidi::Channel::index(0);
+  routes[1].input = bmmidi::Channel::index(0);
+  routes[1].outputPort = 1;
+  routes[1].output = bmmidi::Channel::index(4);
+  const bmmidi::RoutingMatrix matrix{routes};
+
+  const auto note = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(0), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{100});
+  EXPECT_THAT(routeMsg(matrix, note), ElementsAre(Pair(0, ElementsAre(0x90, 60, 100)),
+                                                  Pair(1, ElementsAre(0x94, 60, 100))));
+
+  const auto otherChannel = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(1), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{100});
+  EXPECT_THAT(routeMsg(matrix, otherChannel), IsEmpty());
+
+  EXPECT_THAT(matrix.numDestinations(bmmidi::Channel::index(0), bmmidi::MsgType::kPitchBend),
+              Eq(2));
+}
+
+TEST(RoutingMatrix, MergesOmniInputs) {
+  std::vector<bmmidi::ChannelRoute> routes(1);
+  routes[0].outputPort = 3;
+  routes[0].output = bmmidi::Channel::index(15);
+  const bmmidi::RoutingMatrix matrix{routes};
+
+  for (int i = 0; i < bmmidi::kNumChannels; ++i) {
+    const bmmidi::ProgramChangeMsg program{bmmidi::Channel::index(i),
+                                           bmmidi::PresetNumber::index(i)};
+    EXPECT_THAT(routeMsg(matrix, program), ElementsAre(Pair(3, ElementsAre(0xCF, i))));
+  }
+}
+
+TEST(RoutingMatrix, FiltersByTypeAndKeyRange) {
+  std::vector<bmmidi::ChannelRoute> routes(1);
+  routes[0].input = bmmidi::Channel::index(2);
+  routes[0].msgTypes = bmmidi::chanMsgTypeBit(bmmidi::MsgType::kNoteOn)
+                     | bmmidi::chanMsgTypeBit(bmmidi::MsgType::kNoteOff)
+                     | bmmidi::chanMsgTypeBit(bmmidi::MsgType::kControlChange);
+  routes[0].firstKey = bmmidi::KeyNumber::key(48);
+  routes[0].lastKey = bmmidi::KeyNumber::key(59);
+  const bmmidi::RoutingMatrix matrix{routes};
+
+  const auto ch = bmmidi::Channel::index(2);
+  EXPECT_THAT(routeMsg(matrix, bmmidi::NoteMsg::off(ch, bmmidi::KeyNumber::key(48))).size(),
+              Eq(1u));
+  EXPECT_THAT(routeMsg(matrix, bmmidi::NoteMsg::off(ch, bmmidi::KeyNumber::key(60))), IsEmpty());
+
+  // Key range does not apply to CC numbers.
+  const bmmidi::ControlChangeMsg cc{ch, bmmidi::Control::kSustainPedal, bmmidi::DataValue{127}};
+  EXPECT_THAT(routeMsg(matrix, cc).size(), Eq(1u));
+
+  const bmmidi::PitchBendMsg bend{ch, bmmidi::PitchBend::midpoint()};
+  EXPECT_THAT(routeMsg(matrix, bend), IsEmpty());
+}
+
+TEST(RoutingMatrix, PassesSystemMsgsToSystemPorts) {
+  const bmmidi::RoutingMatrix matrix{{}, {0, 2}};
+  EXPECT_THAT(routeMsg(matrix, bmmidi::timingClockMsg()),
+              ElementsAre(Pair(0, ElementsAre(0xF8)), Pair(2, ElementsAre(0xF8))));
+}
+
+TEST(RoutingMatrix, RoutesTimedMsgs) {
+  std::vector<bmmidi::ChannelRoute> routes(1);
+  routes[0].output = bmmidi::Channel::index(7);
+  const bmmidi::RoutingMatrix matrix{routes};
+
+  const auto timedNote = bmmidi::TimedNoteMsg::on(
+      1.5, bmmidi::Channel::index(0), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{100});
+  int numCalls = 0;
+  matrix.route(timedNote.asView<bmmidi::MsgView>(),
+               [&numCalls](int port, const bmmidi::TimedMsgView& out) {
+    ++numCalls;
+    EXPECT_THAT(port, Eq(0));
+    EXPECT_THAT(out.timestamp(), Eq(1.5));
+    EXPECT_THAT(out.value().rawBytes()[0], Eq(0x97));
+  });
+  EXPECT_THAT(numCalls, Eq(1));
+}
+
+}  // namespace
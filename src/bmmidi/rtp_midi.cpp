@@ -0,0 +1,875 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/rtp_midi.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "bmmidi/running_status.hpp"
+#include "bmmidi/status.hpp"
+#include "bmmidi/sysex.hpp"
+
+namespace bmmidi {
+namespace {
+
+constexpr int kRtpHeaderBytes = 12;
+constexpr std::uint8_t kRtpVersion = 2;
+constexpr std::uint8_t kRtpPaddingFlag = 0x20;
+constexpr std::uint8_t kRtpExtensionFlag = 0x10;
+constexpr std::uint8_t kRtpMarkerFlag = 0x80;
+
+// MIDI command section header: B J Z P LEN (4 bits, or 12 bits if B is set).
+constexpr std::uint8_t kLongLenFlag = 0x80;
+constexpr std::uint8_t kJournalFlag = 0x40;
+constexpr std::uint8_t kFirstDeltaFlag = 0x20;
+constexpr int kMaxShortListBytes = 0x0F;
+constexpr int kMaxListBytes = 0x0FFF;
+constexpr int kMaxDeltaBytes = 4;
+constexpr std::int64_t kMaxDelta = 0x0FFFFFFF;
+
+// Recovery journal header: S Y A H TOTCHAN (4 bits), checkpoint seq (16 bits).
+constexpr int kJournalHeaderBytes = 3;
+constexpr std::uint8_t kSingleLossFlag = 0x80;
+constexpr std::uint8_t kSystemJournalFlag = 0x40;
+constexpr std::uint8_t kChannelJournalsFlag = 0x20;
+
+// Channel journal header: S CHAN (4 bits) H LENGTH (10 bits), then the table
+// of contents with one bit per chapter (in the order chapters appear).
+constexpr int kChannelHeaderBytes = 3;
+constexpr std::uint8_t kChapterP = 0x80;
+constexpr std::uint8_t kChapterC = 0x40;
+constexpr std::uint8_t kChapterM = 0x20;
+constexpr std::uint8_t kChapterW = 0x10;
+constexpr std::uint8_t kChapterN = 0x08;
+constexpr std::uint8_t kChapterE = 0x04;
+constexpr std::uint8_t kChapterT = 0x02;
+constexpr std::uint8_t kChapterA = 0x01;
+
+// The S bit (or, for chapter N, the B bit) is 0 if a journal structure codes
+// changes made by the immediately previous packet.
+constexpr std::uint8_t kSBit = 0x80;
+constexpr std::uint8_t kPlayBit = 0x80;
+constexpr std::uint8_t kBankBit = 0x80;
+
+// Chapter N codes "no offbits" as LOW > HIGH, and 128 note logs as LEN = 127
+// with LOW = 15 and HIGH = 0.
+constexpr int kNoOffBitsLow = 15;
+constexpr int kMaxShortNoteLogs = 127;
+
+constexpr std::uint8_t kSysExStart = static_cast<std::uint8_t>(MsgType::kSystemExclusive);
+constexpr std::uint8_t kSysExEnd = static_cast<std::uint8_t>(MsgType::kEndOfSystemExclusive);
+constexpr std::uint8_t kSysExCancel = 0xF4;
+constexpr std::uint8_t kFirstRealtimeStatus = 0xF8;
+constexpr std::uint8_t kDefaultOffVelocity = 64;
+
+void appendBigEndian16(std::vector<std::uint8_t>& out, std::uint16_t value) {
+  out.push_back(static_cast<std::uint8_t>(value >> 8));
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void appendBigEndian32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+  appendBigEndian16(out, static_cast<std::uint16_t>(value >> 16));
+  appendBigEndian16(out, static_cast<std::uint16_t>(value));
+}
+
+std::uint16_t readBigEndian16(const std::uint8_t* bytes) {
+  return static_cast<std::uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+std::uint32_t readBigEndian32(const std::uint8_t* bytes) {
+  return (static_cast<std::uint32_t>(readBigEndian16(bytes)) << 16) | readBigEndian16(bytes + 2);
+}
+
+int numDeltaBytes(std::uint32_t delta) {
+  int numBytes = 1;
+  for (delta >>= 7; delta != 0; delta >>= 7) { ++numBytes; }
+  return numBytes;
+}
+
+// Appends delta as a variable-length quantity (7 bits per byte, MSB first).
+void appendDelta(std::vector<std::uint8_t>& out, std::uint32_t delta) {
+  for (int shift = 7 * (numDeltaBytes(delta) - 1); shift > 0; shift -= 7) {
+    out.push_back(static_cast<std::uint8_t>(0x80 | ((delta >> shift) & 0x7F)));
+  }
+  out.push_back(static_cast<std::uint8_t>(delta & 0x7F));
+}
+
+// Returns the 10-bit LENGTH field of a journal structure header.
+int readLength10(const std::uint8_t* bytes) {
+  return ((bytes[0] & 0x03) << 8) | bytes[1];
+}
+
+// Removes items no longer changed after checkpointIndex from active.
+void pruneActive(std::vector<std::uint8_t>& active, std::bitset<kNumKeys>& isActive,
+                 const std::int64_t* changed, std::int64_t checkpointIndex) {
+  auto kept = active.begin();
+  for (const std::uint8_t item : active) {
+    if (changed[item] > checkpointIndex) {
+      *kept++ = item;
+    } else {
+      isActive.reset(item);
+    }
+  }
+  active.erase(kept, active.end());
+}
+
+void markActive(std::vector<std::uint8_t>& active, std::bitset<kNumKeys>& isActive, int item) {
+  if (!isActive.test(item)) {
+    isActive.set(item);
+    active.push_back(static_cast<std::uint8_t>(item));
+  }
+}
+
+}  // namespace
+
+RtpMidiSender::RtpMidiSender(const RtpMidiSenderOptions& options)
+    : options_{options}, firstSeq_{options.firstSeq} {
+  assert(options.maxPacketBytes > kRtpHeaderBytes + 2);
+  for (JournalChannel& channel : channels_) { resetChannel(channel); }
+}
+
+void RtpMidiSender::resetChannel(JournalChannel& channel) {
+  channel.program = 0;
+  channel.bankMsb = 0;
+  channel.bankLsb = 0;
+  channel.hasBank = false;
+  channel.programChanged = 0;
+
+  std::memset(channel.controls, 0, sizeof(channel.controls));
+  std::fill(std::begin(channel.controlChanged), std::end(channel.controlChanged), 0);
+  channel.isControlActive.reset();
+  channel.activeControls.clear();
+
+  channel.bendLsb = 0;
+  channel.bendMsb = 0;
+  channel.bendChanged = 0;
+
+  std::memset(channel.velocities, 0, sizeof(channel.velocities));
+  std::fill(std::begin(channel.noteChanged), std::end(channel.noteChanged), 0);
+  channel.isNoteActive.reset();
+  channel.activeNotes.clear();
+
+  channel.chanPressure = 0;
+  channel.chanPressureChanged = 0;
+
+  std::memset(channel.keyPressures, 0, sizeof(channel.keyPressures));
+  std::fill(std::begin(channel.keyPressureChanged), std::end(channel.keyPressureChanged), 0);
+  channel.isKeyPressureActive.reset();
+  channel.activeKeyPressures.clear();
+
+  channel.lastChanged = 0;
+  channel.cache.clear();
+  channel.isCacheValid = false;
+}
+
+int RtpMidiSender::encodePacket(double timestamp, const TimedMsgBuffer& msgs, int firstIndex,
+                                std::vector<std::uint8_t>& packet) {
+  assert((0 <= firstIndex) && (firstIndex <= msgs.size()));
+  ++numPackets_;
+
+  // The journal codes the packets before this one, so is encoded before this
+  // packet's messages are recorded.
+  journal_.clear();
+  if (options_.useJournal) { encodeJournal(); }
+
+  const int numAvailableBytes = options_.maxPacketBytes - kRtpHeaderBytes - 2
+      - static_cast<int>(journal_.size());
+  const int maxListBytes = std::min(numAvailableBytes, kMaxListBytes);
+
+  const std::int64_t packetTicks = static_cast<std::int64_t>(std::llround(timestamp));
+  std::int64_t prevTicks = packetTicks;
+  RunningStatusEncoder runningStatus;
+  commands_.clear();
+  int numCommands = 0;
+  bool hasFirstDelta = false;
+
+  int index = firstIndex;
+  for (; index < msgs.size(); ++index) {
+    const TimedMsgView timedMsg = msgs[index];
+    const MsgView& msg = timedMsg.value();
+    const std::int64_t ticks = std::max(
+        prevTicks, static_cast<std::int64_t>(std::llround(timedMsg.timestamp())));
+    const auto delta = static_cast<std::uint32_t>(std::min(ticks - prevTicks, kMaxDelta));
+
+    // Every command but the first has a delta time, and the first has one only
+    // if nonzero.
+    const bool hasDelta = (numCommands > 0) || (delta != 0);
+    const int numBytes = (hasDelta ? numDeltaBytes(delta) : 0) + runningStatus.numWireBytes(msg);
+    if (static_cast<int>(commands_.size()) + numBytes > maxListBytes) {
+      if (numCommands > 0) { break; }
+      if (numBytes > kMaxListBytes) {
+        ++numDroppedMsgs_;
+        continue;
+      }
+    }
+
+    if (hasDelta) {
+      appendDelta(commands_, delta);
+      if (numCommands == 0) { hasFirstDelta = true; }
+    }
+    const int numOmitted = runningStatus.advance(msg);
+    commands_.insert(commands_.end(), msg.rawBytes() + numOmitted,
+                     msg.rawBytes() + msg.numBytes());
+    prevTicks = ticks;
+    ++numCommands;
+  }
+
+  packet.clear();
+  packet.push_back(static_cast<std::uint8_t>(kRtpVersion << 6));
+  packet.push_back(static_cast<std::uint8_t>(((numCommands > 0) ? kRtpMarkerFlag : 0)
+                                             | (options_.payloadType & 0x7F)));
+  appendBigEndian16(packet, static_cast<std::uint16_t>(firstSeq_ + numPackets_ - 1));
+  appendBigEndian32(packet, static_cast<std::uint32_t>(packetTicks));
+  appendBigEndian32(packet, options_.ssrc);
+
+  const int numListBytes = static_cast<int>(commands_.size());
+  const std::uint8_t flags = (options_.useJournal ? kJournalFlag : 0)
+      | (hasFirstDelta ? kFirstDeltaFlag : 0);
+  if (numListBytes > kMaxShortListBytes) {
+    packet.push_back(static_cast<std::uint8_t>(flags | kLongLenFlag | (numListBytes >> 8)));
+    packet.push_back(static_cast<std::uint8_t>(numListBytes));
+  } else {
+    packet.push_back(static_cast<std::uint8_t>(flags | numListBytes));
+  }
+  packet.insert(packet.end(), commands_.begin(), commands_.end());
+  packet.insert(packet.end(), journal_.begin(), journal_.end());
+
+  if (options_.useJournal) {
+    for (int i = firstIndex; i < index; ++i) { recordMsg(msgs[i].value()); }
+  }
+  return index - firstIndex;
+}
+
+void RtpMidiSender::setCheckpoint(std::uint16_t seq) {
+  const auto lastSeq = static_cast<std::uint16_t>(firstSeq_ + numPackets_ - 1);
+  const std::int64_t index = numPackets_ - static_cast<std::uint16_t>(lastSeq - seq);
+  if (index <= checkpointIndex_) { return; }
+
+  checkpointIndex_ = index;
+  for (JournalChannel& channel : channels_) { channel.isCacheValid = false; }
+}
+
+void RtpMidiSender::recordMsg(const MsgView& msg) {
+  if (!msg.status().isChannelSpecific()) { return; }
+
+  const std::uint8_t* bytes = msg.rawBytes();
+  JournalChannel& channel = channels_[bytes[0] & 0x0F];
+  const auto type = static_cast<MsgType>(bytes[0] & 0xF0);
+
+  switch (type) {
+    case MsgType::kNoteOff:
+    case MsgType::kNoteOn: {
+      const bool isOn = (type == MsgType::kNoteOn) && (bytes[2] != 0);
+      noteChanged(channel, bytes[1], isOn ? bytes[2] : 0);
+      break;
+    }
+
+    case MsgType::kPolyphonicKeyPressure:
+      channel.keyPressures[bytes[1]] = bytes[2];
+      channel.keyPressureChanged[bytes[1]] = numPackets_;
+      markActive(channel.activeKeyPressures, channel.isKeyPressureActive, bytes[1]);
+      break;
+
+    case MsgType::kControlChange: {
+      const int control = bytes[1];
+      if ((control == static_cast<int>(Control::kAllNotesOff))
+          || (control == static_cast<int>(Control::kAllSoundOff))) {
+        for (int key = 0; key < kNumKeys; ++key) {
+          if (channel.velocities[key] != 0) { noteChanged(channel, key, 0); }
+        }
+        break;
+      }
+      if (control >= static_cast<int>(Control::kAllSoundOff)) { return; }
+
+      channel.controls[control] = bytes[2];
+      channel.controlChanged[control] = numPackets_;
+      markActive(channel.activeControls, channel.isControlActive, control);
+      break;
+    }
+
+    case MsgType::kProgramChange:
+      channel.program = bytes[1];
+      channel.bankMsb = channel.controls[static_cast<int>(Control::kBankSelect)];
+      channel.bankLsb = channel.controls[static_cast<int>(Control::kLsbBankSelect)];
+      channel.hasBank = (channel.controlChanged[static_cast<int>(Control::kBankSelect)] != 0);
+      channel.programChanged = numPackets_;
+      break;
+
+    case MsgType::kChannelPressure:
+      channel.chanPressure = bytes[1];
+      channel.chanPressureChanged = numPackets_;
+      break;
+
+    case MsgType::kPitchBend:
+      channel.bendLsb = bytes[1];
+      channel.bendMsb = bytes[2];
+      channel.bendChanged = numPackets_;
+      break;
+
+    default:
+      return;
+  }
+
+  channel.lastChanged = numPackets_;
+  channel.isCacheValid = false;
+}
+
+void RtpMidiSender::noteChanged(JournalChannel& channel, int key, std::uint8_t velocity) {
+  channel.velocities[key] = velocity;
+  channel.noteChanged[key] = numPackets_;
+  markActive(channel.activeNotes, channel.isNoteActive, key);
+}
+
+void RtpMidiSender::encodeJournal() {
+  const std::int64_t prevIndex = numPackets_ - 1;
+  journal_.resize(kJournalHeaderBytes);
+
+  int numChannels = 0;
+  bool isSingleLossIrrelevant = true;
+  for (int chan = 0; chan < kNumChannels; ++chan) {
+    JournalChannel& channel = channels_[chan];
+    if (channel.lastChanged <= checkpointIndex_) { continue; }
+
+    if (!channel.isCacheValid) { encodeChannel(chan, channel); }
+    if (channel.cache.empty()) { continue; }
+
+    journal_.insert(journal_.end(), channel.cache.begin(), channel.cache.end());
+    ++numChannels;
+    if (channel.lastChanged == prevIndex) { isSingleLossIrrelevant = false; }
+  }
+
+  journal_[0] = static_cast<std::uint8_t>((isSingleLossIrrelevant ? kSingleLossFlag : 0)
+      | ((numChannels > 0) ? (kChannelJournalsFlag | (numChannels - 1)) : 0));
+  const auto checkpointSeq = static_cast<std::uint16_t>(firstSeq_ + checkpointIndex_ - 1);
+  journal_[1] = static_cast<std::uint8_t>(checkpointSeq >> 8);
+  journal_[2] = static_cast<std::uint8_t>(checkpointSeq);
+}
+
+void RtpMidiSender::encodeChannel(int chan, JournalChannel& channel) {
+  const std::int64_t prevIndex = numPackets_ - 1;
+  const auto sBit = [prevIndex](std::int64_t changed) -> std::uint8_t {
+    return (changed == prevIndex) ? 0 : kSBit;
+  };
+
+  std::vector<std::uint8_t>& out = channel.cache;
+  out.assign(kChannelHeaderBytes, 0);
+  std::uint8_t chapters = 0;
+
+  if (channel.programChanged > checkpointIndex_) {
+    chapters |= kChapterP;
+    out.push_back(sBit(channel.programChanged) | channel.program);
+    out.push_back((channel.hasBank ? kBankBit : 0) | channel.bankMsb);
+    out.push_back(channel.bankLsb);
+  }
+
+  pruneActive(channel.activeControls, channel.isControlActive, channel.controlChanged,
+              checkpointIndex_);
+  if (!channel.activeControls.empty()) {
+    chapters |= kChapterC;
+    const std::size_t headerIndex = out.size();
+    out.push_back(0);
+    std::uint8_t chapterS = kSBit;
+    for (const std::uint8_t control : channel.activeControls) {
+      const std::uint8_t s = sBit(channel.controlChanged[control]);
+      chapterS &= s;
+      out.push_back(s | control);
+      out.push_back(channel.controls[control]);
+    }
+    out[headerIndex] = static_cast<std::uint8_t>(
+        chapterS | (channel.activeControls.size() - 1));
+  }
+
+  if (channel.bendChanged > checkpointIndex_) {
+    chapters |= kChapterW;
+    out.push_back(sBit(channel.bendChanged) | channel.bendLsb);
+    out.push_back(channel.bendMsb);
+  }
+
+  pruneActive(channel.activeNotes, channel.isNoteActive, channel.noteChanged, checkpointIndex_);
+  if (!channel.activeNotes.empty()) {
+    chapters |= kChapterN;
+    const std::size_t headerIndex = out.size();
+    out.push_back(0);
+    out.push_back(0);
+
+    std::uint8_t offBits[kNumKeys / 8] = {};
+    int low = kNoOffBitsLow;
+    int high = -1;
+    int numLogs = 0;
+    std::uint8_t chapterS = kSBit;
+    for (const std::uint8_t key : channel.activeNotes) {
+      const std::uint8_t s = sBit(channel.noteChanged[key]);
+      chapterS &= s;
+      if (channel.velocities[key] != 0) {
+        out.push_back(s | key);
+        out.push_back(kPlayBit | channel.velocities[key]);
+        ++numLogs;
+      } else {
+        offBits[key / 8] |= (0x80 >> (key % 8));
+        low = std::min(low, key / 8);
+        high = std::max(high, key / 8);
+      }
+    }
+
+    if (high >= 0) {
+      out.insert(out.end(), &offBits[low], &offBits[high + 1]);
+    } else {
+      // LOW = 15 with HIGH = 0 would mean 128 logs if there are 127.
+      high = (numLogs == kMaxShortNoteLogs) ? 1 : 0;
+    }
+    out[headerIndex] = static_cast<std::uint8_t>(
+        chapterS | std::min(numLogs, kMaxShortNoteLogs));
+    out[headerIndex + 1] = static_cast<std::uint8_t>((low << 4) | high);
+  }
+
+  if (channel.chanPressureChanged > checkpointIndex_) {
+    chapters |= kChapterT;
+    out.push_back(sBit(channel.chanPressureChanged) | channel.chanPressure);
+  }
+
+  pruneActive(channel.activeKeyPressures, channel.isKeyPressureActive,
+              channel.keyPressureChanged, checkpointIndex_);
+  if (!channel.activeKeyPressures.empty()) {
+    chapters |= kChapterA;
+    const std::size_t headerIndex = out.size();
+    out.push_back(0);
+    std::uint8_t chapterS = kSBit;
+    for (const std::uint8_t key : channel.activeKeyPressures) {
+      const std::uint8_t s = sBit(channel.keyPressureChanged[key]);
+      chapterS &= s;
+      out.push_back(s | key);
+      out.push_back(channel.keyPressures[key]);
+    }
+    out[headerIndex] = static_cast<std::uint8_t>(
+        chapterS | (channel.activeKeyPressures.size() - 1));
+  }
+
+  if (chapters == 0) {
+    out.clear();
+  } else {
+    const int length = static_cast<int>(out.size());
+    out[0] = static_cast<std::uint8_t>(sBit(channel.lastChanged) | (chan << 3) | (length >> 8));
+    out[1] = static_cast<std::uint8_t>(length);
+    out[2] = chapters;
+  }
+
+  // S bits only stay valid if nothing changed in the previous packet.
+  channel.isCacheValid = (channel.lastChanged != prevIndex);
+}
+
+RtpMidiReceiver::RtpMidiReceiver() { reset(); }
+
+void RtpMidiReceiver::reset() {
+  hasReceived_ = false;
+  lastHeader_ = RtpMidiHeader{};
+  for (ChannelState& state : channels_) {
+    std::memset(state.controls, kUnknown, sizeof(state.controls));
+    std::memset(state.keyPressures, kUnknown, sizeof(state.keyPressures));
+    std::memset(state.velocities, 0, sizeof(state.velocities));
+    state.program = kUnknown;
+    state.chanPressure = kUnknown;
+    state.pitchBend = kUnknown;
+  }
+}
+
+RtpMidiResult RtpMidiReceiver::receive(const std::uint8_t* bytes, int numBytes,
+                                       TimedMsgBuffer& msgs) {
+  if ((numBytes < kRtpHeaderBytes) || ((bytes[0] >> 6) != kRtpVersion)) {
+    return RtpMidiResult::kNotRtp;
+  }
+
+  int end = numBytes;
+  if ((bytes[0] & kRtpPaddingFlag) != 0) {
+    const int numPaddingBytes = bytes[end - 1];
+    if ((numPaddingBytes == 0) || (numPaddingBytes > end - kRtpHeaderBytes)) {
+      return RtpMidiResult::kTruncated;
+    }
+    end -= numPaddingBytes;
+  }
+  int pos = kRtpHeaderBytes + 4 * (bytes[0] & 0x0F);
+  if ((bytes[0] & kRtpExtensionFlag) != 0) {
+    if (pos + 4 > end) { return RtpMidiResult::kTruncated; }
+    pos += 4 + 4 * readBigEndian16(&bytes[pos + 2]);
+  }
+
+  RtpMidiHeader header;
+  header.marker = (bytes[1] & kRtpMarkerFlag) != 0;
+  header.payloadType = bytes[1] & 0x7F;
+  header.seq = readBigEndian16(&bytes[2]);
+  header.timestamp = readBigEndian32(&bytes[4]);
+  header.ssrc = readBigEndian32(&bytes[8]);
+
+  int numLost = 0;
+  if (hasReceived_) {
+    const auto gap = static_cast<std::int16_t>(header.seq - expectedSeq_);
+    if (gap < 0) { return RtpMidiResult::kOutOfOrder; }
+    numLost = gap;
+  }
+
+  if (pos >= end) { return RtpMidiResult::kTruncated; }
+  const std::uint8_t flags = bytes[pos];
+  int numListBytes = flags & 0x0F;
+  ++pos;
+  if ((flags & kLongLenFlag) != 0) {
+    if (pos >= end) { return RtpMidiResult::kTruncated; }
+    numListBytes = (numListBytes << 8) | bytes[pos];
+    ++pos;
+  }
+  if (pos + numListBytes > end) { return RtpMidiResult::kTruncated; }
+
+  // Unwrap the 32-bit RTP timestamp relative to the last packet's.
+  if (hasReceived_) {
+    timestamp_ += static_cast<std::int32_t>(
+        header.timestamp - static_cast<std::uint32_t>(timestamp_));
+  } else {
+    timestamp_ = header.timestamp;
+  }
+  lastHeader_ = header;
+
+  const int journalPos = pos + numListBytes;
+  if ((numLost > 0) && ((flags & kJournalFlag) != 0)) {
+    const RtpMidiResult result = decodeJournal(
+        &bytes[journalPos], end - journalPos, (numLost == 1), msgs);
+    if (result != RtpMidiResult::kOk) { return result; }
+  }
+
+  const RtpMidiResult result = decodeCommands(
+      &bytes[pos], numListBytes, (flags & kFirstDeltaFlag) != 0, msgs);
+  if (result != RtpMidiResult::kOk) { return result; }
+
+  // Only count the packet as received once fully decoded, so that after a
+  // malformed packet the next one recovers from its journal.
+  hasReceived_ = true;
+  expectedSeq_ = static_cast<std::uint16_t>(header.seq + 1);
+  numLostPackets_ += numLost;
+  return RtpMidiResult::kOk;
+}
+
+RtpMidiResult RtpMidiReceiver::decodeCommands(const std::uint8_t* bytes, int numBytes,
+                                              bool hasFirstDelta, TimedMsgBuffer& msgs) {
+  std::int64_t ticks = timestamp_;
+  std::uint8_t runningStatus = 0;
+  bool isFirst = true;
+
+  int pos = 0;
+  while (pos < numBytes) {
+    if (!isFirst || hasFirstDelta) {
+      std::uint32_t delta = 0;
+      for (int i = 0;; ++i) {
+        if ((pos >= numBytes) || (i == kMaxDeltaBytes)) { return RtpMidiResult::kTruncated; }
+        const std::uint8_t byte = bytes[pos++];
+        delta = (delta << 7) | (byte & 0x7F);
+        if ((byte & 0x80) == 0) { break; }
+      }
+      ticks += delta;
+      if (pos >= numBytes) { return RtpMidiResult::kTruncated; }
+    }
+    isFirst = false;
+    const auto timestamp = static_cast<double>(ticks);
+
+    std::uint8_t status = bytes[pos];
+    if (status < 0x80) {
+      if (runningStatus == 0) { return RtpMidiResult::kInvalidCommand; }
+      status = runningStatus;
+    } else {
+      ++pos;
+    }
+
+    if (status >= kFirstRealtimeStatus) {
+      if ((status == 0xF9) || (status == 0xFD)) { return RtpMidiResult::kInvalidCommand; }
+      emit(timestamp, &status, 1, msgs);
+      continue;
+    }
+
+    if ((status == kSysExStart) || (status == kSysExEnd)) {
+      // Realtime commands may be embedded in SysEx, so copy its data bytes.
+      runningStatus = 0;
+      sysEx_.clear();
+      sysEx_.push_back(status);
+      std::uint8_t terminator = 0;
+      while (terminator == 0) {
+        const int runStart = pos;
+        while ((pos < numBytes) && (bytes[pos] < 0x80)) { ++pos; }
+        sysEx_.insert(sysEx_.end(), &bytes[runStart], &bytes[pos]);
+        if (pos >= numBytes) { return RtpMidiResult::kTruncated; }
+
+        const std::uint8_t byte = bytes[pos++];
+        if (byte >= kFirstRealtimeStatus) {
+          emit(timestamp, &byte, 1, msgs);
+        } else {
+          terminator = byte;
+        }
+      }
+
+      if ((terminator != kSysExEnd) && (terminator != kSysExStart)
+          && (terminator != kSysExCancel)) {
+        return RtpMidiResult::kInvalidCommand;
+      }
+      // Only complete SysEx (F0 ... F7) is emitted, not segments of one.
+      if ((status == kSysExStart) && (terminator == kSysExEnd)) {
+        sysEx_.push_back(kSysExEnd);
+        if (internal::hasCompleteSysExHeader(sysEx_.data(), static_cast<int>(sysEx_.size()))) {
+          emit(timestamp, sysEx_.data(), static_cast<int>(sysEx_.size()), msgs);
+        } else {
+          ++numDroppedSysEx_;  // E.g. empty (F0 F7), so unusable as any SysEx reference.
+        }
+      }
+      continue;
+    }
+
+    if (status >= kSysExStart) {
+      if ((status == kSysExCancel) || (status == 0xF5)) { return RtpMidiResult::kInvalidCommand; }
+      runningStatus = 0;
+    } else {
+      runningStatus = status;
+    }
+
+    const int numDataBytes = Status{status}.numDataBytes();
+    if (pos + numDataBytes > numBytes) { return RtpMidiResult::kTruncated; }
+    std::uint8_t msgBytes[3] = {status, 0, 0};
+    for (int i = 0; i < numDataBytes; ++i) {
+      if (bytes[pos + i] >= 0x80) { return RtpMidiResult::kInvalidCommand; }
+      msgBytes[1 + i] = bytes[pos + i];
+    }
+    pos += numDataBytes;
+    emit(timestamp, msgBytes, 1 + numDataBytes, msgs);
+  }
+  return RtpMidiResult::kOk;
+}
+
+RtpMidiResult RtpMidiReceiver::decodeJournal(const std::uint8_t* bytes, int numBytes,
+                                             bool isSingleLoss, TimedMsgBuffer& msgs) {
+  if (numBytes < kJournalHeaderBytes) { return RtpMidiResult::kTruncated; }
+  const std::uint8_t flags = bytes[0];
+  if (isSingleLoss && ((flags & kSingleLossFlag) != 0)) { return RtpMidiResult::kOk; }
+
+  int pos = kJournalHeaderBytes;
+  if ((flags & kSystemJournalFlag) != 0) {
+    if (pos + 2 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int length = readLength10(&bytes[pos]);
+    if ((length < 2) || (pos + length > numBytes)) { return RtpMidiResult::kTruncated; }
+    pos += length;
+  }
+
+  if ((flags & kChannelJournalsFlag) != 0) {
+    const int numChannels = (flags & 0x0F) + 1;
+    for (int i = 0; i < numChannels; ++i) {
+      if (pos + kChannelHeaderBytes > numBytes) { return RtpMidiResult::kTruncated; }
+      const int length = readLength10(&bytes[pos]);
+      if ((length < kChannelHeaderBytes) || (pos + length > numBytes)) {
+        return RtpMidiResult::kTruncated;
+      }
+      const RtpMidiResult result = recoverChannel(&bytes[pos], length, isSingleLoss, msgs);
+      if (result != RtpMidiResult::kOk) { return result; }
+      pos += length;
+    }
+  }
+  return RtpMidiResult::kOk;
+}
+
+RtpMidiResult RtpMidiReceiver::recoverChannel(const std::uint8_t* bytes, int numBytes,
+                                              bool isSingleLoss, TimedMsgBuffer& msgs) {
+  // After a single lost packet, only structures with S = 0 are relevant.
+  const auto isIrrelevant = [isSingleLoss](std::uint8_t byte) {
+    return isSingleLoss && ((byte & kSBit) != 0);
+  };
+  if (isIrrelevant(bytes[0])) { return RtpMidiResult::kOk; }
+
+  const int chan = (bytes[0] >> 3) & 0x0F;
+  const std::uint8_t chapters = bytes[2];
+  ChannelState& state = channels_[chan];
+  int pos = kChannelHeaderBytes;
+
+  if ((chapters & kChapterP) != 0) {
+    if (pos + 3 > numBytes) { return RtpMidiResult::kTruncated; }
+    if (!isIrrelevant(bytes[pos])) {
+      const int program = bytes[pos] & 0x7F;
+      bool needsProgram = (state.program != program);
+      if ((bytes[pos + 1] & kBankBit) != 0) {
+        const int bankMsb = bytes[pos + 1] & 0x7F;
+        const int bankLsb = bytes[pos + 2] & 0x7F;
+        const auto bankSelect = static_cast<int>(Control::kBankSelect);
+        const auto lsbBankSelect = static_cast<int>(Control::kLsbBankSelect);
+        if (state.controls[bankSelect] != bankMsb) {
+          recover(0xB0 | chan, bankSelect, bankMsb, msgs);
+          needsProgram = true;
+        }
+        if (state.controls[lsbBankSelect] != bankLsb) {
+          recover(0xB0 | chan, lsbBankSelect, bankLsb, msgs);
+          needsProgram = true;
+        }
+      }
+      if (needsProgram) { recover(0xC0 | chan, program, 0, msgs); }
+    }
+    pos += 3;
+  }
+
+  if ((chapters & kChapterC) != 0) {
+    if (pos + 1 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int numLogs = (bytes[pos] & 0x7F) + 1;
+    if (pos + 1 + 2 * numLogs > numBytes) { return RtpMidiResult::kTruncated; }
+    const bool isChapterIrrelevant = isIrrelevant(bytes[pos]);
+    for (int i = 0; i < numLogs; ++i) {
+      const std::uint8_t* log = &bytes[pos + 1 + 2 * i];
+      const int control = log[0] & 0x7F;
+      const int value = log[1] & 0x7F;
+      // Logs using the alternative (toggle/count) coding are not recovered.
+      const bool isAlt = (log[1] & 0x80) != 0;
+      if (isChapterIrrelevant || isIrrelevant(log[0]) || isAlt) { continue; }
+      if (control >= static_cast<int>(Control::kAllSoundOff)) { continue; }
+      if (state.controls[control] != value) { recover(0xB0 | chan, control, value, msgs); }
+    }
+    pos += 1 + 2 * numLogs;
+  }
+
+  if ((chapters & kChapterM) != 0) {
+    if (pos + 2 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int length = readLength10(&bytes[pos]);
+    if ((length < 2) || (pos + length > numBytes)) { return RtpMidiResult::kTruncated; }
+    pos += length;
+  }
+
+  if ((chapters & kChapterW) != 0) {
+    if (pos + 2 > numBytes) { return RtpMidiResult::kTruncated; }
+    if (!isIrrelevant(bytes[pos])) {
+      const int lsb = bytes[pos] & 0x7F;
+      const int msb = bytes[pos + 1] & 0x7F;
+      if (state.pitchBend != (lsb | (msb << 7))) { recover(0xE0 | chan, lsb, msb, msgs); }
+    }
+    pos += 2;
+  }
+
+  if ((chapters & kChapterN) != 0) {
+    if (pos + 2 > numBytes) { return RtpMidiResult::kTruncated; }
+    int numLogs = bytes[pos] & 0x7F;
+    const int low = bytes[pos + 1] >> 4;
+    const int high = bytes[pos + 1] & 0x0F;
+    if ((numLogs == kMaxShortNoteLogs) && (low == kNoOffBitsLow) && (high == 0)) {
+      numLogs = kNumKeys;
+    }
+    const int numOffBytes = (low <= high) ? (high - low + 1) : 0;
+    if (pos + 2 + 2 * numLogs + numOffBytes > numBytes) { return RtpMidiResult::kTruncated; }
+
+    if (!isIrrelevant(bytes[pos])) {
+      for (int i = 0; i < numLogs; ++i) {
+        const std::uint8_t* log = &bytes[pos + 2 + 2 * i];
+        const int key = log[0] & 0x7F;
+        const int velocity = log[1] & 0x7F;
+        const bool shouldPlay = (log[1] & kPlayBit) != 0;
+        if (isIrrelevant(log[0]) || !shouldPlay || (velocity == 0)) { continue; }
+        if (state.velocities[key] == 0) { recover(0x90 | chan, key, velocity, msgs); }
+      }
+
+      const std::uint8_t* offBits = &bytes[pos + 2 + 2 * numLogs];
+      for (int i = 0; i < numOffBytes; ++i) {
+        for (int bit = 0; bit < 8; ++bit) {
+          const int key = 8 * (low + i) + bit;
+          if (((offBits[i] & (0x80 >> bit)) != 0) && (state.velocities[key] != 0)) {
+            recover(0x80 | chan, key, kDefaultOffVelocity, msgs);
+          }
+        }
+      }
+    }
+    pos += 2 + 2 * numLogs + numOffBytes;
+  }
+
+  if ((chapters & kChapterE) != 0) {
+    if (pos + 1 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int numLogs = (bytes[pos] & 0x7F) + 1;
+    if (pos + 1 + 2 * numLogs > numBytes) { return RtpMidiResult::kTruncated; }
+    pos += 1 + 2 * numLogs;
+  }
+
+  if ((chapters & kChapterT) != 0) {
+    if (pos + 1 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int pressure = bytes[pos] & 0x7F;
+    if (!isIrrelevant(bytes[pos]) && (state.chanPressure != pressure)) {
+      recover(0xD0 | chan, pressure, 0, msgs);
+    }
+    pos += 1;
+  }
+
+  if ((chapters & kChapterA) != 0) {
+    if (pos + 1 > numBytes) { return RtpMidiResult::kTruncated; }
+    const int numLogs = (bytes[pos] & 0x7F) + 1;
+    if (pos + 1 + 2 * numLogs > numBytes) { return RtpMidiResult::kTruncated; }
+    const bool isChapterIrrelevant = isIrrelevant(bytes[pos]);
+    for (int i = 0; i < numLogs; ++i) {
+      const std::uint8_t* log = &bytes[pos + 1 + 2 * i];
+      const int key = log[0] & 0x7F;
+      const int pressure = log[1] & 0x7F;
+      if (isChapterIrrelevant || isIrrelevant(log[0])) { continue; }
+      if (state.keyPressures[key] != pressure) { recover(0xA0 | chan, key, pressure, msgs); }
+    }
+  }
+  return RtpMidiResult::kOk;
+}
+
+void RtpMidiReceiver::emit(double timestamp, const std::uint8_t* bytes, int numBytes,
+                           TimedMsgBuffer& msgs) {
+  msgs.push(timestamp, bytes, numBytes);
+  if (bytes[0] < kSysExStart) { trackMsg(bytes); }
+}
+
+void RtpMidiReceiver::recover(std::uint8_t status, int data1, int data2, TimedMsgBuffer& msgs) {
+  const std::uint8_t bytes[3] = {status, static_cast<std::uint8_t>(data1),
+                                 static_cast<std::uint8_t>(data2)};
+  emit(static_cast<double>(timestamp_), bytes, 1 + Status{status}.numDataBytes(), msgs);
+  ++numRecoveredMsgs_;
+}
+
+void RtpMidiReceiver::trackMsg(const std::uint8_t* bytes) {
+  ChannelState& state = channels_[bytes[0] & 0x0F];
+  const auto type = static_cast<MsgType>(bytes[0] & 0xF0);
+
+  switch (type) {
+    case MsgType::kNoteOff:
+    case MsgType::kNoteOn: {
+      const bool isOn = (type == MsgType::kNoteOn) && (bytes[2] != 0);
+      state.velocities[bytes[1]] = isOn ? bytes[2] : 0;
+      break;
+    }
+
+    case MsgType::kPolyphonicKeyPressure:
+      state.keyPressures[bytes[1]] = static_cast<std::int8_t>(bytes[2]);
+      break;
+
+    case MsgType::kControlChange: {
+      const int control = bytes[1];
+      if (control == static_cast<int>(Control::kResetAllControllers)) {
+        // Reset values are device-specific, so treat them as unknown.
+        std::memset(state.controls, kUnknown, sizeof(state.controls));
+        std::memset(state.keyPressures, kUnknown, sizeof(state.keyPressures));
+        state.chanPressure = kUnknown;
+        state.pitchBend = kUnknown;
+      } else if ((control == static_cast<int>(Control::kAllNotesOff))
+                 || (control == static_cast<int>(Control::kAllSoundOff))) {
+        std::memset(state.velocities, 0, sizeof(state.velocities));
+      } else {
+        state.controls[control] = static_cast<std::int8_t>(bytes[2]);
+      }
+      break;
+    }
+
+    case MsgType::kProgramChange:
+      state.program = static_cast<std::int8_t>(bytes[1]);
+      break;
+
+    case MsgType::kChannelPressure:
+      state.chanPressure = static_cast<std::int8_t>(bytes[1]);
+      break;
+
+    case MsgType::kPitchBend:
+      state.pitchBend = bytes[1] | (bytes[2] << 7);
+      break;
+
+    default:
+      break;
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,262 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_RTP_MIDI_HPP
+#define BMMIDI_RTP_MIDI_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/control.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+/** Result of decoding an RTP-MIDI packet. */
+enum class RtpMidiResult {
+  /** Decoded successfully. */
+  kOk,
+
+  /** Input is not an RTP version 2 packet. */
+  kNotRtp,
+
+  /** Packet ended in the middle of a header, command, or journal. */
+  kTruncated,
+
+  /** MIDI list contains a command that is not valid (e.g. data without status). */
+  kInvalidCommand,
+
+  /**
+   * Packet is older than (or a duplicate of) one already received, so was
+   * ignored (its contents were already recovered from the journal, if any).
+   */
+  kOutOfOrder,
+};
+
+/** Fixed fields of an RTP packet header. */
+struct RtpMidiHeader {
+  std::uint8_t payloadType = 0;
+  bool marker = false;
+  std::uint16_t seq = 0;
+  std::uint32_t timestamp = 0;
+  std::uint32_t ssrc = 0;
+};
+
+/** Options for RtpMidiSender. */
+struct RtpMidiSenderOptions {
+  /** RTP synchronization source identifier for this stream. */
+  std::uint32_t ssrc = 0;
+
+  /** RTP payload type (dynamic, negotiated out of band). */
+  std::uint8_t payloadType = 97;
+
+  /** Sequence number of the first packet. */
+  std::uint16_t firstSeq = 0;
+
+  /** Whether to include a recovery journal in each packet. */
+  bool useJournal = true;
+
+  /**
+   * Max # of bytes per packet, which limits the # of messages encoded (but at
+   * least one message is always encoded if it can be).
+   */
+  int maxPacketBytes = 1200;
+};
+
+/**
+ * Encodes timed MIDI messages as RTP-MIDI (RFC 6295) packets for sending over
+ * UDP: a MIDI command section (delta-time command list using running status)
+ * followed by a recovery journal that lets receivers repair the effects of
+ * lost packets.
+ *
+ * The journal codes channel chapters P (Program Change, with Bank Select),
+ * C (Control Change), W (Pitch Bend), N (Note On/Off), T (Channel Pressure),
+ * and A (Poly Key Pressure) for the state changed since the checkpoint packet.
+ * It is maintained incrementally as messages are encoded: each journalled item
+ * records the packet that last changed it, and each channel caches its encoded
+ * journal, so the cost per packet depends on how much changed since the
+ * checkpoint rather than on the history of the stream. Call setCheckpoint()
+ * as receivers report which packets they have received (e.g. from RTCP), so
+ * the journal stays small.
+ *
+ * Not journalled: System messages (the system journal is not sent), Channel
+ * Mode messages (except that All Notes Off and All Sound Off turn off the
+ * channel's notes), and chapters M (parameters) and E (note extras). SysEx
+ * messages too large for one packet are dropped (rather than segmented).
+ */
+class RtpMidiSender {
+public:
+  explicit RtpMidiSender(const RtpMidiSenderOptions& options = RtpMidiSenderOptions{});
+
+  /**
+   * Encodes messages msgs[firstIndex, ...) into one packet (replacing its
+   * contents), returning the # of messages consumed. If firstIndex is
+   * msgs.size(), encodes a packet with no commands (which still carries the
+   * journal, e.g. to guard against loss of the last packet).
+   *
+   * timestamp and message timestamps are in RTP clock ticks on the same
+   * timeline (the RTP timestamp is timestamp modulo 2^32). Message timestamps
+   * should be nondecreasing and at least timestamp; earlier ones are sent with
+   * zero delta time.
+   */
+  int encodePacket(double timestamp, const TimedMsgBuffer& msgs, int firstIndex,
+                   std::vector<std::uint8_t>& packet);
+
+  /**
+   * Sets the checkpoint packet to seq (of a packet already sent), e.g. once
+   * all receivers have reported receiving it, so that later journals only code
+   * changes made after it. Ignored if seq is older than the current checkpoint.
+   */
+  void setCheckpoint(std::uint16_t seq);
+
+  /** Returns sequence number of the next packet to be encoded. */
+  std::uint16_t nextSeq() const { return static_cast<std::uint16_t>(firstSeq_ + numPackets_); }
+
+  /** Returns # of (too large) messages dropped rather than sent. */
+  std::int64_t numDroppedMsgs() const { return numDroppedMsgs_; }
+
+private:
+  // Packet index (1-based) in which each journalled item last changed, where 0
+  // means never. Items changed after checkpointIndex_ are journalled; the
+  // active lists (unordered, and pruned lazily) hold those candidates.
+  struct JournalChannel {
+    std::uint8_t program;
+    std::uint8_t bankMsb;
+    std::uint8_t bankLsb;
+    bool hasBank;
+    std::int64_t programChanged;
+
+    std::uint8_t controls[kNumControls];
+    std::int64_t controlChanged[kNumControls];
+    std::bitset<kNumControls> isControlActive;
+    std::vector<std::uint8_t> activeControls;
+
+    std::uint8_t bendLsb;
+    std::uint8_t bendMsb;
+    std::int64_t bendChanged;
+
+    std::uint8_t velocities[kNumKeys];  // 0 if the key is off.
+    std::int64_t noteChanged[kNumKeys];
+    std::bitset<kNumKeys> isNoteActive;
+    std::vector<std::uint8_t> activeNotes;
+
+    std::uint8_t chanPressure;
+    std::int64_t chanPressureChanged;
+
+    std::uint8_t keyPressures[kNumKeys];
+    std::int64_t keyPressureChanged[kNumKeys];
+    std::bitset<kNumKeys> isKeyPressureActive;
+    std::vector<std::uint8_t> activeKeyPressures;
+
+    std::int64_t lastChanged;
+
+    // Encoded channel journal, reusable while isCacheValid (which requires
+    // that no S bits would change, i.e. nothing changed in the last packet).
+    std::vector<std::uint8_t> cache;
+    bool isCacheValid;
+  };
+
+  static void resetChannel(JournalChannel& channel);
+
+  void recordMsg(const MsgView& msg);
+  void noteChanged(JournalChannel& channel, int key, std::uint8_t velocity);
+
+  void encodeJournal();
+  void encodeChannel(int chan, JournalChannel& channel);
+
+  RtpMidiSenderOptions options_;
+  std::uint16_t firstSeq_;
+  std::int64_t numPackets_ = 0;
+  std::int64_t checkpointIndex_ = 0;
+  std::int64_t numDroppedMsgs_ = 0;
+  JournalChannel channels_[kNumChannels];
+  std::vector<std::uint8_t> commands_;
+  std::vector<std::uint8_t> journal_;
+};
+
+/**
+ * Decodes RTP-MIDI (RFC 6295) packets from one sender, appending their
+ * messages to a TimedMsgBuffer.
+ *
+ * Tracks the state of each MIDI channel as seen by the receiver, and after
+ * packet loss (a gap in sequence numbers) uses the packet's recovery journal
+ * to emit the messages needed to repair it, e.g. Note Off for notes whose
+ * Note Off was lost, or the latest value of a controller. Recovery messages
+ * are appended before the packet's own commands, with the packet timestamp.
+ *
+ * Timestamps are in RTP clock ticks, unwrapped to a continuous timeline (so
+ * they keep increasing past 2^32). Segmented SysEx commands (which span
+ * packets) and the system journal are skipped, as are SysEx commands without a
+ * complete SysEx header (see numDroppedSysEx()).
+ */
+class RtpMidiReceiver {
+public:
+  RtpMidiReceiver();
+
+  /**
+   * Decodes packet bytes[0, numBytes), appending its messages to msgs. On
+   * error, msgs holds any messages decoded before the error, and the packet is
+   * treated as lost (so the next packet's journal is used to recover it).
+   */
+  RtpMidiResult receive(const std::uint8_t* bytes, int numBytes, TimedMsgBuffer& msgs);
+
+  /** Returns header of the last packet decoded. */
+  const RtpMidiHeader& lastHeader() const { return lastHeader_; }
+
+  /** Returns # of packets detected as lost since construction. */
+  std::int64_t numLostPackets() const { return numLostPackets_; }
+
+  /** Returns # of messages emitted from recovery journals since construction. */
+  std::int64_t numRecoveredMsgs() const { return numRecoveredMsgs_; }
+
+  /**
+   * Returns # of complete SysEx commands dropped since construction, as too
+   * short for a complete SysEx header (e.g. F0 F7).
+   */
+  std::int64_t numDroppedSysEx() const { return numDroppedSysEx_; }
+
+  /** Forgets all tracked state, as if no packets had been received. */
+  void reset();
+
+private:
+  static constexpr std::int8_t kUnknown = -1;
+
+  struct ChannelState {
+    std::int8_t controls[kNumControls];
+    std::int8_t keyPressures[kNumKeys];
+    std::uint8_t velocities[kNumKeys];  // 0 if the key is off.
+    std::int8_t program;
+    std::int8_t chanPressure;
+    int pitchBend;
+  };
+
+  RtpMidiResult decodeCommands(const std::uint8_t* bytes, int numBytes, bool hasFirstDelta,
+                               TimedMsgBuffer& msgs);
+  RtpMidiResult decodeJournal(const std::uint8_t* bytes, int numBytes, bool isSingleLoss,
+                              TimedMsgBuffer& msgs);
+  RtpMidiResult recoverChannel(const std::uint8_t* bytes, int numBytes, bool isSingleLoss,
+                               TimedMsgBuffer& msgs);
+
+  void emit(double timestamp, const std::uint8_t* bytes, int numBytes, TimedMsgBuffer& msgs);
+  void recover(std::uint8_t status, int data1, int data2, TimedMsgBuffer& msgs);
+  void trackMsg(const std::uint8_t* bytes);
+
+  bool hasReceived_ = false;
+  std::uint16_t expectedSeq_ = 0;
+  std::int64_t timestamp_ = 0;
+  RtpMidiHeader lastHeader_;
+  std::int64_t numLostPackets_ = 0;
+  std::int64_t numRecoveredMsgs_ = 0;
+  std::int64_t numDroppedSysEx_ = 0;
+  ChannelState channels_[kNumChannels];
+  std::vector<std::uint8_t> sysEx_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_RTP_MIDI_HPP
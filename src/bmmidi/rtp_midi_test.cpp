@@ -0,0 +1,291 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/rtp_midi.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+using Bytes = std::vector<std::uint8_t>;
+using Msgs = std::vector<std::vector<int>>;
+
+void push(bmmidi::TimedMsgBuffer& buffer, double timestamp, const Bytes& bytes) {
+  buffer.push(timestamp, bytes.data(), static_cast<int>(bytes.size()));
+}
+
+Msgs msgsOf(const bmmidi::TimedMsgBuffer& buffer) {
+  Msgs result;
+  for (const bmmidi::TimedMsgView msg : buffer) {
+    result.emplace_back(msg.value().rawBytes(), msg.value().rawBytes() + msg.value().numBytes());
+  }
+  return result;
+}
+
+std::vector<double> timestampsOf(const bmmidi::TimedMsgBuffer& buffer) {
+  return std::vector<double>(buffer.rawTimestamps(), buffer.rawTimestamps() + buffer.size());
+}
+
+// Returns packet bytes after the 12-byte RTP header.
+Bytes payloadOf(const Bytes& packet) { return Bytes(packet.begin() + 12, packet.end()); }
+
+// Returns RTP packet (without journal) with the given MIDI list.
+Bytes makePacket(std::uint16_t seq, std::uint8_t flags, const Bytes& list) {
+  Bytes packet = {0x80, 0x61, static_cast<std::uint8_t>(seq >> 8),
+                  static_cast<std::uint8_t>(seq), 0, 0, 0, 0, 0, 0, 0, 0};
+  packet.push_back(static_cast<std::uint8_t>(flags | list.size()));
+  packet.insert(packet.end(), list.begin(), list.end());
+  return packet;
+}
+
+bmmidi::RtpMidiResult receive(bmmidi::RtpMidiReceiver& receiver, const Bytes& packet,
+                              bmmidi::TimedMsgBuffer& msgs) {
+  return receiver.receive(packet.data(), static_cast<int>(packet.size()), msgs);
+}
+
+TEST(RtpMidiSender, EncodesCommandList) {
+  bmmidi::RtpMidiSenderOptions options;
+  options.ssrc = 0x12345678;
+  options.firstSeq = 7;
+  options.useJournal = false;
+  bmmidi::RtpMidiSender sender{options};
+
+  bmmidi::TimedMsgBuffer msgs;
+  push(msgs, 1000.0, {0x90, 60, 100});
+  push(msgs, 1000.0, {0x90, 62, 100});
+  push(msgs, 1010.0, {0xB0, 7, 80});
+
+  Bytes packet;
+  EXPECT_THAT(sender.encodePacket(1000.0, msgs, 0, packet), Eq(3));
+  EXPECT_THAT(packet, ElementsAre(0x80, 0xE1, 0x00, 0x07, 0x00, 0x00, 0x03, 0xE8,
+                                  0x12, 0x34, 0x56, 0x78,
+                                  0x0A, 0x90, 60, 100, 0x00, 62, 100, 0x0A, 0xB0, 7, 80));
+  EXPECT_THAT(sender.nextSeq(), Eq(8));
+}
+
+TEST(RtpMidiSender, SplitsMsgsAcrossPackets) {
+  bmmidi::RtpMidiSenderOptions options;
+  options.useJournal = false;
+  options.maxPacketBytes = 21;
+  bmmidi::RtpMidiSender sender{options};
+
+  bmmidi::TimedMsgBuffer msgs;
+  for (int i = 0; i < 3; ++i) { push(msgs, 0.0, {0x90, static_cast<std::uint8_t>(60 + i), 100}); }
+  Bytes sysEx(5000, 0x01);
+  sysEx.front() = 0xF0;
+  sysEx.back() = 0xF7;
+  push(msgs, 0.0, sysEx);
+  push(msgs, 0.0, {0xF8});
+
+  Bytes packet;
+  EXPECT_THAT(sender.encodePacket(0.0, msgs, 0, packet), Eq(2));
+  EXPECT_THAT(payloadOf(packet), ElementsAre(0x06, 0x90, 60, 100, 0x00, 61, 100));
+  EXPECT_THAT(sender.encodePacket(0.0, msgs, 2, packet), Eq(1));
+  EXPECT_THAT(sender.encodePacket(0.0, msgs, 3, packet), Eq(2));
+  EXPECT_THAT(payloadOf(packet), ElementsAre(0x01, 0xF8));
+  EXPECT_THAT(sender.numDroppedMsgs(), Eq(1));
+}
+
+TEST(RtpMidiSender, CodesJournalIncrementally) {
+  bmmidi::RtpMidiSender sender;
+  bmmidi::TimedMsgBuffer msgs;
+  push(msgs, 0.0, {0xB2, 7, 100});
+  const bmmidi::TimedMsgBuffer noMsgs;
+
+  // Empty journal (S set, no channels), checkpoint before the first packet.
+  Bytes packet;
+  sender.encodePacket(0.0, msgs, 0, packet);
+  EXPECT_THAT(payloadOf(packet), ElementsAre(0x43, 0xB2, 7, 100, 0x80, 0xFF, 0xFF));
+
+  // Chapter C for channel index 2, coding the previous packet (S clear).
+  sender.encodePacket(0.0, noMsgs, 0, packet);
+  EXPECT_THAT(payloadOf(packet),
+              ElementsAre(0x40, 0x20, 0xFF, 0xFF, 0x10, 0x06, 0x40, 0x00, 0x07, 100));
+
+  // Same chapter, now with S bits set.
+  sender.encodePacket(0.0, noMsgs, 0, packet);
+  EXPECT_THAT(payloadOf(packet),
+              ElementsAre(0x40, 0xA0, 0xFF, 0xFF, 0x90, 0x06, 0x40, 0x80, 0x87, 100));
+
+  // Once the receiver has everything, the journal is empty again.
+  sender.setCheckpoint(2);
+  sender.encodePacket(0.0, noMsgs, 0, packet);
+  EXPECT_THAT(payloadOf(packet), ElementsAre(0x40, 0x80, 0x00, 0x02));
+}
+
+TEST(RtpMidi, RoundTripsMsgs) {
+  bmmidi::RtpMidiSender sender;
+  bmmidi::RtpMidiReceiver receiver;
+
+  bmmidi::TimedMsgBuffer sent;
+  push(sent, 5.0, {0x91, 60, 100});
+  push(sent, 205.0, {0xB1, 1, 64});
+  push(sent, 205.0, {0xF0, 0x7D, 0x01, 0x02, 0xF7});
+  push(sent, 300.0, {0xF8});
+  push(sent, 300.0, {0xB1, 1, 65});
+  push(sent, 300.0, {0xB1, 2, 66});
+  push(sent, 301.0, {0xF2, 0x10, 0x20});
+  push(sent, 20000.0, {0xE1, 0x00, 0x50});
+
+  Bytes packet;
+  EXPECT_THAT(sender.encodePacket(0.0, sent, 0, packet), Eq(sent.size()));
+
+  bmmidi::TimedMsgBuffer received;
+  EXPECT_THAT(receive(receiver, packet, received), Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(msgsOf(received), Eq(msgsOf(sent)));
+  EXPECT_THAT(timestampsOf(received), Eq(timestampsOf(sent)));
+  EXPECT_THAT(receiver.lastHeader().seq, Eq(0));
+  EXPECT_THAT(receiver.numLostPackets(), Eq(0));
+}
+
+TEST(RtpMidi, RecoversSingleLostPacket) {
+  bmmidi::RtpMidiSender sender;
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer sent;
+  bmmidi::TimedMsgBuffer received;
+  Bytes packet;
+
+  push(sent, 0.0, {0x90, 60, 100});
+  push(sent, 0.0, {0xB0, 7, 100});
+  push(sent, 0.0, {0xB0, 10, 5});
+  sender.encodePacket(0.0, sent, 0, packet);
+  EXPECT_THAT(receive(receiver, packet, received), Eq(bmmidi::RtpMidiResult::kOk));
+
+  // Lost.
+  sent.clear();
+  push(sent, 10.0, {0x80, 60, 0});
+  push(sent, 10.0, {0x90, 62, 90});
+  push(sent, 10.0, {0xB0, 7, 50});
+  push(sent, 10.0, {0xC0, 5});
+  push(sent, 10.0, {0xE0, 0x00, 0x50});
+  push(sent, 10.0, {0xD0, 30});
+  sender.encodePacket(10.0, sent, 0, packet);
+
+  sent.clear();
+  push(sent, 20.0, {0x90, 64, 80});
+  sender.encodePacket(20.0, sent, 0, packet);
+  received.clear();
+  EXPECT_THAT(receive(receiver, packet, received), Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(msgsOf(received),
+              ElementsAre(ElementsAre(0xC0, 5), ElementsAre(0xB0, 7, 50),
+                          ElementsAre(0xE0, 0x00, 0x50), ElementsAre(0x90, 62, 90),
+                          ElementsAre(0x80, 60, 64), ElementsAre(0xD0, 30),
+                          ElementsAre(0x90, 64, 80)));
+  EXPECT_THAT(timestampsOf(received), Eq(std::vector<double>(7, 20.0)));
+  EXPECT_THAT(receiver.numLostPackets(), Eq(1));
+  EXPECT_THAT(receiver.numRecoveredMsgs(), Eq(6));
+}
+
+TEST(RtpMidi, RecoversBurstLoss) {
+  bmmidi::RtpMidiSender sender;
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer sent;
+  bmmidi::TimedMsgBuffer received;
+  const bmmidi::TimedMsgBuffer noMsgs;
+  Bytes packet;
+
+  push(sent, 0.0, {0x93, 60, 100});
+  push(sent, 0.0, {0xA3, 60, 20});
+  sender.encodePacket(0.0, sent, 0, packet);
+  receive(receiver, packet, received);
+
+  // Both lost.
+  sent.clear();
+  push(sent, 0.0, {0xB3, 0, 1});
+  push(sent, 0.0, {0xB3, 32, 2});
+  push(sent, 0.0, {0xC3, 3});
+  sender.encodePacket(0.0, sent, 0, packet);
+  sent.clear();
+  push(sent, 0.0, {0xA3, 60, 40});
+  push(sent, 0.0, {0x83, 60, 0});
+  sender.encodePacket(0.0, sent, 0, packet);
+
+  // Guard packet with only the journal.
+  sender.encodePacket(0.0, noMsgs, 0, packet);
+  received.clear();
+  EXPECT_THAT(receive(receiver, packet, received), Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(msgsOf(received),
+              ElementsAre(ElementsAre(0xB3, 0, 1), ElementsAre(0xB3, 32, 2), ElementsAre(0xC3, 3),
+                          ElementsAre(0x83, 60, 64), ElementsAre(0xA3, 60, 40)));
+  EXPECT_THAT(receiver.numLostPackets(), Eq(2));
+  EXPECT_THAT(receiver.numRecoveredMsgs(), Eq(5));
+}
+
+TEST(RtpMidiReceiver, RejectsOutOfOrderAndMalformedPackets) {
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer msgs;
+
+  EXPECT_THAT(receive(receiver, {0x00, 0x61, 0, 0}, msgs), Eq(bmmidi::RtpMidiResult::kNotRtp));
+  EXPECT_THAT(receive(receiver, makePacket(5, 0x00, {0x3C, 0x64}), msgs),
+              Eq(bmmidi::RtpMidiResult::kInvalidCommand));
+
+  Bytes truncated = makePacket(5, 0x00, {0x90, 0x3C, 0x64});
+  truncated.pop_back();
+  EXPECT_THAT(receive(receiver, truncated, msgs), Eq(bmmidi::RtpMidiResult::kTruncated));
+  EXPECT_THAT(receive(receiver, makePacket(5, 0x00, {0xF8}), msgs),
+              Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(receive(receiver, makePacket(5, 0x00, {0xF8}), msgs),
+              Eq(bmmidi::RtpMidiResult::kOutOfOrder));
+  EXPECT_THAT(receive(receiver, makePacket(4, 0x00, {0xF8}), msgs),
+              Eq(bmmidi::RtpMidiResult::kOutOfOrder));
+
+  // Packet 6 lost, but 7's journal (J flag set) is missing.
+  EXPECT_THAT(receive(receiver, makePacket(7, 0x40, {0xFA}), msgs),
+              Eq(bmmidi::RtpMidiResult::kTruncated));
+  EXPECT_THAT(receive(receiver, makePacket(6, 0x00, {0xFA}), msgs),
+              Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(receiver.numLostPackets(), Eq(0));
+}
+
+TEST(RtpMidiReceiver, SkipsSegmentedSysEx) {
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(receive(receiver,
+                      makePacket(0, 0x00, {0xF0, 0x01, 0xF8, 0x02, 0xF0, 0x00, 0x90, 60, 100,
+                                           0x00, 0xF7, 0x03, 0xF4}),
+                      msgs),
+              Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(msgsOf(msgs), ElementsAre(ElementsAre(0xF8), ElementsAre(0x90, 60, 100)));
+}
+
+TEST(RtpMidiReceiver, DropsSysExWithoutCompleteHeader) {
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(receive(receiver,
+                      makePacket(0, 0x00, {0xF0, 0xF7, 0x00, 0xF0, 0x7E, 0xF7,
+                                           0x00, 0xF0, 0x7D, 0x01, 0xF7}),
+                      msgs),
+              Eq(bmmidi::RtpMidiResult::kOk));
+  EXPECT_THAT(msgsOf(msgs), ElementsAre(ElementsAre(0xF0, 0x7D, 0x01, 0xF7)));
+  EXPECT_THAT(receiver.numDroppedSysEx(), Eq(2));
+}
+
+TEST(RtpMidi, UnwrapsTimestamps) {
+  bmmidi::RtpMidiSender sender;
+  bmmidi::RtpMidiReceiver receiver;
+  bmmidi::TimedMsgBuffer beforeWrap;
+  bmmidi::TimedMsgBuffer afterWrap;
+  bmmidi::TimedMsgBuffer received;
+  Bytes packet;
+
+  const double kWrap = 4294967296.0;
+  push(beforeWrap, kWrap - 6.0, {0xF8});
+  push(afterWrap, kWrap + 10.0, {0xF8});
+  sender.encodePacket(kWrap - 6.0, beforeWrap, 0, packet);
+  receive(receiver, packet, received);
+  sender.encodePacket(kWrap + 10.0, afterWrap, 0, packet);
+  receive(receiver, packet, received);
+
+  EXPECT_THAT(receiver.lastHeader().timestamp, Eq(10u));
+  EXPECT_THAT(timestampsOf(received), ElementsAre(kWrap - 6.0, kWrap + 10.0));
+}
+
+}  // namespace
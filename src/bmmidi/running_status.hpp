@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_RUNNING_STATUS_HPP
+#define BMMIDI_RUNNING_STATUS_HPP
+
+#include <cstdint>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+
+/**
+ * Tracks running status while transmitting a raw MIDI byte stream, so that a
+ * Channel Voice message's status byte can be omitted when it repeats the
+ * previous Channel Voice status.
+ *
+ * Per the MIDI spec, System Realtime messages (which may be interleaved
+ * anywhere) leave running status unchanged, while System Common and System
+ * Exclusive messages cancel it.
+ */
+class RunningStatusEncoder {
+public:
+  /**
+   * Updates running status for sending msg next, returning # of leading bytes
+   * of msg to omit on the wire (1 if its status byte can be omitted, else 0).
+   */
+  int advance(const MsgView& msg) {
+    const std::uint8_t status = msg.status().value();
+    if (status >= kFirstRealtimeStatus) { return 0; }
+
+    if (!msg.status().isChannelSpecific()) {
+      runningStatus_ = 0;
+      return 0;
+    }
+
+    const bool canOmit = (status == runningStatus_);
+    runningStatus_ = status;
+    return canOmit ? 1 : 0;
+  }
+
+  /**
+   * Returns # of bytes msg would occupy on the wire if sent next (without
+   * updating running status).
+   */
+  int numWireBytes(const MsgView& msg) const {
+    const std::uint8_t status = msg.status().value();
+    return msg.numBytes() - ((status == runningStatus_) ? 1 : 0);
+  }
+
+  /**
+   * Clears running status, so the next Channel Voice message includes its
+   * status byte (e.g. after the receiver may have lost sync).
+   */
+  void reset() { runningStatus_ = 0; }
+
+  /** Returns current running status byte value, or 0 if none. */
+  std::uint8_t runningStatus() const { return runningStatus_; }
+
+private:
+  static constexpr std::uint8_t kFirstRealtimeStatus = 0xF8;
+
+  std::uint8_t runningStatus_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_RUNNING_STATUS_HPP
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/running_status.hpp"
+
+#include <cstdint>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/data_value.hpp"
+#include "bmmidi/key_number.hpp"
+#include "bmmidi/msg.hpp"
+
+namespace {
+
+using ::testing::Eq;
+
+TEST(RunningStatusEncoder, OmitsRepeatedChannelStatus) {
+  bmmidi::RunningStatusEncoder encoder;
+  const auto ch = bmmidi::Channel::index(0);
+  const auto on = bmmidi::NoteMsg::on(ch, bmmidi::KeyNumber::middleC(), bmmidi::DataValue{90});
+  const auto off = bmmidi::NoteMsg::off(ch, bmmidi::KeyNumber::middleC());
+  const auto otherChannel = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(1), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{90});
+
+  EXPECT_THAT(encoder.numWireBytes(on), Eq(3));
+  EXPECT_THAT(encoder.advance(on), Eq(0));
+  EXPECT_THAT(encoder.numWireBytes(on), Eq(2));
+  EXPECT_THAT(encoder.advance(on), Eq(1));
+  EXPECT_THAT(encoder.runningStatus(), Eq(0x90));
+
+  EXPECT_THAT(encoder.advance(off), Eq(0));
+  EXPECT_THAT(encoder.advance(otherChannel), Eq(0));
+  EXPECT_THAT(encoder.advance(otherChannel), Eq(1));
+
+  encoder.reset();
+  EXPECT_THAT(encoder.advance(otherChannel), Eq(0));
+}
+
+TEST(RunningStatusEncoder, KeepsStatusAcrossRealtimeMsgs) {
+  bmmidi::RunningStatusEncoder encoder;
+  const auto on = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(0), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{90});
+
+  EXPECT_THAT(encoder.advance(on), Eq(0));
+  EXPECT_THAT(encoder.advance(bmmidi::timingClockMsg()), Eq(0));
+  EXPECT_THAT(encoder.advance(on), Eq(1));
+}
+
+TEST(RunningStatusEncoder, CancelsStatusOnSystemCommonAndSysEx) {
+  bmmidi::RunningStatusEncoder encoder;
+  const auto on = bmmidi::NoteMsg::on(
+      bmmidi::Channel::index(0), bmmidi::KeyNumber::middleC(), bmmidi::DataValue{90});
+  const std::uint8_t songSelect[] = {0xF3, 0x02};
+  const std::uint8_t sysEx[] = {0xF0, 0x7D, 0x01, 0xF7};
+
+  EXPECT_THAT(encoder.advance(on), Eq(0));
+  EXPECT_THAT(encoder.advance(bmmidi::MsgView{songSelect, 2}), Eq(0));
+  EXPECT_THAT(encoder.runningStatus(), Eq(0));
+  EXPECT_THAT(encoder.advance(on), Eq(0));
+  EXPECT_THAT(encoder.advance(bmmidi::MsgView{sysEx, 4}), Eq(0));
+  EXPECT_THAT(encoder.advance(on), Eq(0));
+}
+
+}  // namespace
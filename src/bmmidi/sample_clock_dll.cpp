@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/sample_clock_dll.hpp"
+
+#include <cmath>
+
+namespace bmmidi {
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+void SampleClockDll::update(double hostTime, int numFrames) {
+  assert(numFrames > 0);
+  if (!isStarted_) {
+    isStarted_ = true;
+    secondsPerFrame_ = 1.0 / nominalSampleRate_;
+    position0_ = 0.0;
+    time0_ = hostTime;
+    time1_ = time0_ + secondsPerFrame_ * numFrames;
+  } else {
+    // Loop filter gains for a critically damped loop updated once per block.
+    const double omega = 2.0 * kPi * bandwidthHz_ * numFrames / nominalSampleRate_;
+    const double b = std::sqrt(2.0) * omega;
+    const double c = omega * omega;
+
+    // The block starts where the last one was predicted to end (so positions
+    // are continuous), and the error corrects the prediction for the next.
+    const double error = hostTime - time1_;
+    position0_ += numFrames_;
+    time0_ = time1_;
+    time1_ += b * error + secondsPerFrame_ * numFrames;
+    secondsPerFrame_ += c * error / numFrames;
+  }
+
+  numFrames_ = numFrames;
+  framesPerSecond_ = numFrames / (time1_ - time0_);
+}
+
+void SampleClockDll::mapToSamplePositions(TimedMsgBuffer& msgs) const {
+  for (int i = 0; i < msgs.size(); ++i) {
+    msgs.setTimestampAt(i, toSamplePosition(msgs.timestampAt(i)));
+  }
+}
+
+void SampleClockDll::mapToHostTimes(TimedMsgBuffer& msgs) const {
+  for (int i = 0; i < msgs.size(); ++i) { msgs.setTimestampAt(i, toHostTime(msgs.timestampAt(i))); }
+}
+
+}  // namespace bmmidi
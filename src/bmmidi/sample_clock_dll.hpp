@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SAMPLE_CLOCK_DLL_HPP
+#define BMMIDI_SAMPLE_CLOCK_DLL_HPP
+
+#include <cassert>
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace bmmidi {
+
+/**
+ * Second-order delay-locked loop (DLL) that tracks an audio device's sample
+ * clock against the host clock from the (jittery) host times at which audio
+ * callbacks run, and converts between host times and fractional sample
+ * positions in O(1).
+ *
+ * Call update() at the start of each audio callback. The loop filters out the
+ * callbacks' scheduling jitter while following the actual sample rate, so
+ * converted positions are smooth even on busy systems, unlike positions
+ * extrapolated from each callback's raw time. Lower bandwidths (in Hz) filter
+ * more jitter but take longer to lock (about 1 / bandwidth seconds).
+ * See F. Adriaensen, "Using a DLL to filter time" (2005).
+ *
+ * Sample positions count frames since the first update(). All times are in
+ * seconds.
+ */
+class SampleClockDll {
+public:
+  /** Creates a DLL for a device running at (nominally) sampleRate. */
+  explicit SampleClockDll(double sampleRate, double bandwidthHz = 0.5)
+      : nominalSampleRate_{sampleRate},
+        bandwidthHz_{bandwidthHz},
+        secondsPerFrame_{1.0 / sampleRate},
+        framesPerSecond_{sampleRate} {
+    assert(sampleRate > 0.0);
+    assert(bandwidthHz > 0.0);
+  }
+
+  /** Restarts tracking (e.g. after the device was restarted or stalled). */
+  void reset() { isStarted_ = false; }
+
+  /**
+   * Updates the loop with hostTime, measured at the start of the callback for
+   * the block of numFrames frames following the previous block.
+   */
+  void update(double hostTime, int numFrames);
+
+  /** Returns true once update() was called. */
+  bool isStarted() const { return isStarted_; }
+
+  /** Returns the filtered host time of the start of the current block. */
+  double blockStartTime() const { return time0_; }
+
+  /** Returns the predicted host time of the start of the next block. */
+  double nextBlockTime() const { return time1_; }
+
+  /** Returns the sample position of the start of the current block. */
+  double blockStartPosition() const { return position0_; }
+
+  /** Returns the estimated actual sample rate. */
+  double sampleRate() const { return 1.0 / secondsPerFrame_; }
+
+  /** Returns the fractional sample position at hostTime. */
+  double toSamplePosition(double hostTime) const {
+    assert(isStarted_);
+    return position0_ + (hostTime - time0_) * framesPerSecond_;
+  }
+
+  /** Returns the host time at samplePosition. */
+  double toHostTime(double samplePosition) const {
+    assert(isStarted_);
+    return time0_ + (samplePosition - position0_) / framesPerSecond_;
+  }
+
+  /** Maps all timestamps of msgs from host times to sample positions. */
+  void mapToSamplePositions(TimedMsgBuffer& msgs) const;
+
+  /** Maps all timestamps of msgs from sample positions to host times. */
+  void mapToHostTimes(TimedMsgBuffer& msgs) const;
+
+private:
+  double nominalSampleRate_;
+  double bandwidthHz_;
+  bool isStarted_ = false;
+
+  double time0_ = 0.0;      // Filtered host time of current block.
+  double time1_ = 0.0;      // Predicted host time of next block.
+  double position0_ = 0.0;  // Sample position of current block.
+  int numFrames_ = 0;       // Frames of current block.
+  double secondsPerFrame_;  // Filtered.
+  double framesPerSecond_;  // Over the current block: numFrames_ / (time1_ - time0_).
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SAMPLE_CLOCK_DLL_HPP
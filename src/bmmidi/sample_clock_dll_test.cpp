@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/sample_clock_dll.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Lt;
+
+constexpr double kNominalRate = 48000.0;
+constexpr int kBlockFrames = 256;
+
+TEST(SampleClockDll, StartsAtNominalRate) {
+  bmmidi::SampleClockDll dll{kNominalRate};
+  EXPECT_THAT(dll.isStarted(), IsFalse());
+  dll.update(10.0, kBlockFrames);
+  ASSERT_THAT(dll.isStarted(), IsTrue());
+  EXPECT_THAT(dll.toSamplePosition(10.0), Eq(0.0));
+  EXPECT_THAT(dll.toSamplePosition(10.5), DoubleNear(24000.0, 1e-6));
+  EXPECT_THAT(dll.toHostTime(480.0), DoubleNear(10.01, 1e-12));
+  EXPECT_THAT(dll.nextBlockTime(), DoubleNear(10.0 + kBlockFrames / kNominalRate, 1e-12));
+}
+
+// Returns the root mean square deviation of errors from their mean.
+double rmsDeviation(const std::vector<double>& errors) {
+  double mean = 0.0;
+  for (const double error : errors) { mean += error / errors.size(); }
+  double sumSquares = 0.0;
+  for (const double error : errors) { sumSquares += (error - mean) * (error - mean); }
+  return std::sqrt(sumSquares / errors.size());
+}
+
+TEST(SampleClockDll, FiltersCallbackJitter) {
+  // Device runs 30 ppm fast; callbacks wake up 0-1 ms late.
+  const double actualRate = kNominalRate * (1.0 + 30e-6);
+  std::mt19937 random{3};
+  std::uniform_real_distribution<double> wakeDelay{0.0, 0.001};
+
+  bmmidi::SampleClockDll dll{kNominalRate};
+  std::vector<double> dllErrors;
+  std::vector<double> naiveErrors;
+  double lastPosition = -1.0;
+  bool isMonotonic = true;
+  for (int block = 0; block < 20000; ++block) {
+    const double blockTime = 5.0 + block * kBlockFrames / actualRate;
+    const double callbackTime = blockTime + wakeDelay(random);
+    dll.update(callbackTime, kBlockFrames);
+    if (block < 5000) { continue; }  // Let the loop settle.
+
+    // A message in the middle of the block.
+    const double msgTime = blockTime + 0.5 * kBlockFrames / actualRate;
+    const double truePosition = block * kBlockFrames + 0.5 * kBlockFrames;
+    const double naivePosition = block * kBlockFrames + (msgTime - callbackTime) * kNominalRate;
+    dllErrors.push_back(dll.toSamplePosition(msgTime) - truePosition);
+    naiveErrors.push_back(naivePosition - truePosition);
+
+    isMonotonic = isMonotonic && (dll.toSamplePosition(blockTime) > lastPosition);
+    lastPosition = dll.toSamplePosition(blockTime);
+  }
+
+  // Both are offset by the mean wake delay (which only the device could
+  // know), but the DLL's positions barely jitter.
+  EXPECT_THAT(rmsDeviation(naiveErrors), DoubleNear(48.0 / std::sqrt(12.0), 0.5));
+  EXPECT_THAT(rmsDeviation(dllErrors), Lt(2.5));
+  EXPECT_THAT(dll.sampleRate(), DoubleNear(actualRate, 20.0));
+  EXPECT_THAT(isMonotonic, IsTrue());
+}
+
+TEST(SampleClockDll, MapsBuffers) {
+  bmmidi::SampleClockDll dll{kNominalRate};
+  dll.update(1.0, kBlockFrames);
+  dll.update(1.0 + kBlockFrames / kNominalRate, kBlockFrames);
+
+  const std::uint8_t clock[] = {0xF8};
+  bmmidi::TimedMsgBuffer msgs;
+  msgs.push(1.0, clock, 1);
+  msgs.push(1.01, clock, 1);
+  dll.mapToSamplePositions(msgs);
+  EXPECT_THAT(msgs.timestampAt(0), DoubleNear(0.0, 1e-6));
+  EXPECT_THAT(msgs.timestampAt(1), DoubleNear(480.0, 1e-6));
+  dll.mapToHostTimes(msgs);
+  EXPECT_THAT(msgs.timestampAt(0), DoubleNear(1.0, 1e-12));
+  EXPECT_THAT(msgs.timestampAt(1), DoubleNear(1.01, 1e-12));
+}
+
+}  // namespace
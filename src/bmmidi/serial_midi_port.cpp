@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/serial_midi_port.hpp"
+
+#include <asm/termbits.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+
+namespace bmmidi {
+
+namespace {
+
+// Configures tty fd for raw 8N1 bytes at baudRate, using termios2 so that
+// nonstandard rates like 31250 baud can be set directly.
+int configureTty(int fd, int baudRate) {
+  struct termios2 tio;
+  if (::ioctl(fd, TCGETS2, &tio) != 0) { return errno; }
+
+  tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF
+                   | IXANY);
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+  tio.c_cflag |= CS8 | CLOCAL | CREAD | BOTHER | (BOTHER << IBSHIFT);
+  tio.c_ispeed = static_cast<speed_t>(baudRate);
+  tio.c_ospeed = static_cast<speed_t>(baudRate);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+
+  return (::ioctl(fd, TCSETS2, &tio) == 0) ? 0 : errno;
+}
+
+}  // namespace
+
+double monotonicSeconds() {
+  struct timespec now;
+  ::clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<double>(now.tv_sec) + 1.0e-9 * static_cast<double>(now.tv_nsec);
+}
+
+SerialMidiPort::SerialMidiPort(const SerialMidiPortOptions& options)
+    : options_{options},
+      parser_{options.parserOptions},
+      readBuffer_(static_cast<std::size_t>(options.readBufferBytes)) {
+  assert(options.baudRate > 0);
+  assert(options.bitsPerByte > 0);
+  assert(options.readBufferBytes > 0);
+}
+
+SerialMidiPort::~SerialMidiPort() { close(); }
+
+int SerialMidiPort::openTty(const char* path) {
+  close();
+  const int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) { return errno; }
+
+  const int error = configureTty(fd, options_.baudRate);
+  if (error != 0) {
+    ::close(fd);
+    return error;
+  }
+  return attach(fd, true);
+}
+
+int SerialMidiPort::attach(int fd, bool takeOwnership) {
+  assert(fd >= 0);
+  close();
+  fd_ = fd;
+  ownsFd_ = takeOwnership;
+
+  const int flags = ::fcntl(fd, F_GETFL);
+  if ((flags < 0) || (::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+    const int error = errno;
+    close();
+    return error;
+  }
+
+  epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if ((epollFd_ < 0) || (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0)) {
+    const int error = errno;
+    close();
+    return error;
+  }
+  epollEvents_ = EPOLLIN;
+  lastReadTime_ = 0.0;
+  return 0;
+}
+
+void SerialMidiPort::close() {
+  if (epollFd_ >= 0) { ::close(epollFd_); }
+  if (ownsFd_ && (fd_ >= 0)) { ::close(fd_); }
+  fd_ = -1;
+  ownsFd_ = false;
+  epollFd_ = -1;
+  epollEvents_ = 0;
+
+  parser_.reset();
+  runningStatus_.reset();
+  pending_.clear();
+  numWritten_ = 0;
+}
+
+int SerialMidiPort::poll(int timeoutMs, TimedMsgBuffer& msgs) {
+  const int numReady = wait(EPOLLIN, timeoutMs);
+  if (numReady <= 0) { return numReady; }
+  return readAvailable(msgs);
+}
+
+int SerialMidiPort::readAvailable(TimedMsgBuffer& msgs) {
+  if (fd_ < 0) { return -EBADF; }
+
+  const double byteSeconds = options_.interpolateByteTimes
+      ? static_cast<double>(options_.bitsPerByte) / options_.baudRate : 0.0;
+  int numRead = 0;
+  for (;;) {
+    const ssize_t n = ::read(fd_, readBuffer_.data(), readBuffer_.size());
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) { break; }
+      return (numRead > 0) ? numRead : -errno;
+    }
+    if (n == 0) { return (numRead > 0) ? numRead : -EPIPE; }
+
+    // Assume the bytes arrived back to back, ending now (but not before the
+    // previous read).
+    const int numBytes = static_cast<int>(n);
+    const double readTime = monotonicSeconds();
+    const double firstByteTime = std::max(lastReadTime_, readTime - (numBytes - 1) * byteSeconds);
+    lastReadTime_ = readTime;
+    parser_.parseWithPositions(
+        readBuffer_.data(), numBytes,
+        [&msgs, readTime, firstByteTime, byteSeconds](const MsgView& msg, int lastByteIndex) {
+          msgs.push(std::min(readTime, firstByteTime + lastByteIndex * byteSeconds), msg);
+        });
+
+    numRead += numBytes;
+    if (static_cast<std::size_t>(numBytes) < readBuffer_.size()) { break; }  // Drained.
+  }
+  return numRead;
+}
+
+void SerialMidiPort::queue(const MsgView& msg) {
+  // Reclaim already written space once it dominates.
+  if ((numWritten_ > 0) && (2 * numWritten_ >= static_cast<int>(pending_.size()))) {
+    pending_.erase(pending_.begin(), pending_.begin() + numWritten_);
+    numWritten_ = 0;
+  }
+
+  const int numOmitted = options_.useRunningStatus ? runningStatus_.advance(msg) : 0;
+  pending_.insert(pending_.end(), msg.rawBytes() + numOmitted, msg.rawBytes() + msg.numBytes());
+}
+
+int SerialMidiPort::flush(int timeoutMs) {
+  if (fd_ < 0) { return EBADF; }
+
+  while (numPendingBytes() > 0) {
+    const ssize_t n = ::write(fd_, &pending_[numWritten_],
+                              static_cast<std::size_t>(numPendingBytes()));
+    if (n >= 0) {
+      numWritten_ += static_cast<int>(n);
+      continue;
+    }
+    if (errno == EINTR) { continue; }
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) { return errno; }
+
+    const int numReady = wait(EPOLLOUT, timeoutMs);
+    if (numReady < 0) { return -numReady; }
+    if (numReady == 0) { return EAGAIN; }
+  }
+
+  pending_.clear();
+  numWritten_ = 0;
+  return 0;
+}
+
+int SerialMidiPort::wait(std::uint32_t events, int timeoutMs) {
+  if (fd_ < 0) { return -EBADF; }
+
+  if (events != epollEvents_) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd_;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd_, &event) != 0) { return -errno; }
+    epollEvents_ = events;
+  }
+
+  struct epoll_event ready;
+  for (;;) {
+    const int numReady = ::epoll_wait(epollFd_, &ready, 1, timeoutMs);
+    if (numReady >= 0) { return numReady; }
+    if (errno != EINTR) { return -errno; }
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SERIAL_MIDI_PORT_HPP
+#define BMMIDI_SERIAL_MIDI_PORT_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/msg_stream_parser.hpp"
+#include "bmmidi/running_status.hpp"
+
+namespace bmmidi {
+
+/** Returns current CLOCK_MONOTONIC time, in seconds (as used by SerialMidiPort). */
+double monotonicSeconds();
+
+/** Options for SerialMidiPort. */
+struct SerialMidiPortOptions {
+  /** Line rate (bits per second) that ttys are configured for. */
+  int baudRate = 31250;
+
+  /** Bits on the wire per byte (start + 8 data + stop). */
+  int bitsPerByte = 10;
+
+  /**
+   * Spread the timestamps of bytes returned by each read() back from the read
+   * time at the line rate (as if the last byte just arrived), rather than
+   * giving every message from the read the same timestamp.
+   */
+  bool interpolateByteTimes = true;
+
+  /** Max # of bytes requested per read() call. */
+  int readBufferBytes = 4096;
+
+  /** Omit repeated Channel Voice status bytes when writing. */
+  bool useRunningStatus = true;
+
+  MsgStreamParserOptions parserOptions;
+};
+
+/**
+ * MIDI byte stream I/O over a serial port (e.g. a UART driving DIN ports) or
+ * any other file descriptor (pipe, socket, pseudo-terminal), on Linux.
+ *
+ * Input is waited for with epoll and then drained with as few read() calls as
+ * possible (each returning up to readBufferBytes), which are fed in bulk to a
+ * MsgStreamParser and timestamped with CLOCK_MONOTONIC. Output messages are
+ * queued through a RunningStatusEncoder and written with as few write() calls
+ * as possible by flush().
+ *
+ * All functions that make system calls return 0 on success, or else an errno
+ * value (reads return a negated errno value instead).
+ */
+class SerialMidiPort {
+public:
+  explicit SerialMidiPort(const SerialMidiPortOptions& options = SerialMidiPortOptions{});
+  ~SerialMidiPort();
+
+  SerialMidiPort(const SerialMidiPort&) = delete;
+  SerialMidiPort& operator=(const SerialMidiPort&) = delete;
+
+  /**
+   * Opens the tty at path (e.g. "/dev/ttyAMA0") in raw 8N1 mode at baudRate,
+   * which need not be a standard rate. Closes any previously open fd first.
+   */
+  int openTty(const char* path);
+
+  /**
+   * Uses the already open fd (making it nonblocking), which is closed by
+   * close() (or destruction) only if takeOwnership.
+   */
+  int attach(int fd, bool takeOwnership);
+
+  /** Closes (or detaches) the fd, forgetting any parser and output state. */
+  void close();
+
+  /** Returns true if an fd is open (or attached). */
+  bool isOpen() const { return fd_ >= 0; }
+
+  /** Returns the fd (e.g. to add to another event loop), or -1 if not open. */
+  int fd() const { return fd_; }
+
+  /**
+   * Waits up to timeoutMs milliseconds (-1 to wait indefinitely, 0 to not wait)
+   * for input, then reads all available input (see readAvailable()). Returns
+   * the # of bytes read (0 on timeout), or a negated errno value.
+   */
+  int poll(int timeoutMs, TimedMsgBuffer& msgs);
+
+  /**
+   * Reads all currently available input without waiting, appending complete
+   * messages to msgs with CLOCK_MONOTONIC timestamps (in seconds) of when
+   * their last bytes arrived. Returns the # of bytes read, or a negated errno
+   * value (-EPIPE at end of file).
+   */
+  int readAvailable(TimedMsgBuffer& msgs);
+
+  /** Queues msg to be written by the next flush(). */
+  void queue(const MsgView& msg);
+
+  /** Returns # of queued bytes not yet written. */
+  int numPendingBytes() const { return static_cast<int>(pending_.size()) - numWritten_; }
+
+  /**
+   * Writes queued bytes, waiting up to timeoutMs milliseconds (-1 to wait
+   * indefinitely) whenever the fd cannot accept more. Returns EAGAIN if bytes
+   * remain queued at the timeout.
+   */
+  int flush(int timeoutMs);
+
+  /** Returns the parser, e.g. for its counters of discarded input. */
+  const MsgStreamParser& parser() const { return parser_; }
+
+private:
+  // Waits up to timeoutMs for the fd to have any of epoll events, returning
+  // # of ready fds or a negated errno value.
+  int wait(std::uint32_t events, int timeoutMs);
+
+  SerialMidiPortOptions options_;
+  int fd_ = -1;
+  bool ownsFd_ = false;
+  int epollFd_ = -1;
+  std::uint32_t epollEvents_ = 0;  // Events fd_ is registered for.
+
+  MsgStreamParser parser_;
+  std::vector<std::uint8_t> readBuffer_;
+  double lastReadTime_ = 0.0;
+
+  RunningStatusEncoder runningStatus_;
+  std::vector<std::uint8_t> pending_;
+  int numWritten_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SERIAL_MIDI_PORT_HPP
@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/serial_midi_port.hpp"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Le;
+
+using Bytes = std::vector<std::uint8_t>;
+
+std::vector<Bytes> msgBytes(const bmmidi::TimedMsgBuffer& msgs) {
+  std::vector<Bytes> result;
+  for (const bmmidi::TimedMsgView msg : msgs) {
+    const bmmidi::MsgView view = msg.value();
+    result.emplace_back(view.rawBytes(), view.rawBytes() + view.numBytes());
+  }
+  return result;
+}
+
+void writeAll(int fd, const Bytes& bytes) {
+  ASSERT_THAT(::write(fd, bytes.data(), bytes.size()), Eq(static_cast<ssize_t>(bytes.size())));
+}
+
+// Reads from fd until numBytes have arrived (or a read fails).
+Bytes readBytes(int fd, std::size_t numBytes) {
+  Bytes result(numBytes);
+  std::size_t numRead = 0;
+  while (numRead < numBytes) {
+    const ssize_t n = ::read(fd, &result[numRead], numBytes - numRead);
+    if (n <= 0) { break; }
+    numRead += static_cast<std::size_t>(n);
+  }
+  result.resize(numRead);
+  return result;
+}
+
+class Pipe {
+public:
+  Pipe() { EXPECT_THAT(::pipe2(fds_, O_CLOEXEC), Eq(0)); }
+  ~Pipe() {
+    closeReadEnd();
+    closeWriteEnd();
+  }
+
+  int readEnd() const { return fds_[0]; }
+  int writeEnd() const { return fds_[1]; }
+
+  void closeReadEnd() { closeFd(fds_[0]); }
+  void closeWriteEnd() { closeFd(fds_[1]); }
+
+private:
+  static void closeFd(int& fd) {
+    if (fd >= 0) { ::close(fd); }
+    fd = -1;
+  }
+
+  int fds_[2] = {-1, -1};
+};
+
+TEST(SerialMidiPort, ReadsInterpolatedTimestamps) {
+  Pipe pipe;
+  bmmidi::SerialMidiPort port;
+  ASSERT_THAT(port.attach(pipe.readEnd(), false), Eq(0));
+
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(port.poll(0, msgs), Eq(0));
+
+  writeAll(pipe.writeEnd(), {0x90, 60, 100, 62, 100, 0xF8, 0xB0, 7});
+  const double before = bmmidi::monotonicSeconds();
+  EXPECT_THAT(port.poll(1000, msgs), Eq(8));
+  const double after = bmmidi::monotonicSeconds();
+
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0x90, 60, 100), ElementsAre(0x90, 62, 100),
+                                          ElementsAre(0xF8)));
+  ASSERT_THAT(msgs.size(), Eq(3));
+
+  // Each byte takes 10 bits at 31250 baud, ending with the last byte read.
+  const double byteSeconds = 10.0 / 31250.0;
+  EXPECT_THAT(msgs[2].timestamp(), Ge(before - 2 * byteSeconds));
+  EXPECT_THAT(msgs[2].timestamp(), Le(after));
+  EXPECT_THAT(msgs[1].timestamp() - msgs[0].timestamp(), DoubleNear(2 * byteSeconds, 1e-9));
+  EXPECT_THAT(msgs[2].timestamp() - msgs[1].timestamp(), DoubleNear(byteSeconds, 1e-9));
+
+  // The rest of the message arrives in a later read.
+  msgs.clear();
+  writeAll(pipe.writeEnd(), {100});
+  EXPECT_THAT(port.poll(1000, msgs), Eq(1));
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xB0, 7, 100)));
+}
+
+TEST(SerialMidiPort, ReportsEndOfFile) {
+  Pipe pipe;
+  bmmidi::SerialMidiPort port;
+  ASSERT_THAT(port.attach(pipe.readEnd(), false), Eq(0));
+  pipe.closeWriteEnd();
+
+  bmmidi::TimedMsgBuffer msgs;
+  EXPECT_THAT(port.poll(1000, msgs), Eq(-EPIPE));
+}
+
+TEST(SerialMidiPort, WritesWithRunningStatus) {
+  Pipe pipe;
+  bmmidi::SerialMidiPort port;
+  ASSERT_THAT(port.attach(pipe.writeEnd(), false), Eq(0));
+
+  const Bytes noteOn1 = {0x90, 60, 100};
+  const Bytes noteOn2 = {0x90, 62, 100};
+  const Bytes clock = {0xF8};
+  const Bytes noteOn3 = {0x90, 64, 100};
+  for (const Bytes* msg : {&noteOn1, &noteOn2, &clock, &noteOn3}) {
+    port.queue(bmmidi::MsgView{msg->data(), static_cast<int>(msg->size())});
+  }
+  EXPECT_THAT(port.numPendingBytes(), Eq(8));
+  EXPECT_THAT(port.flush(1000), Eq(0));
+  EXPECT_THAT(port.numPendingBytes(), Eq(0));
+  EXPECT_THAT(readBytes(pipe.readEnd(), 8), ElementsAre(0x90, 60, 100, 62, 100, 0xF8, 64, 100));
+}
+
+TEST(SerialMidiPort, TimesOutWhenOutputIsFull) {
+  Pipe pipe;
+  bmmidi::SerialMidiPort port;
+  ASSERT_THAT(port.attach(pipe.writeEnd(), false), Eq(0));
+
+  Bytes sysEx(1024 * 1024, 0x11);
+  sysEx.front() = 0xF0;
+  sysEx.back() = 0xF7;
+  port.queue(bmmidi::MsgView{sysEx.data(), static_cast<int>(sysEx.size())});
+  EXPECT_THAT(port.flush(10), Eq(EAGAIN));
+  EXPECT_THAT(port.numPendingBytes(), Ge(1));
+}
+
+TEST(SerialMidiPort, OpensPseudoTerminal) {
+  const int master = ::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  ASSERT_THAT(master, Ge(0));
+  ASSERT_THAT(::grantpt(master), Eq(0));
+  ASSERT_THAT(::unlockpt(master), Eq(0));
+
+  bmmidi::SerialMidiPort port;
+  ASSERT_THAT(port.openTty(::ptsname(master)), Eq(0));
+  EXPECT_THAT(port.isOpen(), IsTrue());
+
+  // Raw mode passes all bytes through unchanged, in both directions.
+  const Bytes input = {0xF0, 0x0A, 0x0D, 0x03, 0x11, 0x13, 0xF7, 0xC0, 0x7F};
+  writeAll(master, input);
+  bmmidi::TimedMsgBuffer msgs;
+  while (msgs.size() < 2) { ASSERT_THAT(port.poll(1000, msgs), Ge(1)); }
+  EXPECT_THAT(msgBytes(msgs), ElementsAre(ElementsAre(0xF0, 0x0A, 0x0D, 0x03, 0x11, 0x13, 0xF7),
+                                          ElementsAre(0xC0, 0x7F)));
+
+  const Bytes output = {0xB0, 0x0A, 0x0D};
+  port.queue(bmmidi::MsgView{output.data(), static_cast<int>(output.size())});
+  EXPECT_THAT(port.flush(1000), Eq(0));
+  EXPECT_THAT(readBytes(master, output.size()), Eq(output));
+
+  port.close();
+  ::close(master);
+}
+
+TEST(SerialMidiPort, FailsToOpenMissingTty) {
+  bmmidi::SerialMidiPort port;
+  EXPECT_THAT(port.openTty("/nonexistent/tty"), Eq(ENOENT));
+  EXPECT_THAT(port.isOpen(), IsFalse());
+}
+
+}  // namespace
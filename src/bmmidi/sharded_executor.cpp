@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/sharded_executor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+
+namespace bmmidi {
+
+namespace {
+
+// Next message to merge from one shard's outputs (or from System messages).
+struct MergeCursor {
+  double timestamp;
+  int source;  // Index in input of the message that produced this one.
+  int stream;  // Index in busyShards_, or -1 for System messages.
+  int index;   // Index in the stream.
+};
+
+struct IsMergedLater {
+  bool operator()(const MergeCursor& lhs, const MergeCursor& rhs) const {
+    if (lhs.timestamp != rhs.timestamp) { return lhs.timestamp > rhs.timestamp; }
+    return lhs.source > rhs.source;
+  }
+};
+
+}  // namespace
+
+void ChannelShardedExecutor::partition(const TimedMsgBuffer& in, const std::vector<int>* inPorts) {
+  assert((inPorts == nullptr) || (static_cast<int>(inPorts->size()) == in.size()));
+
+  int numPorts = 1;
+  if (inPorts != nullptr) {
+    for (const int port : *inPorts) {
+      assert(port >= 0);
+      numPorts = std::max(numPorts, port + 1);
+    }
+  }
+  const int numShards = numPorts * kNumChannels;
+  if (static_cast<int>(shards_.size()) < numShards) { shards_.resize(numShards); }
+  for (int i = 0; i < numShards; ++i) {
+    Shard& shard = shards_[i];
+    shard.id = MsgShard{i / kNumChannels, Channel::index(i % kNumChannels)};
+    shard.msgIndices.clear();
+    shard.out.clear();
+    shard.outSources.clear();
+    shard.outOrder.clear();
+  }
+  systemIndices_.clear();
+
+  const std::uint8_t* bytes = in.rawBytes();
+  const int* offsets = in.rawOffsets();
+  for (int i = 0; i < in.size(); ++i) {
+    assert((i == 0) || (in.timestampAt(i - 1) <= in.timestampAt(i)));
+    const std::uint8_t status = bytes[offsets[i]];
+    if (status >= 0xF0) {
+      systemIndices_.push_back(i);
+    } else {
+      const int port = (inPorts != nullptr) ? (*inPorts)[i] : 0;
+      shards_[port * kNumChannels + (status & 0x0F)].msgIndices.push_back(i);
+    }
+  }
+
+  busyShards_.clear();
+  for (int i = 0; i < numShards; ++i) {
+    if (!shards_[i].msgIndices.empty()) { busyShards_.push_back(i); }
+  }
+}
+
+void ChannelShardedExecutor::sortOutputs(Shard& shard) {
+  shard.outOrder.resize(shard.out.size());
+  for (int i = 0; i < shard.out.size(); ++i) { shard.outOrder[i] = i; }
+
+  // Outputs are usually already sorted (e.g. by a stateless transform).
+  const double* timestamps = shard.out.rawTimestamps();
+  const auto isBefore = [timestamps, &shard](int lhs, int rhs) {
+    if (timestamps[lhs] != timestamps[rhs]) { return timestamps[lhs] < timestamps[rhs]; }
+    return shard.outSources[lhs] < shard.outSources[rhs];
+  };
+  if (!std::is_sorted(shard.outOrder.begin(), shard.outOrder.end(), isBefore)) {
+    std::stable_sort(shard.outOrder.begin(), shard.outOrder.end(), isBefore);
+  }
+}
+
+void ChannelShardedExecutor::runShards(const std::function<void(Shard&)>& fn) {
+  // Submit the biggest shards first, so they don't finish last.
+  std::sort(busyShards_.begin(), busyShards_.end(), [this](int lhs, int rhs) {
+    return shards_[lhs].msgIndices.size() > shards_[rhs].msgIndices.size();
+  });
+  for (const int index : busyShards_) {
+    Shard* shard = &shards_[index];
+    pool_.submit([&fn, shard] { fn(*shard); });
+  }
+  pool_.waitIdle();
+}
+
+void ChannelShardedExecutor::merge(const TimedMsgBuffer& in, const std::vector<int>* inPorts,
+                                   TimedMsgBuffer& out, std::vector<int>* outPorts) {
+  out.clear();
+  if (outPorts != nullptr) { outPorts->clear(); }
+
+  std::priority_queue<MergeCursor, std::vector<MergeCursor>, IsMergedLater> cursors;
+  for (int s = 0; s < static_cast<int>(busyShards_.size()); ++s) {
+    const Shard& shard = shards_[busyShards_[s]];
+    if (!shard.out.empty()) {
+      const int first = shard.outOrder[0];
+      cursors.push(MergeCursor{shard.out.timestampAt(first), shard.outSources[first], s, 0});
+    }
+  }
+  if (!systemIndices_.empty()) {
+    const int source = systemIndices_[0];
+    cursors.push(MergeCursor{in.timestampAt(source), source, -1, 0});
+  }
+
+  while (!cursors.empty()) {
+    const MergeCursor cursor = cursors.top();
+    cursors.pop();
+
+    if (cursor.stream < 0) {
+      out.push(in[cursor.source]);
+      if (outPorts != nullptr) {
+        outPorts->push_back((inPorts != nullptr) ? (*inPorts)[cursor.source] : 0);
+      }
+      const int next = cursor.index + 1;
+      if (next < static_cast<int>(systemIndices_.size())) {
+        const int source = systemIndices_[next];
+        cursors.push(MergeCursor{in.timestampAt(source), source, -1, next});
+      }
+      continue;
+    }
+
+    const Shard& shard = shards_[busyShards_[cursor.stream]];
+    out.push(shard.out[shard.outOrder[cursor.index]]);
+    if (outPorts != nullptr) { outPorts->push_back(shard.id.port); }
+    const int next = cursor.index + 1;
+    if (next < shard.out.size()) {
+      const int outIndex = shard.outOrder[next];
+      cursors.push(MergeCursor{shard.out.timestampAt(outIndex), shard.outSources[outIndex],
+                               cursor.stream, next});
+    }
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SHARDED_EXECUTOR_HPP
+#define BMMIDI_SHARDED_EXECUTOR_HPP
+
+#include <cassert>
+#include <functional>
+#include <vector>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/thread_pool.hpp"
+
+namespace bmmidi {
+
+/** Identifies one shard of a ChannelShardedExecutor: a (port, channel) pair. */
+struct MsgShard {
+  int port = 0;
+  Channel channel = Channel::first();
+
+  /** Returns the dense index of this shard (port * kNumChannels + channel index). */
+  int index() const { return port * kNumChannels + channel.index(); }
+};
+
+/**
+ * Runs an offline transform over a timed message stream in parallel, by
+ * partitioning Channel messages into shards by (port, channel), transforming
+ * each shard on a worker thread, and merging the results back in timestamp
+ * order.
+ *
+ * The result is the same as running the transform sequentially: each shard's
+ * messages are transformed in order (by one thread), and System messages are
+ * barriers, passed through unchanged and in order relative to the outputs of
+ * all messages before and after them. Since messages on different channels
+ * are independent, this scales with the # of busy shards (e.g. MPE tracks).
+ */
+class ChannelShardedExecutor {
+public:
+  /**
+   * Starts numThreads worker threads (or one per hardware thread, if
+   * numThreads <= 0).
+   */
+  explicit ChannelShardedExecutor(int numThreads = 0) : pool_{numThreads} {}
+
+  ChannelShardedExecutor(const ChannelShardedExecutor&) = delete;
+  ChannelShardedExecutor& operator=(const ChannelShardedExecutor&) = delete;
+
+  /**
+   * Transforms in (sorted by timestamp, all on port 0) into out (which is
+   * cleared first). See process() with ports for details.
+   */
+  template<typename ShardFn>
+  void process(const TimedMsgBuffer& in, ShardFn&& fn, TimedMsgBuffer& out) {
+    process(in, nullptr, fn, out, nullptr);
+  }
+
+  /**
+   * Transforms in (sorted by timestamp) into out (which is cleared first).
+   *
+   * Calls fn(const MsgShard& shard, const TimedMsgView& msg, TimedMsgBuffer&
+   * shardOut) for each Channel message in, which appends any outputs for msg
+   * (at any timestamps, e.g. later Note Offs) to shardOut. Calls
+   * for the same shard are made in order from one thread, but calls for
+   * different shards are made concurrently (so per-shard state can be kept in
+   * a table indexed by MsgShard::index() without locking).
+   *
+   * If inPorts is not nullptr, inPorts[i] is the (>= 0) port of in[i], and
+   * the port of each output is written to outPorts (if not nullptr).
+   *
+   * Outputs are ordered by timestamp, then by the position of the message
+   * that produced them, then by the order fn appended them (so ties keep their
+   * sequential order). Each shard's outputs are sorted on its worker thread,
+   * so only the final merge is serial.
+   */
+  template<typename ShardFn>
+  void process(const TimedMsgBuffer& in, const std::vector<int>* inPorts, ShardFn&& fn,
+               TimedMsgBuffer& out, std::vector<int>* outPorts) {
+    partition(in, inPorts);
+    runShards([&in, &fn](Shard& shard) {
+      for (const int index : shard.msgIndices) {
+        fn(shard.id, in[index], shard.out);
+        shard.outSources.resize(shard.out.size(), index);
+      }
+      sortOutputs(shard);
+    });
+    merge(in, inPorts, out, outPorts);
+  }
+
+  /** Returns the # of worker threads. */
+  int numThreads() const { return pool_.numThreads(); }
+
+private:
+  struct Shard {
+    MsgShard id;
+    std::vector<int> msgIndices;  // Indices in input of this shard's messages.
+    TimedMsgBuffer out;
+    std::vector<int> outSources;  // Index in input of each output's message.
+    std::vector<int> outOrder;    // Indices in out, in merge order.
+  };
+
+  // Sorts message indices of in into shards_ and systemIndices_.
+  void partition(const TimedMsgBuffer& in, const std::vector<int>* inPorts);
+
+  // Sorts shard's outputs into merge order.
+  static void sortOutputs(Shard& shard);
+
+  // Runs fn on each non-empty shard on the pool, and waits for all.
+  void runShards(const std::function<void(Shard&)>& fn);
+
+  // Merges shard outputs and System messages into out.
+  void merge(const TimedMsgBuffer& in, const std::vector<int>* inPorts, TimedMsgBuffer& out,
+             std::vector<int>* outPorts);
+
+  std::vector<Shard> shards_;
+  std::vector<int> busyShards_;     // Indices of non-empty shards.
+  std::vector<int> systemIndices_;  // Indices in input of System messages.
+
+  // Declared last, so workers stop before the members above are destroyed.
+  WorkStealingPool pool_;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SHARDED_EXECUTOR_HPP
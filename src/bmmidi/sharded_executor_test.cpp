@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/sharded_executor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/channel.hpp"
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+using Bytes = std::vector<std::uint8_t>;
+
+std::vector<Bytes> msgBytes(const bmmidi::TimedMsgBuffer& msgs) {
+  std::vector<Bytes> result;
+  for (const bmmidi::TimedMsgView msg : msgs) {
+    const bmmidi::MsgView view = msg.value();
+    result.emplace_back(view.rawBytes(), view.rawBytes() + view.numBytes());
+  }
+  return result;
+}
+
+// Stateful per-shard transform: replaces each Note On's velocity with a
+// running count of notes on its shard, and echoes it 0.5 later as Note Off.
+class CountingEcho {
+public:
+  explicit CountingEcho(int numShards) : counts_(numShards, 0) {}
+
+  void operator()(const bmmidi::MsgShard& shard, const bmmidi::TimedMsgView& msg,
+                  bmmidi::TimedMsgBuffer& out) {
+    const std::uint8_t* bytes = msg.value().rawBytes();
+    if ((bytes[0] & 0xF0) != 0x90) {
+      out.push(msg);
+      return;
+    }
+    int& count = counts_[shard.index()];
+    count = (count + 1) % 128;
+    const std::uint8_t noteOn[] = {bytes[0], bytes[1], static_cast<std::uint8_t>(count)};
+    const std::uint8_t noteOff[] = {static_cast<std::uint8_t>(0x80 | (bytes[0] & 0x0F)), bytes[1],
+                                    0};
+    out.push(msg.timestamp(), noteOn, 3);
+    out.push(msg.timestamp() + 0.5, noteOff, 3);
+  }
+
+private:
+  std::vector<int> counts_;
+};
+
+// Runs fn over in sequentially, merging outputs by (timestamp, source index).
+bmmidi::TimedMsgBuffer processSequentially(const bmmidi::TimedMsgBuffer& in,
+                                           const std::vector<int>& ports, CountingEcho fn) {
+  struct Output {
+    double timestamp;
+    int source;
+    Bytes bytes;
+  };
+  std::vector<Output> outputs;
+  bmmidi::TimedMsgBuffer scratch;
+  for (int i = 0; i < in.size(); ++i) {
+    const bmmidi::MsgView view = in[i].value();
+    scratch.clear();
+    if (view.rawBytes()[0] >= 0xF0) {
+      scratch.push(in[i]);
+    } else {
+      fn(bmmidi::MsgShard{ports[i], bmmidi::Channel::index(view.rawBytes()[0] & 0x0F)}, in[i],
+         scratch);
+    }
+    for (const bmmidi::TimedMsgView msg : scratch) {
+      const bmmidi::MsgView out = msg.value();
+      outputs.push_back(
+          Output{msg.timestamp(), i, Bytes(out.rawBytes(), out.rawBytes() + out.numBytes())});
+    }
+  }
+  std::stable_sort(outputs.begin(), outputs.end(), [](const Output& lhs, const Output& rhs) {
+    return (lhs.timestamp != rhs.timestamp) ? (lhs.timestamp < rhs.timestamp)
+                                            : (lhs.source < rhs.source);
+  });
+
+  bmmidi::TimedMsgBuffer result;
+  for (const Output& output : outputs) {
+    result.push(output.timestamp, output.bytes.data(), static_cast<int>(output.bytes.size()));
+  }
+  return result;
+}
+
+TEST(ChannelShardedExecutor, KeepsOrderWithinChannelsAndAtBarriers) {
+  bmmidi::TimedMsgBuffer in;
+  const std::vector<Bytes> msgs = {
+      {0x90, 60, 100}, {0x91, 62, 100}, {0xF8}, {0x90, 64, 100}, {0xB1, 7, 90}, {0xFC},
+  };
+  const std::vector<double> timestamps = {0.0, 0.0, 0.0, 1.0, 2.0, 2.0};
+  for (int i = 0; i < static_cast<int>(msgs.size()); ++i) {
+    in.push(timestamps[i], msgs[i].data(), static_cast<int>(msgs[i].size()));
+  }
+
+  bmmidi::ChannelShardedExecutor executor{2};
+  bmmidi::TimedMsgBuffer out;
+  executor.process(in, CountingEcho{bmmidi::kNumChannels}, out);
+
+  EXPECT_THAT(msgBytes(out), ElementsAre(ElementsAre(0x90, 60, 1), ElementsAre(0x91, 62, 1),
+                                         ElementsAre(0xF8), ElementsAre(0x80, 60, 0),
+                                         ElementsAre(0x81, 62, 0), ElementsAre(0x90, 64, 2),
+                                         ElementsAre(0x80, 64, 0), ElementsAre(0xB1, 7, 90),
+                                         ElementsAre(0xFC)));
+  EXPECT_THAT(out.timestampAt(3), Eq(0.5));
+  EXPECT_THAT(out.timestampAt(6), Eq(1.5));
+}
+
+TEST(ChannelShardedExecutor, MatchesSequentialProcessing) {
+  constexpr int kNumPorts = 3;
+  std::mt19937 rng{1234};
+  std::uniform_int_distribution<int> typeDist{0, 9};
+  std::uniform_int_distribution<int> channelDist{0, 15};
+  std::uniform_int_distribution<int> portDist{0, kNumPorts - 1};
+  std::uniform_int_distribution<int> dataDist{0, 127};
+  std::uniform_int_distribution<int> stepDist{0, 3};
+
+  bmmidi::TimedMsgBuffer in;
+  std::vector<int> ports;
+  double now = 0.0;
+  for (int i = 0; i < 20000; ++i) {
+    now += 0.25 * stepDist(rng);
+    const int type = typeDist(rng);
+    const auto channel = static_cast<std::uint8_t>(channelDist(rng));
+    Bytes msg;
+    if (type == 0) {
+      msg = {0xF8};
+    } else if (type < 6) {
+      msg = {static_cast<std::uint8_t>(0x90 | channel), static_cast<std::uint8_t>(dataDist(rng)),
+             100};
+    } else {
+      msg = {static_cast<std::uint8_t>(0xB0 | channel), 1,
+             static_cast<std::uint8_t>(dataDist(rng))};
+    }
+    in.push(now, msg.data(), static_cast<int>(msg.size()));
+    ports.push_back(portDist(rng));
+  }
+
+  bmmidi::ChannelShardedExecutor executor{4};
+  bmmidi::TimedMsgBuffer out;
+  std::vector<int> outPorts;
+  executor.process(in, &ports, CountingEcho{kNumPorts * bmmidi::kNumChannels}, out, &outPorts);
+
+  const bmmidi::TimedMsgBuffer expected =
+      processSequentially(in, ports, CountingEcho{kNumPorts * bmmidi::kNumChannels});
+  ASSERT_THAT(out.size(), Eq(expected.size()));
+  EXPECT_THAT(msgBytes(out), Eq(msgBytes(expected)));
+  for (int i = 0; i < out.size(); ++i) {
+    ASSERT_THAT(out.timestampAt(i), Eq(expected.timestampAt(i)));
+  }
+  ASSERT_THAT(outPorts.size(), Eq(static_cast<std::size_t>(out.size())));
+
+  // Reusing the executor gives the same result.
+  bmmidi::TimedMsgBuffer again;
+  executor.process(in, &ports, CountingEcho{kNumPorts * bmmidi::kNumChannels}, again, nullptr);
+  EXPECT_THAT(msgBytes(again), Eq(msgBytes(expected)));
+}
+
+}  // namespace
@@ -0,0 +1,233 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/shm_msg_ring.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <new>
+
+namespace bmmidi {
+
+namespace {
+
+constexpr std::uint32_t kMagic = 0x424D5247;  // "BMRG"
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint64_t kMinCapacityBytes = 256;
+
+// Futexes must be plain 32-bit words shared between processes.
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+              "Futex words must be 32 bits");
+static_assert((ATOMIC_INT_LOCK_FREE == 2) && (ATOMIC_LONG_LOCK_FREE == 2),
+              "Shared atomics must be lock-free");
+
+constexpr std::uint64_t dataOffset() {
+  return (sizeof(internal::ShmMsgRingHeader) + 63) & ~std::uint64_t{63};
+}
+
+bool isValidCapacity(std::uint64_t capacity) {
+  return (capacity >= kMinCapacityBytes) && ((capacity & (capacity - 1)) == 0)
+      && (capacity <= std::uint64_t{INT_MAX});
+}
+
+// Sleeps while *word == expected, for up to timeoutMs (if >= 0). Returns 0 or
+// an errno value (ETIMEDOUT, or EAGAIN/EINTR if woken spuriously).
+int futexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected, int timeoutMs) {
+  struct timespec timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+  const long result = ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT,
+                                expected, (timeoutMs >= 0) ? &timeout : nullptr, nullptr, 0);
+  return (result == 0) ? 0 : errno;
+}
+
+void futexWake(std::atomic<std::uint32_t>& word) {
+  ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr,
+            nullptr, 0);
+}
+
+// Rings doorbell seq if the other side is (about to be) waiting on it.
+void ringDoorbell(std::atomic<std::uint32_t>& seq, const std::atomic<std::uint32_t>& isWaiting) {
+  if (isWaiting.load(std::memory_order_seq_cst) != 0) {
+    seq.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(seq);
+  }
+}
+
+}  // namespace
+
+ShmMsgRing::~ShmMsgRing() { close(); }
+
+int ShmMsgRing::create(int capacityBytes) {
+  close();
+  assert(isValidCapacity(static_cast<std::uint64_t>(capacityBytes)));
+  fd_ = ::memfd_create("bmmidi-msg-ring", MFD_CLOEXEC);
+  if (fd_ < 0) { return errno; }
+  return map(static_cast<std::uint64_t>(capacityBytes));
+}
+
+int ShmMsgRing::createNamed(const char* name, int capacityBytes) {
+  close();
+  assert(isValidCapacity(static_cast<std::uint64_t>(capacityBytes)));
+  fd_ = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd_ < 0) { return errno; }
+  return map(static_cast<std::uint64_t>(capacityBytes));
+}
+
+int ShmMsgRing::openNamed(const char* name) {
+  close();
+  fd_ = ::shm_open(name, O_RDWR | O_CLOEXEC, 0);
+  if (fd_ < 0) { return errno; }
+  return map(0);
+}
+
+int ShmMsgRing::unlinkNamed(const char* name) {
+  return (::shm_unlink(name) == 0) ? 0 : errno;
+}
+
+int ShmMsgRing::attach(int fd) {
+  assert(fd >= 0);
+  close();
+  fd_ = fd;
+  return map(0);
+}
+
+int ShmMsgRing::map(std::uint64_t capacity) {
+  const bool isCreating = (capacity > 0);
+  if (isCreating) {
+    if (::ftruncate(fd_, static_cast<off_t>(dataOffset() + capacity)) != 0) {
+      const int error = errno;
+      close();
+      return error;
+    }
+  } else {
+    struct stat stats;
+    if (::fstat(fd_, &stats) != 0) {
+      const int error = errno;
+      close();
+      return error;
+    }
+    const auto size = static_cast<std::uint64_t>(stats.st_size);
+    if ((stats.st_size < 0) || (size <= dataOffset()) || !isValidCapacity(size - dataOffset())) {
+      close();
+      return EINVAL;
+    }
+    capacity = size - dataOffset();
+  }
+
+  const auto numBytes = static_cast<std::size_t>(dataOffset() + capacity);
+  void* memory = ::mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (memory == MAP_FAILED) {
+    const int error = errno;
+    close();
+    return error;
+  }
+
+  header_ = static_cast<internal::ShmMsgRingHeader*>(memory);
+  data_ = static_cast<std::uint8_t*>(memory) + dataOffset();
+  numMappedBytes_ = numBytes;
+  capacity_ = capacity;
+  msgBytes_.resize(static_cast<std::size_t>(maxMsgBytes()));
+
+  if (isCreating) {
+    new (memory) internal::ShmMsgRingHeader{};
+    header_->version = kVersion;
+    header_->capacityBytes = capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+  } else if ((header_->magic != kMagic) || (header_->version != kVersion)
+             || (header_->capacityBytes != capacity)) {
+    close();
+    return EINVAL;
+  }
+  return 0;
+}
+
+void ShmMsgRing::close() {
+  if (header_ != nullptr) { ::munmap(header_, numMappedBytes_); }
+  if (fd_ >= 0) { ::close(fd_); }
+  header_ = nullptr;
+  data_ = nullptr;
+  capacity_ = 0;
+  numMappedBytes_ = 0;
+  fd_ = -1;
+  isCorrupt_ = false;
+  numInvalidMsgs_ = 0;
+}
+
+bool ShmMsgRing::tryPush(double timestamp, const MsgView& msg) {
+  assert(isOpen());
+  assert(msg.numBytes() <= maxMsgBytes());
+
+  const auto numBytes = static_cast<std::uint32_t>(msg.numBytes());
+  const std::uint64_t numRecordBytes = recordBytes(numBytes);
+  std::uint64_t writePos = header_->writePos.load(std::memory_order_relaxed);
+  const std::uint64_t readPos = header_->readPos.load(std::memory_order_acquire);
+  if ((writePos - readPos) + bytesToPush(writePos, numRecordBytes) > capacity_) { return false; }
+
+  std::uint64_t offset = writePos & (capacity_ - 1);
+  internal::ShmMsgRecord record = {};
+  if (capacity_ - offset < numRecordBytes) {
+    // Skip unused space at the end (which always fits a record header).
+    record.numBytes = internal::kShmMsgWrapMarker;
+    std::memcpy(&data_[offset], &record, sizeof(record));
+    writePos += capacity_ - offset;
+    offset = 0;
+  }
+
+  record.timestamp = timestamp;
+  record.numBytes = numBytes;
+  std::memcpy(&data_[offset], &record, sizeof(record));
+  std::memcpy(&data_[offset + sizeof(record)], msg.rawBytes(), numBytes);
+
+  header_->writePos.store(writePos + numRecordBytes, std::memory_order_seq_cst);
+  ringDoorbell(header_->dataSeq, header_->isConsumerWaiting);
+  return true;
+}
+
+int ShmMsgRing::push(double timestamp, const MsgView& msg, int timeoutMs) {
+  const std::uint64_t numRecordBytes = recordBytes(static_cast<std::uint32_t>(msg.numBytes()));
+  while (!tryPush(timestamp, msg)) {
+    // Announce waiting before rechecking for room, so that the consumer either
+    // sees the announcement or this sees its progress.
+    const std::uint32_t seq = header_->spaceSeq.load(std::memory_order_seq_cst);
+    header_->isProducerWaiting.store(1, std::memory_order_seq_cst);
+    const std::uint64_t writePos = header_->writePos.load(std::memory_order_relaxed);
+    const std::uint64_t readPos = header_->readPos.load(std::memory_order_seq_cst);
+    int error = 0;
+    if ((writePos - readPos) + bytesToPush(writePos, numRecordBytes) > capacity_) {
+      error = futexWait(header_->spaceSeq, seq, timeoutMs);
+    }
+    header_->isProducerWaiting.store(0, std::memory_order_relaxed);
+    if (error == ETIMEDOUT) { return tryPush(timestamp, msg) ? 0 : ETIMEDOUT; }
+  }
+  return 0;
+}
+
+int ShmMsgRing::waitForMsgs(int timeoutMs) {
+  assert(isOpen());
+  if (!isEmpty()) { return 0; }
+
+  const std::uint32_t seq = header_->dataSeq.load(std::memory_order_seq_cst);
+  header_->isConsumerWaiting.store(1, std::memory_order_seq_cst);
+  int error = 0;
+  if (isEmpty()) { error = futexWait(header_->dataSeq, seq, timeoutMs); }
+  header_->isConsumerWaiting.store(0, std::memory_order_relaxed);
+  return ((error == ETIMEDOUT) && isEmpty()) ? ETIMEDOUT : 0;
+}
+
+void ShmMsgRing::releaseTo(std::uint64_t readPos) {
+  header_->readPos.store(readPos, std::memory_order_seq_cst);
+  ringDoorbell(header_->spaceSeq, header_->isProducerWaiting);
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,254 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SHM_MSG_RING_HPP
+#define BMMIDI_SHM_MSG_RING_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+
+namespace internal {
+
+// Start of a ShmMsgRing's shared memory (followed by its data area), with the
+// producer's and consumer's fields on separate cache lines.
+struct ShmMsgRingHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint64_t capacityBytes;
+
+  // Written by the producer.
+  alignas(64) std::atomic<std::uint64_t> writePos;  // Total bytes written.
+  std::atomic<std::uint32_t> dataSeq;               // Futex rung on writes.
+  std::atomic<std::uint32_t> isProducerWaiting;
+
+  // Written by the consumer.
+  alignas(64) std::atomic<std::uint64_t> readPos;  // Total bytes consumed.
+  std::atomic<std::uint32_t> spaceSeq;             // Futex rung on reads.
+  std::atomic<std::uint32_t> isConsumerWaiting;
+};
+
+// Header of each record in the data area, followed by its message bytes (with
+// records padded to multiples of kShmMsgRecordAlign bytes).
+struct ShmMsgRecord {
+  double timestamp;
+  std::uint32_t numBytes;
+  std::uint32_t reserved;
+};
+
+BMMIDI_INLINE_VAR static constexpr std::uint64_t kShmMsgRecordAlign = sizeof(ShmMsgRecord);
+
+// ShmMsgRecord::numBytes marking unused space at the end of the data area.
+BMMIDI_INLINE_VAR static constexpr std::uint32_t kShmMsgWrapMarker = 0xFFFFFFFF;
+
+}  // namespace internal
+
+/**
+ * Single-producer, single-consumer ring of timed messages (including SysEx,
+ * stored inline) in shared memory, for passing messages between processes
+ * (e.g. to and from sandboxed plugin processes) with no serialization or
+ * system calls on the fast path.
+ *
+ * One process creates the ring (in an anonymous memfd, whose fd it can pass to
+ * another process, or in a named POSIX shared memory object), and another
+ * process attaches to it. One thread must only push and one thread must only
+ * consume, and either side can busy-poll (tryPush(), consume()) from a
+ * realtime thread, or block (push(), waitForMsgs()) on a futex doorbell. The
+ * doorbell is only rung (with a system call) when the other side is asleep.
+ *
+ * Records are copied out of shared memory and then validated as they are
+ * consumed, so a misbehaving producer (even one that rewrites records while
+ * they are consumed) can only cause invalid messages to be skipped (see
+ * numInvalidMsgs()) or the ring to be marked corrupt (see isCorrupt()), never
+ * out-of-bounds access.
+ *
+ * All functions that make system calls return 0 on success, or else an errno
+ * value.
+ */
+class ShmMsgRing {
+public:
+  ShmMsgRing() = default;
+  ~ShmMsgRing();
+
+  ShmMsgRing(const ShmMsgRing&) = delete;
+  ShmMsgRing& operator=(const ShmMsgRing&) = delete;
+
+  /**
+   * Creates a ring in a new anonymous memfd with the given data capacity,
+   * which must be a power of 2 of at least 256 bytes.
+   */
+  int create(int capacityBytes);
+
+  /** Creates a ring in a new POSIX shared memory object name (e.g. "/ring"). */
+  int createNamed(const char* name, int capacityBytes);
+
+  /** Opens a ring previously created with createNamed(). */
+  int openNamed(const char* name);
+
+  /** Removes the name of a POSIX shared memory object. */
+  static int unlinkNamed(const char* name);
+
+  /**
+   * Maps the ring in fd (e.g. received from the process that created it),
+   * taking ownership of fd. Returns EINVAL if fd does not hold a ring.
+   */
+  int attach(int fd);
+
+  /** Unmaps the ring and closes its fd. */
+  void close();
+
+  /** Returns true if a ring is mapped. */
+  bool isOpen() const { return header_ != nullptr; }
+
+  /** Returns the ring's fd (e.g. to pass to another process), or -1 if not open. */
+  int fd() const { return fd_; }
+
+  /** Returns the capacity of the data area, in bytes. */
+  int capacityBytes() const { return static_cast<int>(capacity_); }
+
+  /** Returns the maximum # of bytes of each message. */
+  int maxMsgBytes() const {
+    return static_cast<int>(capacity_ / 2 - sizeof(internal::ShmMsgRecord));
+  }
+
+  // Producer functions.
+
+  /**
+   * Pushes msg (of at most maxMsgBytes()) with the given timestamp, returning
+   * false if there is currently no room for it. Never blocks.
+   */
+  bool tryPush(double timestamp, const MsgView& msg);
+
+  /**
+   * Pushes msg with the given timestamp, waiting up to timeoutMs milliseconds
+   * (-1 to wait indefinitely) for room. Returns ETIMEDOUT if there was none.
+   */
+  int push(double timestamp, const MsgView& msg, int timeoutMs);
+
+  // Consumer functions.
+
+  /**
+   * Calls emit(const TimedMsgView&) for up to maxMsgs available messages, in
+   * order, then releases their space all at once. Returns the # of messages
+   * consumed. Never blocks.
+   *
+   * Emitted TimedMsgView references point into the consumer's copy of each
+   * message (not shared memory), and are only valid during each emit() call.
+   */
+  template<typename EmitFn>
+  int consume(EmitFn&& emit, int maxMsgs = std::numeric_limits<int>::max()) {
+    assert(isOpen());
+    if (isCorrupt_) { return 0; }
+
+    const std::uint64_t firstReadPos = header_->readPos.load(std::memory_order_relaxed);
+    std::uint64_t readPos = firstReadPos;
+    const std::uint64_t writePos = header_->writePos.load(std::memory_order_acquire);
+    if (((writePos - readPos) > capacity_)
+        || (((writePos - readPos) % internal::kShmMsgRecordAlign) != 0)) {
+      isCorrupt_ = true;
+      return 0;
+    }
+
+    int numConsumed = 0;
+    while ((readPos != writePos) && (numConsumed < maxMsgs)) {
+      const std::uint64_t offset = readPos & (capacity_ - 1);
+      internal::ShmMsgRecord record;
+      std::memcpy(&record, &data_[offset], sizeof(record));
+      if (record.numBytes == internal::kShmMsgWrapMarker) {
+        if (capacity_ - offset > writePos - readPos) {
+          isCorrupt_ = true;
+          break;
+        }
+        readPos += capacity_ - offset;
+        continue;
+      }
+
+      const std::uint64_t numRecordBytes = recordBytes(record.numBytes);
+      if ((record.numBytes > static_cast<std::uint32_t>(maxMsgBytes()))
+          || (numRecordBytes > writePos - readPos) || (offset + numRecordBytes > capacity_)) {
+        isCorrupt_ = true;
+        break;
+      }
+
+      // Validate a private copy, which the producer cannot change afterward.
+      std::memcpy(msgBytes_.data(), &data_[offset + sizeof(record)], record.numBytes);
+      const int numBytes = static_cast<int>(record.numBytes);
+      if (isValidMsg(msgBytes_.data(), numBytes)) {
+        emit(TimedMsgView{record.timestamp, msgBytes_.data(), numBytes});
+      } else {
+        ++numInvalidMsgs_;
+      }
+      readPos += numRecordBytes;
+      ++numConsumed;
+    }
+
+    if (readPos != firstReadPos) { releaseTo(readPos); }
+    return numConsumed;
+  }
+
+  /** Returns true if there are no messages to consume. */
+  bool isEmpty() const {
+    assert(isOpen());
+    return header_->writePos.load(std::memory_order_seq_cst)
+        == header_->readPos.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Waits up to timeoutMs milliseconds (-1 to wait indefinitely) until there
+   * are messages to consume, returning 0 if so (or if woken spuriously) or
+   * ETIMEDOUT.
+   */
+  int waitForMsgs(int timeoutMs);
+
+  /** Returns true if consumers found the shared state to be inconsistent. */
+  bool isCorrupt() const { return isCorrupt_; }
+
+  /** Returns # of invalid messages skipped by consume() since opening. */
+  std::int64_t numInvalidMsgs() const { return numInvalidMsgs_; }
+
+private:
+  static std::uint64_t recordBytes(std::uint32_t numBytes) {
+    const std::uint64_t numUnpadded = sizeof(internal::ShmMsgRecord) + std::uint64_t{numBytes};
+    return (numUnpadded + internal::kShmMsgRecordAlign - 1) & ~(internal::kShmMsgRecordAlign - 1);
+  }
+
+  // Returns # of bytes pushing a record of numRecordBytes at writePos uses
+  // (including any wrap padding).
+  std::uint64_t bytesToPush(std::uint64_t writePos, std::uint64_t numRecordBytes) const {
+    const std::uint64_t numTailBytes = capacity_ - (writePos & (capacity_ - 1));
+    return (numTailBytes < numRecordBytes) ? (numTailBytes + numRecordBytes) : numRecordBytes;
+  }
+
+  // Maps the ring in fd_ (whose header is initialized if capacity > 0).
+  int map(std::uint64_t capacity);
+
+  // Publishes consumption of everything before readPos, waking the producer
+  // if it is waiting for room.
+  void releaseTo(std::uint64_t readPos);
+
+  internal::ShmMsgRingHeader* header_ = nullptr;
+  std::uint8_t* data_ = nullptr;
+  std::uint64_t capacity_ = 0;  // Trusted copy of header_->capacityBytes.
+  std::size_t numMappedBytes_ = 0;
+  int fd_ = -1;
+
+  // Consumer's copy of the message being consumed (of maxMsgBytes()).
+  std::vector<std::uint8_t> msgBytes_;
+
+  bool isCorrupt_ = false;
+  std::int64_t numInvalidMsgs_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SHM_MSG_RING_HPP
@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/shm_msg_ring.hpp"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/test_msgs.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Ne;
+
+using Bytes = std::vector<std::uint8_t>;
+
+using bmmidi::test::testMsg;
+using bmmidi::test::viewOf;
+
+// Consumes all available messages as {timestamp, bytes...}.
+std::vector<std::vector<double>> consumeAll(bmmidi::ShmMsgRing& ring) {
+  std::vector<std::vector<double>> result;
+  ring.consume([&result](const bmmidi::TimedMsgView& msg) {
+    std::vector<double> entry{msg.timestamp()};
+    const bmmidi::MsgView view = msg.value();
+    entry.insert(entry.end(), view.rawBytes(), view.rawBytes() + view.numBytes());
+    result.push_back(entry);
+  });
+  return result;
+}
+
+TEST(ShmMsgRing, PushesAndConsumesInOrder) {
+  bmmidi::ShmMsgRing ring;
+  ASSERT_THAT(ring.create(4096), Eq(0));
+  EXPECT_THAT(ring.isEmpty(), IsTrue());
+  EXPECT_THAT(ring.capacityBytes(), Eq(4096));
+  EXPECT_THAT(ring.maxMsgBytes(), Eq(2032));
+
+  EXPECT_THAT(ring.tryPush(1.0, viewOf({0x90, 60, 100})), IsTrue());
+  EXPECT_THAT(ring.tryPush(2.0, viewOf({0xF0, 0x7D, 1, 2, 3, 0xF7})), IsTrue());
+  EXPECT_THAT(ring.push(3.0, viewOf({0xF8}), 0), Eq(0));
+  EXPECT_THAT(ring.isEmpty(), IsFalse());
+  EXPECT_THAT(ring.waitForMsgs(0), Eq(0));
+
+  EXPECT_THAT(consumeAll(ring), ElementsAre(ElementsAre(1.0, 0x90, 60, 100),
+                                            ElementsAre(2.0, 0xF0, 0x7D, 1, 2, 3, 0xF7),
+                                            ElementsAre(3.0, 0xF8)));
+  EXPECT_THAT(ring.isEmpty(), IsTrue());
+  EXPECT_THAT(ring.waitForMsgs(1), Eq(ETIMEDOUT));
+}
+
+TEST(ShmMsgRing, WrapsAroundWhenFull) {
+  bmmidi::ShmMsgRing ring;
+  ASSERT_THAT(ring.create(256), Eq(0));
+
+  // Each 3-byte message takes a 32-byte record.
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_THAT(ring.tryPush(i, viewOf({0xB0, 7, static_cast<std::uint8_t>(i)})), IsTrue());
+  }
+
+  // A 100-byte SysEx (a 128-byte record) doesn't fit in the last 64 bytes, so
+  // needs room to skip them and wrap around.
+  Bytes sysEx(100, 0x55);
+  sysEx.front() = 0xF0;
+  sysEx.back() = 0xF7;
+  EXPECT_THAT(ring.consume([](const bmmidi::TimedMsgView&) {}, 3), Eq(3));
+  EXPECT_THAT(ring.tryPush(6.0, viewOf(sysEx)), IsFalse());
+  EXPECT_THAT(ring.consume([](const bmmidi::TimedMsgView&) {}, 1), Eq(1));
+  EXPECT_THAT(ring.tryPush(6.0, viewOf(sysEx)), IsTrue());
+
+  EXPECT_THAT(ring.tryPush(7.0, viewOf({0xF8})), IsFalse());
+  EXPECT_THAT(ring.push(7.0, viewOf({0xF8}), 1), Eq(ETIMEDOUT));
+
+  const auto msgs = consumeAll(ring);
+  ASSERT_THAT(msgs.size(), Eq(3));
+  EXPECT_THAT(msgs[0], ElementsAre(4.0, 0xB0, 7, 4));
+  EXPECT_THAT(msgs[1], ElementsAre(5.0, 0xB0, 7, 5));
+  EXPECT_THAT(msgs[2].size(), Eq(101));
+  EXPECT_THAT(ring.isCorrupt(), IsFalse());
+  EXPECT_THAT(ring.tryPush(7.0, viewOf({0xF8})), IsTrue());
+}
+
+TEST(ShmMsgRing, SkipsInvalidMsgs) {
+  bmmidi::ShmMsgRing ring;
+  ASSERT_THAT(ring.create(256), Eq(0));
+
+  // Corrupt the message bytes in shared memory after pushing.
+  const Bytes msg = {0x90, 60, 100};
+  ASSERT_THAT(ring.tryPush(0.0, viewOf(msg)), IsTrue());
+  ASSERT_THAT(ring.tryPush(1.0, viewOf(msg)), IsTrue());
+  const auto numFileBytes = static_cast<std::size_t>(::lseek(ring.fd(), 0, SEEK_END));
+  void* memory = ::mmap(nullptr, numFileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd(), 0);
+  ASSERT_THAT(memory, Ne(MAP_FAILED));
+  std::uint8_t* data = static_cast<std::uint8_t*>(memory) + (numFileBytes - 256);
+  ASSERT_THAT(data[16], Eq(0x90));
+  data[17] = 0x80;
+  ::munmap(memory, numFileBytes);
+
+  EXPECT_THAT(consumeAll(ring), ElementsAre(ElementsAre(1.0, 0x90, 60, 100)));
+  EXPECT_THAT(ring.numInvalidMsgs(), Eq(1));
+}
+
+TEST(ShmMsgRing, RejectsInvalidFds) {
+  const int fd = ::memfd_create("not-a-ring", MFD_CLOEXEC);
+  ASSERT_THAT(::ftruncate(fd, 8192), Eq(0));
+
+  bmmidi::ShmMsgRing ring;
+  EXPECT_THAT(ring.attach(fd), Eq(EINVAL));
+  EXPECT_THAT(ring.isOpen(), IsFalse());
+}
+
+TEST(ShmMsgRing, SharesNamedRing) {
+  const std::string name = "/bmmidi-shm-msg-ring-test-" + std::to_string(::getpid());
+  bmmidi::ShmMsgRing producer;
+  ASSERT_THAT(producer.createNamed(name.c_str(), 1024), Eq(0));
+  EXPECT_THAT(producer.createNamed(name.c_str(), 1024), Eq(EEXIST));
+  ASSERT_THAT(producer.openNamed(name.c_str()), Eq(0));
+
+  bmmidi::ShmMsgRing consumer;
+  ASSERT_THAT(consumer.openNamed(name.c_str()), Eq(0));
+  EXPECT_THAT(bmmidi::ShmMsgRing::unlinkNamed(name.c_str()), Eq(0));
+  EXPECT_THAT(consumer.capacityBytes(), Eq(1024));
+
+  EXPECT_THAT(producer.tryPush(5.0, viewOf({0xC1, 9})), IsTrue());
+  EXPECT_THAT(consumeAll(consumer), ElementsAre(ElementsAre(5.0, 0xC1, 9)));
+  EXPECT_THAT(producer.isEmpty(), IsTrue());
+}
+
+TEST(ShmMsgRing, BlocksAcrossProcesses) {
+  constexpr int kNumMsgs = 20000;
+  bmmidi::ShmMsgRing ring;
+  ASSERT_THAT(ring.create(1024), Eq(0));
+
+  const pid_t child = ::fork();
+  ASSERT_THAT(child, Ge(0));
+  if (child == 0) {
+    // Producer process, attached to its own mapping of the ring.
+    bmmidi::ShmMsgRing producer;
+    if (producer.attach(::dup(ring.fd())) != 0) { ::_exit(1); }
+    for (int i = 0; i < kNumMsgs; ++i) {
+      const Bytes msg = testMsg(i);
+      if (producer.push(i, viewOf(msg), 5000) != 0) { ::_exit(2); }
+    }
+    ::_exit(0);
+  }
+
+  int numReceived = 0;
+  int numMismatched = 0;
+  while (numReceived < kNumMsgs) {
+    if (ring.waitForMsgs(5000) != 0) { break; }
+    ring.consume([&numReceived, &numMismatched](const bmmidi::TimedMsgView& msg) {
+      const Bytes expected = testMsg(numReceived);
+      const bmmidi::MsgView view = msg.value();
+      if ((msg.timestamp() != numReceived)
+          || (Bytes(view.rawBytes(), view.rawBytes() + view.numBytes()) != expected)) {
+        ++numMismatched;
+      }
+      ++numReceived;
+    });
+  }
+
+  int status = 0;
+  ASSERT_THAT(::waitpid(child, &status, 0), Eq(child));
+  EXPECT_THAT(WIFEXITED(status) && (WEXITSTATUS(status) == 0), IsTrue());
+  EXPECT_THAT(numReceived, Eq(kNumMsgs));
+  EXPECT_THAT(numMismatched, Eq(0));
+}
+
+TEST(ShmMsgRing, BusyPollsBetweenThreads) {
+  constexpr int kNumMsgs = 20000;
+  bmmidi::ShmMsgRing ring;
+  ASSERT_THAT(ring.create(1024), Eq(0));
+
+  std::thread producer{[&ring] {
+    for (int i = 0; i < kNumMsgs; ++i) {
+      const Bytes msg = testMsg(i);
+      while (!ring.tryPush(i, viewOf(msg))) { std::this_thread::yield(); }
+    }
+  }};
+
+  int numReceived = 0;
+  int numMismatched = 0;
+  while (numReceived < kNumMsgs) {
+    const int numConsumed =
+        ring.consume([&numReceived, &numMismatched](const bmmidi::TimedMsgView& msg) {
+          if (msg.timestamp() != numReceived) { ++numMismatched; }
+          ++numReceived;
+        });
+    if (numConsumed == 0) { std::this_thread::yield(); }
+  }
+  producer.join();
+  EXPECT_THAT(numMismatched, Eq(0));
+}
+
+}  // namespace
@@ -0,0 +1,316 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/smf.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/status.hpp"
+
+namespace bmmidi {
+namespace {
+
+constexpr std::size_t kChunkHeaderBytes = 8;
+constexpr std::size_t kMinHeaderChunkBytes = 6;
+constexpr int kMaxVarLenBytes = 4;
+
+constexpr std::uint8_t kMetaEvent = 0xFF;
+constexpr std::uint8_t kMetaEndOfTrack = 0x2F;
+constexpr std::uint8_t kMetaSetTempo = 0x51;
+constexpr std::uint8_t kMetaTimeSignature = 0x58;
+constexpr std::uint32_t kSetTempoBytes = 3;
+constexpr std::uint32_t kTimeSignatureBytes = 4;
+constexpr int kMaxDenominatorPower = 30;
+constexpr std::uint8_t kSysExStart = static_cast<std::uint8_t>(MsgType::kSystemExclusive);
+constexpr std::uint8_t kSysExEnd = static_cast<std::uint8_t>(MsgType::kEndOfSystemExclusive);
+
+std::uint32_t readBigEndian32(const std::uint8_t* bytes) {
+  return (static_cast<std::uint32_t>(bytes[0]) << 24)
+      | (static_cast<std::uint32_t>(bytes[1]) << 16)
+      | (static_cast<std::uint32_t>(bytes[2]) << 8)
+      | static_cast<std::uint32_t>(bytes[3]);
+}
+
+std::uint16_t readBigEndian16(const std::uint8_t* bytes) {
+  return static_cast<std::uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+// Returns seconds per tick at the given tempo (for a PPQ division), or 0 if
+// the division is 0.
+double secondsPerTick(const SmfHeader& header, std::uint32_t microsPerQuarterNote) {
+  const int ticksPerQuarterNote = header.ticksPerQuarterNote();
+  return (ticksPerQuarterNote > 0) ? microsPerQuarterNote * 1e-6 / ticksPerQuarterNote : 0.0;
+}
+
+// Sequential reader over the bytes of one track chunk.
+class TrackReader {
+public:
+  TrackReader(const std::uint8_t* bytes, std::size_t numBytes)
+      : bytes_{bytes}, numBytes_{numBytes} {}
+
+  bool atEnd() const { return pos_ >= numBytes_; }
+  std::size_t remaining() const { return numBytes_ - pos_; }
+  const std::uint8_t* current() const { return &bytes_[pos_]; }
+
+  bool readByte(std::uint8_t& value) {
+    if (atEnd()) { return false; }
+    value = bytes_[pos_++];
+    return true;
+  }
+
+  bool peekByte(std::uint8_t& value) const {
+    if (atEnd()) { return false; }
+    value = bytes_[pos_];
+    return true;
+  }
+
+  // Reads a variable-length quantity of up to 4 bytes (28 bits).
+  bool readVarLen(std::uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < kMaxVarLenBytes; ++i) {
+      std::uint8_t byte;
+      if (!readByte(byte)) { return false; }
+      value = (value << 7) | (byte & 0x7F);
+      if ((byte & 0x80) == 0) { return true; }
+    }
+    return false;
+  }
+
+  bool skip(std::size_t count) {
+    if (count > remaining()) { return false; }
+    pos_ += count;
+    return true;
+  }
+
+private:
+  const std::uint8_t* bytes_;
+  std::size_t numBytes_;
+  std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+SmfResult decodeSmfTrack(const std::uint8_t* bytes, std::size_t numBytes, TimedMsgBuffer& track,
+                         std::vector<SmfTempoChange>* tempoChanges,
+                         std::vector<SmfTimeSignature>* timeSignatures) {
+  TrackReader reader{bytes, numBytes};
+  std::uint64_t ticks = 0;
+  std::uint8_t runningStatus = 0;
+
+  // SysEx split across F0 and F7 "continuation" events is accumulated here.
+  std::vector<std::uint8_t> pendingSysEx;
+  double pendingSysExTicks = 0.0;
+
+  while (!reader.atEnd()) {
+    std::uint32_t delta;
+    if (!reader.readVarLen(delta)) { return SmfResult::kTruncated; }
+    ticks += delta;
+    const double timestamp = static_cast<double>(ticks);
+
+    std::uint8_t first;
+    if (!reader.peekByte(first)) { return SmfResult::kTruncated; }
+
+    if (first == kMetaEvent) {
+      reader.skip(1);
+      std::uint8_t metaType;
+      std::uint32_t length;
+      if (!reader.readByte(metaType) || !reader.readVarLen(length)
+          || (length > reader.remaining())) {
+        return SmfResult::kTruncated;
+      }
+      const std::uint8_t* data = reader.current();
+      reader.skip(length);
+      runningStatus = 0;  // Meta events cancel running status.
+
+      if (metaType == kMetaEndOfTrack) { break; }
+      if ((metaType == kMetaSetTempo) && (length >= kSetTempoBytes) && (tempoChanges != nullptr)) {
+        SmfTempoChange change;
+        change.ticks = timestamp;
+        change.microsPerQuarterNote = (static_cast<std::uint32_t>(data[0]) << 16)
+            | (static_cast<std::uint32_t>(data[1]) << 8) | data[2];
+        tempoChanges->push_back(change);
+      } else if ((metaType == kMetaTimeSignature) && (length >= kTimeSignatureBytes)
+                 && (data[1] <= kMaxDenominatorPower) && (timeSignatures != nullptr)) {
+        SmfTimeSignature signature;
+        signature.ticks = timestamp;
+        signature.numerator = data[0];
+        signature.denominator = 1 << data[1];
+        timeSignatures->push_back(signature);
+      }
+      continue;
+    }
+
+    if ((first == kSysExStart) || (first == kSysExEnd)) {
+      reader.skip(1);
+      std::uint32_t length;
+      if (!reader.readVarLen(length)) { return SmfResult::kTruncated; }
+      if (length > reader.remaining()) { return SmfResult::kTruncated; }
+      const std::uint8_t* data = reader.current();
+      reader.skip(length);
+      runningStatus = 0;  // SysEx events cancel running status.
+
+      if (first == kSysExStart) {
+        pendingSysEx.assign(1, kSysExStart);
+        pendingSysExTicks = timestamp;
+      } else if (pendingSysEx.empty()) {
+        // F7 "escape" event with arbitrary raw bytes (not a SysEx packet).
+        continue;
+      }
+
+      pendingSysEx.insert(pendingSysEx.end(), data, data + length);
+      if ((length > 0) && (data[length - 1] == kSysExEnd)) {
+        // Skip malformed SysEx (e.g. F0 F7, or with non-data bytes), which is
+        // unsafe to reference.
+        const int numSysExBytes = static_cast<int>(pendingSysEx.size());
+        if (isValidMsg(pendingSysEx.data(), numSysExBytes)) {
+          track.push(pendingSysExTicks, pendingSysEx.data(), numSysExBytes);
+        }
+        pendingSysEx.clear();
+      }
+      continue;
+    }
+
+    std::uint8_t statusByte;
+    if (first & 0x80) {
+      if (first >= kSysExStart) { return SmfResult::kInvalidEvent; }
+      reader.skip(1);
+      statusByte = first;
+      runningStatus = first;
+    } else {
+      if (runningStatus == 0) { return SmfResult::kInvalidEvent; }
+      statusByte = runningStatus;
+    }
+
+    const int numDataBytes = Status{statusByte}.numDataBytes();
+    std::uint8_t msgBytes[3] = {statusByte, 0, 0};
+    for (int i = 1; i <= numDataBytes; ++i) {
+      if (!reader.readByte(msgBytes[i])) { return SmfResult::kTruncated; }
+      if (msgBytes[i] & 0x80) { return SmfResult::kInvalidEvent; }
+    }
+    track.push(timestamp, msgBytes, 1 + numDataBytes);
+  }
+
+  return SmfResult::kOk;
+}
+
+namespace {
+
+// Decodes the header and track chunks of an SMF into contents (leaving tempo
+// changes without seconds).
+SmfResult decodeSmfChunks(const std::uint8_t* bytes, std::size_t numBytes, SmfContents& contents) {
+  for (auto& track : contents.tracks) { track.clear(); }
+
+  if ((numBytes < kChunkHeaderBytes + kMinHeaderChunkBytes)
+      || (std::memcmp(bytes, "MThd", 4) != 0)) {
+    contents.tracks.clear();
+    return SmfResult::kNotSmf;
+  }
+
+  const std::uint32_t headerLength = readBigEndian32(&bytes[4]);
+  if ((headerLength < kMinHeaderChunkBytes)
+      || (headerLength > numBytes - kChunkHeaderBytes)) {
+    contents.tracks.clear();
+    return SmfResult::kNotSmf;
+  }
+
+  const std::uint8_t* header = &bytes[kChunkHeaderBytes];
+  const std::uint16_t format = readBigEndian16(&header[0]);
+  if (format > static_cast<std::uint16_t>(SmfFormat::kMultiSequence)) {
+    contents.tracks.clear();
+    return SmfResult::kNotSmf;
+  }
+  contents.header.format = static_cast<SmfFormat>(format);
+  contents.header.numTracks = readBigEndian16(&header[2]);
+  contents.header.division = readBigEndian16(&header[4]);
+
+  // Reuse existing track buffers (and their allocations) where possible.
+  contents.tracks.resize(contents.header.numTracks);
+
+  std::size_t pos = kChunkHeaderBytes + headerLength;
+  int trackIndex = 0;
+  while (trackIndex < contents.header.numTracks) {
+    if (numBytes - pos < kChunkHeaderBytes) {
+      contents.tracks.resize(trackIndex);
+      return SmfResult::kTruncated;
+    }
+
+    const std::uint32_t chunkLength = readBigEndian32(&bytes[pos + 4]);
+    const bool isTrack = (std::memcmp(&bytes[pos], "MTrk", 4) == 0);
+    pos += kChunkHeaderBytes;
+    if (chunkLength > numBytes - pos) {
+      contents.tracks.resize(trackIndex);
+      return SmfResult::kTruncated;
+    }
+
+    if (isTrack) {  // Unknown chunk types are skipped, per the SMF spec.
+      const auto result = decodeSmfTrack(&bytes[pos], chunkLength, contents.tracks[trackIndex],
+                                         &contents.tempoChanges, &contents.timeSignatures);
+      ++trackIndex;
+      if (result != SmfResult::kOk) {
+        contents.tracks.resize(trackIndex);
+        return result;
+      }
+    }
+    pos += chunkLength;
+  }
+
+  return SmfResult::kOk;
+}
+
+// Sorts tempo changes and time signatures of all tracks (keeping track order
+// for simultaneous ones), and fills in the seconds of each tempo change.
+void finishTempoMap(SmfContents& contents) {
+  std::stable_sort(contents.tempoChanges.begin(), contents.tempoChanges.end(),
+                   [](const SmfTempoChange& a, const SmfTempoChange& b) {
+                     return a.ticks < b.ticks;
+                   });
+  std::stable_sort(contents.timeSignatures.begin(), contents.timeSignatures.end(),
+                   [](const SmfTimeSignature& a, const SmfTimeSignature& b) {
+                     return a.ticks < b.ticks;
+                   });
+
+  SmfTempoChange previous;
+  for (SmfTempoChange& change : contents.tempoChanges) {
+    change.seconds = contents.header.isSmpteDivision()
+        ? contents.ticksToSeconds(change.ticks)
+        : previous.seconds + secondsPerTick(contents.header, previous.microsPerQuarterNote)
+                                 * (change.ticks - previous.ticks);
+    previous = change;
+  }
+}
+
+}  // namespace
+
+SmfResult decodeSmf(const std::uint8_t* bytes, std::size_t numBytes, SmfContents& contents) {
+  contents.tempoChanges.clear();
+  contents.timeSignatures.clear();
+  const SmfResult result = decodeSmfChunks(bytes, numBytes, contents);
+  finishTempoMap(contents);
+  return result;
+}
+
+double SmfContents::ticksToSeconds(double ticks) const {
+  if (header.isSmpteDivision()) {
+    const double ticksPerSecond = header.smpteTicksPerSecond();
+    return (ticksPerSecond > 0.0) ? ticks / ticksPerSecond : 0.0;
+  }
+
+  // Last tempo change at or before ticks.
+  const auto next = std::upper_bound(
+      tempoChanges.begin(), tempoChanges.end(), ticks,
+      [](double t, const SmfTempoChange& change) { return t < change.ticks; });
+  const SmfTempoChange origin = (next == tempoChanges.begin()) ? SmfTempoChange{} : *(next - 1);
+  return origin.seconds
+      + secondsPerTick(header, origin.microsPerQuarterNote) * (ticks - origin.ticks);
+}
+
+void SmfContents::mapToSeconds(TimedMsgBuffer& track) const {
+  for (int i = 0; i < track.size(); ++i) {
+    track.setTimestampAt(i, ticksToSeconds(track.timestampAt(i)));
+  }
+}
+
+}  // namespace bmmidi
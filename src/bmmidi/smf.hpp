@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SMF_HPP
+#define BMMIDI_SMF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_buffer.hpp"
+
+namespace bmmidi {
+
+/** Result of decoding a Standard MIDI File (SMF). */
+enum class SmfResult {
+  /** Decoded successfully. */
+  kOk,
+
+  /** Input does not start with a valid "MThd" header chunk. */
+  kNotSmf,
+
+  /** Input ended in the middle of a chunk or event. */
+  kTruncated,
+
+  /** A track contains an event that is not valid in an SMF. */
+  kInvalidEvent,
+};
+
+/** Standard MIDI File format, from the header chunk. */
+enum class SmfFormat : std::uint16_t {
+  /** Single multi-channel track. */
+  kSingleTrack = 0,
+
+  /** One or more simultaneous tracks. */
+  kMultiTrack = 1,
+
+  /** One or more sequentially independent single-track patterns. */
+  kMultiSequence = 2,
+};
+
+/** Information from a Standard MIDI File header ("MThd") chunk. */
+struct SmfHeader {
+  SmfFormat format = SmfFormat::kSingleTrack;
+
+  /** # of track chunks declared by the header. */
+  int numTracks = 0;
+
+  /**
+   * Raw 16-bit division value. If bit 15 is 0, the lower 15 bits are ticks per
+   * quarter note; otherwise the division is SMPTE-based (see isSmpteDivision()).
+   */
+  std::uint16_t division = 0;
+
+  /** Returns true if division is SMPTE frames & ticks per frame (not PPQ). */
+  bool isSmpteDivision() const { return (division & 0x8000) != 0; }
+
+  /** Returns ticks per quarter note (only valid if !isSmpteDivision()). */
+  int ticksPerQuarterNote() const { return division & 0x7FFF; }
+
+  /**
+   * Returns ticks per second (only valid if isSmpteDivision()): SMPTE frames
+   * per second (with 29 meaning 29.97 drop-frame) times ticks per frame.
+   */
+  double smpteTicksPerSecond() const {
+    const int framesPerSecond = -static_cast<std::int8_t>(division >> 8);
+    const double exactFramesPerSecond =
+        (framesPerSecond == 29) ? 30000.0 / 1001.0 : static_cast<double>(framesPerSecond);
+    return exactFramesPerSecond * (division & 0xFF);
+  }
+};
+
+/** Tempo in effect until the first Set Tempo meta event (120 BPM). */
+BMMIDI_INLINE_VAR static constexpr std::uint32_t kSmfDefaultMicrosPerQuarterNote = 500000;
+
+/** Tempo change from a Set Tempo meta event (FF 51). */
+struct SmfTempoChange {
+  /** Absolute ticks of the change. */
+  double ticks = 0.0;
+
+  /** Tempo from ticks on, in microseconds per quarter note. */
+  std::uint32_t microsPerQuarterNote = kSmfDefaultMicrosPerQuarterNote;
+
+  /** Seconds since the start of the file at ticks (set by decodeSmf()). */
+  double seconds = 0.0;
+};
+
+/** Time signature from a Time Signature meta event (FF 58). */
+struct SmfTimeSignature {
+  /** Absolute ticks of the change. */
+  double ticks = 0.0;
+
+  int numerator = 4;
+
+  /** Note value of a beat (e.g. 8 for 6/8), a power of 2. */
+  int denominator = 4;
+};
+
+/**
+ * Decoded contents of a Standard MIDI File: one TimedMsgBuffer of MIDI
+ * messages per track, with timestamps in absolute ticks since the start of
+ * the track, plus the tempo map and time signatures needed to interpret them.
+ *
+ * Meta events are not included in the decoded tracks. Set Tempo and Time
+ * Signature events of all tracks are collected (in tick order) instead, and
+ * others (text, key signature, etc.) are skipped. SysEx events split across
+ * multiple F0/F7 events are reassembled into single complete SysEx messages
+ * (F0 ... F7), and any that are not valid messages (see isValidMsg()) are
+ * skipped.
+ */
+struct SmfContents {
+  SmfHeader header;
+  std::vector<TimedMsgBuffer> tracks;
+
+  /** Tempo changes, sorted by ticks (empty if 120 BPM throughout). */
+  std::vector<SmfTempoChange> tempoChanges;
+
+  /** Time signature changes, sorted by ticks (empty if 4/4 throughout). */
+  std::vector<SmfTimeSignature> timeSignatures;
+
+  /**
+   * Returns seconds since the start of the file at ticks, following the tempo
+   * map (or the SMPTE division, which tempo changes do not affect). Returns 0
+   * if the division is 0 (invalid).
+   */
+  double ticksToSeconds(double ticks) const;
+
+  /** Maps all timestamps of track from ticks to seconds (see ticksToSeconds()). */
+  void mapToSeconds(TimedMsgBuffer& track) const;
+};
+
+/**
+ * Decodes the Standard MIDI File stored in bytes[0, numBytes) into contents,
+ * reusing any storage already allocated by contents. On error, contents holds
+ * any tracks (and tempo changes and time signatures) decoded before the error.
+ */
+SmfResult decodeSmf(const std::uint8_t* bytes, std::size_t numBytes, SmfContents& contents);
+
+/**
+ * Decodes a single "MTrk" chunk body from bytes[0, numBytes) (not including
+ * the 8-byte chunk header), appending its MIDI messages to track, and its
+ * tempo changes (without seconds) and time signatures to tempoChanges and
+ * timeSignatures, unless nullptr.
+ */
+SmfResult decodeSmfTrack(const std::uint8_t* bytes, std::size_t numBytes, TimedMsgBuffer& track,
+                         std::vector<SmfTempoChange>* tempoChanges = nullptr,
+                         std::vector<SmfTimeSignature>* timeSignatures = nullptr);
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SMF_HPP
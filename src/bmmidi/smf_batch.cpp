@@ -0,0 +1,135 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/smf_batch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <utility>
+
+namespace bmmidi {
+namespace {
+
+constexpr int kDefaultFilesInFlightPerThread = 4;
+
+// Reads entire file into bytes (reusing its storage).
+SmfBatchStatus readFile(const std::string& path, std::size_t maxFileBytes,
+                        std::vector<std::uint8_t>& bytes) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) { return SmfBatchStatus::kReadFailed; }
+
+  const std::streamoff size = file.tellg();
+  if (size < 0) { return SmfBatchStatus::kReadFailed; }
+  if (static_cast<std::uint64_t>(size) > maxFileBytes) { return SmfBatchStatus::kTooLarge; }
+
+  bytes.resize(static_cast<std::size_t>(size));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char*>(bytes.data()), size)) {
+    return SmfBatchStatus::kReadFailed;
+  }
+  return SmfBatchStatus::kOk;
+}
+
+}  // namespace
+
+SmfBatchProcessor::SmfBatchProcessor(
+    const SmfBatchOptions& options, TrackCallback onTrack, ResultCallback onResult)
+    : onTrack_{std::move(onTrack)},
+      onResult_{std::move(onResult)},
+      maxFileBytes_{options.maxFileBytes},
+      maxFilesInFlight_{options.maxFilesInFlight},
+      pool_{options.numThreads} {
+  assert(onTrack_);
+  if (maxFilesInFlight_ <= 0) {
+    maxFilesInFlight_ = kDefaultFilesInFlightPerThread * pool_.numThreads();
+  }
+}
+
+SmfBatchProcessor::~SmfBatchProcessor() { finish(); }
+
+std::size_t SmfBatchProcessor::submit(std::string path) {
+  std::size_t fileIndex;
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    slotFreed_.wait(lock, [this] { return numInFlight_ < maxFilesInFlight_; });
+    ++numInFlight_;
+    fileIndex = nextFileIndex_++;
+  }
+
+  pool_.submit([this, fileIndex, path = std::move(path)] {
+    processFile(fileIndex, path);
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      --numInFlight_;
+    }
+    slotFreed_.notify_one();
+  });
+  return fileIndex;
+}
+
+void SmfBatchProcessor::finish() { pool_.waitIdle(); }
+
+void SmfBatchProcessor::processFile(std::size_t fileIndex, const std::string& path) {
+  // Per-worker storage, reused across files to avoid reallocating.
+  thread_local std::vector<std::uint8_t> fileBytes;
+  thread_local SmfContents contents;
+
+  SmfBatchResult result;
+  result.fileIndex = fileIndex;
+  result.path = path;
+
+  try {
+    result.status = readFile(path, maxFileBytes_, fileBytes);
+    if (result.status == SmfBatchStatus::kOk) {
+      result.decodeResult = decodeSmf(fileBytes.data(), fileBytes.size(), contents);
+      if (result.decodeResult != SmfResult::kOk) {
+        result.status = SmfBatchStatus::kDecodeFailed;
+      }
+    }
+  } catch (...) {
+    // E.g. std::bad_alloc; isolate failure to this file.
+    result.status = SmfBatchStatus::kDecodeException;
+  }
+
+  if (result.status == SmfBatchStatus::kOk) {
+    try {
+      for (int i = 0; i < static_cast<int>(contents.tracks.size()); ++i) {
+        onTrack_(fileIndex, i, contents, contents.tracks[i]);
+      }
+    } catch (...) {
+      result.status = SmfBatchStatus::kCallbackFailed;
+    }
+  }
+
+  if (onResult_) {
+    try {
+      onResult_(result);
+    } catch (...) {
+      // Nowhere left to report it, but must not escape the pool's worker.
+    }
+  }
+}
+
+std::vector<SmfBatchResult> processSmfFiles(
+    const std::vector<std::string>& paths,
+    const SmfBatchOptions& options,
+    SmfBatchProcessor::TrackCallback onTrack) {
+  std::vector<SmfBatchResult> results(paths.size());
+
+  {
+    // Each result slot is written by exactly one task, so no locking needed.
+    SmfBatchProcessor processor{options, std::move(onTrack),
+                                [&results](const SmfBatchResult& result) {
+                                  results[result.fileIndex] = result;
+                                }};
+    for (const auto& path : paths) { processor.submit(path); }
+    processor.finish();
+  }
+
+  return results;
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_SMF_BATCH_HPP
+#define BMMIDI_SMF_BATCH_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bmmidi/msg_buffer.hpp"
+#include "bmmidi/smf.hpp"
+#include "bmmidi/thread_pool.hpp"
+
+namespace bmmidi {
+
+/** Outcome of processing one file with SmfBatchProcessor. */
+enum class SmfBatchStatus {
+  /** File was decoded and all of its tracks were passed to the callback. */
+  kOk,
+
+  /** File could not be opened or read. */
+  kReadFailed,
+
+  /** File is larger than SmfBatchOptions::maxFileBytes (so was skipped). */
+  kTooLarge,
+
+  /** File is not a valid SMF (see SmfBatchResult::decodeResult). */
+  kDecodeFailed,
+
+  /** The track callback threw an exception while processing this file. */
+  kCallbackFailed,
+
+  /** Reading or decoding this file threw an exception (e.g. std::bad_alloc). */
+  kDecodeException,
+};
+
+/** Result of processing one file with SmfBatchProcessor. */
+struct SmfBatchResult {
+  /** Index of this file, in the order files were submitted. */
+  std::size_t fileIndex = 0;
+
+  /** Path of the file, as submitted. */
+  std::string path;
+
+  SmfBatchStatus status = SmfBatchStatus::kOk;
+
+  /** Detailed decoder result (only meaningful for kDecodeFailed). */
+  SmfResult decodeResult = SmfResult::kOk;
+};
+
+/** Configuration for SmfBatchProcessor. */
+struct SmfBatchOptions {
+  /** # of worker threads (<= 0 means one per hardware thread). */
+  int numThreads = 0;
+
+  /**
+   * Maximum # of submitted files that may be waiting or in progress at once;
+   * submit() blocks while this many are outstanding. Bounds the memory used by
+   * queued paths (<= 0 means 4x the # of worker threads).
+   */
+  int maxFilesInFlight = 0;
+
+  /**
+   * Files larger than this are skipped with kTooLarge, which bounds the memory
+   * used per worker for file bytes and decoded tracks.
+   */
+  std::size_t maxFileBytes = 64 * 1024 * 1024;
+};
+
+/**
+ * Decodes a large batch of Standard MIDI Files in parallel on a
+ * WorkStealingPool, streaming each decoded track to a callback.
+ *
+ * Each worker thread decodes one file at a time into buffers it reuses across
+ * files, and invokes the track callback for each track before decoding its
+ * next file, so at most numThreads decoded files are ever held in memory.
+ * submit() applies back-pressure by blocking while maxFilesInFlight files are
+ * outstanding.
+ *
+ * Failures are isolated per file: unreadable, oversized, or malformed files
+ * (and exceptions thrown by the track callback) are reported through the
+ * result callback and do not affect processing of other files. Exceptions
+ * thrown by the result callback are ignored.
+ *
+ * Callbacks are invoked concurrently from worker threads, so must be
+ * thread-safe.
+ */
+class SmfBatchProcessor {
+public:
+  /**
+   * Called once per decoded track with (fileIndex, trackIndex, contents,
+   * track), where contents is the whole decoded file (e.g. for its header and
+   * SmfContents::ticksToSeconds()) and track is contents.tracks[trackIndex].
+   * The references are only valid during the call.
+   */
+  using TrackCallback = std::function<void(std::size_t fileIndex, int trackIndex,
+                                           const SmfContents& contents,
+                                           const TimedMsgBuffer& track)>;
+
+  /** Called once per submitted file after it has been fully processed. */
+  using ResultCallback = std::function<void(const SmfBatchResult& result)>;
+
+  explicit SmfBatchProcessor(
+      const SmfBatchOptions& options, TrackCallback onTrack, ResultCallback onResult = nullptr);
+
+  SmfBatchProcessor(const SmfBatchProcessor&) = delete;
+  SmfBatchProcessor& operator=(const SmfBatchProcessor&) = delete;
+
+  /** Waits for all submitted files to finish processing. */
+  ~SmfBatchProcessor();
+
+  /**
+   * Queues the file at path for processing and returns its file index. Blocks
+   * while maxFilesInFlight files are already outstanding.
+   */
+  std::size_t submit(std::string path);
+
+  /**
+   * Blocks until all submitted files have been processed. Must not be called
+   * from a callback (see WorkStealingPool::waitIdle()).
+   */
+  void finish();
+
+private:
+  void processFile(std::size_t fileIndex, const std::string& path);
+
+  TrackCallback onTrack_;
+  ResultCallback onResult_;
+  std::size_t maxFileBytes_;
+  int maxFilesInFlight_;
+
+  std::mutex mutex_;
+  std::condition_variable slotFreed_;
+  int numInFlight_ = 0;       // Guarded by mutex_.
+  std::size_t nextFileIndex_ = 0;  // Guarded by mutex_.
+
+  // Declared last, so workers stop before the members above are destroyed.
+  WorkStealingPool pool_;
+};
+
+/**
+ * Convenience function that decodes all files in paths with an
+ * SmfBatchProcessor and returns their results (ordered by file index).
+ */
+std::vector<SmfBatchResult> processSmfFiles(
+    const std::vector<std::string>& paths,
+    const SmfBatchOptions& options,
+    SmfBatchProcessor::TrackCallback onTrack);
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_SMF_BATCH_HPP
@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/smf_batch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+using ::testing::Eq;
+
+std::string writeTempFile(const std::string& name, const std::vector<std::uint8_t>& bytes) {
+  const std::string path = ::testing::TempDir() + "bmmidi_smf_batch_" + name;
+  std::ofstream file{path, std::ios::binary};
+  file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  return path;
+}
+
+// Returns a format 1 SMF with numTracks tracks, each containing numNotes notes.
+std::vector<std::uint8_t> makeSmf(int numTracks, int numNotes) {
+  std::vector<std::uint8_t> bytes = {
+      'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, static_cast<std::uint8_t>(numTracks), 0, 96};
+  for (int t = 0; t < numTracks; ++t) {
+    std::vector<std::uint8_t> body;
+    for (int i = 0; i < numNotes; ++i) {
+      const std::uint8_t event[] = {0x10, 0x90, 0x3C, 0x64};
+      body.insert(body.end(), event, event + 4);
+    }
+    const std::uint8_t endOfTrack[] = {0x00, 0xFF, 0x2F, 0x00};
+    body.insert(body.end(), endOfTrack, endOfTrack + 4);
+
+    const auto n = body.size();
+    const std::uint8_t chunkHeader[] = {
+        'M', 'T', 'r', 'k', 0, 0, static_cast<std::uint8_t>(n >> 8), static_cast<std::uint8_t>(n)};
+    bytes.insert(bytes.end(), chunkHeader, chunkHeader + 8);
+    bytes.insert(bytes.end(), body.begin(), body.end());
+  }
+  return bytes;
+}
+
+TEST(SmfBatch, ProcessesAllFilesInParallel) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < 20; ++i) {
+    paths.push_back(writeTempFile("ok" + std::to_string(i) + ".mid", makeSmf(1 + i % 3, 10 + i)));
+  }
+
+  std::atomic<int> numTracks{0};
+  std::atomic<int> numMsgs{0};
+  bmmidi::SmfBatchOptions options;
+  options.numThreads = 4;
+  options.maxFilesInFlight = 3;
+
+  const auto results = bmmidi::processSmfFiles(paths, options,
+      [&](std::size_t, int, const bmmidi::SmfContents& contents,
+          const bmmidi::TimedMsgBuffer& track) {
+        EXPECT_THAT(contents.header.ticksPerQuarterNote(), Eq(96));
+        numTracks.fetch_add(1);
+        numMsgs.fetch_add(track.size());
+      });
+
+  int expectedTracks = 0;
+  int expectedMsgs = 0;
+  for (int i = 0; i < 20; ++i) {
+    expectedTracks += 1 + i % 3;
+    expectedMsgs += (1 + i % 3) * (10 + i);
+  }
+  EXPECT_THAT(numTracks.load(), Eq(expectedTracks));
+  EXPECT_THAT(numMsgs.load(), Eq(expectedMsgs));
+
+  ASSERT_THAT(results.size(), Eq(paths.size()));
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    EXPECT_THAT(results[i].fileIndex, Eq(i));
+    EXPECT_THAT(results[i].path, Eq(paths[i]));
+    EXPECT_THAT(results[i].status, Eq(bmmidi::SmfBatchStatus::kOk));
+  }
+}
+
+TEST(SmfBatch, IsolatesPerFileErrors) {
+  std::vector<std::string> paths = {
+      writeTempFile("good.mid", makeSmf(2, 5)),
+      ::testing::TempDir() + "bmmidi_smf_batch_does_not_exist.mid",
+      writeTempFile("garbage.mid", {'n', 'o', 't', ' ', 'm', 'i', 'd', 'i'}),
+      writeTempFile("big.mid", makeSmf(4, 200)),
+      writeTempFile("throws.mid", makeSmf(1, 7)),
+  };
+
+  std::mutex mutex;
+  std::vector<std::size_t> filesWithTracks;
+  bmmidi::SmfBatchOptions options;
+  options.numThreads = 2;
+  options.maxFileBytes = 1024;
+
+  const auto results = bmmidi::processSmfFiles(paths, options,
+      [&](std::size_t fileIndex, int, const bmmidi::SmfContents&,
+          const bmmidi::TimedMsgBuffer& track) {
+        if (track.size() == 7) { throw std::runtime_error{"callback failure"}; }
+        std::lock_guard<std::mutex> lock{mutex};
+        filesWithTracks.push_back(fileIndex);
+      });
+
+  ASSERT_THAT(results.size(), Eq(5u));
+  EXPECT_THAT(results[0].status, Eq(bmmidi::SmfBatchStatus::kOk));
+  EXPECT_THAT(results[1].status, Eq(bmmidi::SmfBatchStatus::kReadFailed));
+  EXPECT_THAT(results[2].status, Eq(bmmidi::SmfBatchStatus::kDecodeFailed));
+  EXPECT_THAT(results[2].decodeResult, Eq(bmmidi::SmfResult::kNotSmf));
+  EXPECT_THAT(results[3].status, Eq(bmmidi::SmfBatchStatus::kTooLarge));
+  EXPECT_THAT(results[4].status, Eq(bmmidi::SmfBatchStatus::kCallbackFailed));
+
+  EXPECT_THAT(filesWithTracks, ::testing::ElementsAre(0u, 0u));
+}
+
+TEST(SmfBatch, IgnoresResultCallbackExceptions) {
+  const auto path = writeTempFile("result_throws.mid", makeSmf(1, 3));
+
+  std::atomic<int> numResults{0};
+  bmmidi::SmfBatchOptions options;
+  options.numThreads = 2;
+  options.maxFilesInFlight = 1;
+
+  {
+    bmmidi::SmfBatchProcessor processor{options,
+        [](std::size_t, int, const bmmidi::SmfContents&, const bmmidi::TimedMsgBuffer&) {},
+        [&](const bmmidi::SmfBatchResult&) {
+          numResults.fetch_add(1);
+          throw std::runtime_error{"result callback failure"};
+        }};
+
+    // Each submit() waits for the previous file's slot to be freed.
+    for (int i = 0; i < 4; ++i) { processor.submit(path); }
+    processor.finish();
+  }
+
+  EXPECT_THAT(numResults.load(), Eq(4));
+}
+
+TEST(SmfBatch, SubmitAppliesBackPressure) {
+  const auto path = writeTempFile("pressure.mid", makeSmf(1, 3));
+
+  std::atomic<int> inCallback{0};
+  std::atomic<int> maxInCallback{0};
+  std::atomic<int> numResults{0};
+  bmmidi::SmfBatchOptions options;
+  options.numThreads = 4;
+  options.maxFilesInFlight = 2;
+
+  {
+    bmmidi::SmfBatchProcessor processor{options,
+        [&](std::size_t, int, const bmmidi::SmfContents&, const bmmidi::TimedMsgBuffer&) {
+          const int now = inCallback.fetch_add(1) + 1;
+          int prevMax = maxInCallback.load();
+          while ((now > prevMax) && !maxInCallback.compare_exchange_weak(prevMax, now)) {}
+          std::this_thread::sleep_for(std::chrono::milliseconds{2});
+          inCallback.fetch_sub(1);
+        },
+        [&](const bmmidi::SmfBatchResult&) { numResults.fetch_add(1); }};
+
+    for (int i = 0; i < 12; ++i) { processor.submit(path); }
+    processor.finish();
+  }
+
+  EXPECT_THAT(numResults.load(), Eq(12));
+  EXPECT_THAT(maxInCallback.load() <= 2, Eq(true));
+}
+
+}  // namespace
@@ -0,0 +1,228 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/smf.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg_reference.hpp"
+
+namespace {
+
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+std::vector<std::uint8_t> makeSmf(const std::vector<std::vector<std::uint8_t>>& trackBodies) {
+  std::vector<std::uint8_t> bytes = {
+      'M', 'T', 'h', 'd', 0, 0, 0, 6,
+      0, 1,  // Format 1.
+      0, static_cast<std::uint8_t>(trackBodies.size()),
+      0x01, 0xE0,  // 480 ticks per quarter note.
+  };
+  for (const auto& body : trackBodies) {
+    const auto n = body.size();
+    const std::uint8_t chunkHeader[] = {
+        'M', 'T', 'r', 'k',
+        static_cast<std::uint8_t>(n >> 24), static_cast<std::uint8_t>(n >> 16),
+        static_cast<std::uint8_t>(n >> 8), static_cast<std::uint8_t>(n)};
+    bytes.insert(bytes.end(), chunkHeader, chunkHeader + 8);
+    bytes.insert(bytes.end(), body.begin(), body.end());
+  }
+  return bytes;
+}
+
+std::vector<std::uint8_t> bytesOf(const bmmidi::TimedMsgView& timedMsg) {
+  const auto& msg = timedMsg.value();
+  return std::vector<std::uint8_t>(msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+}
+
+TEST(Smf, DecodesHeader) {
+  const auto bytes = makeSmf({{0x00, 0xFF, 0x2F, 0x00}});
+  bmmidi::SmfContents contents;
+
+  EXPECT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  EXPECT_THAT(contents.header.format, Eq(bmmidi::SmfFormat::kMultiTrack));
+  EXPECT_THAT(contents.header.numTracks, Eq(1));
+  EXPECT_THAT(contents.header.isSmpteDivision(), IsFalse());
+  EXPECT_THAT(contents.header.ticksPerQuarterNote(), Eq(480));
+  ASSERT_THAT(contents.tracks.size(), Eq(1u));
+  EXPECT_THAT(contents.tracks[0].empty(), IsTrue());
+}
+
+TEST(Smf, DecodesEventsWithRunningStatusAndSkipsMeta) {
+  const auto bytes = makeSmf({{
+      0x00, 0xFF, 0x01, 0x02, 'h', 'i',          // Text meta event (skipped).
+      0x00, 0x90, 0x3C, 0x64,                    // Note On C4.
+      0x81, 0x00, 0x40, 0x50,                    // +128 ticks, running status: Note On E4.
+      0x60, 0x3C, 0x00,                          // +96 ticks, running status: C4 velocity 0.
+      0x00, 0xC2, 0x05,                          // Program change.
+      0x00, 0xFF, 0x2F, 0x00,                    // End of track.
+  }});
+  bmmidi::SmfContents contents;
+
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  const auto& track = contents.tracks[0];
+  ASSERT_THAT(track.size(), Eq(4));
+
+  EXPECT_THAT(track[0].timestamp(), Eq(0.0));
+  EXPECT_THAT(bytesOf(track[0]), ElementsAre(0x90, 0x3C, 0x64));
+  EXPECT_THAT(track[1].timestamp(), Eq(128.0));
+  EXPECT_THAT(bytesOf(track[1]), ElementsAre(0x90, 0x40, 0x50));
+  EXPECT_THAT(track[2].timestamp(), Eq(224.0));
+  EXPECT_THAT(bytesOf(track[2]), ElementsAre(0x90, 0x3C, 0x00));
+  EXPECT_THAT(track[3].timestamp(), Eq(224.0));
+  EXPECT_THAT(bytesOf(track[3]), ElementsAre(0xC2, 0x05));
+}
+
+TEST(Smf, CollectsTempoMapFromAllTracks) {
+  const auto bytes = makeSmf({
+      {
+          0x00, 0xFF, 0x58, 0x04, 0x06, 0x03, 0x18, 0x08,  // Time signature 6/8.
+          0x00, 0x90, 0x3C, 0x64,
+          0x87, 0x40, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90,  // +960 ticks: 240 BPM.
+          0x87, 0x40, 0x80, 0x3C, 0x00,                    // +960 ticks.
+          0x00, 0xFF, 0x2F, 0x00,
+      },
+      {
+          0x8F, 0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40,  // At 1920 ticks: 60 BPM.
+          0x83, 0x60, 0x91, 0x3E, 0x64,                    // +480 ticks.
+          0x00, 0xFF, 0x2F, 0x00,
+      },
+  });
+  bmmidi::SmfContents contents;
+
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  ASSERT_THAT(contents.tempoChanges.size(), Eq(2u));
+  EXPECT_THAT(contents.tempoChanges[0].ticks, Eq(960.0));
+  EXPECT_THAT(contents.tempoChanges[0].microsPerQuarterNote, Eq(250000u));
+  EXPECT_THAT(contents.tempoChanges[0].seconds, DoubleEq(1.0));
+  EXPECT_THAT(contents.tempoChanges[1].ticks, Eq(1920.0));
+  EXPECT_THAT(contents.tempoChanges[1].seconds, DoubleEq(1.5));
+  ASSERT_THAT(contents.timeSignatures.size(), Eq(1u));
+  EXPECT_THAT(contents.timeSignatures[0].numerator, Eq(6));
+  EXPECT_THAT(contents.timeSignatures[0].denominator, Eq(8));
+
+  EXPECT_THAT(contents.ticksToSeconds(480.0), DoubleEq(0.5));   // 120 BPM by default.
+  EXPECT_THAT(contents.ticksToSeconds(1440.0), DoubleEq(1.25));
+  EXPECT_THAT(contents.ticksToSeconds(2400.0), DoubleEq(2.5));
+
+  auto track = contents.tracks[1];
+  contents.mapToSeconds(track);
+  ASSERT_THAT(track.size(), Eq(1));
+  EXPECT_THAT(track[0].timestamp(), DoubleEq(2.5));
+}
+
+TEST(Smf, MapsSmpteTicksToSeconds) {
+  auto bytes = makeSmf({{
+      0x00, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90,  // Tempo (ignored for SMPTE).
+      0x00, 0xFF, 0x2F, 0x00,
+  }});
+  bytes[12] = 0xE7;  // 25 frames per second.
+  bytes[13] = 40;    // 40 ticks per frame.
+  bmmidi::SmfContents contents;
+
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  EXPECT_THAT(contents.header.isSmpteDivision(), IsTrue());
+  EXPECT_THAT(contents.header.smpteTicksPerSecond(), DoubleEq(1000.0));
+  EXPECT_THAT(contents.ticksToSeconds(2500.0), DoubleEq(2.5));
+}
+
+TEST(Smf, ReassemblesSysExPackets) {
+  const auto bytes = makeSmf({{
+      0x00, 0xF0, 0x03, 0x7D, 0x01, 0x02,  // SysEx start (no EOX yet).
+      0x10, 0xF7, 0x02, 0x03, 0xF7,        // Continuation packet with EOX.
+      0x00, 0xF7, 0x01, 0xF8,              // Escape event (ignored).
+      0x00, 0xFF, 0x2F, 0x00,
+  }});
+  bmmidi::SmfContents contents;
+
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  const auto& track = contents.tracks[0];
+  ASSERT_THAT(track.size(), Eq(1));
+  EXPECT_THAT(track[0].timestamp(), Eq(0.0));
+  EXPECT_THAT(bytesOf(track[0]), ElementsAre(0xF0, 0x7D, 0x01, 0x02, 0x03, 0xF7));
+}
+
+TEST(Smf, SkipsInvalidSysEx) {
+  const auto bytes = makeSmf({{
+      0x00, 0xF0, 0x01, 0xF7,                    // Empty.
+      0x00, 0xF0, 0x03, 0x7D, 0x90, 0xF7,        // Status byte inside.
+      0x00, 0xF0, 0x02, 0x7E, 0xF7,              // Universal without device or sub-IDs.
+      0x00, 0xF0, 0x03, 0x7D, 0x01, 0xF7,        // Valid.
+      0x00, 0xFF, 0x2F, 0x00,
+  }});
+  bmmidi::SmfContents contents;
+
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  const auto& track = contents.tracks[0];
+  ASSERT_THAT(track.size(), Eq(1));
+  EXPECT_THAT(bytesOf(track[0]), ElementsAre(0xF0, 0x7D, 0x01, 0xF7));
+}
+
+TEST(Smf, DecodesMultipleTracksAndSkipsUnknownChunks) {
+  auto bytes = makeSmf({
+      {0x00, 0xB0, 0x07, 0x64, 0x00, 0xFF, 0x2F, 0x00},
+      {0x05, 0x91, 0x3C, 0x64, 0x00, 0xFF, 0x2F, 0x00},
+  });
+  // Insert an unknown chunk before the second track.
+  const std::uint8_t unknown[] = {'X', 'Y', 'Z', 'W', 0, 0, 0, 2, 0xAA, 0xBB};
+  bytes.insert(bytes.begin() + 14 + 16, unknown, unknown + 10);
+
+  bmmidi::SmfContents contents;
+  ASSERT_THAT(bmmidi::decodeSmf(bytes.data(), bytes.size(), contents), Eq(bmmidi::SmfResult::kOk));
+  ASSERT_THAT(contents.tracks.size(), Eq(2u));
+  EXPECT_THAT(bytesOf(contents.tracks[0][0]), ElementsAre(0xB0, 0x07, 0x64));
+  EXPECT_THAT(contents.tracks[1][0].timestamp(), Eq(5.0));
+  EXPECT_THAT(bytesOf(contents.tracks[1][0]), ElementsAre(0x91, 0x3C, 0x64));
+}
+
+TEST(Smf, ReportsErrors) {
+  bmmidi::SmfContents contents;
+
+  const std::vector<std::uint8_t> notSmf = {'R', 'I', 'F', 'F', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96};
+  EXPECT_THAT(bmmidi::decodeSmf(notSmf.data(), notSmf.size(), contents),
+              Eq(bmmidi::SmfResult::kNotSmf));
+
+  auto truncated = makeSmf({{0x00, 0x90, 0x3C, 0x64}});
+  truncated.resize(truncated.size() - 2);
+  EXPECT_THAT(bmmidi::decodeSmf(truncated.data(), truncated.size(), contents),
+              Eq(bmmidi::SmfResult::kTruncated));
+
+  const auto noRunningStatus = makeSmf({{0x00, 0x3C, 0x64}});
+  EXPECT_THAT(bmmidi::decodeSmf(noRunningStatus.data(), noRunningStatus.size(), contents),
+              Eq(bmmidi::SmfResult::kInvalidEvent));
+
+  const auto badDataByte = makeSmf({{0x00, 0x90, 0x3C, 0xE4}});
+  EXPECT_THAT(bmmidi::decodeSmf(badDataByte.data(), badDataByte.size(), contents),
+              Eq(bmmidi::SmfResult::kInvalidEvent));
+
+  // SysEx and meta events cancel running status.
+  const auto runningStatusAfterSysEx =
+      makeSmf({{0x00, 0x90, 0x3C, 0x64, 0x00, 0xF0, 0x02, 0x7D, 0xF7, 0x00, 0x3C, 0x00}});
+  EXPECT_THAT(
+      bmmidi::decodeSmf(runningStatusAfterSysEx.data(), runningStatusAfterSysEx.size(), contents),
+      Eq(bmmidi::SmfResult::kInvalidEvent));
+  const auto runningStatusAfterMeta =
+      makeSmf({{0x00, 0x90, 0x3C, 0x64, 0x00, 0xFF, 0x01, 0x00, 0x00, 0x3C, 0x00}});
+  EXPECT_THAT(
+      bmmidi::decodeSmf(runningStatusAfterMeta.data(), runningStatusAfterMeta.size(), contents),
+      Eq(bmmidi::SmfResult::kInvalidEvent));
+
+  const auto realtimeInTrack = makeSmf({{0x00, 0xF8}});
+  EXPECT_THAT(bmmidi::decodeSmf(realtimeInTrack.data(), realtimeInTrack.size(), contents),
+              Eq(bmmidi::SmfResult::kInvalidEvent));
+
+  const auto overlongVarLen = makeSmf({{0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x90, 0x3C, 0x64}});
+  EXPECT_THAT(bmmidi::decodeSmf(overlongVarLen.data(), overlongVarLen.size(), contents),
+              Eq(bmmidi::SmfResult::kTruncated));
+}
+
+}  // namespace
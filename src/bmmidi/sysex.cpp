@@ -18,6 +18,24 @@ bool typeHasSubId2(UniversalCategory category, std::uint8_t subId1) {
   }
 }
 
+bool hasCompleteSysExHeader(const std::uint8_t* bytes, int numBytes) {
+  constexpr int kNumFramingBytes = kOneSysExHdrStatusByte + kOneSysExTerminatingEoxByte;
+  if (numBytes < kNumFramingBytes + 1) { return false; }  // No SysEx ID.
+
+  const std::uint8_t sysExId = bytes[1];
+  if ((sysExId == static_cast<std::uint8_t>(UniversalCategory::kNonRealTime))
+      || (sysExId == static_cast<std::uint8_t>(UniversalCategory::kRealTime))) {
+    if (numBytes < kNumFramingBytes + kNumUniversalHdrBytesOneSubId) { return false; }
+    return !typeHasSubId2(static_cast<UniversalCategory>(sysExId), bytes[3])
+        || (numBytes >= kNumFramingBytes + kNumUniversalHdrBytesTwoSubIds);
+  }
+
+  const int numMfrBytes = (sysExId == Manufacturer::kExtendedSysExId)
+      ? kNumManufacturerIdExtBytes
+      : kNumManufacturerIdShortBytes;
+  return numBytes >= kNumFramingBytes + numMfrBytes;
+}
+
 }  // namespace internal
 
 namespace {
@@ -798,6 +798,11 @@ static constexpr int kNumUniversalHdrBytesTwoSubIds = 4;
 
 bool typeHasSubId2(UniversalCategory category, std::uint8_t subId1);
 
+// Returns true if the SysEx message bytes[0, numBytes) (including F0 and EOX)
+// has room for its whole header: SysEx ID and extended manufacturer ID bytes,
+// or Universal device ID and sub-IDs.
+bool hasCompleteSysExHeader(const std::uint8_t* bytes, int numBytes);
+
 }  // namespace internal
 }  // namespace bmmidi
 
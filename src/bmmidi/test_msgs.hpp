@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_TEST_MSGS_HPP
+#define BMMIDI_TEST_MSGS_HPP
+
+// Message helpers shared by unit tests (not part of the library).
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bmmidi/msg_reference.hpp"
+
+namespace bmmidi {
+namespace test {
+
+/** Returns a view of bytes, which must hold a valid message. */
+inline MsgView viewOf(const std::vector<std::uint8_t>& bytes) {
+  return MsgView{bytes.data(), static_cast<int>(bytes.size())};
+}
+
+/**
+ * Returns the index-th message of a test sequence of valid messages: Note On,
+ * except every sysExInterval-th message, which is a SysEx message of 3 to
+ * maxSysExBytes bytes. All bytes derive from index (so torn copies are
+ * detectable).
+ */
+inline std::vector<std::uint8_t> testMsg(int index, int sysExInterval = 100,
+                                         int maxSysExBytes = 302) {
+  if (index % sysExInterval == 0) {
+    std::vector<std::uint8_t> sysEx(static_cast<std::size_t>(3 + index % (maxSysExBytes - 2)),
+                                    static_cast<std::uint8_t>(index % 128));
+    sysEx.front() = 0xF0;
+    sysEx[1] = 0x7D;  // Non-commercial SysEx ID.
+    sysEx.back() = 0xF7;
+    return sysEx;
+  }
+  return {0x90, static_cast<std::uint8_t>(index % 128), static_cast<std::uint8_t>(index % 127)};
+}
+
+}  // namespace test
+}  // namespace bmmidi
+
+#endif  // BMMIDI_TEST_MSGS_HPP
@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/thread_pool.hpp"
+
+#include <cassert>
+#include <utility>
+
+namespace bmmidi {
+namespace {
+
+// Identifies the pool and worker index of the current thread (if any).
+thread_local const WorkStealingPool* tlsPool = nullptr;
+thread_local int tlsWorkerIndex = -1;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(int numThreads) {
+  if (numThreads <= 0) {
+    numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    if (numThreads <= 0) { numThreads = 1; }
+  }
+
+  workers_.reserve(numThreads);
+  for (int i = 0; i < numThreads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    workers_[i]->thread = std::thread{[this, i] { runWorker(i); }};
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  waitIdle();
+  {
+    std::lock_guard<std::mutex> lock{sleepMutex_};
+    stopping_ = true;
+  }
+  wakeWorkers_.notify_all();
+  for (auto& worker : workers_) { worker->thread.join(); }
+}
+
+int WorkStealingPool::currentWorkerIndex() const {
+  return (tlsPool == this) ? tlsWorkerIndex : -1;
+}
+
+void WorkStealingPool::submit(Task task) {
+  assert(task);
+
+  int index = currentWorkerIndex();
+  if (index < 0) {
+    index = static_cast<int>(nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size());
+  }
+
+  numUnfinished_.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock{workers_[index]->mutex};
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+  {
+    // Increment under sleepMutex_ so a worker can't miss the wakeup between
+    // checking numQueued_ and going to sleep.
+    std::lock_guard<std::mutex> lock{sleepMutex_};
+    numQueued_.fetch_add(1, std::memory_order_release);
+  }
+  wakeWorkers_.notify_one();
+}
+
+void WorkStealingPool::waitIdle() {
+  assert(currentWorkerIndex() < 0);
+  std::unique_lock<std::mutex> lock{sleepMutex_};
+  idle_.wait(lock, [this] { return numUnfinished_.load(std::memory_order_acquire) == 0; });
+}
+
+bool WorkStealingPool::tryPopOwn(int index, Task& task) {
+  auto& worker = *workers_[index];
+  std::lock_guard<std::mutex> lock{worker.mutex};
+  if (worker.tasks.empty()) { return false; }
+  task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  return true;
+}
+
+bool WorkStealingPool::trySteal(int thiefIndex, Task& task) {
+  const int n = numThreads();
+  for (int offset = 1; offset < n; ++offset) {
+    auto& victim = *workers_[(thiefIndex + offset) % n];
+    std::lock_guard<std::mutex> lock{victim.mutex};
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::runWorker(int index) {
+  tlsPool = this;
+  tlsWorkerIndex = index;
+
+  Task task;
+  for (;;) {
+    if (tryPopOwn(index, task) || trySteal(index, task)) {
+      numQueued_.fetch_sub(1, std::memory_order_relaxed);
+      task();
+      task = nullptr;
+
+      if (numUnfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock{sleepMutex_};
+        idle_.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{sleepMutex_};
+    wakeWorkers_.wait(lock, [this] {
+      return stopping_ || (numQueued_.load(std::memory_order_acquire) > 0);
+    });
+    if (stopping_ && (numQueued_.load(std::memory_order_acquire) == 0)) { return; }
+  }
+}
+
+}  // namespace bmmidi
@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_THREAD_POOL_HPP
+#define BMMIDI_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bmmidi {
+
+/**
+ * Fixed-size pool of worker threads with one task deque per worker. Each
+ * worker runs tasks from the back of its own deque and, when that is empty,
+ * steals from the front of other workers' deques, which keeps all workers
+ * busy when tasks have very uneven costs (e.g. decoding files of very
+ * different sizes).
+ *
+ * Tasks submitted from a worker thread go to that worker's own deque; tasks
+ * submitted from other threads are distributed round-robin.
+ */
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+
+  /**
+   * Starts numThreads worker threads (or one per hardware thread, if
+   * numThreads <= 0).
+   */
+  explicit WorkStealingPool(int numThreads = 0);
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /** Waits for all submitted tasks to finish, then stops worker threads. */
+  ~WorkStealingPool();
+
+  /** Returns the # of worker threads. */
+  int numThreads() const { return static_cast<int>(workers_.size()); }
+
+  /** Queues task to run on some worker thread. */
+  void submit(Task task);
+
+  /**
+   * Blocks until all tasks submitted so far (and any they submit) have run.
+   * Must not be called from a worker thread (i.e. from a task), which would
+   * wait for its own task to finish and so deadlock.
+   */
+  void waitIdle();
+
+  /**
+   * Returns the [0, numThreads()) index of the calling worker thread, or -1 if
+   * not called from one of this pool's workers.
+   */
+  int currentWorkerIndex() const;
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void runWorker(int index);
+  bool tryPopOwn(int index, Task& task);
+  bool trySteal(int thiefIndex, Task& task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex sleepMutex_;
+  std::condition_variable wakeWorkers_;
+  std::condition_variable idle_;
+  std::atomic<int> numQueued_{0};      // Tasks submitted but not yet started.
+  std::atomic<int> numUnfinished_{0};  // Tasks submitted but not yet finished.
+  std::atomic<unsigned> nextWorker_{0};
+  bool stopping_ = false;  // Guarded by sleepMutex_.
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_THREAD_POOL_HPP
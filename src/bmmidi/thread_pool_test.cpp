@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Lt;
+
+TEST(WorkStealingPool, RunsAllTasks) {
+  bmmidi::WorkStealingPool pool{4};
+  EXPECT_THAT(pool.numThreads(), Eq(4));
+
+  std::atomic<int> sum{0};
+  for (int i = 1; i <= 1000; ++i) {
+    pool.submit([&sum, i] { sum.fetch_add(i); });
+  }
+  pool.waitIdle();
+  EXPECT_THAT(sum.load(), Eq(500500));
+}
+
+TEST(WorkStealingPool, RunsTasksSubmittedByTasks) {
+  bmmidi::WorkStealingPool pool{3};
+  std::atomic<int> count{0};
+
+  for (int i = 0; i < 10; ++i) {
+    pool.submit([&pool, &count] {
+      EXPECT_THAT(pool.currentWorkerIndex(), Ge(0));
+      EXPECT_THAT(pool.currentWorkerIndex(), Lt(3));
+      for (int j = 0; j < 10; ++j) {
+        pool.submit([&count] { count.fetch_add(1); });
+      }
+    });
+  }
+  pool.waitIdle();
+  EXPECT_THAT(count.load(), Eq(100));
+  EXPECT_THAT(pool.currentWorkerIndex(), Eq(-1));
+}
+
+TEST(WorkStealingPool, IdleWorkersStealFromBusyWorker) {
+  bmmidi::WorkStealingPool pool{4};
+  std::atomic<int> count{0};
+  std::atomic<bool> release{false};
+
+  // One task floods its own worker's deque and then blocks that worker; the
+  // queued tasks can only finish if other workers steal them.
+  pool.submit([&] {
+    for (int i = 0; i < 50; ++i) {
+      pool.submit([&count] { count.fetch_add(1); });
+    }
+    while (count.load() < 50) { std::this_thread::sleep_for(std::chrono::milliseconds{1}); }
+    release = true;
+  });
+  pool.waitIdle();
+  EXPECT_THAT(release.load(), Eq(true));
+  EXPECT_THAT(count.load(), Eq(50));
+}
+
+TEST(WorkStealingPool, DestructorFinishesQueuedTasks) {
+  std::atomic<int> count{0};
+  {
+    bmmidi::WorkStealingPool pool{2};
+    for (int i = 0; i < 100; ++i) {
+      pool.submit([&count] { count.fetch_add(1); });
+    }
+  }
+  EXPECT_THAT(count.load(), Eq(100));
+}
+
+}  // namespace
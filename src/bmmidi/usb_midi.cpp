@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/usb_midi.hpp"
+
+#include <cstring>
+
+namespace bmmidi {
+
+int encodeUsbMidiMsg(int cable, const MsgView& msg, std::uint8_t* packets) {
+  assert((0 <= cable) && (cable < kNumUsbMidiCables));
+  const std::uint8_t* bytes = msg.rawBytes();
+  const int numBytes = msg.numBytes();
+  const std::uint8_t status = bytes[0];
+  const auto cableBits = static_cast<std::uint8_t>(cable << 4);
+
+  if (status == static_cast<std::uint8_t>(MsgType::kSystemExclusive)) {
+    // Full packets continue the SysEx, and the last (1-3 bytes, ending with
+    // EOX) ends it.
+    int numPackets = 0;
+    for (int i = 0; i < numBytes; i += 3, ++numPackets) {
+      std::uint8_t* packet = &packets[numPackets * kUsbMidiPacketBytes];
+      const int numRemaining = numBytes - i;
+      const int numPacketBytes = (numRemaining > 3) ? 3 : numRemaining;
+      const auto cin = (numRemaining > 3) ? UsbMidiCin::kSysExContinue
+          : static_cast<UsbMidiCin>(static_cast<int>(UsbMidiCin::kSysExEnd1) + numRemaining - 1);
+      packet[0] = cableBits | static_cast<std::uint8_t>(cin);
+      std::memset(&packet[1], 0, 3);
+      std::memcpy(&packet[1], &bytes[i], numPacketBytes);
+    }
+    return numPackets;
+  }
+
+  UsbMidiCin cin;
+  if (msg.status().isChannelSpecific()) {
+    cin = static_cast<UsbMidiCin>(status >> 4);
+  } else if (status >= 0xF8) {
+    cin = UsbMidiCin::kSingleByte;
+  } else if (numBytes == 3) {
+    cin = UsbMidiCin::kSystemCommon3;
+  } else if (numBytes == 2) {
+    cin = UsbMidiCin::kSystemCommon2;
+  } else {
+    cin = UsbMidiCin::kSysExEnd1;  // Also used for 1-byte System Common.
+  }
+
+  packets[0] = cableBits | static_cast<std::uint8_t>(cin);
+  std::memset(&packets[1], 0, 3);
+  std::memcpy(&packets[1], bytes, numBytes);
+  return 1;
+}
+
+UsbMidiDecoder::UsbMidiDecoder(const UsbMidiDecoderOptions& options) : options_{options} {
+  assert(options.maxSysExBytes >= 2);
+}
+
+void UsbMidiDecoder::reset() {
+  for (CableState& state : cables_) {
+    state.sysEx.clear();
+    state.sysExOverflowed = false;
+  }
+}
+
+bool UsbMidiDecoder::isValidMsgPacket(UsbMidiCin cin, const std::uint8_t* packet, int numBytes) {
+  const std::uint8_t status = packet[1];
+  bool isValidStatus;
+  switch (cin) {
+    case UsbMidiCin::kSystemCommon2:
+      isValidStatus = (status == 0xF1) || (status == 0xF3);
+      break;
+
+    case UsbMidiCin::kSystemCommon3:
+      isValidStatus = (status == 0xF2);
+      break;
+
+    case UsbMidiCin::kSysExEnd1:
+      isValidStatus = (status == 0xF6);
+      break;
+
+    case UsbMidiCin::kSingleByte:
+      isValidStatus = (status >= kFirstRealtimeStatus) && (status != 0xF9) && (status != 0xFD);
+      break;
+
+    default:
+      isValidStatus = ((status >> 4) == static_cast<int>(cin));
+      break;
+  }
+  if (!isValidStatus) { return false; }
+
+  for (int i = 2; i <= numBytes; ++i) {
+    if (packet[i] >= 0x80) { return false; }
+  }
+  return true;
+}
+
+void UsbMidiDecoder::startSysEx(CableState& state) {
+  if (!state.sysEx.empty()) { ++numDroppedSysEx_; }
+  state.sysEx.assign(1, std::uint8_t{kSysExStart});
+  state.sysExOverflowed = false;
+}
+
+void UsbMidiDecoder::dropSysEx(CableState& state) {
+  state.sysEx.clear();
+  state.sysExOverflowed = false;
+  ++numDroppedSysEx_;
+}
+
+bool UsbMidiDecoder::appendSysExData(CableState& state, const std::uint8_t* bytes, int numBytes) {
+  for (int i = 0; i < numBytes; ++i) {
+    if (bytes[i] >= 0x80) { return false; }
+  }
+  if (state.sysExOverflowed) { return true; }
+
+  // Leave room for the terminating EOX.
+  if (static_cast<int>(state.sysEx.size()) + numBytes > options_.maxSysExBytes - 1) {
+    // Keep only the start, to skip the rest of this message.
+    state.sysExOverflowed = true;
+    state.sysEx.resize(1);
+    return true;
+  }
+  state.sysEx.insert(state.sysEx.end(), bytes, bytes + numBytes);
+  return true;
+}
+
+int UsbMidiDecoder::appendSysExRun(const std::uint8_t* packets, int i, int numPackets) {
+  const std::uint8_t header = packets[i * kUsbMidiPacketBytes];
+  CableState& state = cables_[header >> 4];
+
+  int end = i + 1;
+  while ((end < numPackets) && (packets[end * kUsbMidiPacketBytes] == header)) { ++end; }
+  if (!state.sysExOverflowed) {
+    state.sysEx.reserve(state.sysEx.size() + 3 * static_cast<std::size_t>(end - i));
+  }
+
+  for (; i < end; ++i) {
+    const std::uint8_t* bytes = &packets[i * kUsbMidiPacketBytes + 1];
+    const int numStartBytes = (bytes[0] == kSysExStart) ? 1 : 0;
+    if (numStartBytes > 0) { startSysEx(state); }
+    if (state.sysEx.empty()) {
+      ++numDiscardedPackets_;
+      continue;
+    }
+    if (!appendSysExData(state, &bytes[numStartBytes], 3 - numStartBytes)) {
+      dropSysEx(state);
+      ++numDiscardedPackets_;
+    }
+  }
+  return end;
+}
+
+}  // namespace bmmidi
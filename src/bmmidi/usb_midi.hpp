@@ -0,0 +1,291 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef BMMIDI_USB_MIDI_HPP
+#define BMMIDI_USB_MIDI_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bmmidi/cpp_features.hpp"
+#include "bmmidi/msg_reference.hpp"
+#include "bmmidi/sysex.hpp"
+
+namespace bmmidi {
+
+/** # of bytes in each USB-MIDI 1.0 event packet. */
+BMMIDI_INLINE_VAR static constexpr int kUsbMidiPacketBytes = 4;
+
+/** # of virtual cables addressable by USB-MIDI 1.0 event packets. */
+BMMIDI_INLINE_VAR static constexpr int kNumUsbMidiCables = 16;
+
+/**
+ * USB-MIDI 1.0 Code Index Number (CIN), stored in the lower 4 bits of the
+ * first byte of each event packet (with the cable number in the upper 4 bits),
+ * which classifies the (up to 3) MIDI bytes that follow.
+ */
+enum class UsbMidiCin : std::uint8_t {
+  /** Reserved for future extensions. */
+  kMisc = 0x0,
+
+  /** Reserved for future cable events. */
+  kCableEvent = 0x1,
+
+  /** 2-byte System Common message (MTC Quarter Frame, Song Select). */
+  kSystemCommon2 = 0x2,
+
+  /** 3-byte System Common message (Song Position Pointer). */
+  kSystemCommon3 = 0x3,
+
+  /** SysEx starts or continues (3 bytes). */
+  kSysExContinue = 0x4,
+
+  /** 1-byte System Common message (Tune Request), or SysEx ends with 1 byte. */
+  kSysExEnd1 = 0x5,
+
+  /** SysEx ends with 2 bytes. */
+  kSysExEnd2 = 0x6,
+
+  /** SysEx ends with 3 bytes. */
+  kSysExEnd3 = 0x7,
+
+  kNoteOff = 0x8,
+  kNoteOn = 0x9,
+  kPolyphonicKeyPressure = 0xA,
+  kControlChange = 0xB,
+  kProgramChange = 0xC,
+  kChannelPressure = 0xD,
+  kPitchBend = 0xE,
+
+  /** Single byte (System Realtime message). */
+  kSingleByte = 0xF,
+};
+
+/** Returns # of event packets needed to send msg. */
+inline int numUsbMidiPackets(const MsgView& msg) {
+  // Only SysEx messages span multiple packets.
+  return (msg.numBytes() + 2) / 3;
+}
+
+/**
+ * Encodes msg for the given cable as USB-MIDI event packets written to
+ * packets, which must have room for numUsbMidiPackets(msg) packets, returning
+ * the # of packets written. Unused trailing bytes of each packet are 0.
+ */
+int encodeUsbMidiMsg(int cable, const MsgView& msg, std::uint8_t* packets);
+
+namespace internal {
+
+inline MsgView usbMidiMsgOf(const MsgView& msg) { return msg; }
+inline MsgView usbMidiMsgOf(const TimedMsgView& msg) { return msg.value(); }
+
+}  // namespace internal
+
+/**
+ * Appends USB-MIDI event packets for the given cable encoding every message of
+ * msgs (any range of Msg<N>, MsgView, or TimedMsgView, e.g. a TimedMsgBuffer)
+ * to packets, growing packets only once.
+ */
+template<typename MsgRange>
+void encodeUsbMidiMsgs(int cable, const MsgRange& msgs, std::vector<std::uint8_t>& packets) {
+  int numPackets = 0;
+  for (const auto& msg : msgs) { numPackets += numUsbMidiPackets(internal::usbMidiMsgOf(msg)); }
+
+  std::size_t offset = packets.size();
+  packets.resize(offset + static_cast<std::size_t>(numPackets) * kUsbMidiPacketBytes);
+  for (const auto& msg : msgs) {
+    offset += kUsbMidiPacketBytes
+        * encodeUsbMidiMsg(cable, internal::usbMidiMsgOf(msg), &packets[offset]);
+  }
+}
+
+/** Options for UsbMidiDecoder. */
+struct UsbMidiDecoderOptions {
+  /**
+   * Maximum # of bytes (F0 through F7, inclusive) of a reassembled SysEx
+   * message. Longer SysEx messages are dropped (see numDroppedSysEx()).
+   */
+  int maxSysExBytes = 64 * 1024;
+};
+
+/**
+ * Decodes batches of USB-MIDI 1.0 event packets (e.g. the contents of bulk
+ * transfers) into complete messages, reassembling SysEx messages per cable
+ * across packets and decode() calls.
+ *
+ * Non-SysEx messages are emitted as views directly into the packet bytes, and
+ * each run of SysEx packets for a cable is appended straight into that cable's
+ * reassembly storage, so the cost per packet is a few byte comparisons.
+ *
+ * Malformed packets (reserved CINs, status bytes that do not match their CIN,
+ * or SysEx data without a start) are discarded and counted, as are SysEx
+ * messages that are interrupted, longer than maxSysExBytes, or too short for a
+ * complete SysEx header (e.g. F0 F7).
+ */
+class UsbMidiDecoder {
+public:
+  explicit UsbMidiDecoder(const UsbMidiDecoderOptions& options = UsbMidiDecoderOptions{});
+
+  /**
+   * Decodes packets[0, numPackets * kUsbMidiPacketBytes), calling
+   * emit(int cable, const MsgView&) for each complete message in order.
+   *
+   * Emitted MsgView references are only valid during each emit() call.
+   */
+  template<typename EmitFn>
+  void decode(const std::uint8_t* packets, int numPackets, EmitFn&& emit) {
+    assert((packets != nullptr) || (numPackets == 0));
+    int i = 0;
+    while (i < numPackets) {
+      const std::uint8_t* packet = &packets[i * kUsbMidiPacketBytes];
+      const int cable = packet[0] >> 4;
+      const auto cin = static_cast<UsbMidiCin>(packet[0] & 0x0F);
+
+      if (cin == UsbMidiCin::kSysExContinue) {
+        i = appendSysExRun(packets, i, numPackets);
+        continue;
+      }
+      ++i;
+
+      const int numBytes = numMsgBytes(cin, packet[1]);
+      if (numBytes > 0) {
+        if (isValidMsgPacket(cin, packet, numBytes)) {
+          // Anything but realtime interrupts (and so invalidates) SysEx.
+          if ((packet[1] < kFirstRealtimeStatus) && isInSysEx(cable)) {
+            dropSysEx(cables_[cable]);
+          }
+          emit(cable, MsgView{&packet[1], numBytes});
+        } else {
+          ++numDiscardedPackets_;
+        }
+      } else if (numBytes < 0) {
+        endSysEx(cable, packet, -numBytes, emit);
+      } else {
+        ++numDiscardedPackets_;
+      }
+    }
+  }
+
+  /** Decodes all packets in data (any contiguous container of std::uint8_t). */
+  template<typename Container, typename EmitFn>
+  void decode(const Container& data, EmitFn&& emit) {
+    decode(data.data(), static_cast<int>(data.size()) / kUsbMidiPacketBytes,
+           std::forward<EmitFn>(emit));
+  }
+
+  /** Forgets all incomplete SysEx messages. Does not reset counters. */
+  void reset();
+
+  /** Returns true if currently in the middle of a SysEx message on cable. */
+  bool isInSysEx(int cable) const {
+    assert((0 <= cable) && (cable < kNumUsbMidiCables));
+    return !cables_[cable].sysEx.empty();
+  }
+
+  /** Returns # of malformed packets discarded since construction. */
+  std::int64_t numDiscardedPackets() const { return numDiscardedPackets_; }
+
+  /** Returns # of interrupted, too long, or too short SysEx messages dropped since construction. */
+  std::int64_t numDroppedSysEx() const { return numDroppedSysEx_; }
+
+private:
+  static constexpr std::uint8_t kSysExStart = 0xF0;
+  static constexpr std::uint8_t kEox = 0xF7;
+  static constexpr std::uint8_t kFirstRealtimeStatus = 0xF8;
+
+  struct CableState {
+    // SysEx bytes so far (starting with F0), or empty if not in SysEx.
+    std::vector<std::uint8_t> sysEx;
+    bool sysExOverflowed = false;
+  };
+
+  // Returns # of message bytes in a non-SysEx packet with the given CIN and
+  // first byte, -(# of bytes) for a packet ending SysEx, or 0 if the CIN is
+  // reserved.
+  static int numMsgBytes(UsbMidiCin cin, std::uint8_t firstByte) {
+    switch (cin) {
+      case UsbMidiCin::kMisc:
+      case UsbMidiCin::kCableEvent:
+      case UsbMidiCin::kSysExContinue:
+        return 0;
+
+      case UsbMidiCin::kSysExEnd1:
+        // Also used for Tune Request.
+        return (firstByte == kEox) ? -1 : 1;
+
+      case UsbMidiCin::kSysExEnd2:
+        return -2;
+
+      case UsbMidiCin::kSysExEnd3:
+        return -3;
+
+      case UsbMidiCin::kSingleByte:
+        return 1;
+
+      case UsbMidiCin::kSystemCommon2:
+      case UsbMidiCin::kProgramChange:
+      case UsbMidiCin::kChannelPressure:
+        return 2;
+
+      default:
+        return 3;
+    }
+  }
+
+  static bool isValidMsgPacket(UsbMidiCin cin, const std::uint8_t* packet, int numBytes);
+
+  template<typename EmitFn>
+  void endSysEx(int cable, const std::uint8_t* packet, int numBytes, EmitFn& emit) {
+    CableState& state = cables_[cable];
+    const std::uint8_t* bytes = &packet[1];
+    const int numStartBytes = (bytes[0] == kSysExStart) ? 1 : 0;
+    if (numStartBytes > 0) { startSysEx(state); }
+    if (state.sysEx.empty()) {
+      ++numDiscardedPackets_;
+      return;
+    }
+
+    if ((bytes[numBytes - 1] != kEox)
+        || !appendSysExData(state, &bytes[numStartBytes], numBytes - 1 - numStartBytes)) {
+      dropSysEx(state);
+      ++numDiscardedPackets_;
+      return;
+    }
+    if (state.sysExOverflowed) {
+      dropSysEx(state);
+      return;
+    }
+
+    state.sysEx.push_back(std::uint8_t{kEox});
+    if (!internal::hasCompleteSysExHeader(state.sysEx.data(),
+                                          static_cast<int>(state.sysEx.size()))) {
+      dropSysEx(state);  // E.g. empty (F0 F7), so unusable as any SysEx reference.
+      return;
+    }
+    emit(cable, MsgView{state.sysEx.data(), static_cast<int>(state.sysEx.size())});
+    state.sysEx.clear();
+  }
+
+  void startSysEx(CableState& state);
+  void dropSysEx(CableState& state);
+
+  // Appends data bytes[0, numBytes) to SysEx (unless it already overflowed),
+  // returning false if any is not a data byte.
+  bool appendSysExData(CableState& state, const std::uint8_t* bytes, int numBytes);
+
+  // Appends the run of SysEx start/continue packets (for the same cable)
+  // starting at packet i, returning the index of the packet just past it.
+  int appendSysExRun(const std::uint8_t* packets, int i, int numPackets);
+
+  UsbMidiDecoderOptions options_;
+  CableState cables_[kNumUsbMidiCables];
+  std::int64_t numDiscardedPackets_ = 0;
+  std::int64_t numDroppedSysEx_ = 0;
+};
+
+}  // namespace bmmidi
+
+#endif  // BMMIDI_USB_MIDI_HPP
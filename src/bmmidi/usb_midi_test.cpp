@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: 2022 Barndollar Music, Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "bmmidi/usb_midi.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "bmmidi/msg.hpp"
+#include "bmmidi/msg_buffer.hpp"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+using Bytes = std::vector<std::uint8_t>;
+
+// Each decoded message as {cable, bytes...}.
+using Msgs = std::vector<std::vector<int>>;
+
+Msgs decodeAll(bmmidi::UsbMidiDecoder& decoder, const Bytes& packets) {
+  Msgs result;
+  decoder.decode(packets, [&result](int cable, const bmmidi::MsgView& msg) {
+    EXPECT_THAT(bmmidi::isValidMsg(msg.rawBytes(), msg.numBytes()), IsTrue());
+    std::vector<int> entry{cable};
+    entry.insert(entry.end(), msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+    result.push_back(entry);
+  });
+  return result;
+}
+
+Bytes encode(int cable, const Bytes& bytes) {
+  const bmmidi::MsgView msg{bytes.data(), static_cast<int>(bytes.size())};
+  Bytes packets(bmmidi::kUsbMidiPacketBytes * bmmidi::numUsbMidiPackets(msg));
+  bmmidi::encodeUsbMidiMsg(cable, msg, packets.data());
+  return packets;
+}
+
+TEST(UsbMidi, EncodesMsgs) {
+  EXPECT_THAT(encode(0, {0x93, 60, 100}), ElementsAre(0x09, 0x93, 60, 100));
+  EXPECT_THAT(encode(1, {0xC2, 5}), ElementsAre(0x1C, 0xC2, 5, 0));
+  EXPECT_THAT(encode(2, {0xF2, 0x10, 0x20}), ElementsAre(0x23, 0xF2, 0x10, 0x20));
+  EXPECT_THAT(encode(3, {0xF3, 0x04}), ElementsAre(0x32, 0xF3, 0x04, 0));
+  EXPECT_THAT(encode(4, {0xF6}), ElementsAre(0x45, 0xF6, 0, 0));
+  EXPECT_THAT(encode(15, {0xF8}), ElementsAre(0xFF, 0xF8, 0, 0));
+}
+
+TEST(UsbMidi, EncodesSysExAcrossPackets) {
+  EXPECT_THAT(encode(0, {0xF0, 0xF7}), ElementsAre(0x06, 0xF0, 0xF7, 0));
+  EXPECT_THAT(encode(0, {0xF0, 1, 0xF7}), ElementsAre(0x07, 0xF0, 1, 0xF7));
+  EXPECT_THAT(encode(1, {0xF0, 1, 2, 0xF7}),
+              ElementsAre(0x14, 0xF0, 1, 2, 0x15, 0xF7, 0, 0));
+  EXPECT_THAT(encode(1, {0xF0, 1, 2, 3, 4, 0xF7}),
+              ElementsAre(0x14, 0xF0, 1, 2, 0x17, 3, 4, 0xF7));
+  EXPECT_THAT(encode(1, {0xF0, 1, 2, 3, 4, 5, 0xF7}),
+              ElementsAre(0x14, 0xF0, 1, 2, 0x14, 3, 4, 5, 0x15, 0xF7, 0, 0));
+}
+
+TEST(UsbMidi, EncodesMsgRanges) {
+  const std::vector<bmmidi::ControlChangeMsg> msgs = {
+      bmmidi::ControlChangeMsg{bmmidi::Channel::index(0), bmmidi::Control::kChannelVolume,
+                               bmmidi::DataValue{100}},
+      bmmidi::ControlChangeMsg{bmmidi::Channel::index(1), bmmidi::Control::kPan,
+                               bmmidi::DataValue{64}}};
+  Bytes packets = {0x0F, 0xF8, 0, 0};
+  bmmidi::encodeUsbMidiMsgs(0, msgs, packets);
+  EXPECT_THAT(packets, ElementsAre(0x0F, 0xF8, 0, 0, 0x0B, 0xB0, 7, 100, 0x0B, 0xB1, 10, 64));
+
+  bmmidi::TimedMsgBuffer buffer;
+  const Bytes sysEx = {0xF0, 1, 2, 3, 0xF7};
+  buffer.push(0.0, sysEx.data(), static_cast<int>(sysEx.size()));
+  packets.clear();
+  bmmidi::encodeUsbMidiMsgs(2, buffer, packets);
+  EXPECT_THAT(packets, ElementsAre(0x24, 0xF0, 1, 2, 0x26, 3, 0xF7, 0));
+}
+
+TEST(UsbMidiDecoder, DecodesMsgs) {
+  bmmidi::UsbMidiDecoder decoder;
+  EXPECT_THAT(decodeAll(decoder, {0x09, 0x93, 60, 100, 0x1C, 0xC2, 5, 0, 0x23, 0xF2, 0x10, 0x20,
+                                  0x32, 0xF3, 0x04, 0, 0x45, 0xF6, 0, 0, 0xFF, 0xF8, 0, 0}),
+              ElementsAre(ElementsAre(0, 0x93, 60, 100), ElementsAre(1, 0xC2, 5),
+                          ElementsAre(2, 0xF2, 0x10, 0x20), ElementsAre(3, 0xF3, 0x04),
+                          ElementsAre(4, 0xF6), ElementsAre(15, 0xF8)));
+  EXPECT_THAT(decoder.numDiscardedPackets(), Eq(0));
+}
+
+TEST(UsbMidiDecoder, ReassemblesSysExPerCable) {
+  bmmidi::UsbMidiDecoder decoder;
+  EXPECT_THAT(decodeAll(decoder, {0x04, 0xF0, 1, 2, 0x14, 0xF0, 9, 9, 0x0F, 0xF8, 0, 0,
+                                  0x04, 3, 4, 5}),
+              ElementsAre(ElementsAre(0, 0xF8)));
+  EXPECT_THAT(decoder.isInSysEx(0), IsTrue());
+  EXPECT_THAT(decoder.isInSysEx(1), IsTrue());
+
+  EXPECT_THAT(decodeAll(decoder, {0x06, 6, 0xF7, 0, 0x15, 0xF7, 0, 0}),
+              ElementsAre(ElementsAre(0, 0xF0, 1, 2, 3, 4, 5, 6, 0xF7),
+                          ElementsAre(1, 0xF0, 9, 9, 0xF7)));
+  EXPECT_THAT(decoder.isInSysEx(0), IsFalse());
+  EXPECT_THAT(decodeAll(decoder, {0x07, 0xF0, 1, 0xF7, 0x06, 0xF0, 0xF7, 0}),
+              ElementsAre(ElementsAre(0, 0xF0, 1, 0xF7)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));  // Empty SysEx has no ID.
+}
+
+TEST(UsbMidiDecoder, RoundTripsLargeSysEx) {
+  Bytes sysEx(10000, 0x55);
+  sysEx.front() = 0xF0;
+  sysEx.back() = 0xF7;
+  const Bytes packets = encode(5, sysEx);
+
+  bmmidi::UsbMidiDecoder decoder;
+  Bytes decoded;
+  decoder.decode(packets, [&decoded](int cable, const bmmidi::MsgView& msg) {
+    EXPECT_THAT(cable, Eq(5));
+    decoded.assign(msg.rawBytes(), msg.rawBytes() + msg.numBytes());
+  });
+  EXPECT_THAT(decoded, Eq(sysEx));
+}
+
+TEST(UsbMidiDecoder, DiscardsMalformedPackets) {
+  bmmidi::UsbMidiDecoder decoder;
+  EXPECT_THAT(decodeAll(decoder, {0x00, 0x90, 60, 100,    // Reserved CIN.
+                                  0x09, 0x80, 60, 100,    // Status does not match CIN.
+                                  0x09, 0x90, 0x80, 100,  // Status as data.
+                                  0x04, 1, 2, 3,          // SysEx without start.
+                                  0x05, 0xF7, 0, 0,       // SysEx end without start.
+                                  0x0F, 0xF9, 0, 0}),     // Undefined realtime.
+              IsEmpty());
+  EXPECT_THAT(decoder.numDiscardedPackets(), Eq(6));
+
+  // Interrupted SysEx.
+  EXPECT_THAT(decodeAll(decoder, {0x04, 0xF0, 1, 2, 0x08, 0x80, 60, 0, 0x05, 0xF7, 0, 0}),
+              ElementsAre(ElementsAre(0, 0x80, 60, 0)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));
+  EXPECT_THAT(decoder.numDiscardedPackets(), Eq(7));
+}
+
+TEST(UsbMidiDecoder, DropsTooLongSysEx) {
+  bmmidi::UsbMidiDecoderOptions options;
+  options.maxSysExBytes = 5;
+  bmmidi::UsbMidiDecoder decoder{options};
+
+  EXPECT_THAT(decodeAll(decoder, {0x04, 0xF0, 1, 2, 0x06, 3, 0xF7, 0}),
+              ElementsAre(ElementsAre(0, 0xF0, 1, 2, 3, 0xF7)));
+  EXPECT_THAT(decodeAll(decoder, {0x04, 0xF0, 1, 2, 0x07, 3, 4, 0xF7, 0x0F, 0xFA, 0, 0}),
+              ElementsAre(ElementsAre(0, 0xFA)));
+  EXPECT_THAT(decoder.numDroppedSysEx(), Eq(1));
+}
+
+}  // namespace